@@ -51,6 +51,25 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 //
 #define OC_SCAN_POLICY_VARIABLE_NAME       L"scan-policy"
 
+//
+// Variable used for caching boot entry scan results between boots (if enabled).
+// Boot Services only.
+//
+#define OC_SCAN_CACHE_VARIABLE_NAME        L"boot-scan-cache"
+
+//
+// Variable used for sharing TSC frequency calibrated against ACPI PM timer
+// between the images within the same boot. Volatile, Boot Services only.
+//
+#define OC_TSC_FREQUENCY_VARIABLE_NAME     L"tsc-frequency"
+
+//
+// Variable used for keeping OC_CPU_INFO_TABLE between boots (if enabled).
+// Reused only with matching CPUID signature and microcode revision.
+// Boot Services only.
+//
+#define OC_CPU_INFO_VARIABLE_NAME          L"cpu-info"
+
 //
 // Variable used to report OpenCore version in the following format:
 // REL-001-2019-01-01. This follows versioning style of Lilu and plugins.
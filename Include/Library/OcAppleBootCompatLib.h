@@ -64,6 +64,12 @@ typedef struct OC_ABC_SETTINGS_ {
   ///
   BOOLEAN  ShrinkMemoryMap;
   ///
+  /// Sort memory map descriptors by address before shrinking them, as some firmwares
+  /// report them out of order preventing adjacent ranges from being joined.
+  /// Requires ShrinkMemoryMap.
+  ///
+  BOOLEAN  SortMemoryMap;
+  ///
   /// Ensure that ExitBootServices call succeeds even with outdated MemoryMap key.
   ///
   BOOLEAN  ForceExitBootServices;
@@ -31,4 +31,17 @@ OcAppleImageConversionInstallProtocol (
   IN BOOLEAN  Reinstall
   );
 
+/**
+  Set the memory budget of the decoded image cache.
+  Decoded images are cached by content hash, so that decoding the same
+  image again only copies the pixels. Least recently used images are
+  evicted first. The default budget is 4 MB, 0 disables the cache.
+
+  @param[in] MaxCacheSize  Maximum total size of cached images.
+**/
+VOID
+OcAppleImageConversionSetCacheSize (
+  IN UINTN  MaxCacheSize
+  );
+
 #endif // OC_APPLE_IMAGE_CONVERSION_LIB_H
@@ -19,7 +19,9 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #ifndef APPLE_DXE_IMAGE_VERIFICATION_H
 #define APPLE_DXE_IMAGE_VERIFICATION_H
 
+#include <Guid/AppleCertificate.h>
 #include <IndustryStandard/PeImage.h>
+#include <Library/OcCryptoLib.h>
 
 #define APPLE_SIGNATURE_SECENTRY_SIZE 8
 
@@ -51,6 +53,35 @@ typedef struct APPLE_SIGNATURE_CONTEXT_ {
   UINT8                            Signature[256];
 } APPLE_SIGNATURE_CONTEXT;
 
+//
+// Region of the image covered by the signature hash.
+//
+typedef struct APPLE_PE_IMAGE_HASH_RANGE_ {
+  UINT32                           Start;
+  UINT32                           End;
+} APPLE_PE_IMAGE_HASH_RANGE;
+
+#define APPLE_PE_IMAGE_HASH_RANGES 4
+
+//
+// Streaming verification context
+//
+typedef struct APPLE_PE_IMAGE_STREAM_CONTEXT_ {
+  EFI_STATUS                          Status;
+  UINT32                              ImageSize;
+  UINT32                              Position;
+  UINT8                               *Headers;
+  UINT32                              HeadersSize;
+  BOOLEAN                             HasPeContext;
+  UINT32                              PeHdrOffset;
+  UINT32                              SignatureOffset;
+  UINT32                              RealImageSize;
+  APPLE_PE_IMAGE_HASH_RANGE           HashRanges[APPLE_PE_IMAGE_HASH_RANGES];
+  APPLE_PE_COFF_LOADER_IMAGE_CONTEXT  PeContext;
+  SHA256_CONTEXT                      HashContext;
+  UINT8                               Signature[sizeof (APPLE_EFI_CERTIFICATE_INFO) + sizeof (APPLE_EFI_CERTIFICATE)];
+} APPLE_PE_IMAGE_STREAM_CONTEXT;
+
 //
 // Function prototypes
 //
@@ -88,4 +119,66 @@ VerifyApplePeImageSignature (
   IN OUT UINTN                               *ImageSize
   );
 
+/**
+  Start streaming verification of an Apple-signed PE image.
+  Image data is then passed to ApplePeImageStreamUpdate in file order,
+  and the result is obtained from ApplePeImageStreamFinal.
+
+  @param[out] Stream     Streaming verification context.
+  @param[in]  ImageSize  Total size of the image file in bytes.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+ApplePeImageStreamInit (
+  OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+  IN  UINTN                          ImageSize
+  );
+
+/**
+  Pass the next part of the image to streaming verification.
+  Only the image headers are buffered, the rest is hashed in place.
+  The image is sanitised in place, i.e. DOS stub and data past the
+  signature are zeroed in Data, just like VerifyApplePeImageSignature does.
+
+  @param[in,out] Stream    Streaming verification context.
+  @param[in,out] Data      Next part of the image.
+  @param[in]     DataSize  Size of Data in bytes.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+ApplePeImageStreamUpdate (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+  IN OUT VOID                           *Data,
+  IN     UINTN                          DataSize
+  );
+
+/**
+  Complete streaming verification and free its resources.
+
+  @param[in,out] Stream         Streaming verification context.
+  @param[out]    RealImageSize  Image size without data past the signature.
+
+  @retval EFI_SUCCESS             The image is correctly signed.
+  @retval EFI_INVALID_PARAMETER   The image is malformed or incomplete.
+  @retval EFI_UNSUPPORTED         The image has no valid Apple signature.
+  @retval EFI_SECURITY_VIOLATION  The image signature is invalid.
+**/
+EFI_STATUS
+ApplePeImageStreamFinal (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+     OUT UINTN                          *RealImageSize
+  );
+
+/**
+  Abort streaming verification and free its resources.
+
+  @param[in,out] Stream  Streaming verification context.
+**/
+VOID
+ApplePeImageStreamFree (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream
+  );
+
 #endif //APPLE_DXE_IMAGE_VERIFICATION_H
@@ -47,4 +47,29 @@ AppleImg4Verify (
   OUT UINTN                             *DigestSize OPTIONAL
   );
 
+/**
+  Begin an IMG4 verification session. Within a session the hardware
+  environment is retrieved only once, and Manifests which passed signature
+  verification are remembered by their digest, so that further objects
+  verified against the same Manifest only need their image digest checked.
+  An active session is restarted.
+
+  Sessions are opt-in. Callers verifying the objects of one boot, e.g. the
+  kernel, kernelcache and drivers, should wrap that sequence and end the
+  session before NVRAM may change.
+**/
+VOID
+OcAppleImg4BeginSession (
+  VOID
+  );
+
+/**
+  End the IMG4 verification session and forget verified Manifests.
+  Does nothing when no session is active.
+**/
+VOID
+OcAppleImg4EndSession (
+  VOID
+  );
+
 #endif // OC_APPLE_IMG4_LIB_H
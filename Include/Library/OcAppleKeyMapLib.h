@@ -27,6 +27,18 @@ OcAppleKeyMapGetDatabase (
   VOID
   );
 
+/**
+  Returns an event signalled whenever pressed keys or modifiers change
+  in the Apple Key Map Database installed by this library. The event
+  can be passed to WaitForEvent and must not be closed by the caller.
+
+  @retval change event or NULL when the database was installed by others.
+**/
+EFI_EVENT
+OcAppleKeyMapGetChangeEvent (
+  VOID
+  );
+
 /**
   Install and initialise Apple Key Map protocols.
 
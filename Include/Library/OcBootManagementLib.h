@@ -18,6 +18,8 @@
 #include <Uefi.h>
 #include <IndustryStandard/AppleBootArgs.h>
 #include <Library/OcAppleBootPolicyLib.h>
+#include <Library/OcDevicePathLib.h>
+#include <Protocol/DevicePath.h>
 #include <Protocol/LoadedImage.h>
 
 /**
@@ -53,6 +55,12 @@ typedef struct OC_BOOT_ENTRY_ {
   //
   EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
   //
+  // Fingerprint of DevicePath for quick matching against boot options.
+  // Must be refreshed with OcGetDevicePathFingerprint whenever DevicePath
+  // changes. Zero Size means it has not been computed yet.
+  //
+  OC_DEVICE_PATH_FINGERPRINT DevicePathFingerprint;
+  //
   // Action to perform on execution. Only valid for system entries.
   //
   OC_BOOT_SYSTEM_ACTION     SystemAction;
@@ -427,6 +435,15 @@ typedef struct {
   //
   CHAR16           **CustomBootPaths;
   //
+  // Issue non-blocking booter probes for all volumes before scanning them.
+  // Requires EFI_FILE_PROTOCOL revision 2, volumes without it are scanned as usual.
+  //
+  BOOLEAN          ProbeVolumesAsync;
+  //
+  // Cache scan results in NVRAM and reuse them for volumes with unchanged booters.
+  //
+  BOOLEAN          UseScanCache;
+  //
   // Number of absolute custom entries.
   //
   UINT32           AbsoluteEntryCount;
@@ -117,4 +117,51 @@ DecompressZLIB (
   IN  UINTN        SrcLen
   );
 
+/**
+  ZLIB decompressor keeping its state allocated between decompressions.
+**/
+typedef struct OC_ZLIB_DECOMPRESSOR_ OC_ZLIB_DECOMPRESSOR;
+
+/**
+  Allocate ZLIB decompressor for DecompressZLIBWith.
+
+  @return  Decompressor on success otherwise NULL.
+**/
+OC_ZLIB_DECOMPRESSOR *
+CreateZLIBDecompressor (
+  VOID
+  );
+
+/**
+  Free ZLIB decompressor allocated by CreateZLIBDecompressor.
+
+  @param[in]  Decompressor  Decompressor to free.
+**/
+VOID
+FreeZLIBDecompressor (
+  IN OC_ZLIB_DECOMPRESSOR  *Decompressor
+  );
+
+/**
+  Decompress buffer with ZLIB algorithm reusing decompressor state.
+  This avoids state allocation and initialisation on every call compared
+  to DecompressZLIB.
+
+  @param[in,out]  Decompressor  Decompressor from CreateZLIBDecompressor.
+  @param[out]     Dst           Destination buffer.
+  @param[in]      DstLen        Destination buffer size.
+  @param[in]      Src           Source buffer.
+  @param[in]      SrcLen        Source buffer size.
+
+  @return  DecompressedLen on success otherwise 0.
+**/
+UINTN
+DecompressZLIBWith (
+  IN OUT OC_ZLIB_DECOMPRESSOR  *Decompressor,
+  OUT    UINT8                 *Dst,
+  IN     UINTN                 DstLen,
+  IN     CONST UINT8           *Src,
+  IN     UINTN                 SrcLen
+  );
+
 #endif // OC_COMPRESSION_LIB_H
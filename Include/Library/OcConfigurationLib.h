@@ -123,7 +123,8 @@
   _(BOOLEAN                     , ProtectCsmRegion          ,     , FALSE  , ()) \
   _(BOOLEAN                     , ProvideCustomSlide        ,     , FALSE  , ()) \
   _(BOOLEAN                     , SetupVirtualMap           ,     , FALSE  , ()) \
-  _(BOOLEAN                     , ShrinkMemoryMap           ,     , FALSE  , ())
+  _(BOOLEAN                     , ShrinkMemoryMap           ,     , FALSE  , ()) \
+  _(BOOLEAN                     , SortMemoryMap             ,     , FALSE  , ())
   OC_DECLARE (OC_BOOTER_QUIRKS)
 
 ///
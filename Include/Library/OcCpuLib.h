@@ -119,8 +119,38 @@ typedef struct {
   UINT64                  FSBFrequency;
 } OC_CPU_INFO;
 
+//
+// Configuration table holding the OC_CPU_INFO snapshot of the first
+// OcCpuScanProcessor call during this boot. Other images reuse it instead
+// of probing CPUID, MSRs and the timers again.
+// 0FB30992-CDDB-43C3-90F3-A7EE6CC9EDBA
+//
+#define OC_CPU_INFO_TABLE_GUID \
+  { \
+    0x0fb30992, 0xcddb, 0x43c3, { 0x90, 0xf3, 0xa7, 0xee, 0x6c, 0xc9, 0xed, 0xba } \
+  }
+
+extern EFI_GUID       gOcCpuInfoTableGuid;
+
+//
+// Bump on any OC_CPU_INFO layout or field meaning change. Tables and
+// persisted copies with a different revision or size are ignored.
+// Revision 2 reads MicrocodeRevision from the upper half of the MSR.
+//
+#define OC_CPU_INFO_TABLE_REVISION 2
+
+typedef struct {
+  UINT32       Revision;
+  UINT32       Size;
+  OC_CPU_INFO  CpuInfo;
+} OC_CPU_INFO_TABLE;
+
 /**
   Scan the processor and fill the cpu info structure with results.
+  The first scan during this boot is published through gOcCpuInfoTableGuid
+  configuration table and returned to subsequent callers without rescanning.
+  With PcdOcCpuPersistInfo the snapshot is also kept in NVRAM and reused on
+  next boots as long as CPUID signature and microcode revision match.
 
   @param[in] Cpu  A pointer to the cpu info structure to fill with results.
 **/
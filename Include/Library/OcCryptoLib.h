@@ -77,8 +77,10 @@ typedef enum OC_SIG_HASH_TYPE_ {
 } OC_SIG_HASH_TYPE;
 
 typedef struct AES_CONTEXT_ {
-  UINT8 RoundKey[AES_KEY_EXP_SIZE];
-  UINT8 Iv[AES_BLOCK_SIZE];
+  UINT8  RoundKey[AES_KEY_EXP_SIZE];
+  UINT32 EncRoundKey[AES_KEY_EXP_SIZE / sizeof (UINT32)];
+  UINT32 DecRoundKey[AES_KEY_EXP_SIZE / sizeof (UINT32)];
+  UINT8  Iv[AES_BLOCK_SIZE];
 } AES_CONTEXT;
 
 typedef struct MD5_CONTEXT_ {
@@ -94,6 +94,77 @@ IsDevicePathChild (
   IN  EFI_DEVICE_PATH_PROTOCOL      *ChildPath
   );
 
+/**
+  Device path fingerprint used to quickly reject mismatching device paths.
+  Equal device paths always have equal fingerprints, but not vice versa,
+  so a matching fingerprint must be confirmed by a regular comparison.
+**/
+typedef struct {
+  ///
+  /// Device path size in bytes including the end node, 0 when not computed.
+  ///
+  UINTN    Size;
+  ///
+  /// Size of the part preceding the first File Path node in bytes.
+  ///
+  UINTN    RootSize;
+  ///
+  /// Hash of the part preceding the first File Path node.
+  ///
+  UINT32   RootHash;
+  ///
+  /// Hash of the normalised file path, see OcGetFileDevicePathHash.
+  ///
+  UINT32   FilePathHash;
+  ///
+  /// Whether FilePathHash is valid.
+  ///
+  BOOLEAN  HasFilePathHash;
+} OC_DEVICE_PATH_FINGERPRINT;
+
+/**
+  Calculate hash of raw device path data.
+
+  @param[in] Data  Device path data to hash.
+  @param[in] Size  Size of Data in bytes.
+
+  @retval  Data hash.
+**/
+UINT32
+OcHashDevicePathData (
+  IN CONST VOID  *Data,
+  IN UINTN       Size
+  );
+
+/**
+  Calculate hash of the file path described by DevicePath.
+  The path is normalised the same way as FileDevicePathsEqual does,
+  i.e. case-insensitively and regardless of how it is split into nodes.
+
+  @param[in]  DevicePath  Device path starting with File Path nodes.
+  @param[out] Hash        Normalised file path hash.
+
+  @retval TRUE   DevicePath consists of File Path nodes followed by end node.
+  @retval FALSE  DevicePath cannot be hashed, Hash is not valid.
+**/
+BOOLEAN
+OcGetFileDevicePathHash (
+  IN  CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  OUT UINT32                          *Hash
+  );
+
+/**
+  Calculate device path fingerprint.
+
+  @param[in]  DevicePath   Device path to fingerprint.
+  @param[out] Fingerprint  Resulting fingerprint.
+**/
+VOID
+OcGetDevicePathFingerprint (
+  IN  CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  OUT OC_DEVICE_PATH_FINGERPRINT      *Fingerprint
+  );
+
 /**
   Get absolute device path.
 
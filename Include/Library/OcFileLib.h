@@ -56,7 +56,8 @@ LocateRootVolume (
   );
 
 /**
-  Locate file system from GUID.
+  Locate file system from GUID. When several file systems share the GUID,
+  e.g. on cloned disks, the first one in handle order is returned.
 
   @param[in]  Guid  GUID of the volume to locate.
 
@@ -131,6 +132,115 @@ GetFileData (
   OUT UINT8              *Buffer
   );
 
+/**
+  Default read-ahead window of buffered file readers.
+**/
+#define OC_FILE_READER_WINDOW_SIZE  BASE_64KB
+
+/**
+  Default block alignment of buffered file reader windows.
+**/
+#define OC_FILE_READER_BLOCK_SIZE   BASE_4KB
+
+/**
+  Buffered file reader state.
+  Small reads are served from a read-ahead window, large reads go directly
+  to the caller buffer, and the file position is tracked to avoid seeking.
+**/
+typedef struct {
+  EFI_FILE_PROTOCOL  *File;
+  UINT8              *Window;
+  UINT32             WindowSize;
+  UINT32             BlockSize;
+  UINT32             WindowPosition;
+  UINT32             WindowLength;
+  UINT64             FilePosition;
+  UINT32             FileSize;
+  BOOLEAN            HasFilePosition;
+  BOOLEAN            HasFileSize;
+} OC_FILE_READER;
+
+/**
+  Initialise buffered file reader.
+
+  @param[out] Reader       Reader to initialise.
+  @param[in]  File         A pointer to the file protocol.
+  @param[in]  WindowSize   Read-ahead window size, 0 disables buffering.
+  @param[in]  BlockSize    Window alignment, a power of two not above WindowSize.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+OcFileReaderInit (
+  OUT OC_FILE_READER     *Reader,
+  IN  EFI_FILE_PROTOCOL  *File,
+  IN  UINT32             WindowSize,
+  IN  UINT32             BlockSize
+  );
+
+/**
+  Free buffered file reader resources. The file is not closed.
+
+  @param[in,out] Reader    Reader to free.
+**/
+VOID
+OcFileReaderFree (
+  IN OUT OC_FILE_READER  *Reader
+  );
+
+/**
+  Read exact amount of bytes through buffered file reader,
+  same as GetFileData.
+
+  @param[in,out] Reader    Buffered file reader.
+  @param[in]     Position  Position to read data from.
+  @param[in]     Size      The size of the data read.
+  @param[out]    Buffer    A pointer to previously allocated buffer to read data to.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+OcFileReaderRead (
+  IN OUT OC_FILE_READER  *Reader,
+  IN     UINT32          Position,
+  IN     UINT32          Size,
+     OUT UINT8           *Buffer
+  );
+
+/**
+  Determine file size through buffered file reader, same as GetFileSize.
+  The size is only queried once.
+
+  @param[in,out] Reader    Buffered file reader.
+  @param[out]    Size      32-bit file size.
+
+  @retval EFI_SUCCESS on success.
+**/
+EFI_STATUS
+OcFileReaderGetSize (
+  IN OUT OC_FILE_READER  *Reader,
+     OUT UINT32          *Size
+  );
+
+/**
+  Read whole file contents. Small files are sized and read with a single
+  read request, larger ones are sized only after the first window is read.
+  The buffer is terminated with a CHAR16 zero, which is not accounted in
+  FileSize.
+
+  @param[in]  File         A pointer to the file protocol.
+  @param[out] FileSize     Size of the file read (optional).
+  @param[in]  MaxFileSize  Maximum file size (optional).
+
+  @retval A pointer to a buffer containing file read or NULL.
+**/
+VOID *
+OcGetFileContents (
+  IN  EFI_FILE_PROTOCOL  *File,
+  OUT UINT32             *FileSize    OPTIONAL,
+  IN  UINT32             MaxFileSize  OPTIONAL
+  );
+
 /**
   Write exact amount of bytes to a newly created file in EFI_FILE_PROTOCOL.
   Please note, that several filesystems (or drivers) may limit file name length.
@@ -116,6 +116,7 @@ GetCurrentMemoryMapAlloc (
 
 /**
   Shrink memory map by joining non-runtime records.
+  Only adjacent descriptors are joined, sort the map first if needed.
 
   @param[in,out]  MemoryMapSize      Memory map size in bytes, updated on shrink.
   @param[in,out]  MemoryMap          Memory map to shrink.
@@ -128,6 +129,20 @@ ShrinkMemoryMap (
   IN     UINTN                  DescriptorSize
   );
 
+/**
+  Sort memory map descriptors by physical address.
+
+  @param[in]      MemoryMapSize      Memory map size in bytes.
+  @param[in,out]  MemoryMap          Memory map to sort.
+  @param[in]      DescriptorSize     Memory map descriptor size in bytes.
+**/
+VOID
+SortMemoryMap (
+  IN     UINTN                  MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  );
+
 /**
   Check range allocation compatibility callback.
 
@@ -305,7 +320,8 @@ VmMapVirtualPage (
 
 /**
   Map (remap) a range of 4K pages at physical address to given virtual address
-  in the specified page table.
+  in the specified page table. 2 MB and 1 GB pages are used for the parts
+  of the range, where both addresses are suitably aligned.
 
   @param[in,out]  Context       Virtual memory pool context.
   @param[in]      PageTable     Page table to update.
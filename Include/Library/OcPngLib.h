@@ -64,6 +64,31 @@ DecodePng (
   OUT  BOOLEAN  *HasAlphaType OPTIONAL
   );
 
+/**
+  Decodes PNG image into EFI_UGA_PIXEL buffer with inverted alpha in Reserved.
+  8-bit RGBA images are decoded without any intermediate image buffer.
+
+  @param  Buffer                 Buffer with desired png image
+  @param  Size                   Size of input image
+  @param  RawData                Output EFI_UGA_PIXEL buffer, free with FreePool
+  @param  RawDataSize            Output buffer size
+  @param  Width                  Image width at output
+  @param  Height                 Image height at output
+
+  @return EFI_SUCCESS            The function completed successfully.
+  @return EFI_OUT_OF_RESOURCES   There are not enough resources to init state.
+  @return EFI_INVALID_PARAMETER  Passed wrong parameter
+**/
+EFI_STATUS
+DecodePngToUga (
+  IN   VOID     *Buffer,
+  IN   UINTN    Size,
+  OUT  VOID     **RawData,
+  OUT  UINTN    *RawDataSize,
+  OUT  UINT32   *Width,
+  OUT  UINT32   *Height
+  );
+
 /**
   Frees image buffer
 
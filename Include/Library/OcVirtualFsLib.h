@@ -110,4 +110,29 @@ DisableVirtualFs (
   IN OUT EFI_BOOT_SERVICES       *BootServices
   );
 
+/**
+  Enables read caching of real files accessed through virtual file systems.
+  Files opened read-only are read whole on first access and kept in memory
+  keyed by volume, path, size, and modification time, so that reopening them
+  does not touch the disk. Least recently used files are evicted first.
+  Can be called again to change the limit.
+
+  @param[in] MaxCacheSize  Maximum total size of cached file data.
+
+  @return  EFI_SUCCESS on success.
+**/
+EFI_STATUS
+EnableVirtualFsCache (
+  IN UINTN  MaxCacheSize
+  );
+
+/**
+  Disables read caching of real files and frees cached data.
+  Files currently open keep their cached data until closed.
+**/
+VOID
+DisableVirtualFsCache (
+  VOID
+  );
+
 #endif // OC_VIRTUAL_FS_LIB_H
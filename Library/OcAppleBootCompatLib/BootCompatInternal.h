@@ -98,6 +98,12 @@
 **/
 #define ESTIMATED_KERNEL_SIZE    ((UINTN) SIZE_128MB)
 
+/**
+  Maximum size of the post-processed memory map snapshot.
+  Currently hardcoded for simplicity, larger maps are not cached.
+**/
+#define MEMORY_MAP_SNAPSHOT_SIZE ((UINTN) EFI_PAGES_TO_SIZE (8))
+
 /**
   Preserved relocation entry.
 **/
@@ -193,6 +199,21 @@ typedef struct SERVICES_OVERRIDE_STATE_ {
   ///
   UINTN                         MemoryMapDescriptorSize;
   ///
+  /// Post-processed memory map returned to boot.efi last time,
+  /// MEMORY_MAP_SNAPSHOT_SIZE bytes long.
+  ///
+  EFI_MEMORY_DESCRIPTOR         *MemoryMapSnapshot;
+  ///
+  /// Post-processed memory map snapshot size, 0 when invalid.
+  ///
+  UINTN                         MemoryMapSnapshotSize;
+  ///
+  /// Original memory map size, map key, and descriptor size of the snapshot.
+  ///
+  UINTN                         MemoryMapSnapshotOriginalSize;
+  UINTN                         MemoryMapSnapshotMapKey;
+  UINTN                         MemoryMapSnapshotDescriptorSize;
+  ///
   /// Amount of nested boot.efi detected.
   ///
   UINTN                         AppleBootNestedCount;
@@ -22,6 +22,7 @@
 #include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
 #include <Library/OcBootManagementLib.h>
 #include <Library/OcMemoryLib.h>
 #include <Library/OcMiscLib.h>
@@ -467,6 +468,30 @@ OcGetMemoryMap (
   }
 
   if (BootCompat->ServiceState.AppleBootNestedCount > 0) {
+    //
+    // boot.efi requests the memory map several times in a row. When the
+    // firmware reports the same map, return the previous result without
+    // processing it again. MapKey changes with every memory map change,
+    // so the original service is called each time to obtain it.
+    //
+    if (BootCompat->ServiceState.MemoryMapSnapshotSize > 0
+      && BootCompat->ServiceState.MemoryMapSnapshotMapKey == *MapKey
+      && BootCompat->ServiceState.MemoryMapSnapshotOriginalSize == *MemoryMapSize
+      && BootCompat->ServiceState.MemoryMapSnapshotDescriptorSize == *DescriptorSize) {
+      CopyMem (
+        MemoryMap,
+        BootCompat->ServiceState.MemoryMapSnapshot,
+        BootCompat->ServiceState.MemoryMapSnapshotSize
+        );
+      *MemoryMapSize = BootCompat->ServiceState.MemoryMapSnapshotSize;
+      return Status;
+    }
+
+    BootCompat->ServiceState.MemoryMapSnapshotSize           = 0;
+    BootCompat->ServiceState.MemoryMapSnapshotMapKey         = *MapKey;
+    BootCompat->ServiceState.MemoryMapSnapshotOriginalSize   = *MemoryMapSize;
+    BootCompat->ServiceState.MemoryMapSnapshotDescriptorSize = *DescriptorSize;
+
     if (BootCompat->Settings.ProtectCsmRegion) {
       ProtectCsmRegion (
         *MemoryMapSize,
@@ -485,6 +510,14 @@ OcGetMemoryMap (
     }
 
     if (BootCompat->Settings.ShrinkMemoryMap) {
+      if (BootCompat->Settings.SortMemoryMap) {
+        SortMemoryMap (
+          *MemoryMapSize,
+          MemoryMap,
+          *DescriptorSize
+          );
+      }
+
       ShrinkMemoryMap (
         MemoryMapSize,
         MemoryMap,
@@ -492,6 +525,16 @@ OcGetMemoryMap (
         );
     }
 
+    if (BootCompat->ServiceState.MemoryMapSnapshot != NULL
+      && *MemoryMapSize <= MEMORY_MAP_SNAPSHOT_SIZE) {
+      CopyMem (
+        BootCompat->ServiceState.MemoryMapSnapshot,
+        MemoryMap,
+        *MemoryMapSize
+        );
+      BootCompat->ServiceState.MemoryMapSnapshotSize = *MemoryMapSize;
+    }
+
     //
     // Remember some descriptor size, since we will not have it later
     // during hibernate wake to be able to iterate memory map.
@@ -717,6 +760,12 @@ InstallServiceOverrides (
 
   ServicePtrs = &BootCompat->ServicePtrs;
 
+  //
+  // Preallocate memory map snapshot, as it cannot be allocated
+  // from GetMemoryMap without changing the memory map.
+  //
+  BootCompat->ServiceState.MemoryMapSnapshot = AllocatePool (MEMORY_MAP_SNAPSHOT_SIZE);
+
   OriginalTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
 
   ServicePtrs->AllocatePages        = gBS->AllocatePages;
@@ -87,6 +87,18 @@ STATIC SIMPLE_POINTER_INSTANCE *mPointerProtocols = NULL;
 // mNoSimplePointerInstances
 STATIC UINTN mNumberOfPointerProtocols = 0;
 
+// mPointerProtocolsAllocated
+STATIC UINTN mPointerProtocolsAllocated = 0;
+
+// mOriginalUninstallProtocolInterface
+STATIC EFI_UNINSTALL_PROTOCOL_INTERFACE mOriginalUninstallProtocolInterface = NULL;
+
+// mOriginalReinstallProtocolInterface
+STATIC EFI_REINSTALL_PROTOCOL_INTERFACE mOriginalReinstallProtocolInterface = NULL;
+
+// mOriginalUninstallMultipleProtocolInterfaces
+STATIC EFI_UNINSTALL_MULTIPLE_PROTOCOL_INTERFACES mOriginalUninstallMultipleProtocolInterfaces = NULL;
+
 // mSimplePointerPollEvent
 STATIC EFI_EVENT mSimplePointerPollEvent = NULL;
 
@@ -132,6 +144,24 @@ STATIC BOOLEAN mScreenResolutionSet;
 // mScreenResolution
 STATIC DIMENSION mResolution;
 
+// InternalFindSimplePointerInstance
+STATIC
+UINTN
+InternalFindSimplePointerInstance (
+  IN EFI_HANDLE  Handle
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < mNumberOfPointerProtocols; ++Index) {
+    if (mPointerProtocols[Index].Handle == Handle) {
+      break;
+    }
+  }
+
+  return Index;
+}
+
 // InternalRegisterSimplePointerInterface
 STATIC
 VOID
@@ -142,39 +172,58 @@ InternalRegisterSimplePointerInterface (
 {
   SIMPLE_POINTER_INSTANCE *Instance;
   UINTN                   Index;
+  EFI_TPL                 OldTpl;
 
   DEBUG ((DEBUG_VERBOSE, "InternalRegisterSimplePointerInterface\n"));
 
-  Instance = AllocateZeroPool (
-               (mNumberOfPointerProtocols + 1) * sizeof (*Instance)
-               );
+  //
+  // The initial scan runs at the caller TPL, do not let polling interrupt the update.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 
-  if (Instance != NULL) {
+  //
+  // Reinstalled interfaces and handles found by both the initial scan and
+  // the notification update their existing instance.
+  //
+  Index = InternalFindSimplePointerInstance (Handle);
+
+  if (Index == mNumberOfPointerProtocols) {
     //
-    // Apple did not check against NULL here and below as of boot.efi
+    // Grow the array geometrically here, so that polling and uninstallation
+    // never need to allocate.
     //
-    if (mPointerProtocols != NULL) {
-      CopyMem (
-        Instance,
-        mPointerProtocols,
-        (mNumberOfPointerProtocols * sizeof (*Instance))
-        );
-    }
+    if (mNumberOfPointerProtocols == mPointerProtocolsAllocated) {
+      Instance = AllocateZeroPool (
+                   (mPointerProtocolsAllocated * 2 + 4) * sizeof (*Instance)
+                   );
 
-    Index = mNumberOfPointerProtocols;
+      if (Instance == NULL) {
+        gBS->RestoreTPL (OldTpl);
+        return;
+      }
 
-    ++mNumberOfPointerProtocols;
+      if (mPointerProtocols != NULL) {
+        CopyMem (
+          Instance,
+          mPointerProtocols,
+          (mNumberOfPointerProtocols * sizeof (*Instance))
+          );
 
-    Instance[Index].Handle    = Handle;
-    Instance[Index].Interface = SimplePointer;
-    Instance[Index].Installed = TRUE;
+        FreePool ((VOID *)mPointerProtocols);
+      }
 
-    if (mPointerProtocols != NULL) {
-      FreePool ((VOID *)mPointerProtocols);
+      mPointerProtocols          = Instance;
+      mPointerProtocolsAllocated = mPointerProtocolsAllocated * 2 + 4;
     }
 
-    mPointerProtocols = Instance;
+    ++mNumberOfPointerProtocols;
   }
+
+  mPointerProtocols[Index].Handle    = Handle;
+  mPointerProtocols[Index].Interface = SimplePointer;
+  mPointerProtocols[Index].Installed = TRUE;
+
+  gBS->RestoreTPL (OldTpl);
 }
 
 // EventSimplePointerDesctructor
@@ -192,102 +241,235 @@ EventSimplePointerDesctructor (
     //
     mPointerProtocols = NULL;
   }
+
+  mNumberOfPointerProtocols  = 0;
+  mPointerProtocolsAllocated = 0;
 }
 
-// InternalRemoveUninstalledInstances
+// InternalSetSimplePointerInstalled
 STATIC
 VOID
-InternalRemoveUninstalledInstances (
-  IN OUT SIMPLE_POINTER_INSTANCE  **InstancesPtr,
-  IN     UINTN                    *NumberOfInstances,
-  IN     EFI_GUID                 *Protocol
+InternalSetSimplePointerInstalled (
+  IN EFI_HANDLE                   Handle,
+  IN EFI_SIMPLE_POINTER_PROTOCOL  *NewInterface  OPTIONAL,
+  IN BOOLEAN                      Installed
   )
 {
-  EFI_STATUS              Status;
-  UINTN                   NumberHandles;
-  EFI_HANDLE              *Buffer;
-  SIMPLE_POINTER_INSTANCE *Instance;
-  UINTN                   Index;
-  UINTN                   Index2;
-  SIMPLE_POINTER_INSTANCE *OrgInstances;
-  SIMPLE_POINTER_INSTANCE *NewInstances;
-  UINTN                   NumberOfMatches;
+  EFI_TPL  OldTpl;
+  UINTN    Index;
 
-  DEBUG ((DEBUG_VERBOSE, "InternalRemoveUninstalledInstances\n"));
+  //
+  // Pointer polling and install notifications run at TPL_NOTIFY.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
 
-  OrgInstances    = *InstancesPtr;
+  Index = InternalFindSimplePointerInstance (Handle);
+  if (Index < mNumberOfPointerProtocols) {
+    if (NewInterface != NULL) {
+      mPointerProtocols[Index].Interface = NewInterface;
+    }
 
-  Status = gBS->LocateHandleBuffer (
-                  ByProtocol,
-                  Protocol,
-                  NULL,
-                  &NumberHandles,
-                  &Buffer
-                  );
+    mPointerProtocols[Index].Installed = Installed;
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+// InternalRemoveSimplePointerInstance
+STATIC
+VOID
+InternalRemoveSimplePointerInstance (
+  IN EFI_HANDLE  Handle
+  )
+{
+  EFI_TPL  OldTpl;
+  UINTN    Index;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+
+  Index = InternalFindSimplePointerInstance (Handle);
+  if (Index < mNumberOfPointerProtocols) {
+    --mNumberOfPointerProtocols;
+
+    CopyMem (
+      &mPointerProtocols[Index],
+      &mPointerProtocols[Index + 1],
+      (mNumberOfPointerProtocols - Index) * sizeof (*mPointerProtocols)
+      );
+  }
+
+  gBS->RestoreTPL (OldTpl);
+}
+
+// InternalUninstallProtocolInterface
+STATIC
+EFI_STATUS
+EFIAPI
+InternalUninstallProtocolInterface (
+  IN EFI_HANDLE  Handle,
+  IN EFI_GUID    *Protocol,
+  IN VOID        *Interface
+  )
+{
+  EFI_STATUS  Status;
+
+  if (!CompareGuid (Protocol, &gEfiSimplePointerProtocolGuid)) {
+    return mOriginalUninstallProtocolInterface (Handle, Protocol, Interface);
+  }
+
+  //
+  // Stop polling the interface before it goes away, it may be freed right after.
+  //
+  InternalSetSimplePointerInstalled (Handle, NULL, FALSE);
+
+  Status = mOriginalUninstallProtocolInterface (Handle, Protocol, Interface);
 
   if (!EFI_ERROR (Status)) {
-    if (*NumberOfInstances > 0) {
-      NumberOfMatches = 0;
+    InternalRemoveSimplePointerInstance (Handle);
+  } else {
+    InternalSetSimplePointerInstalled (Handle, NULL, TRUE);
+  }
 
-      for (Index = 0; Index < *NumberOfInstances; ++Index) {
-        Instance = &OrgInstances[Index];
+  return Status;
+}
 
-        if (Instance->Installed) {
-          for (Index2 = 0; Index2 < NumberHandles; ++Index2) {
-            if (Instance->Handle == Buffer[Index2]) {
-              ++NumberOfMatches;
-              break;
-            }
-          }
+// InternalReinstallProtocolInterface
+STATIC
+EFI_STATUS
+EFIAPI
+InternalReinstallProtocolInterface (
+  IN EFI_HANDLE  Handle,
+  IN EFI_GUID    *Protocol,
+  IN VOID        *OldInterface,
+  IN VOID        *NewInterface
+  )
+{
+  EFI_STATUS  Status;
 
-          if (NumberHandles == Index2) {
-            Instance->Installed = FALSE;
-          }
-        }
-      }
+  if (!CompareGuid (Protocol, &gEfiSimplePointerProtocolGuid)) {
+    return mOriginalReinstallProtocolInterface (
+             Handle,
+             Protocol,
+             OldInterface,
+             NewInterface
+             );
+  }
 
-      if (NumberOfMatches != *NumberOfInstances) {
-        //
-        // Apple did not check for NumberOfMatches being > 0.
-        //
-        NewInstances = NULL;
-        if (NumberOfMatches > 0) {
-          NewInstances = AllocateZeroPool (
-                   NumberOfMatches * sizeof (*NewInstances)
-                   );
-        }
+  InternalSetSimplePointerInstalled (Handle, NULL, FALSE);
 
-        if (NewInstances != NULL) {
-          Index2 = 0;
-          for (Index = 0; Index < *NumberOfInstances; ++Index) {
-            Instance = &OrgInstances[Index];
-            if (Instance->Installed) {
-              CopyMem (
-                (VOID *)&NewInstances[Index2],
-                (VOID *)Instance, sizeof (*Instance)
-                );
-
-              ++Index2;
-            }
-          }
+  Status = mOriginalReinstallProtocolInterface (
+             Handle,
+             Protocol,
+             OldInterface,
+             NewInterface
+             );
 
-          FreePool (OrgInstances);
+  if (!EFI_ERROR (Status)) {
+    InternalSetSimplePointerInstalled (Handle, NewInterface, TRUE);
+  } else {
+    InternalSetSimplePointerInstalled (Handle, NULL, TRUE);
+  }
 
-          *InstancesPtr      = NewInstances;
-          *NumberOfInstances = NumberOfMatches;
-        }
-      }
+  return Status;
+}
+
+// InternalUninstallMultipleProtocolInterfaces
+STATIC
+EFI_STATUS
+EFIAPI
+InternalUninstallMultipleProtocolInterfaces (
+  IN EFI_HANDLE  Handle,
+  ...
+  )
+{
+  EFI_STATUS  Status;
+  VA_LIST     Args;
+  UINTN       Index;
+  EFI_GUID    *Protocol;
+  VOID        *Interface;
+
+  //
+  // Variable arguments cannot be forwarded, follow the reference implementation
+  // on top of the single interface uninstallation.
+  //
+  VA_START (Args, Handle);
+  for (Index = 0, Status = EFI_SUCCESS; !EFI_ERROR (Status); ++Index) {
+    Protocol = VA_ARG (Args, EFI_GUID *);
+    if (Protocol == NULL) {
+      break;
     }
 
-    FreePool (Buffer);
-  } else {
-    if (OrgInstances != NULL) {
-      FreePool (OrgInstances);
+    Interface = VA_ARG (Args, VOID *);
+    Status    = InternalUninstallProtocolInterface (Handle, Protocol, Interface);
+  }
+  VA_END (Args);
+
+  if (EFI_ERROR (Status)) {
+    VA_START (Args, Handle);
+    for (; Index > 1; --Index) {
+      Protocol  = VA_ARG (Args, EFI_GUID *);
+      Interface = VA_ARG (Args, VOID *);
+      gBS->InstallProtocolInterface (
+             &Handle,
+             Protocol,
+             EFI_NATIVE_INTERFACE,
+             Interface
+             );
     }
+    VA_END (Args);
+
+    Status = EFI_INVALID_PARAMETER;
+  }
+
+  return Status;
+}
+
+// InternalHookProtocolUninstallation
+STATIC
+VOID
+InternalHookProtocolUninstallation (
+  VOID
+  )
+{
+  if (mOriginalUninstallProtocolInterface != NULL) {
+    return;
+  }
+
+  mOriginalUninstallProtocolInterface          = gBS->UninstallProtocolInterface;
+  mOriginalReinstallProtocolInterface          = gBS->ReinstallProtocolInterface;
+  mOriginalUninstallMultipleProtocolInterfaces = gBS->UninstallMultipleProtocolInterfaces;
+  gBS->UninstallProtocolInterface              = InternalUninstallProtocolInterface;
+  gBS->ReinstallProtocolInterface              = InternalReinstallProtocolInterface;
+  gBS->UninstallMultipleProtocolInterfaces     = InternalUninstallMultipleProtocolInterfaces;
+  gBS->Hdr.CRC32                               = 0;
+  gBS->CalculateCrc32 (gBS, gBS->Hdr.HeaderSize, &gBS->Hdr.CRC32);
+}
 
-    *InstancesPtr      = NULL;
-    *NumberOfInstances = 0;
+// InternalUnhookProtocolUninstallation
+STATIC
+VOID
+InternalUnhookProtocolUninstallation (
+  VOID
+  )
+{
+  //
+  // Leave the hooks in place when somebody hooked the services after us.
+  //
+  if (mOriginalUninstallProtocolInterface == NULL
+    || gBS->UninstallProtocolInterface != InternalUninstallProtocolInterface
+    || gBS->ReinstallProtocolInterface != InternalReinstallProtocolInterface
+    || gBS->UninstallMultipleProtocolInterfaces != InternalUninstallMultipleProtocolInterfaces) {
+    return;
   }
+
+  gBS->UninstallProtocolInterface              = mOriginalUninstallProtocolInterface;
+  gBS->ReinstallProtocolInterface              = mOriginalReinstallProtocolInterface;
+  gBS->UninstallMultipleProtocolInterfaces     = mOriginalUninstallMultipleProtocolInterfaces;
+  mOriginalUninstallProtocolInterface          = NULL;
+  mOriginalReinstallProtocolInterface          = NULL;
+  mOriginalUninstallMultipleProtocolInterfaces = NULL;
+  gBS->Hdr.CRC32                               = 0;
+  gBS->CalculateCrc32 (gBS, gBS->Hdr.HeaderSize, &gBS->Hdr.CRC32);
 }
 
 // InternalSimplePointerInstallNotifyFunction
@@ -372,6 +554,11 @@ EventCreateSimplePointerInstallNotifyEvent (
 
       mSimplePointerInstallNotifyEvent = NULL;
     } else {
+      //
+      // UEFI has no uninstallation notifications, intercept the services
+      // instead, so that polling never has to rescan the handle database.
+      //
+      InternalHookProtocolUninstallation ();
       InternalSimplePointerInstallNotifyFunction (NULL, NULL);
     }
   }
@@ -390,6 +577,8 @@ EventCloseSimplePointerInstallNotifyEvent (
   if (mSimplePointerInstallNotifyEvent != NULL) {
     gBS->CloseEvent (mSimplePointerInstallNotifyEvent);
   }
+
+  InternalUnhookProtocolUninstallation ();
 }
 
 // InternalGetScreenResolution
@@ -654,12 +843,6 @@ InternalSimplePointerPollNotifyFunction (
 
   Modifiers = InternalGetModifierStrokes ();
 
-  InternalRemoveUninstalledInstances (
-    &mPointerProtocols,
-    &mNumberOfPointerProtocols,
-    &gEfiSimplePointerProtocolGuid
-    );
-
   CommonStatus = EFI_UNSUPPORTED;
 
   if (mNumberOfPointerProtocols > 0) {
@@ -667,6 +850,10 @@ InternalSimplePointerPollNotifyFunction (
 
     for (Index = 0; Index < mNumberOfPointerProtocols; ++Index) {
       Instance      = &mPointerProtocols[Index];
+      if (!Instance->Installed) {
+        continue;
+      }
+
       SimplePointer = Instance->Interface;
       Status        = SimplePointer->GetState (SimplePointer, &State);
 
@@ -823,13 +1010,11 @@ EventCreateSimplePointerPollEvent (
          (VOID *)&mUiScale
          );
 
-  InternalRemoveUninstalledInstances (
-    &mPointerProtocols,
-    &mNumberOfPointerProtocols,
-    &gEfiSimplePointerProtocolGuid
-    );
-
   for (Index = 0; Index < mNumberOfPointerProtocols; ++Index) {
+    if (!mPointerProtocols[Index].Installed) {
+      continue;
+    }
+
     mPointerProtocols[Index].Interface->Reset (
       mPointerProtocols[Index].Interface, FALSE
       );
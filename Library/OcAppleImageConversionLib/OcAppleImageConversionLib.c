@@ -14,10 +14,12 @@ THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
 WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 **/
 
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/OcAppleImageConversionLib.h>
+#include <Library/OcCryptoLib.h>
 #include <Library/OcGuardLib.h>
 #include <Library/OcMiscLib.h>
 #include <Library/OcPngLib.h>
@@ -25,6 +27,196 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 
 STATIC CONST UINT8 mPngHeader[] = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A };
 
+//
+// PNG signature and IHDR chunk, which fully determine image dimensions.
+//
+#define IMAGE_CACHE_HEADER_SIZE   33
+
+#define IMAGE_CACHE_DEFAULT_SIZE  SIZE_4MB
+
+typedef struct {
+  LIST_ENTRY     Link;
+  UINTN          ImageSize;
+  UINT8          ImageHash[SHA256_DIGEST_SIZE];
+  UINT8          Header[IMAGE_CACHE_HEADER_SIZE];
+  UINT32         Width;
+  UINT32         Height;
+  UINTN          PixelsSize;
+  EFI_UGA_PIXEL  *Pixels;
+} IMAGE_CACHE_ENTRY;
+
+#define IMAGE_CACHE_ENTRY_FROM_LINK(This) \
+  BASE_CR ((This), IMAGE_CACHE_ENTRY, Link)
+
+//
+// Decoded images keyed by content hash, most recently used first.
+//
+STATIC LIST_ENTRY  mImageCache        = INITIALIZE_LIST_HEAD_VARIABLE (mImageCache);
+STATIC UINTN       mImageCacheUsed;
+STATIC UINTN       mImageCacheMaxSize = IMAGE_CACHE_DEFAULT_SIZE;
+
+STATIC
+VOID
+InternalImageCacheRemove (
+  IN IMAGE_CACHE_ENTRY  *Entry
+  )
+{
+  RemoveEntryList (&Entry->Link);
+  mImageCacheUsed -= Entry->PixelsSize + sizeof (*Entry);
+  FreePool (Entry->Pixels);
+  FreePool (Entry);
+}
+
+/**
+  Evict least recently used images to fit a new one.
+
+  @param[in] Size  Size of the new entry.
+
+  @retval TRUE when the entry fits the cache.
+**/
+STATIC
+BOOLEAN
+InternalImageCacheReserve (
+  IN UINTN  Size
+  )
+{
+  if (Size > mImageCacheMaxSize) {
+    return FALSE;
+  }
+
+  while (mImageCacheMaxSize - mImageCacheUsed < Size) {
+    InternalImageCacheRemove (
+      IMAGE_CACHE_ENTRY_FROM_LINK (GetPreviousNode (&mImageCache, &mImageCache))
+      );
+  }
+
+  return TRUE;
+}
+
+/**
+  Find decoded image by its content and mark it most recently used.
+
+  @param[in] ImageSize  Size of the encoded image.
+  @param[in] ImageHash  SHA-256 of the encoded image.
+
+  @return cached image or NULL.
+**/
+STATIC
+IMAGE_CACHE_ENTRY *
+InternalImageCacheLookup (
+  IN UINTN        ImageSize,
+  IN CONST UINT8  *ImageHash
+  )
+{
+  LIST_ENTRY         *Link;
+  IMAGE_CACHE_ENTRY  *Entry;
+
+  for (
+    Link = GetFirstNode (&mImageCache);
+    !IsNull (&mImageCache, Link);
+    Link = GetNextNode (&mImageCache, Link)
+    ) {
+    Entry = IMAGE_CACHE_ENTRY_FROM_LINK (Link);
+    if (Entry->ImageSize == ImageSize
+      && CompareMem (Entry->ImageHash, ImageHash, SHA256_DIGEST_SIZE) == 0) {
+      RemoveEntryList (&Entry->Link);
+      InsertHeadList (&mImageCache, &Entry->Link);
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Find decoded image with the same header, which has the same dimensions.
+
+  @param[in] ImageBuffer  Encoded image.
+  @param[in] ImageSize    Size of the encoded image.
+
+  @return cached image or NULL.
+**/
+STATIC
+IMAGE_CACHE_ENTRY *
+InternalImageCacheLookupHeader (
+  IN VOID   *ImageBuffer,
+  IN UINTN  ImageSize
+  )
+{
+  LIST_ENTRY         *Link;
+  IMAGE_CACHE_ENTRY  *Entry;
+
+  if (ImageBuffer == NULL || ImageSize < IMAGE_CACHE_HEADER_SIZE) {
+    return NULL;
+  }
+
+  for (
+    Link = GetFirstNode (&mImageCache);
+    !IsNull (&mImageCache, Link);
+    Link = GetNextNode (&mImageCache, Link)
+    ) {
+    Entry = IMAGE_CACHE_ENTRY_FROM_LINK (Link);
+    if (CompareMem (Entry->Header, ImageBuffer, IMAGE_CACHE_HEADER_SIZE) == 0) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Remember a copy of decoded image.
+
+  @param[in] ImageBuffer  Encoded image.
+  @param[in] ImageSize    Size of the encoded image.
+  @param[in] ImageHash    SHA-256 of the encoded image.
+  @param[in] Width        Image width.
+  @param[in] Height       Image height.
+  @param[in] Pixels       Decoded image.
+  @param[in] PixelsSize   Size of the decoded image.
+**/
+STATIC
+VOID
+InternalImageCacheInsert (
+  IN VOID                 *ImageBuffer,
+  IN UINTN                ImageSize,
+  IN CONST UINT8          *ImageHash,
+  IN UINT32               Width,
+  IN UINT32               Height,
+  IN CONST EFI_UGA_PIXEL  *Pixels,
+  IN UINTN                PixelsSize
+  )
+{
+  IMAGE_CACHE_ENTRY  *Entry;
+
+  if (ImageSize < IMAGE_CACHE_HEADER_SIZE
+    || PixelsSize > MAX_UINTN - sizeof (*Entry)
+    || !InternalImageCacheReserve (PixelsSize + sizeof (*Entry))) {
+    return;
+  }
+
+  Entry = AllocatePool (sizeof (*Entry));
+  if (Entry == NULL) {
+    return;
+  }
+
+  Entry->Pixels = AllocateCopyPool (PixelsSize, Pixels);
+  if (Entry->Pixels == NULL) {
+    FreePool (Entry);
+    return;
+  }
+
+  Entry->ImageSize  = ImageSize;
+  Entry->Width      = Width;
+  Entry->Height     = Height;
+  Entry->PixelsSize = PixelsSize;
+  CopyMem (Entry->ImageHash, ImageHash, SHA256_DIGEST_SIZE);
+  CopyMem (Entry->Header, ImageBuffer, IMAGE_CACHE_HEADER_SIZE);
+
+  InsertHeadList (&mImageCache, &Entry->Link);
+  mImageCacheUsed += PixelsSize + sizeof (*Entry);
+}
+
 STATIC
 EFI_STATUS
 EFIAPI
@@ -56,7 +248,15 @@ GetImageDims (
   OUT UINT32  *ImageHeight
   )
 {
-  EFI_STATUS  Status;
+  EFI_STATUS         Status;
+  IMAGE_CACHE_ENTRY  *Entry;
+
+  Entry = InternalImageCacheLookupHeader (ImageBuffer, ImageSize);
+  if (Entry != NULL) {
+    *ImageWidth  = Entry->Width;
+    *ImageHeight = Entry->Height;
+    return EFI_SUCCESS;
+  }
 
   Status = GetPngDims (ImageBuffer, ImageSize, ImageWidth, ImageHeight);
 
@@ -77,57 +277,66 @@ DecodeImageData (
   OUT UINTN          *RawImageDataSize
   )
 {
-  UINT32          X;
-  UINT32          Y;
-  VOID            *Data;
-  UINT32          Width;
-  UINT32          Height;
-  UINT8           *DataWalker;
-  EFI_UGA_PIXEL   *Pixel;
-  EFI_STATUS      Status;
+  UINT32             Width;
+  UINT32             Height;
+  EFI_STATUS         Status;
+  UINT8              ImageHash[SHA256_DIGEST_SIZE];
+  IMAGE_CACHE_ENTRY  *Entry;
 
   if (!RawImageData || !RawImageDataSize) {
     return EFI_INVALID_PARAMETER;
   }
 
-  Status = DecodePng (
+  //
+  // The same icons are decoded over and over, serve a copy when we can.
+  //
+  if (mImageCacheMaxSize > 0 && ImageBuffer != NULL) {
+    Sha256 (ImageHash, ImageBuffer, ImageSize);
+
+    Entry = InternalImageCacheLookup (ImageSize, ImageHash);
+    if (Entry != NULL) {
+      *RawImageData = AllocateCopyPool (Entry->PixelsSize, Entry->Pixels);
+      if (*RawImageData == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+
+      *RawImageDataSize = Entry->PixelsSize;
+      return EFI_SUCCESS;
+    }
+  }
+
+  //
+  // Decode right into EFI_UGA_PIXEL layout, alpha is inverted into Reserved.
+  //
+  Status = DecodePngToUga (
             ImageBuffer,
             ImageSize,
-            &Data,
+            (VOID **) RawImageData,
+            RawImageDataSize,
             &Width,
-            &Height,
-            NULL
+            &Height
             );
 
-  if (EFI_ERROR (Status)) {
-    return EFI_UNSUPPORTED;
+  if (Status == EFI_OUT_OF_RESOURCES) {
+    return Status;
   }
 
-  if (OcOverflowTriMulUN (Width, Height, sizeof(EFI_UGA_PIXEL), RawImageDataSize)) {
-    FreePng (Data);
+  if (EFI_ERROR (Status)) {
     return EFI_UNSUPPORTED;
   }
 
-  *RawImageData = (EFI_UGA_PIXEL *) AllocatePool (*RawImageDataSize);
-
-  if (*RawImageData == NULL) {
-    FreePng (Data);
-    return EFI_OUT_OF_RESOURCES;
-  }
-
-  DataWalker = (UINT8 *) Data;
-  Pixel      = *RawImageData;
-  for (Y = 0; Y < Height; Y++) {
-    for (X = 0; X < Width; X++) {
-      Pixel->Red = *DataWalker++;
-      Pixel->Green = *DataWalker++;
-      Pixel->Blue = *DataWalker++;
-      Pixel->Reserved = 0xFF - *DataWalker++;
-      Pixel++;
-    }
+  if (mImageCacheMaxSize > 0 && ImageBuffer != NULL) {
+    InternalImageCacheInsert (
+      ImageBuffer,
+      ImageSize,
+      ImageHash,
+      Width,
+      Height,
+      *RawImageData,
+      *RawImageDataSize
+      );
   }
 
-  FreePng (Data);
   return EFI_SUCCESS;
 }
 
@@ -234,3 +443,17 @@ OcAppleImageConversionInstallProtocol (
 
   return &mAppleImageConversion;
 }
+
+VOID
+OcAppleImageConversionSetCacheSize (
+  IN UINTN  MaxCacheSize
+  )
+{
+  mImageCacheMaxSize = MaxCacheSize;
+
+  while (mImageCacheUsed > mImageCacheMaxSize) {
+    InternalImageCacheRemove (
+      IMAGE_CACHE_ENTRY_FROM_LINK (GetPreviousNode (&mImageCache, &mImageCache))
+      );
+  }
+}
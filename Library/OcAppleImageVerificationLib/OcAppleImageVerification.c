@@ -369,6 +369,127 @@ BuildPeContext (
 }
 
 
+/**
+  Extract public key and signature from Apple EFI certificate.
+
+  @param[in]  Cert              Apple EFI certificate.
+  @param[in]  CertSize          Certificate size from certificate info.
+  @param[out] SignatureContext  Signature context to fill.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalGetAppleCertificate (
+  IN  APPLE_EFI_CERTIFICATE    *Cert,
+  IN  UINT32                   CertSize,
+  OUT APPLE_SIGNATURE_CONTEXT  *SignatureContext
+  )
+{
+  UINTN                       Index;
+  UINT8                       PkLe[256];
+  UINT8                       SigLe[256];
+
+  //
+  // Compare size of signature directory with value from PE SecDir header
+  //
+  if (CertSize != Cert->CertSize) {
+    DEBUG ((DEBUG_WARN, "Certificate size mismatch with CertificateInfo size value\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Verify certificate type
+  //
+  if (Cert->CertType != APPLE_EFI_CERTIFICATE_TYPE) {
+    DEBUG ((DEBUG_WARN, "Unknown certificate type\n"));
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Verify certificate GUID
+  //
+  if (!CompareGuid (&Cert->AppleSignatureGuid, &gAppleEfiCertificateGuid)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Verify HashType == Rsa2048Sha256
+  //
+  if (!CompareGuid (&Cert->CertData.HashType, &gEfiCertTypeRsa2048Sha256Guid)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Extract PublicKey and Signature
+  //
+  CopyMem (PkLe, Cert->CertData.PublicKey, 256);
+  CopyMem (SigLe, Cert->CertData.Signature, 256);
+
+  //
+  // Calc public key hash and add in sig context
+  //
+  Sha256 (SignatureContext->PublicKeyHash, PkLe, 256);
+
+  //
+  // Convert to big endian and add in sig context
+  //
+  for (Index = 0; Index < 256; Index++) {
+    SignatureContext->PublicKey[256 - 1 - Index] = PkLe[Index];
+    SignatureContext->Signature[256 - 1 - Index] = SigLe[Index];
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Verify image hash signature with a known Apple public key.
+
+  @param[in] SignatureContext  Signature context.
+  @param[in] PeImageHash       SHA-256 image hash.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalVerifyAppleSignature (
+  IN APPLE_SIGNATURE_CONTEXT  *SignatureContext,
+  IN UINT8                    *PeImageHash
+  )
+{
+  UINTN              Index;
+  OC_RSA_PUBLIC_KEY  *Pk;
+
+  Pk = NULL;
+
+  //
+  // Verify existence in DataBase
+  //
+  for (Index = 0; Index < NUM_OF_PK; Index++) {
+    if (CompareMem (PkDataBase[Index].Hash, SignatureContext->PublicKeyHash, 32) == 0) {
+      //
+      // PublicKey valid. Extract prepared publickey from database
+      //
+      Pk = (OC_RSA_PUBLIC_KEY *) PkDataBase[Index].PublicKey;
+    }
+  }
+
+  if (Pk == NULL) {
+    DEBUG ((DEBUG_WARN, "Unknown publickey or malformed certificate\n"));
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // Verify signature
+  //
+  if (RsaVerifySigHashFromKey (Pk, SignatureContext->Signature, sizeof (SignatureContext->Signature), PeImageHash, 32, OcSigHashTypeSha256) == 1 ) {
+    DEBUG ((DEBUG_INFO, "Signature verified!\n"));
+    return EFI_SUCCESS;
+  }
+
+  return EFI_SECURITY_VIOLATION;
+}
+
 EFI_STATUS
 GetApplePeImageSignature (
   VOID                                *Image,
@@ -378,12 +499,9 @@ GetApplePeImageSignature (
   )
 {
   EFI_STATUS                  Status                    = EFI_UNSUPPORTED;
-  UINTN                       Index                     = 0;
   UINT32                      Result                    = 0;
   APPLE_EFI_CERTIFICATE       *Cert                     = NULL;
   APPLE_EFI_CERTIFICATE_INFO  *CertInfo                 = NULL;
-  UINT8                       PkLe[256];
-  UINT8                       SigLe[256];
   //
   // Check SecDir extistence
   //
@@ -423,57 +541,7 @@ GetApplePeImageSignature (
     Cert = (APPLE_EFI_CERTIFICATE *)
              ((UINT8 *) Image + CertInfo->CertOffset);
 
-    //
-    // Compare size of signature directory with value from PE SecDir header
-    //
-    if (CertInfo->CertSize != Cert->CertSize) {
-      DEBUG ((DEBUG_WARN, "Certificate size mismatch with CertificateInfo size value\n"));
-      return EFI_INVALID_PARAMETER;
-    }
-
-    //
-    // Verify certificate type
-    //
-    if (Cert->CertType != APPLE_EFI_CERTIFICATE_TYPE) {
-      DEBUG ((DEBUG_WARN, "Unknown certificate type\n"));
-      return EFI_UNSUPPORTED;
-    }
-
-    //
-    // Verify certificate GUID
-    //
-    if (!CompareGuid (&Cert->AppleSignatureGuid, &gAppleEfiCertificateGuid)) {
-      return Status;
-    }
-
-    //
-    // Verify HashType == Rsa2048Sha256
-    //
-    if (!CompareGuid (&Cert->CertData.HashType, &gEfiCertTypeRsa2048Sha256Guid)) {
-      return EFI_UNSUPPORTED;
-    }
-
-    //
-    // Extract PublicKey and Signature
-    //
-    CopyMem (PkLe, Cert->CertData.PublicKey, 256);
-    CopyMem (SigLe, Cert->CertData.Signature, 256);
-
-    //
-    // Calc public key hash and add in sig context
-    //
-    Sha256 (SignatureContext->PublicKeyHash, PkLe, 256);
-
-    //
-    // Convert to big endian and add in sig context
-    //
-    for (Index = 0; Index < 256; Index++) {
-      SignatureContext->PublicKey[256 - 1 - Index] = PkLe[Index];
-      SignatureContext->Signature[256 - 1 - Index] = SigLe[Index];
-    }
-
-    Status = EFI_SUCCESS;
-
+    Status = InternalGetAppleCertificate (Cert, CertInfo->CertSize, SignatureContext);
   } else {
     DEBUG ((DEBUG_WARN, "Certificate entry not exist\n"));
   }
@@ -578,97 +646,395 @@ GetApplePeImageSha256 (
   return EFI_SUCCESS;
 }
 
+/**
+  Resize buffered image headers.
+
+  @param[in,out] Stream       Streaming verification context.
+  @param[in]     HeadersSize  New headers size, not below current position.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
 EFI_STATUS
-VerifyApplePeImageSignature (
-  IN OUT VOID                                *PeImage,
-  IN OUT UINTN                               *ImageSize
+InternalPeStreamResizeHeaders (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+  IN     UINT32                         HeadersSize
   )
 {
-  UINTN                              Index             = 0;
-  APPLE_SIGNATURE_CONTEXT            *SignatureContext = NULL;
-  OC_RSA_PUBLIC_KEY                  *Pk               = NULL;
-  APPLE_PE_COFF_LOADER_IMAGE_CONTEXT *Context          = NULL;
+  UINT8  *Headers;
 
-  Context = AllocateZeroPool (sizeof (APPLE_PE_COFF_LOADER_IMAGE_CONTEXT));
-  if (Context == NULL) {
-    DEBUG ((DEBUG_WARN, "Pe context allocation failure\n"));
+  ASSERT (HeadersSize >= Stream->Position);
+
+  Headers = AllocatePool (HeadersSize);
+  if (Headers == NULL) {
+    DEBUG ((DEBUG_WARN, "Pe headers allocation failure\n"));
     return EFI_OUT_OF_RESOURCES;
   }
+
+  if (Stream->Headers != NULL) {
+    CopyMem (Headers, Stream->Headers, Stream->Position);
+    FreePool (Stream->Headers);
+  }
+
+  Stream->Headers     = Headers;
+  Stream->HeadersSize = HeadersSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Consume image data once the headers are known: hash the signed ranges,
+  capture the signature, and drop the data past it.
+
+  @param[in,out] Stream  Streaming verification context.
+  @param[in]     Offset  Offset of Data in the image.
+  @param[in,out] Data    Image data.
+  @param[in]     Size    Size of Data in bytes.
+**/
+STATIC
+VOID
+InternalPeStreamConsume (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+  IN     UINT32                         Offset,
+  IN OUT UINT8                          *Data,
+  IN     UINT32                         Size
+  )
+{
+  UINT32  Index;
+  UINT32  Start;
+  UINT32  End;
+
+  //
+  // Hash ranges are ordered and do not overlap, so each byte is hashed
+  // exactly once as data arrives in file order.
+  //
+  for (Index = 0; Index < APPLE_PE_IMAGE_HASH_RANGES; ++Index) {
+    Start = MAX (Offset, Stream->HashRanges[Index].Start);
+    End   = MIN (Offset + Size, Stream->HashRanges[Index].End);
+    if (Start < End) {
+      Sha256Update (&Stream->HashContext, Data + (Start - Offset), End - Start);
+    }
+  }
+
+  Start = MAX (Offset, Stream->SignatureOffset);
+  End   = MIN (Offset + Size, Stream->RealImageSize);
+  if (Start < End) {
+    CopyMem (
+      Stream->Signature + (Start - Stream->SignatureOffset),
+      Data + (Start - Offset),
+      End - Start
+      );
+  }
+
+  Start = MAX (Offset, Stream->RealImageSize);
+  End   = Offset + Size;
+  if (Start < End) {
+    ZeroMem (Data + (Start - Offset), End - Start);
+  }
+}
+
+/**
+  Parse buffered image headers, requesting more of them when necessary.
+
+  @param[in,out] Stream  Streaming verification context.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalPeStreamParseHeaders (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_IMAGE_DOS_HEADER             *DosHdr;
+  EFI_IMAGE_OPTIONAL_HEADER_UNION  *PeHdr;
+  APPLE_PE_COFF_LOADER_IMAGE_CONTEXT *Context;
+  UINT32                           SizeOfHeaders;
+  UINT32                           Temp32;
+
+  DosHdr  = (EFI_IMAGE_DOS_HEADER *) Stream->Headers;
+  Context = &Stream->PeContext;
+
+  if (Stream->HeadersSize == sizeof (EFI_IMAGE_DOS_HEADER)) {
+    //
+    // Apple images always have a DOS header, the hashing relies on it.
+    //
+    if (DosHdr->e_magic != EFI_IMAGE_DOS_SIGNATURE
+      || DosHdr->e_lfanew < sizeof (EFI_IMAGE_DOS_HEADER)
+      || OcOverflowAddU32 (DosHdr->e_lfanew, sizeof (EFI_IMAGE_OPTIONAL_HEADER_UNION), &Temp32)
+      || Temp32 > Stream->ImageSize) {
+      DEBUG ((DEBUG_WARN, "Invalid PE offset\n"));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Stream->PeHdrOffset = DosHdr->e_lfanew;
+    return InternalPeStreamResizeHeaders (Stream, Temp32);
+  }
+
+  PeHdr = (EFI_IMAGE_OPTIONAL_HEADER_UNION *) (Stream->Headers + Stream->PeHdrOffset);
+
+  if (PeHdr->Pe32.OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC) {
+    SizeOfHeaders = PeHdr->Pe32.OptionalHeader.SizeOfHeaders;
+  } else if (PeHdr->Pe32.OptionalHeader.Magic == EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC) {
+    SizeOfHeaders = PeHdr->Pe32Plus.OptionalHeader.SizeOfHeaders;
+  } else {
+    DEBUG ((DEBUG_WARN, "Unsupported PE header magic\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (SizeOfHeaders > Stream->HeadersSize) {
+    if (SizeOfHeaders > Stream->ImageSize) {
+      DEBUG ((DEBUG_WARN, "Invalid image\n"));
+      return EFI_INVALID_PARAMETER;
+    }
+
+    return InternalPeStreamResizeHeaders (Stream, SizeOfHeaders);
+  }
+
   //
-  // Build PE context
+  // All section headers are buffered now. BuildPeContext only accesses the
+  // headers, while checking them against the whole image size.
   //
-  if (EFI_ERROR (BuildPeContext (PeImage, *ImageSize, Context))) {
+  Status = BuildPeContext (Stream->Headers, Stream->ImageSize, Context);
+  if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_WARN, "Malformed ApplePeImage\n"));
-    FreePool (Context);
     return EFI_INVALID_PARAMETER;
   }
 
+  if (Context->SecDir == NULL
+    || Context->SecDir->Size != APPLE_SIGNATURE_SECENTRY_SIZE) {
+    DEBUG ((DEBUG_WARN, "Certificate entry not exist\n"));
+    return EFI_UNSUPPORTED;
+  }
+
   //
-  // Sanitzie ApplePeImage
+  // Signature must follow the headers and fit in the image.
   //
-  SanitizeApplePeImage (PeImage, ImageSize, Context);
+  Stream->SignatureOffset = Context->SecDir->VirtualAddress;
+  if (Stream->SignatureOffset < Stream->HeadersSize
+    || OcOverflowAddU32 (Stream->SignatureOffset, sizeof (Stream->Signature), &Stream->RealImageSize)
+    || Stream->RealImageSize > Stream->ImageSize) {
+    DEBUG ((DEBUG_WARN, "Malformed security header\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Hash DOS header and skip DOS stub, then the PE header without CheckSum
+  // and SECURITY data directory, and everything after it till the signature.
+  //
+  Stream->HashRanges[0].Start = 0;
+  Stream->HashRanges[0].End   = sizeof (EFI_IMAGE_DOS_HEADER);
+  Stream->HashRanges[1].Start = Stream->PeHdrOffset;
+  Stream->HashRanges[1].End   = (UINT32) ((UINT8 *) Context->OptHdrChecksum - Stream->Headers);
+  Stream->HashRanges[2].Start = Stream->HashRanges[1].End + sizeof (UINT32);
+  Stream->HashRanges[2].End   = (UINT32) ((UINT8 *) Context->SecDir - Stream->Headers);
+  Stream->HashRanges[3].Start = Stream->HashRanges[2].End + sizeof (EFI_IMAGE_DATA_DIRECTORY);
+  Stream->HashRanges[3].End   = Stream->SignatureOffset;
+
+  Sha256Init (&Stream->HashContext);
+  InternalPeStreamConsume (Stream, 0, Stream->Headers, Stream->HeadersSize);
+  Stream->HasPeContext = TRUE;
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+ApplePeImageStreamInit (
+  OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+  IN  UINTN                          ImageSize
+  )
+{
+  ASSERT (Stream != NULL);
+
+  ZeroMem (Stream, sizeof (*Stream));
+
+  if (ImageSize > MAX_UINT32) {
+    DEBUG ((DEBUG_WARN, "Invalid image\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Stream->ImageSize = (UINT32) ImageSize;
+
+  Stream->Status = InternalPeStreamResizeHeaders (Stream, sizeof (EFI_IMAGE_DOS_HEADER));
+  return Stream->Status;
+}
+
+EFI_STATUS
+ApplePeImageStreamUpdate (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+  IN OUT VOID                           *Data,
+  IN     UINTN                          DataSize
+  )
+{
+  UINT8   *Walker;
+  UINT32  Size;
+  UINT32  Start;
+  UINT32  End;
+
+  ASSERT (Stream != NULL);
+  ASSERT (Data != NULL || DataSize == 0);
+
+  if (EFI_ERROR (Stream->Status)) {
+    return Stream->Status;
+  }
+
+  if (DataSize > Stream->ImageSize - Stream->Position) {
+    DEBUG ((DEBUG_WARN, "Image data past image size\n"));
+    Stream->Status = EFI_INVALID_PARAMETER;
+    return Stream->Status;
+  }
+
+  Walker = Data;
+
+  while (!Stream->HasPeContext && DataSize > 0) {
+    Size = MIN ((UINT32) DataSize, Stream->HeadersSize - Stream->Position);
+    CopyMem (Stream->Headers + Stream->Position, Walker, Size);
+
+    //
+    // Drop DOS stub, its size is known once DOS header is parsed.
+    //
+    if (Stream->PeHdrOffset != 0) {
+      Start = MAX (Stream->Position, sizeof (EFI_IMAGE_DOS_HEADER));
+      End   = MIN (Stream->Position + Size, Stream->PeHdrOffset);
+      if (Start < End) {
+        ZeroMem (Walker + (Start - Stream->Position), End - Start);
+      }
+    }
+
+    Stream->Position += Size;
+    Walker           += Size;
+    DataSize         -= Size;
+
+    if (Stream->Position == Stream->HeadersSize) {
+      Stream->Status = InternalPeStreamParseHeaders (Stream);
+      if (EFI_ERROR (Stream->Status)) {
+        return Stream->Status;
+      }
+    }
+  }
+
+  if (DataSize > 0) {
+    InternalPeStreamConsume (Stream, Stream->Position, Walker, (UINT32) DataSize);
+    Stream->Position += (UINT32) DataSize;
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+ApplePeImageStreamFinal (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream,
+     OUT UINTN                          *RealImageSize
+  )
+{
+  EFI_STATUS                  Status;
+  APPLE_SIGNATURE_CONTEXT     *SignatureContext;
+  APPLE_EFI_CERTIFICATE_INFO  *CertInfo;
+  UINT32                      Result;
+
+  ASSERT (Stream != NULL);
+  ASSERT (RealImageSize != NULL);
+
+  Status = Stream->Status;
+  if (!EFI_ERROR (Status)
+    && (!Stream->HasPeContext || Stream->Position != Stream->ImageSize)) {
+    DEBUG ((DEBUG_WARN, "Incomplete ApplePeImage\n"));
+    Status = EFI_INVALID_PARAMETER;
+  }
+
+  ApplePeImageStreamFree (Stream);
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Sha256Final (&Stream->HashContext, Stream->PeContext.PeImageHash);
 
   //
-  // Allocate signature context
+  // Certificate is expected to directly follow certificate info.
   //
+  CertInfo = (APPLE_EFI_CERTIFICATE_INFO *) Stream->Signature;
+  if (OcOverflowAddU32 (CertInfo->CertOffset, CertInfo->CertSize, &Result)
+    || Result > Stream->RealImageSize
+    || CertInfo->CertOffset != Stream->SignatureOffset + sizeof (APPLE_EFI_CERTIFICATE_INFO)) {
+    DEBUG ((DEBUG_WARN, "CertificateInfo out of bounds\n"));
+    return EFI_UNSUPPORTED;
+  }
+
   SignatureContext = AllocateZeroPool (sizeof (APPLE_SIGNATURE_CONTEXT));
   if (SignatureContext == NULL) {
     DEBUG ((DEBUG_WARN, "Signature context allocation failure\n"));
-    FreePool (Context);
     return EFI_OUT_OF_RESOURCES;
   }
 
-  //
-  // Extract AppleSignature from PEImage
-  //
-  if (EFI_ERROR (GetApplePeImageSignature (PeImage, *ImageSize, Context, SignatureContext))) {
+  Status = InternalGetAppleCertificate (
+    (APPLE_EFI_CERTIFICATE *) (CertInfo + 1),
+    CertInfo->CertSize,
+    SignatureContext
+    );
+  if (EFI_ERROR (Status)) {
     DEBUG ((DEBUG_WARN, "AppleSignature broken or not present!\n"));
     FreePool (SignatureContext);
-    FreePool (Context);
     return EFI_UNSUPPORTED;
   }
 
-  //
-  // Calcucate PeImage hash
-  //
-  if (EFI_ERROR (GetApplePeImageSha256 (PeImage, Context))) {
-    DEBUG ((DEBUG_WARN, "Couldn't calcuate hash of PeImage\n"));
-    FreePool (SignatureContext);
-    FreePool (Context);
-    return EFI_INVALID_PARAMETER;
+  Status = InternalVerifyAppleSignature (SignatureContext, Stream->PeContext.PeImageHash);
+  FreePool (SignatureContext);
+
+  if (!EFI_ERROR (Status)) {
+    *RealImageSize = Stream->RealImageSize;
+  }
+
+  return Status;
+}
+
+VOID
+ApplePeImageStreamFree (
+  IN OUT APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream
+  )
+{
+  ASSERT (Stream != NULL);
+
+  if (Stream->Headers != NULL) {
+    FreePool (Stream->Headers);
+    Stream->Headers = NULL;
   }
 
   //
-  // Verify existence in DataBase
+  // PE context points to the headers, forbid further updates.
   //
-  for (Index = 0; Index < NUM_OF_PK; Index++) {
-    if (CompareMem (PkDataBase[Index].Hash, SignatureContext->PublicKeyHash, 32) == 0) {
-      //
-      // PublicKey valid. Extract prepared publickey from database
-      //
-      Pk = (OC_RSA_PUBLIC_KEY *) PkDataBase[Index].PublicKey;
-    }
+  Stream->HasPeContext = FALSE;
+  if (!EFI_ERROR (Stream->Status)) {
+    Stream->Status = EFI_ABORTED;
   }
+}
 
-  if (Pk == NULL) {
-    DEBUG ((DEBUG_WARN, "Unknown publickey or malformed certificate\n"));
-    FreePool (SignatureContext);
-    FreePool (Context);
-    return EFI_UNSUPPORTED;
+EFI_STATUS
+VerifyApplePeImageSignature (
+  IN OUT VOID                                *PeImage,
+  IN OUT UINTN                               *ImageSize
+  )
+{
+  EFI_STATUS                     Status;
+  APPLE_PE_IMAGE_STREAM_CONTEXT  *Stream;
+
+  Stream = AllocatePool (sizeof (APPLE_PE_IMAGE_STREAM_CONTEXT));
+  if (Stream == NULL) {
+    DEBUG ((DEBUG_WARN, "Pe context allocation failure\n"));
+    return EFI_OUT_OF_RESOURCES;
   }
 
   //
-  // Verify signature
+  // Hash the image in one pass, sanitising it on the way.
   //
-  if (RsaVerifySigHashFromKey (Pk, SignatureContext->Signature, sizeof (SignatureContext->Signature), Context->PeImageHash, sizeof (Context->PeImageHash), OcSigHashTypeSha256) == 1 ) {
-    DEBUG ((DEBUG_INFO, "Signature verified!\n"));
-    FreePool (SignatureContext);
-    FreePool (Context);
-    return EFI_SUCCESS;
+  Status = ApplePeImageStreamInit (Stream, *ImageSize);
+  if (!EFI_ERROR (Status)) {
+    ApplePeImageStreamUpdate (Stream, PeImage, *ImageSize);
+    Status = ApplePeImageStreamFinal (Stream, ImageSize);
+  } else {
+    ApplePeImageStreamFree (Stream);
   }
 
-  FreePool (SignatureContext);
-  FreePool (Context);
-
-  return EFI_SECURITY_VIOLATION;
+  FreePool (Stream);
+  return Status;
 }
@@ -17,6 +17,7 @@
 
 #include <Protocol/AppleImg4Verification.h>
 
+#include <Library/BaseLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/MemoryAllocationLib.h>
@@ -31,6 +32,23 @@
 GLOBAL_REMOVE_IF_UNREFERENCED const uint8_t *DERImg4RootCertificate     = gAppleX86SecureBootRootCaCert;
 GLOBAL_REMOVE_IF_UNREFERENCED const size_t  *DERImg4RootCertificateSize = &gAppleX86SecureBootRootCaCertSize;
 
+//
+// Manifest which passed signature verification in the current session.
+//
+typedef struct {
+  LIST_ENTRY                   Link;
+  UINTN                        ManifestSize;
+  UINT8                        ManifestDigest[SHA384_DIGEST_SIZE];
+  DERImg4ManifestVerification  Verification;
+} IMG4_VERIFIED_MANIFEST;
+
+#define IMG4_VERIFIED_MANIFEST_FROM_LINK(This) \
+  BASE_CR ((This), IMG4_VERIFIED_MANIFEST, Link)
+
+STATIC BOOLEAN            mImg4SessionActive;
+STATIC DERImg4Environment mImg4SessionEnvironment;
+STATIC LIST_ENTRY         mImg4VerifiedManifests = INITIALIZE_LIST_HEAD_VARIABLE (mImg4VerifiedManifests);
+
 bool
 DERImg4VerifySignature (
   DERByte        *Modulus,
@@ -206,6 +224,96 @@ InternalRetrieveHwInfo (
   // CHANGE: HardwareModel is unused.
 }
 
+/**
+  Find a Manifest verified in the current session.
+
+  @param[in] ManifestDigest  SHA-384 digest of the Manifest.
+  @param[in] ManifestSize    The size, in bytes, of the Manifest.
+
+  @retval Verified Manifest or NULL.
+**/
+STATIC
+IMG4_VERIFIED_MANIFEST *
+InternalImg4LookupManifest (
+  IN CONST UINT8  *ManifestDigest,
+  IN UINTN        ManifestSize
+  )
+{
+  LIST_ENTRY              *Link;
+  IMG4_VERIFIED_MANIFEST  *Manifest;
+
+  for (
+    Link = GetFirstNode (&mImg4VerifiedManifests);
+    !IsNull (&mImg4VerifiedManifests, Link);
+    Link = GetNextNode (&mImg4VerifiedManifests, Link)
+    ) {
+    Manifest = IMG4_VERIFIED_MANIFEST_FROM_LINK (Link);
+    if (Manifest->ManifestSize == ManifestSize
+      && CompareMem (Manifest->ManifestDigest, ManifestDigest, sizeof (Manifest->ManifestDigest)) == 0) {
+      return Manifest;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Remember a Manifest verified in the current session.
+  Failing to allocate only costs a repeated verification later.
+
+  @param[in] ManifestDigest  SHA-384 digest of the Manifest.
+  @param[in] ManifestSize    The size, in bytes, of the Manifest.
+  @param[in] Verification    Verification result of the Manifest.
+**/
+STATIC
+VOID
+InternalImg4InsertManifest (
+  IN CONST UINT8                        *ManifestDigest,
+  IN UINTN                              ManifestSize,
+  IN CONST DERImg4ManifestVerification  *Verification
+  )
+{
+  IMG4_VERIFIED_MANIFEST  *Manifest;
+
+  Manifest = AllocatePool (sizeof (*Manifest));
+  if (Manifest == NULL) {
+    return;
+  }
+
+  Manifest->ManifestSize = ManifestSize;
+  CopyMem (Manifest->ManifestDigest, ManifestDigest, sizeof (Manifest->ManifestDigest));
+  CopyMem (&Manifest->Verification, Verification, sizeof (Manifest->Verification));
+  InsertHeadList (&mImg4VerifiedManifests, &Manifest->Link);
+}
+
+VOID
+OcAppleImg4BeginSession (
+  VOID
+  )
+{
+  OcAppleImg4EndSession ();
+
+  InternalRetrieveHwInfo (&mImg4SessionEnvironment);
+  mImg4SessionActive = TRUE;
+}
+
+VOID
+OcAppleImg4EndSession (
+  VOID
+  )
+{
+  LIST_ENTRY  *Link;
+
+  while (!IsListEmpty (&mImg4VerifiedManifests)) {
+    Link = GetFirstNode (&mImg4VerifiedManifests);
+    RemoveEntryList (Link);
+    FreePool (IMG4_VERIFIED_MANIFEST_FROM_LINK (Link));
+  }
+
+  ZeroMem (&mImg4SessionEnvironment, sizeof (mImg4SessionEnvironment));
+  mImg4SessionActive = FALSE;
+}
+
 /**
   Verify the signature of ImageBuffer against Type of its IMG4 Manifest.
 
@@ -239,11 +347,14 @@ AppleImg4Verify (
   OUT UINTN                             *DigestSize OPTIONAL
   )
 {
-  DERReturn           DerResult;
-  INTN                CmpResult;
+  DERReturn                   DerResult;
+  INTN                        CmpResult;
 
-  DERImg4Environment  EnvInfo;
-  DERImg4ManifestInfo ManInfo;
+  DERImg4Environment          EnvInfo;
+  DERImg4ManifestInfo         ManInfo;
+  DERImg4ManifestVerification Verification;
+  IMG4_VERIFIED_MANIFEST      *VerifiedManifest;
+  UINT8                       ManifestDigest[SHA384_DIGEST_SIZE];
 
   if ((ImageBuffer    == NULL || ImageSize    == 0)
    || (ManifestBuffer == NULL || ManifestSize == 0)
@@ -254,14 +365,39 @@ AppleImg4Verify (
     return EFI_INVALID_PARAMETER;
   }
 
-  DerResult = DERImg4ParseManifest (
-                &ManInfo,
-                ManifestBuffer,
-                ManifestSize,
-                ObjType
-                );
-  if (DerResult != DR_Success) {
-    return EFI_SECURITY_VIOLATION;
+  if (mImg4SessionActive) {
+    //
+    // Manifests already verified in this session only need their properties
+    // parsed for ObjType, the signature and certificate chain are trusted.
+    //
+    Sha384 (ManifestDigest, ManifestBuffer, ManifestSize);
+    VerifiedManifest = InternalImg4LookupManifest (ManifestDigest, ManifestSize);
+
+    DerResult = DERImg4ParseManifestEx (
+                  &ManInfo,
+                  ManifestBuffer,
+                  ManifestSize,
+                  ObjType,
+                  VerifiedManifest != NULL ? &VerifiedManifest->Verification : NULL,
+                  &Verification
+                  );
+    if (DerResult != DR_Success) {
+      return EFI_SECURITY_VIOLATION;
+    }
+
+    if (VerifiedManifest == NULL) {
+      InternalImg4InsertManifest (ManifestDigest, ManifestSize, &Verification);
+    }
+  } else {
+    DerResult = DERImg4ParseManifest (
+                  &ManInfo,
+                  ManifestBuffer,
+                  ManifestSize,
+                  ObjType
+                  );
+    if (DerResult != DR_Success) {
+      return EFI_SECURITY_VIOLATION;
+    }
   }
   //
   // As ManInfo.imageDigest is a buffer of static size, the bounds check to
@@ -278,7 +414,11 @@ AppleImg4Verify (
     return EFI_SECURITY_VIOLATION;
   }
 
-  InternalRetrieveHwInfo (&EnvInfo);
+  if (mImg4SessionActive) {
+    CopyMem (&EnvInfo, &mImg4SessionEnvironment, sizeof (EnvInfo));
+  } else {
+    InternalRetrieveHwInfo (&EnvInfo);
+  }
 
   if (SbMode == AppleImg4SbModeMedium) {
     if (ManInfo.hasEcid
@@ -1231,6 +1231,47 @@ DERImg4ParseManifest (
   size_t               ManSize,
   uint32_t             ObjType
   )
+{
+  return DERImg4ParseManifestEx (
+           ManInfo,
+           ManBuffer,
+           ManSize,
+           ObjType,
+           NULL,
+           NULL
+           );
+}
+
+/**
+  Parse the IMG4 Manifest in ManBuffer and output its information.
+  Unless TrustedVerification is provided, the Manifest is verified exactly
+  like DERImg4ParseManifest does, and its verification result is returned
+  in Verification. When TrustedVerification is provided, the Manifest
+  signature and certificate chain are not verified again.
+
+  @param[out] ManInfo              Output Manifest information structure.
+  @param[in]  ManBuffer            Buffer containing the Manifest data.
+  @param[in]  ManSize              Size, in bytes, of ManBuffer.
+  @param[in]  ObjType              The object type to inspect.
+  @param[in]  TrustedVerification  Verification result previously returned
+                                   for identical Manifest data. Optional.
+  @param[out] Verification         Verification result of the Manifest.
+                                   Optional.
+
+  @retval DR_Success  ManBuffer contains a valid, signed IMG4 Manifest and its
+                      information has been returned into ManInfo.
+  @retval other       An error has occured.
+
+**/
+DERReturn
+DERImg4ParseManifestEx (
+  DERImg4ManifestInfo                *ManInfo,
+  const void                         *ManBuffer,
+  size_t                             ManSize,
+  uint32_t                           ObjType,
+  const DERImg4ManifestVerification  *TrustedVerification,
+  DERImg4ManifestVerification        *Verification
+  )
 {
   DERReturn       DerResult;
 
@@ -1307,9 +1348,31 @@ DERImg4ParseManifest (
   //
   // Verify the Manifest body.
   //
-  DerResult = DERImg4ManifestVerifySignature (&ManBodyCertRoleItem, &Manifest);
-  if (DerResult != DR_Success) {
-    return DerResult;
+  if (TrustedVerification != NULL) {
+    if (TrustedVerification->manCertRoleLength == 0
+     || TrustedVerification->manCertRoleOffset > ManSize
+     || TrustedVerification->manCertRoleLength > ManSize - TrustedVerification->manCertRoleOffset) {
+      return DR_DecodeError;
+    }
+
+    ManBodyCertRoleItem.data   = (DERByte *)ManBuffer + TrustedVerification->manCertRoleOffset;
+    ManBodyCertRoleItem.length = TrustedVerification->manCertRoleLength;
+  } else {
+    DerResult = DERImg4ManifestVerifySignature (&ManBodyCertRoleItem, &Manifest);
+    if (DerResult != DR_Success) {
+      return DerResult;
+    }
+    //
+    // The certificate role is in the last certificate of the Manifest.
+    //
+    assert (ManBodyCertRoleItem.data >= (DERByte *)ManBuffer);
+    assert (ManBodyCertRoleItem.length <= ManSize);
+    assert ((size_t)(ManBodyCertRoleItem.data - (DERByte *)ManBuffer) <= ManSize - ManBodyCertRoleItem.length);
+
+    if (Verification != NULL) {
+      Verification->manCertRoleOffset = ManBodyCertRoleItem.data - (DERByte *)ManBuffer;
+      Verification->manCertRoleLength = ManBodyCertRoleItem.length;
+    }
   }
 
   DerResult = DERDecodeItem (&Manifest.body, &ManBodyInfo);
@@ -51,6 +51,11 @@ typedef struct {
   uint8_t            imageDigest[DER_IMG4_MAX_DIGEST_SIZE];
 } DERImg4ManifestInfo;
 
+typedef struct {
+  size_t   manCertRoleOffset;
+  size_t   manCertRoleLength;
+} DERImg4ManifestVerification;
+
 /**
   Verify and parse the IMG4 Manifest in ManBuffer and output its information.
   On success, the Manifest is guaranteed to be digitally signed with the
@@ -74,6 +79,37 @@ DERImg4ParseManifest (
   uint32_t             ObjType
   );
 
+/**
+  Parse the IMG4 Manifest in ManBuffer and output its information.
+  Unless TrustedVerification is provided, the Manifest is verified exactly
+  like DERImg4ParseManifest does, and its verification result is returned
+  in Verification. When TrustedVerification is provided, the Manifest
+  signature and certificate chain are not verified again.
+
+  @param[out] ManInfo              Output Manifest information structure.
+  @param[in]  ManBuffer            Buffer containing the Manifest data.
+  @param[in]  ManSize              Size, in bytes, of ManBuffer.
+  @param[in]  ObjType              The object type to inspect.
+  @param[in]  TrustedVerification  Verification result previously returned
+                                   for identical Manifest data. Optional.
+  @param[out] Verification         Verification result of the Manifest.
+                                   Optional.
+
+  @retval DR_Success  ManBuffer contains a valid, signed IMG4 Manifest and its
+                      information has been returned into ManInfo.
+  @retval other       An error has occured.
+
+**/
+DERReturn
+DERImg4ParseManifestEx (
+  DERImg4ManifestInfo                *ManInfo,
+  const void                         *ManBuffer,
+  size_t                             ManSize,
+  uint32_t                           ObjType,
+  const DERImg4ManifestVerification  *TrustedVerification,
+  DERImg4ManifestVerification        *Verification
+  );
+
 #ifdef __cplusplus
 }
 #endif
@@ -126,7 +126,7 @@ ParseFatArchitecture (
 STATIC
 UINT32
 ParseCompressedHeader (
-  IN     EFI_FILE_PROTOCOL  *File,
+  IN OUT OC_FILE_READER     *Reader,
   IN OUT UINT8              **Buffer,
   IN     UINT32             Offset,
      OUT UINT32             *AllocatedSize,
@@ -171,7 +171,7 @@ ParseCompressedHeader (
     return KernelSize;
   }
 
-  Status = GetFileData (File, Offset + sizeof (MACH_COMP_HEADER), CompressedSize, CompressedBuffer);
+  Status = OcFileReaderRead (Reader, Offset + sizeof (MACH_COMP_HEADER), CompressedSize, CompressedBuffer);
   if (RETURN_ERROR (Status)) {
     DEBUG ((DEBUG_INFO, "Comp kernel (%u bytes) cannot be read at %08X\n", CompressedSize, Offset));
     FreePool (CompressedBuffer);
@@ -201,7 +201,7 @@ ParseCompressedHeader (
 STATIC
 RETURN_STATUS
 ReadAppleKernelImage (
-  IN     EFI_FILE_PROTOCOL  *File,
+  IN OUT OC_FILE_READER     *Reader,
   IN OUT UINT8              **Buffer,
      OUT UINT32             *KernelSize,
      OUT UINT32             *AllocatedSize,
@@ -214,7 +214,11 @@ ReadAppleKernelImage (
   BOOLEAN           ForbidFat;
   BOOLEAN           Compressed;
 
-  Status = GetFileData (File, Offset, KERNEL_HEADER_SIZE, *Buffer);
+  //
+  // The header read fills the reader window, following header, compressed
+  // data and image reads are served from it as much as possible.
+  //
+  Status = OcFileReaderRead (Reader, Offset, KERNEL_HEADER_SIZE, *Buffer);
   if (RETURN_ERROR (Status)) {
     return Status;
   }
@@ -251,7 +255,7 @@ ReadAppleKernelImage (
           //
           // Figure out size for a non fat image.
           //
-          Status = GetFileSize (File, KernelSize);
+          Status = OcFileReaderGetSize (Reader, KernelSize);
           if (RETURN_ERROR (Status)) {
             DEBUG ((DEBUG_INFO, "Kernel size cannot be determined - %r\n", Status));
             return RETURN_OUT_OF_RESOURCES;
@@ -266,7 +270,7 @@ ReadAppleKernelImage (
           return Status;
         }
 
-        Status = GetFileData (File, Offset, *KernelSize, *Buffer);
+        Status = OcFileReaderRead (Reader, Offset, *KernelSize, *Buffer);
         if (RETURN_ERROR (Status)) {
           DEBUG ((DEBUG_INFO, "Kernel (%u bytes) cannot be read at %08X\n", *KernelSize, Offset));
         }
@@ -282,7 +286,7 @@ ReadAppleKernelImage (
 
         *KernelSize = ParseFatArchitecture (Buffer, &Offset);
         if (*KernelSize != 0) {
-          return ReadAppleKernelImage (File, Buffer, KernelSize, AllocatedSize, ReservedSize, Offset);
+          return ReadAppleKernelImage (Reader, Buffer, KernelSize, AllocatedSize, ReservedSize, Offset);
         }
         return RETURN_INVALID_PARAMETER;
       }
@@ -301,7 +305,7 @@ ReadAppleKernelImage (
         //
         // Loop into updated image in Buffer.
         //
-        *KernelSize = ParseCompressedHeader (File, Buffer, Offset, AllocatedSize, ReservedSize);
+        *KernelSize = ParseCompressedHeader (Reader, Buffer, Offset, AllocatedSize, ReservedSize);
         if (*KernelSize != 0) {
           DEBUG ((DEBUG_VERBOSE, "Compressed result has %08X magic\n", *(UINT32 *) Buffer));
           continue;
@@ -324,7 +328,8 @@ ReadAppleKernel (
   IN     UINT32             ReservedSize
   )
 {
-  RETURN_STATUS  Status;
+  RETURN_STATUS   Status;
+  OC_FILE_READER  Reader;
 
   *KernelSize    = 0;
   *AllocatedSize = KERNEL_HEADER_SIZE;
@@ -334,8 +339,19 @@ ReadAppleKernel (
     return RETURN_INVALID_PARAMETER;
   }
 
-  Status = ReadAppleKernelImage (
+  Status = OcFileReaderInit (
+    &Reader,
     File,
+    OC_FILE_READER_WINDOW_SIZE,
+    OC_FILE_READER_BLOCK_SIZE
+    );
+  if (RETURN_ERROR (Status)) {
+    FreePool (*Kernel);
+    return Status;
+  }
+
+  Status = ReadAppleKernelImage (
+    &Reader,
     Kernel,
     KernelSize,
     AllocatedSize,
@@ -343,6 +359,8 @@ ReadAppleKernel (
     0
     );
 
+  OcFileReaderFree (&Reader);
+
   if (RETURN_ERROR (Status)) {
     FreePool (*Kernel);
   }
@@ -56,6 +56,7 @@ typedef struct {
   APPLE_KEY_CODE                    *KeyCodeBuffer;
   UINTN                             KeyCodeBufferLength;
   LIST_ENTRY                        KeyStrokesInfoList;
+  EFI_EVENT                         KeyMapChangeEvent;
   APPLE_KEY_MAP_DATABASE_PROTOCOL   Database;
   APPLE_KEY_MAP_AGGREGATOR_PROTOCOL Aggregator;
 } KEY_MAP_AGGREGATOR_DATA;
@@ -433,6 +434,10 @@ InternalRemoveKeyStrokesBuffer (
   if (KeyStrokesInfo != NULL) {
     KeyMapAggregatorData->KeyCodeBufferLength -= KeyStrokesInfo->KeyCodeBufferLength;
 
+    if (KeyStrokesInfo->NumberOfKeyCodes > 0 || KeyStrokesInfo->Modifiers != 0) {
+      gBS->SignalEvent (KeyMapAggregatorData->KeyMapChangeEvent);
+    }
+
     RemoveEntryList (&KeyStrokesInfo->Link);
     gBS->FreePool ((VOID *)KeyStrokesInfo);
 
@@ -490,14 +495,28 @@ InternalSetKeyStrokeBufferKeys (
     Status = EFI_OUT_OF_RESOURCES;
 
     if (KeyStrokesInfo->KeyCodeBufferLength >= NumberOfKeyCodes) {
-      KeyStrokesInfo->NumberOfKeyCodes = NumberOfKeyCodes;
-      KeyStrokesInfo->Modifiers        = Modifiers;
-
-      CopyMem (
-        (VOID *)&KeyStrokesInfo->KeyCodes[0],
-        (VOID *)KeyCodes,
-        (NumberOfKeyCodes * sizeof (*KeyCodes))
-        );
+      //
+      // Keyboard drivers report the same keys on every poll, only wake up
+      // the waiters on actual changes.
+      //
+      if (KeyStrokesInfo->NumberOfKeyCodes != NumberOfKeyCodes
+        || KeyStrokesInfo->Modifiers != Modifiers
+        || CompareMem (
+             (VOID *)&KeyStrokesInfo->KeyCodes[0],
+             (VOID *)KeyCodes,
+             (NumberOfKeyCodes * sizeof (*KeyCodes))
+             ) != 0) {
+        KeyStrokesInfo->NumberOfKeyCodes = NumberOfKeyCodes;
+        KeyStrokesInfo->Modifiers        = Modifiers;
+
+        CopyMem (
+          (VOID *)&KeyStrokesInfo->KeyCodes[0],
+          (VOID *)KeyCodes,
+          (NumberOfKeyCodes * sizeof (*KeyCodes))
+          );
+
+        gBS->SignalEvent (KeyMapAggregatorData->KeyMapChangeEvent);
+      }
 
       Status = EFI_SUCCESS;
     }
@@ -521,6 +540,27 @@ OcAppleKeyMapGetDatabase (
   return mKeyMapDatabase;
 }
 
+/**
+  Returns the event signalled on key map changes.
+
+  @retval event or NULL when the installed database is not ours.
+**/
+EFI_EVENT
+OcAppleKeyMapGetChangeEvent (
+  VOID
+  )
+{
+  KEY_MAP_AGGREGATOR_DATA  *KeyMapAggregatorData;
+
+  if (mKeyMapDatabase == NULL
+    || mKeyMapDatabase->SetKeyStrokeBufferKeys != InternalSetKeyStrokeBufferKeys) {
+    return NULL;
+  }
+
+  KeyMapAggregatorData = KEY_MAP_AGGREGATOR_DATA_FROM_DATABASE_THIS (mKeyMapDatabase);
+  return KeyMapAggregatorData->KeyMapChangeEvent;
+}
+
 /**
   Install and initialise Apple Key Map protocols.
 
@@ -586,6 +626,21 @@ OcAppleKeyMapInstallProtocols (
 
   InitializeListHead (&KeyMapAggregatorData->KeyStrokesInfoList);
 
+  //
+  // Plain event for WaitForEvent, signalled on key map changes.
+  //
+  Status = gBS->CreateEvent (
+    0,
+    0,
+    NULL,
+    NULL,
+    &KeyMapAggregatorData->KeyMapChangeEvent
+    );
+  if (EFI_ERROR (Status)) {
+    FreePool (KeyMapAggregatorData);
+    return NULL;
+  }
+
   Status = gBS->InstallMultipleProtocolInterfaces (
     &gImageHandle,
     &gAppleKeyMapDatabaseProtocolGuid,
@@ -595,6 +650,7 @@ OcAppleKeyMapInstallProtocols (
     NULL
     );
   if (EFI_ERROR (Status)) {
+    gBS->CloseEvent (KeyMapAggregatorData->KeyMapChangeEvent);
     FreePool (KeyMapAggregatorData);
     return NULL;
   }
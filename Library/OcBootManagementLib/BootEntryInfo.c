@@ -402,7 +402,20 @@ InternalPrepareScanInfo (
   if (Context->ExcludeHandle != DevPathScanInfo->Device) {
     Status = EFI_NOT_FOUND;
 
-    if (Context->NumCustomBootPaths > 0) {
+    if (DevPathScanInfo->CustomBootPathProbed) {
+      //
+      // Custom boot paths were already probed in non-blocking mode.
+      //
+      if (DevPathScanInfo->CustomBootPathIndex < Context->NumCustomBootPaths) {
+        DevPathScanInfo->BootDevicePath = FileDevicePath (
+          DevPathScanInfo->Device,
+          Context->CustomBootPaths[DevPathScanInfo->CustomBootPathIndex]
+          );
+        if (DevPathScanInfo->BootDevicePath != NULL) {
+          Status = EFI_SUCCESS;
+        }
+      }
+    } else if (Context->NumCustomBootPaths > 0) {
       Status = SimpleFs->OpenVolume (SimpleFs, &Root);
       if (!EFI_ERROR (Status)) {
         Status = OcGetBooterFromPredefinedNameList (
@@ -557,6 +570,7 @@ InternalFillValidBootEntries (
 
     Entries[EntryIndex].DevicePath = DevicePath;
     Entries[EntryIndex].IsExternal = DevPathScanInfo->IsExternal;
+    OcGetDevicePathFingerprint (DevicePath, &Entries[EntryIndex].DevicePathFingerprint);
     InternalSetBootEntryFlags (&Entries[EntryIndex]);
     ++EntryIndex;
 
@@ -599,6 +613,7 @@ InternalFillValidBootEntries (
 
     Entries[EntryIndex].DevicePath = DevicePath;
     Entries[EntryIndex].IsExternal = DevPathScanInfo->IsExternal;
+    OcGetDevicePathFingerprint (DevicePath, &Entries[EntryIndex].DevicePathFingerprint);
     InternalSetBootEntryFlags (&Entries[EntryIndex]);
     ++EntryIndex;
   }
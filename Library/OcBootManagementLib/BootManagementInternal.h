@@ -30,6 +30,13 @@ typedef struct {
   EFI_HANDLE                     BlockIoHandle;
 } INTERNAL_DMG_LOAD_CONTEXT;
 
+//
+// Booter file names probed by Apple Boot Policy in this order when nothing
+// is blessed, shared by volume probing and scan cache validation.
+//
+extern CONST CHAR16  *gInternalBootPathNames[];
+extern CONST UINTN   gInternalNumBootPathNames;
+
 typedef struct {
   EFI_HANDLE               Device;
   UINTN                    NumBootInstances;
@@ -38,6 +45,19 @@ typedef struct {
   EFI_DEVICE_PATH_PROTOCOL *BootDevicePath;
   BOOLEAN                  IsExternal;
   BOOLEAN                  SkipRecovery;
+  //
+  // Set when custom boot paths were already probed by InternalProbeScanVolumes.
+  // CustomBootPathIndex is then the first existing custom boot path index or
+  // NumCustomBootPaths when none of them exist.
+  //
+  BOOLEAN                  CustomBootPathProbed;
+  UINTN                    CustomBootPathIndex;
+  //
+  // Scan cache entry the scan info was restored from, stays valid until
+  // the cache is saved.
+  //
+  CONST VOID               *ScanCacheEntry;
+  UINTN                    ScanCacheEntrySize;
 } INTERNAL_DEV_PATH_SCAN_INFO;
 
 RETURN_STATUS
@@ -95,6 +115,42 @@ InternalLoadBootEntry (
   OUT INTERNAL_DMG_LOAD_CONTEXT   *DmgLoadContext
   );
 
+VOID
+InternalProbeScanVolumes (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     EFI_HANDLE                   *Handles,
+  IN     UINTN                        NoHandles,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfos
+  );
+
+VOID *
+InternalLoadScanCache (
+  IN  OC_PICKER_CONTEXT  *Context,
+  IN  EFI_HANDLE         *Handles,
+  IN  UINTN              NoHandles,
+  OUT UINTN              *CacheSize
+  );
+
+EFI_STATUS
+InternalRestoreScanInfo (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     CONST VOID                   *Cache,
+  IN     UINTN                        CacheSize,
+  IN     EFI_HANDLE                   Device,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfo
+  );
+
+VOID
+InternalSaveScanCache (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     EFI_HANDLE                   *Handles,
+  IN     UINTN                        NoHandles,
+  IN     CONST VOID                   *OldCache  OPTIONAL,
+  IN     UINTN                        OldCacheSize,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfos,
+  IN     UINTN                        NumScanInfos
+  );
+
 EFI_STATUS
 InternalPrepareScanInfo (
   IN     APPLE_BOOT_POLICY_PROTOCOL       *BootPolicy,
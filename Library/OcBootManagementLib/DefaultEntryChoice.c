@@ -258,17 +258,29 @@ InternalGetBootEntryByDevicePath (
   IN     BOOLEAN                   IsBootNext
   )
 {
-  INTN                     CmpResult;
+  INTN                       CmpResult;
 
-  UINTN                    RootDevicePathSize;
+  UINTN                      RootDevicePathSize;
+  UINT32                     RootDevicePathHash;
+  UINT32                     RemainingFilePathHash;
+  BOOLEAN                    HasRemainingFilePathHash;
 
-  EFI_DEVICE_PATH_PROTOCOL *OcDevicePath;
-  EFI_DEVICE_PATH_PROTOCOL *OcRemainingDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL   *OcDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL   *OcRemainingDevicePath;
+  OC_DEVICE_PATH_FINGERPRINT *Fingerprint;
 
-  OC_BOOT_ENTRY            *BootEntry;
-  UINTN                    Index;
+  OC_BOOT_ENTRY              *BootEntry;
+  UINTN                      Index;
 
   RootDevicePathSize = ((UINT8 *)UefiRemainingDevicePath - (UINT8 *)UefiDevicePath);
+  RootDevicePathHash = OcHashDevicePathData (UefiDevicePath, RootDevicePathSize);
+
+  //
+  // Only the file path part needs to be compared for non-BootNext boot.
+  //
+  HasRemainingFilePathHash = !IsBootNext
+    && !IsDevicePathEnd (UefiRemainingDevicePath)
+    && OcGetFileDevicePathHash (UefiRemainingDevicePath, &RemainingFilePathHash);
 
   for (Index = 0; Index < NumBootEntries; ++Index) {
     BootEntry = &BootEntries[Index];
@@ -279,7 +291,26 @@ InternalGetBootEntryByDevicePath (
     OcDevicePath = BootEntry->DevicePath;
     ASSERT (OcDevicePath != NULL);
 
-    if ((GetDevicePathSize (OcDevicePath) - END_DEVICE_PATH_LENGTH) < RootDevicePathSize) {
+    Fingerprint = &BootEntry->DevicePathFingerprint;
+    if (Fingerprint->Size == 0) {
+      OcGetDevicePathFingerprint (OcDevicePath, Fingerprint);
+    }
+
+    if (Fingerprint->RootSize == RootDevicePathSize) {
+      //
+      // The device path splits at the same place, so the fingerprint can reject
+      // the entry without comparing, and a match is only confirmed below.
+      //
+      if (Fingerprint->RootHash != RootDevicePathHash) {
+        continue;
+      }
+
+      if (HasRemainingFilePathHash
+        && Fingerprint->HasFilePathHash
+        && Fingerprint->FilePathHash != RemainingFilePathHash) {
+        continue;
+      }
+    } else if ((Fingerprint->Size - END_DEVICE_PATH_LENGTH) < RootDevicePathSize) {
       continue;
     }
 
@@ -318,6 +349,7 @@ InternalGetBootEntryByDevicePath (
         //
         FreePool (BootEntry->DevicePath);
         BootEntry->DevicePath = UefiDevicePath;
+        OcGetDevicePathFingerprint (UefiDevicePath, &BootEntry->DevicePathFingerprint);
       }
     }
 
@@ -44,6 +44,16 @@
 #include <Library/UefiRuntimeServicesTableLib.h>
 #include <Library/UefiLib.h>
 
+//
+// Key map polling period when no change notification is available.
+//
+#define OC_KEY_MAP_POLL_PERIOD         EFI_TIMER_PERIOD_MILLISECONDS (10)
+
+//
+// Timeout checking period when key map changes are notified.
+//
+#define OC_KEY_MAP_NOTIFY_POLL_PERIOD  EFI_TIMER_PERIOD_MILLISECONDS (50)
+
 EFI_STATUS
 OcDescribeBootEntry (
   IN     APPLE_BOOT_POLICY_PROTOCOL *BootPolicy,
@@ -160,6 +170,8 @@ OcResetBootEntry (
     BootEntry->DevicePath = NULL;
   }
 
+  ZeroMem (&BootEntry->DevicePathFingerprint, sizeof (BootEntry->DevicePathFingerprint));
+
   if (BootEntry->Name != NULL) {
     FreePool (BootEntry->Name);
     BootEntry->Name = NULL;
@@ -233,6 +245,8 @@ OcScanForBootEntries (
   INTERNAL_DEV_PATH_SCAN_INFO      *DevPathScanInfos;
   EFI_DEVICE_PATH_PROTOCOL         *DevicePathWalker;
   CONST FILEPATH_DEVICE_PATH       *FilePath;
+  VOID                             *ScanCache;
+  UINTN                            ScanCacheSize;
 
   Result = OcOverflowMulUN (Context->AllCustomEntryCount, sizeof (OC_BOOT_ENTRY), &EntriesSize);
   if (Result) {
@@ -281,16 +295,44 @@ OcScanForBootEntries (
     return EFI_OUT_OF_RESOURCES;
   }
 
+  ScanCache     = NULL;
+  ScanCacheSize = 0;
+  if (Context->UseScanCache) {
+    ScanCache = InternalLoadScanCache (Context, Handles, NoHandles, &ScanCacheSize);
+  }
+
+  //
+  // Restore cached volumes first, so that only the remaining ones get probed.
+  //
+  if (ScanCache != NULL) {
+    for (Index = 0; Index < NoHandles; ++Index) {
+      InternalRestoreScanInfo (
+        Context,
+        ScanCache,
+        ScanCacheSize,
+        Handles[Index],
+        &DevPathScanInfos[Index]
+        );
+    }
+  }
+
+  if (Context->ProbeVolumesAsync) {
+    InternalProbeScanVolumes (Context, Handles, NoHandles, DevPathScanInfos);
+  }
+
   for (Index = 0; Index < NoHandles; ++Index) {
     DevPathScanInfo = &DevPathScanInfos[Index];
 
-    Status = InternalPrepareScanInfo (
-      BootPolicy,
-      Context,
-      Handles,
-      Index,
-      DevPathScanInfo
-      );
+    Status = EFI_SUCCESS;
+    if (DevPathScanInfo->BootDevicePath == NULL) {
+      Status = InternalPrepareScanInfo (
+        BootPolicy,
+        Context,
+        Handles,
+        Index,
+        DevPathScanInfo
+        );
+    }
 
     if (EFI_ERROR (Status)) {
       continue;
@@ -305,6 +347,9 @@ OcScanForBootEntries (
                &EntriesSize
                );
     if (Result) {
+      if (ScanCache != NULL) {
+        FreePool (ScanCache);
+      }
       FreePool (Handles);
       FreePool (DevPathScanInfos);
       return EFI_OUT_OF_RESOURCES;
@@ -315,6 +360,21 @@ OcScanForBootEntries (
   //
   Status = EFI_SUCCESS;
 
+  if (Context->UseScanCache) {
+    InternalSaveScanCache (
+      Context,
+      Handles,
+      NoHandles,
+      ScanCache,
+      ScanCacheSize,
+      DevPathScanInfos,
+      NoHandles
+      );
+    if (ScanCache != NULL) {
+      FreePool (ScanCache);
+    }
+  }
+
   FreePool (Handles);
 
   if (EntriesSize == 0) {
@@ -938,14 +998,28 @@ OcLoadPickerHotKeys (
   }
 }
 
+/**
+  Obtains key index from user input, sleeping between key map checks.
+
+  @param[in,out]  Context        Picker context.
+  @param[in]      KeyMap         Apple Key Map Aggregator.
+  @param[in]      Timeout        Timeout to wait for.
+  @param[in]      WaitEvents     Events to wait for between checks.
+  @param[in]      NumWaitEvents  Number of events in WaitEvents, 0 to busy wait.
+
+  @returns key index [0, OC_INPUT_MAX), OC_INPUT_ABORTED, or OC_INPUT_INVALID.
+**/
+STATIC
 INTN
-OcWaitForAppleKeyIndex (
-  IN OUT OC_PICKER_CONTEXT  *Context,
-  IN UINTN                  Timeout
+InternalWaitForAppleKeyIndex (
+  IN OUT OC_PICKER_CONTEXT                  *Context,
+  IN     APPLE_KEY_MAP_AGGREGATOR_PROTOCOL  *KeyMap,
+  IN     UINTN                              Timeout,
+  IN     EFI_EVENT                          *WaitEvents,
+  IN     UINTN                              NumWaitEvents
   )
 {
   EFI_STATUS                         Status;
-  APPLE_KEY_MAP_AGGREGATOR_PROTOCOL  *KeyMap;
   APPLE_KEY_CODE                     KeyCode;
 
   UINTN                              NumKeys;
@@ -964,23 +1038,25 @@ OcWaitForAppleKeyIndex (
   UINT64                             CurrTime;
   UINT64                             EndTime;
   UINTN                              CsrActiveConfigSize;
-
-  //
-  // These hotkeys are normally parsed by boot.efi, and they work just fine
-  // when ShowPicker is disabled. On some BSPs, however, they may fail badly
-  // when ShowPicker is enabled, and for this reason we support these hotkeys
-  // within picker itself.
-  //
-  KeyMap = OcAppleKeyMapInstallProtocols (FALSE);
-  if (KeyMap == NULL) {
-    DEBUG ((DEBUG_ERROR, "OCB: Missing AppleKeyMapAggregator\n"));
-    return OC_INPUT_INVALID;
-  }
+  UINTN                              EventIndex;
+  BOOLEAN                            Wait;
 
   CurrTime  = GetTimeInNanoSecond (GetPerformanceCounter ());
   EndTime   = CurrTime + Timeout * 1000000000ULL;
+  Wait      = FALSE;
 
   while (Timeout == 0 || CurrTime == 0 || CurrTime < EndTime) {
+    //
+    // Keys held on entry are checked right away.
+    //
+    if (Wait) {
+      if (NumWaitEvents == 0
+        || EFI_ERROR (gBS->WaitForEvent (NumWaitEvents, WaitEvents, &EventIndex))) {
+        MicroSecondDelay (10);
+      }
+    }
+
+    Wait    = TRUE;
     NumKeys = ARRAY_SIZE (Keys);
     Status = KeyMap->GetKeyStrokes (
                        KeyMap,
@@ -1123,13 +1199,84 @@ OcWaitForAppleKeyIndex (
     if (Timeout != 0 && NumKeys != 0) {
       return OC_INPUT_INVALID;
     }
-
-    MicroSecondDelay (10);
   }
 
   return OC_INPUT_TIMEOUT;
 }
 
+INTN
+OcWaitForAppleKeyIndex (
+  IN OUT OC_PICKER_CONTEXT  *Context,
+  IN UINTN                  Timeout
+  )
+{
+  EFI_STATUS                         Status;
+  APPLE_KEY_MAP_AGGREGATOR_PROTOCOL  *KeyMap;
+  EFI_EVENT                          WaitEvents[2];
+  UINTN                              NumWaitEvents;
+  EFI_EVENT                          PollEvent;
+  INTN                               KeyIndex;
+
+  //
+  // These hotkeys are normally parsed by boot.efi, and they work just fine
+  // when ShowPicker is disabled. On some BSPs, however, they may fail badly
+  // when ShowPicker is enabled, and for this reason we support these hotkeys
+  // within picker itself.
+  //
+  KeyMap = OcAppleKeyMapInstallProtocols (FALSE);
+  if (KeyMap == NULL) {
+    DEBUG ((DEBUG_ERROR, "OCB: Missing AppleKeyMapAggregator\n"));
+    return OC_INPUT_INVALID;
+  }
+
+  //
+  // Spinning on the key map burns a core and starves USB polling on some
+  // firmwares. Sleep in WaitForEvent instead, waking up on key map changes
+  // when they are reported, and on a timer to check the timeout or to poll
+  // at a bounded rate otherwise.
+  //
+  NumWaitEvents = 0;
+  WaitEvents[0] = OcAppleKeyMapGetChangeEvent ();
+  if (WaitEvents[0] != NULL) {
+    ++NumWaitEvents;
+  }
+
+  Status = gBS->CreateEvent (EVT_TIMER, 0, NULL, NULL, &PollEvent);
+  if (!EFI_ERROR (Status)) {
+    Status = gBS->SetTimer (
+      PollEvent,
+      TimerPeriodic,
+      NumWaitEvents > 0 ? OC_KEY_MAP_NOTIFY_POLL_PERIOD : OC_KEY_MAP_POLL_PERIOD
+      );
+    if (EFI_ERROR (Status)) {
+      gBS->CloseEvent (PollEvent);
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    WaitEvents[NumWaitEvents] = PollEvent;
+    ++NumWaitEvents;
+  } else {
+    DEBUG ((DEBUG_INFO, "OCB: Key map poll timer failure - %r\n", Status));
+    PollEvent     = NULL;
+    NumWaitEvents = 0;
+  }
+
+  KeyIndex = InternalWaitForAppleKeyIndex (
+    Context,
+    KeyMap,
+    Timeout,
+    WaitEvents,
+    NumWaitEvents
+    );
+
+  if (PollEvent != NULL) {
+    gBS->CloseEvent (PollEvent);
+  }
+
+  return KeyIndex;
+}
+
 EFI_STATUS
 EFIAPI
 OcShowSimplePasswordRequest (
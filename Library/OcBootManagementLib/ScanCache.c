@@ -0,0 +1,1466 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootManagementInternal.h"
+
+#include <AppleMacEfi.h>
+
+#include <Guid/AppleApfsInfo.h>
+#include <Guid/AppleBless.h>
+#include <Guid/OcVariables.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcDevicePathLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/OcStringLib.h>
+#include <Library/PrintLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+
+#define INTERNAL_SCAN_CACHE_SIGNATURE  SIGNATURE_32 ('O', 'C', 'S', 'C')
+
+//
+// Keep the variable small enough for most NVRAM implementations.
+//
+#define INTERNAL_SCAN_CACHE_MAX_SIZE   BASE_4KB
+
+//
+// Booter path lists probed by the boot policy, see INTERNAL_SCAN_CACHE_PROBE.
+//
+#define INTERNAL_SCAN_CACHE_PROBE_CUSTOM          1U
+#define INTERNAL_SCAN_CACHE_PROBE_BLESSED_FOLDER  2U
+#define INTERNAL_SCAN_CACHE_PROBE_PREDEFINED      3U
+#define INTERNAL_SCAN_CACHE_PROBE_APFS            4U
+
+#pragma pack(push, 1)
+
+typedef PACKED struct {
+  //
+  // INTERNAL_SCAN_CACHE_SIGNATURE.
+  //
+  UINT32    Signature;
+  //
+  // Scan policy the cache was created with.
+  //
+  UINT32    ScanPolicy;
+  //
+  // Hash of custom boot paths the cache was created with.
+  //
+  UINT32    CustomBootPathsHash;
+  //
+  // Size of the volume set following the header. Volume set is made of
+  // device paths of all scanned filesystems in handle order. Adding or
+  // removing any volume invalidates the whole cache, as it may change
+  // booters of other volumes, e.g. APFS Preboot lists every container volume.
+  //
+  UINT32    VolumeSetSize;
+} INTERNAL_SCAN_CACHE_HEADER;
+
+//
+// Entry data follows the entry in this order: volume device path, blessed
+// system file and folder information, multi-instance boot device path,
+// modification times of every boot device path instance and probes.
+//
+typedef PACKED struct {
+  //
+  // Volume device path size. Volume device path contains partition GUID
+  // and, for APFS, volume UUID.
+  //
+  UINT32    VolumeSize;
+  //
+  // Blessed system file and folder information sizes, zero when missing.
+  //
+  UINT32    BlessedFileSize;
+  UINT32    BlessedFolderSize;
+  //
+  // Multi-instance boot device path size.
+  //
+  UINT32    BootDevicePathSize;
+  //
+  // Number of boot device path instances.
+  //
+  UINT32    NumBootInstances;
+  //
+  // Number of booter path lists with paths missing at caching time.
+  //
+  UINT32    NumProbes;
+} INTERNAL_SCAN_CACHE_ENTRY;
+
+//
+// Booter path list probed before or while the cached booters were found.
+// Creating any of the missing paths makes the boot policy pick it instead.
+//
+typedef PACKED struct {
+  //
+  // INTERNAL_SCAN_CACHE_PROBE_* path list.
+  //
+  UINT8     Type;
+  //
+  // Number of leading list paths that were missing.
+  //
+  UINT32    NumMissing;
+  //
+  // Volume UUID naming Preboot directory for INTERNAL_SCAN_CACHE_PROBE_APFS.
+  //
+  GUID      VolumeUuid;
+} INTERNAL_SCAN_CACHE_PROBE;
+
+#pragma pack(pop)
+
+/**
+  Calculate a hash of the scan cache invalidating configuration.
+
+  @param[in] Context  Picker context.
+
+  @returns Custom boot paths hash.
+**/
+STATIC
+UINT32
+InternalGetCustomBootPathsHash (
+  IN OC_PICKER_CONTEXT  *Context
+  )
+{
+  UINT32  Hash;
+  UINTN   Index;
+
+  Hash = (UINT32) Context->NumCustomBootPaths;
+  for (Index = 0; Index < Context->NumCustomBootPaths; ++Index) {
+    Hash ^= OcHashDevicePathData (
+      Context->CustomBootPaths[Index],
+      StrSize (Context->CustomBootPaths[Index])
+      );
+    Hash *= 0x01000193U;
+  }
+
+  return Hash;
+}
+
+/**
+  Build the set of scanned volumes.
+
+  @param[in]  Handles        Filesystem handles.
+  @param[in]  NoHandles      Number of filesystem handles.
+  @param[out] VolumeSetSize  Volume set size.
+
+  @returns Volume set allocated from pool or NULL when it does not fit the cache.
+**/
+STATIC
+UINT8 *
+InternalGetScanCacheVolumeSet (
+  IN  EFI_HANDLE  *Handles,
+  IN  UINTN       NoHandles,
+  OUT UINTN       *VolumeSetSize
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  UINT8                     *VolumeSet;
+  UINTN                     DevicePathSize;
+  UINTN                     Offset;
+  UINTN                     Index;
+
+  VolumeSet = AllocatePool (INTERNAL_SCAN_CACHE_MAX_SIZE);
+  if (VolumeSet == NULL) {
+    return NULL;
+  }
+
+  Offset = 0;
+
+  for (Index = 0; Index < NoHandles; ++Index) {
+    Status = gBS->HandleProtocol (
+      Handles[Index],
+      &gEfiDevicePathProtocolGuid,
+      (VOID **) &DevicePath
+      );
+    if (EFI_ERROR (Status)) {
+      DevicePath     = NULL;
+      DevicePathSize = END_DEVICE_PATH_LENGTH;
+    } else {
+      DevicePathSize = GetDevicePathSize (DevicePath);
+    }
+
+    if (DevicePathSize > INTERNAL_SCAN_CACHE_MAX_SIZE - sizeof (INTERNAL_SCAN_CACHE_HEADER) - Offset) {
+      FreePool (VolumeSet);
+      return NULL;
+    }
+
+    if (DevicePath != NULL) {
+      CopyMem (&VolumeSet[Offset], DevicePath, DevicePathSize);
+    } else {
+      SetDevicePathEndNode (&VolumeSet[Offset]);
+    }
+
+    Offset += DevicePathSize;
+  }
+
+  *VolumeSetSize = Offset;
+  return VolumeSet;
+}
+
+/**
+  Calculate the size of the data following a scan cache entry.
+
+  @param[in]  Entry     Scan cache entry.
+  @param[out] DataSize  Entry data size.
+
+  @retval TRUE on success.
+**/
+STATIC
+BOOLEAN
+InternalGetScanCacheEntryDataSize (
+  IN  CONST INTERNAL_SCAN_CACHE_ENTRY  *Entry,
+  OUT UINTN                            *DataSize
+  )
+{
+  BOOLEAN  Result;
+
+  Result  = OcOverflowTriAddUN (
+    Entry->VolumeSize,
+    Entry->BlessedFileSize,
+    Entry->BlessedFolderSize,
+    DataSize
+    );
+  Result |= OcOverflowAddUN (*DataSize, Entry->BootDevicePathSize, DataSize);
+  Result |= OcOverflowMulAddUN (Entry->NumBootInstances, sizeof (EFI_TIME), *DataSize, DataSize);
+  Result |= OcOverflowMulAddUN (Entry->NumProbes, sizeof (INTERNAL_SCAN_CACHE_PROBE), *DataSize, DataSize);
+
+  return !Result;
+}
+
+/**
+  Open the root of a volume.
+
+  @param[in]  Device  Volume handle.
+  @param[out] Root    Volume root.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalOpenScanCacheVolume (
+  IN  EFI_HANDLE         Device,
+  OUT EFI_FILE_PROTOCOL  **Root
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *FileSystem;
+
+  Status = gBS->HandleProtocol (
+    Device,
+    &gEfiSimpleFileSystemProtocolGuid,
+    (VOID **) &FileSystem
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return FileSystem->OpenVolume (FileSystem, Root);
+}
+
+/**
+  Obtain bless information of the volume, which may redirect the booter
+  without changing any booter file.
+
+  @param[in]  Root               Volume root.
+  @param[out] BlessedFile        Blessed system file information or NULL.
+  @param[out] BlessedFileSize    Blessed system file information size.
+  @param[out] BlessedFolder      Blessed system folder information or NULL.
+  @param[out] BlessedFolderSize  Blessed system folder information size.
+**/
+STATIC
+VOID
+InternalGetBlessInfo (
+  IN  EFI_FILE_PROTOCOL  *Root,
+  OUT VOID               **BlessedFile,
+  OUT UINTN              *BlessedFileSize,
+  OUT VOID               **BlessedFolder,
+  OUT UINTN              *BlessedFolderSize
+  )
+{
+  *BlessedFile = GetFileInfo (
+    Root,
+    &gAppleBlessedSystemFileInfoGuid,
+    sizeof (EFI_DEVICE_PATH_PROTOCOL),
+    BlessedFileSize
+    );
+  if (*BlessedFile == NULL) {
+    *BlessedFileSize = 0;
+  }
+
+  *BlessedFolder = GetFileInfo (
+    Root,
+    &gAppleBlessedSystemFolderInfoGuid,
+    sizeof (EFI_DEVICE_PATH_PROTOCOL),
+    BlessedFolderSize
+    );
+  if (*BlessedFolder == NULL) {
+    *BlessedFolderSize = 0;
+  }
+}
+
+/**
+  Obtain APFS container and volume information of the volume.
+
+  @param[in]  Root           Volume root.
+  @param[out] ContainerUuid  APFS container UUID.
+  @param[out] VolumeUuid     APFS volume UUID.
+  @param[out] VolumeRole     APFS volume role.
+
+  @retval EFI_SUCCESS for APFS volumes.
+  @retval EFI_NOT_FOUND for other volumes.
+**/
+STATIC
+EFI_STATUS
+InternalGetApfsInfo (
+  IN  EFI_FILE_PROTOCOL       *Root,
+  OUT GUID                    *ContainerUuid,
+  OUT GUID                    *VolumeUuid,
+  OUT APPLE_APFS_VOLUME_ROLE  *VolumeRole
+  )
+{
+  APPLE_APFS_CONTAINER_INFO  *ContainerInfo;
+  APPLE_APFS_VOLUME_INFO     *VolumeInfo;
+
+  VolumeInfo = GetFileInfo (
+    Root,
+    &gAppleApfsVolumeInfoGuid,
+    sizeof (*VolumeInfo),
+    NULL
+    );
+  if (VolumeInfo == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  ContainerInfo = GetFileInfo (
+    Root,
+    &gAppleApfsContainerInfoGuid,
+    sizeof (*ContainerInfo),
+    NULL
+    );
+  if (ContainerInfo == NULL) {
+    FreePool (VolumeInfo);
+    return EFI_NOT_FOUND;
+  }
+
+  CopyGuid (ContainerUuid, &ContainerInfo->Uuid);
+  CopyGuid (VolumeUuid, &VolumeInfo->Uuid);
+  *VolumeRole = VolumeInfo->Role;
+
+  FreePool (ContainerInfo);
+  FreePool (VolumeInfo);
+  return EFI_SUCCESS;
+}
+
+/**
+  Obtain the booter path the boot policy derives from blessed system
+  folder information.
+
+  @param[in] BlessedFolder      Blessed system folder information, may be unaligned.
+  @param[in] BlessedFolderSize  Blessed system folder information size.
+
+  @returns Booter path allocated from pool or NULL.
+**/
+STATIC
+CHAR16 *
+InternalGetBlessedFolderBooter (
+  IN CONST VOID  *BlessedFolder  OPTIONAL,
+  IN UINTN       BlessedFolderSize
+  )
+{
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePathWalker;
+  FILEPATH_DEVICE_PATH      *FolderDevicePath;
+  CHAR16                    *BooterPath;
+  UINTN                     BooterPathSize;
+
+  if (BlessedFolder == NULL || BlessedFolderSize < sizeof (EFI_DEVICE_PATH_PROTOCOL)) {
+    return NULL;
+  }
+
+  DevicePath = AllocateCopyPool (BlessedFolderSize, BlessedFolder);
+  if (DevicePath == NULL) {
+    return NULL;
+  }
+
+  BooterPath = NULL;
+
+  if (IsDevicePathValid (DevicePath, BlessedFolderSize)) {
+    DevicePathWalker = DevicePath;
+
+    while (!IsDevicePathEnd (DevicePathWalker)) {
+      if (DevicePathType (DevicePathWalker) == MEDIA_DEVICE_PATH
+        && DevicePathSubType (DevicePathWalker) == MEDIA_FILEPATH_DP) {
+        FolderDevicePath = (FILEPATH_DEVICE_PATH *) DevicePathWalker;
+        BooterPathSize   = OcFileDevicePathNameSize (FolderDevicePath)
+          + L_STR_SIZE_NT (APPLE_BOOTER_ROOT_FILE_NAME);
+        BooterPath       = AllocateZeroPool (BooterPathSize);
+        if (BooterPath != NULL) {
+          StrCpyS (BooterPath, BooterPathSize, &FolderDevicePath->PathName[0]);
+          StrCatS (BooterPath, BooterPathSize, APPLE_BOOTER_ROOT_FILE_NAME);
+        }
+        break;
+      }
+
+      DevicePathWalker = NextDevicePathNode (DevicePathWalker);
+    }
+  }
+
+  FreePool (DevicePath);
+  return BooterPath;
+}
+
+/**
+  Check whether a booter path exists.
+
+  @param[in] Root        Volume root.
+  @param[in] VolumeUuid  APFS volume UUID naming Preboot directory, optional.
+  @param[in] PathName    Booter path with a leading slash.
+
+  @retval EFI_SUCCESS when the booter exists.
+  @retval EFI_NOT_FOUND when the booter is missing.
+  @retval other when the booter state is unknown.
+**/
+STATIC
+EFI_STATUS
+InternalBooterPathExists (
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST GUID         *VolumeUuid  OPTIONAL,
+  IN CONST CHAR16       *PathName
+  )
+{
+  EFI_STATUS         Status;
+  EFI_FILE_PROTOCOL  *File;
+  CHAR16             *FullPath;
+  UINTN              FullPathSize;
+
+  if (VolumeUuid != NULL) {
+    FullPathSize = GUID_STRING_LENGTH * sizeof (CHAR16) + StrSize (PathName);
+    FullPath     = AllocatePool (FullPathSize);
+    if (FullPath == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    UnicodeSPrint (FullPath, FullPathSize, L"%g%s", VolumeUuid, PathName);
+  } else {
+    FullPath = (CHAR16 *) PathName;
+  }
+
+  Status = Root->Open (Root, &File, FullPath, EFI_FILE_MODE_READ, 0);
+  if (!EFI_ERROR (Status)) {
+    File->Close (File);
+  }
+
+  if (VolumeUuid != NULL) {
+    FreePool (FullPath);
+  }
+
+  return Status;
+}
+
+/**
+  Find the first existing booter path in a list.
+
+  @param[in]  Root        Volume root.
+  @param[in]  VolumeUuid  APFS volume UUID naming Preboot directory, optional.
+  @param[in]  PathNames   Booter paths with leading slashes.
+  @param[in]  NumPaths    Number of booter paths.
+  @param[out] NumMissing  Number of missing paths preceding the existing one.
+
+  @retval EFI_SUCCESS when PathNames[*NumMissing] exists.
+  @retval EFI_NOT_FOUND when all paths are missing.
+  @retval other when the state of PathNames[*NumMissing] is unknown.
+**/
+STATIC
+EFI_STATUS
+InternalFindBooterPath (
+  IN  EFI_FILE_PROTOCOL  *Root,
+  IN  CONST GUID         *VolumeUuid  OPTIONAL,
+  IN  CONST CHAR16       **PathNames,
+  IN  UINTN              NumPaths,
+  OUT UINT32             *NumMissing
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Index;
+
+  for (Index = 0; Index < NumPaths; ++Index) {
+    Status = InternalBooterPathExists (Root, VolumeUuid, PathNames[Index]);
+    if (Status != EFI_NOT_FOUND) {
+      *NumMissing = (UINT32) Index;
+      return Status;
+    }
+  }
+
+  *NumMissing = (UINT32) NumPaths;
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Record booter paths found missing.
+
+  @param[in,out] Probes      Zeroed probe list.
+  @param[in,out] NumProbes   Number of probes in the list.
+  @param[in]     Type        INTERNAL_SCAN_CACHE_PROBE_* path list.
+  @param[in]     NumMissing  Number of leading list paths that were missing.
+  @param[in]     VolumeUuid  APFS volume UUID naming Preboot directory, optional.
+**/
+STATIC
+VOID
+InternalAddScanCacheProbe (
+  IN OUT INTERNAL_SCAN_CACHE_PROBE  *Probes,
+  IN OUT UINTN                      *NumProbes,
+  IN     UINT8                      Type,
+  IN     UINT32                     NumMissing,
+  IN     CONST GUID                 *VolumeUuid  OPTIONAL
+  )
+{
+  INTERNAL_SCAN_CACHE_PROBE  *Probe;
+
+  if (NumMissing == 0) {
+    return;
+  }
+
+  Probe             = &Probes[(*NumProbes)++];
+  Probe->Type       = Type;
+  Probe->NumMissing = NumMissing;
+  if (VolumeUuid != NULL) {
+    Probe->VolumeUuid = *VolumeUuid;
+  }
+}
+
+/**
+  Repeat booter lookup of InternalPrepareScanInfo and the boot policy
+  recording every booter path found missing on the way.
+
+  @param[in]     Context            Picker context.
+  @param[in]     Handles            Filesystem handles.
+  @param[in]     NoHandles          Number of filesystem handles.
+  @param[in]     Device             Volume handle.
+  @param[in]     Root               Volume root.
+  @param[in]     BlessedFile        Blessed system file information or NULL.
+  @param[in]     BlessedFileSize    Blessed system file information size.
+  @param[in]     BlessedFolder      Blessed system folder information or NULL.
+  @param[in]     BlessedFolderSize  Blessed system folder information size.
+  @param[in,out] Probes             Zeroed probe list for NoHandles + 2 probes.
+  @param[out]    NumProbes          Number of probes in the list.
+  @param[out]    BootDevicePath     Multi-instance boot device path, must be
+                                    freed by the caller when not NULL.
+
+  @retval EFI_SUCCESS when booters were found.
+**/
+STATIC
+EFI_STATUS
+InternalFindScanCacheBooters (
+  IN     OC_PICKER_CONTEXT          *Context,
+  IN     EFI_HANDLE                 *Handles,
+  IN     UINTN                      NoHandles,
+  IN     EFI_HANDLE                 Device,
+  IN     EFI_FILE_PROTOCOL          *Root,
+  IN     VOID                       *BlessedFile  OPTIONAL,
+  IN     UINTN                      BlessedFileSize,
+  IN     VOID                       *BlessedFolder  OPTIONAL,
+  IN     UINTN                      BlessedFolderSize,
+  IN OUT INTERNAL_SCAN_CACHE_PROBE  *Probes,
+  OUT    UINTN                      *NumProbes,
+  OUT    EFI_DEVICE_PATH_PROTOCOL   **BootDevicePath
+  )
+{
+  EFI_STATUS                Status;
+  EFI_FILE_PROTOCOL         *HandleRoot;
+  EFI_DEVICE_PATH_PROTOCOL  *VolumeDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL  *TempDevicePath;
+  CHAR16                    *FolderBooter;
+  CHAR16                    *FullPath;
+  UINTN                     FullPathSize;
+  GUID                      ContainerUuid;
+  GUID                      VolumeUuid;
+  GUID                      HandleContainerUuid;
+  APPLE_APFS_VOLUME_ROLE    VolumeRole;
+  BOOLEAN                   IsApfs;
+  UINT32                    NumMissing;
+  UINTN                     Index;
+
+  *NumProbes      = 0;
+  *BootDevicePath = NULL;
+
+  //
+  // Custom boot paths take precedence over the boot policy.
+  //
+  if (Context->NumCustomBootPaths > 0) {
+    Status = InternalFindBooterPath (
+      Root,
+      NULL,
+      (CONST CHAR16 **) Context->CustomBootPaths,
+      Context->NumCustomBootPaths,
+      &NumMissing
+      );
+    InternalAddScanCacheProbe (Probes, NumProbes, INTERNAL_SCAN_CACHE_PROBE_CUSTOM, NumMissing, NULL);
+    if (Status != EFI_NOT_FOUND) {
+      if (!EFI_ERROR (Status)) {
+        *BootDevicePath = FileDevicePath (Device, Context->CustomBootPaths[NumMissing]);
+      }
+      return Status;
+    }
+  }
+
+  Status = InternalGetApfsInfo (Root, &ContainerUuid, &VolumeUuid, &VolumeRole);
+  IsApfs = !EFI_ERROR (Status);
+
+  //
+  // Only APFS Preboot volumes have booters.
+  //
+  if (IsApfs && (VolumeRole & APPLE_APFS_VOLUME_ROLE_PREBOOT) == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (BlessedFile != NULL && IsDevicePathValid (BlessedFile, BlessedFileSize)) {
+    *BootDevicePath = AllocateCopyPool (BlessedFileSize, BlessedFile);
+    if (*BootDevicePath == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  } else {
+    FolderBooter = InternalGetBlessedFolderBooter (BlessedFolder, BlessedFolderSize);
+    if (FolderBooter != NULL) {
+      Status = InternalFindBooterPath (
+        Root,
+        NULL,
+        (CONST CHAR16 **) &FolderBooter,
+        1,
+        &NumMissing
+        );
+      InternalAddScanCacheProbe (Probes, NumProbes, INTERNAL_SCAN_CACHE_PROBE_BLESSED_FOLDER, NumMissing, NULL);
+      if (!EFI_ERROR (Status)) {
+        *BootDevicePath = FileDevicePath (Device, FolderBooter);
+        if (*BootDevicePath == NULL) {
+          Status = EFI_OUT_OF_RESOURCES;
+        }
+      }
+
+      FreePool (FolderBooter);
+      if (EFI_ERROR (Status) && Status != EFI_NOT_FOUND) {
+        return Status;
+      }
+    }
+  }
+
+  if (!IsApfs) {
+    if (*BootDevicePath != NULL) {
+      return EFI_SUCCESS;
+    }
+
+    Status = InternalFindBooterPath (
+      Root,
+      NULL,
+      gInternalBootPathNames,
+      gInternalNumBootPathNames,
+      &NumMissing
+      );
+    InternalAddScanCacheProbe (Probes, NumProbes, INTERNAL_SCAN_CACHE_PROBE_PREDEFINED, NumMissing, NULL);
+    if (!EFI_ERROR (Status)) {
+      *BootDevicePath = FileDevicePath (Device, gInternalBootPathNames[NumMissing]);
+      if (*BootDevicePath == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+    }
+
+    return Status;
+  }
+
+  //
+  // Blessed booter is followed by booters of every container volume.
+  //
+  for (Index = 0; Index < NoHandles; ++Index) {
+    Status = InternalOpenScanCacheVolume (Handles[Index], &HandleRoot);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Status = InternalGetApfsInfo (HandleRoot, &HandleContainerUuid, &VolumeUuid, &VolumeRole);
+    HandleRoot->Close (HandleRoot);
+    if (EFI_ERROR (Status) || !CompareGuid (&HandleContainerUuid, &ContainerUuid)) {
+      continue;
+    }
+
+    Status = InternalFindBooterPath (
+      Root,
+      &VolumeUuid,
+      gInternalBootPathNames,
+      gInternalNumBootPathNames,
+      &NumMissing
+      );
+    InternalAddScanCacheProbe (Probes, NumProbes, INTERNAL_SCAN_CACHE_PROBE_APFS, NumMissing, &VolumeUuid);
+    if (Status == EFI_NOT_FOUND) {
+      continue;
+    }
+
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    FullPathSize = GUID_STRING_LENGTH * sizeof (CHAR16) + L_STR_SIZE (L"\\")
+      + StrSize (gInternalBootPathNames[NumMissing]);
+    FullPath     = AllocatePool (FullPathSize);
+    if (FullPath == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    UnicodeSPrint (FullPath, FullPathSize, L"\\%g%s", &VolumeUuid, gInternalBootPathNames[NumMissing]);
+    VolumeDevicePath = FileDevicePath (Device, FullPath);
+    FreePool (FullPath);
+    if (VolumeDevicePath == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    TempDevicePath  = *BootDevicePath;
+    *BootDevicePath = OcAppendDevicePathInstanceDedupe (TempDevicePath, VolumeDevicePath);
+    FreePool (VolumeDevicePath);
+    if (TempDevicePath != NULL) {
+      FreePool (TempDevicePath);
+    }
+
+    if (*BootDevicePath == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  return *BootDevicePath != NULL ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+/**
+  Check whether booter paths missing at caching time are still missing.
+
+  @param[in] Context            Picker context.
+  @param[in] Root               Volume root.
+  @param[in] BlessedFolder      Cached blessed system folder information.
+  @param[in] BlessedFolderSize  Cached blessed system folder information size.
+  @param[in] Probes             Cached unaligned probes.
+  @param[in] NumProbes          Number of cached probes.
+
+  @retval TRUE when all the paths are still missing.
+**/
+STATIC
+BOOLEAN
+InternalAreScanCacheProbesMissing (
+  IN OC_PICKER_CONTEXT  *Context,
+  IN EFI_FILE_PROTOCOL  *Root,
+  IN CONST UINT8        *BlessedFolder,
+  IN UINTN              BlessedFolderSize,
+  IN CONST UINT8        *Probes,
+  IN UINTN              NumProbes
+  )
+{
+  EFI_STATUS                 Status;
+  INTERNAL_SCAN_CACHE_PROBE  Probe;
+  GUID                       VolumeUuid;
+  CONST CHAR16               **PathNames;
+  CHAR16                     *FolderBooter;
+  UINTN                      NumPaths;
+  UINT32                     NumMissing;
+  UINTN                      Index;
+
+  for (Index = 0; Index < NumProbes; ++Index) {
+    CopyMem (&Probe, &Probes[Index * sizeof (Probe)], sizeof (Probe));
+    VolumeUuid   = Probe.VolumeUuid;
+    FolderBooter = NULL;
+
+    switch (Probe.Type) {
+      case INTERNAL_SCAN_CACHE_PROBE_CUSTOM:
+        PathNames = (CONST CHAR16 **) Context->CustomBootPaths;
+        NumPaths  = Context->NumCustomBootPaths;
+        break;
+      case INTERNAL_SCAN_CACHE_PROBE_BLESSED_FOLDER:
+        FolderBooter = InternalGetBlessedFolderBooter (BlessedFolder, BlessedFolderSize);
+        if (FolderBooter == NULL) {
+          return FALSE;
+        }
+        PathNames = (CONST CHAR16 **) &FolderBooter;
+        NumPaths  = 1;
+        break;
+      case INTERNAL_SCAN_CACHE_PROBE_PREDEFINED:
+      case INTERNAL_SCAN_CACHE_PROBE_APFS:
+        PathNames = gInternalBootPathNames;
+        NumPaths  = gInternalNumBootPathNames;
+        break;
+      default:
+        return FALSE;
+    }
+
+    Status = EFI_INVALID_PARAMETER;
+    if (Probe.NumMissing <= NumPaths) {
+      Status = InternalFindBooterPath (
+        Root,
+        Probe.Type == INTERNAL_SCAN_CACHE_PROBE_APFS ? &VolumeUuid : NULL,
+        PathNames,
+        Probe.NumMissing,
+        &NumMissing
+        );
+    }
+
+    if (FolderBooter != NULL) {
+      FreePool (FolderBooter);
+    }
+
+    if (Status != EFI_NOT_FOUND) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Obtain modification times of every boot device path instance.
+
+  @param[in]  BootDevicePath    Multi-instance boot device path.
+  @param[in]  NumBootInstances  Number of boot device path instances.
+  @param[out] Times             Modification times, one per instance.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalGetBooterTimes (
+  IN  EFI_DEVICE_PATH_PROTOCOL  *BootDevicePath,
+  IN  UINTN                     NumBootInstances,
+  OUT EFI_TIME                  *Times
+  )
+{
+  EFI_STATUS                Status;
+  EFI_DEVICE_PATH_PROTOCOL  *Walker;
+  EFI_DEVICE_PATH_PROTOCOL  *Instance;
+  EFI_DEVICE_PATH_PROTOCOL  *RemainingPath;
+  EFI_FILE_PROTOCOL         *File;
+  UINTN                     InstanceSize;
+  UINTN                     Index;
+
+  Walker = BootDevicePath;
+
+  for (Index = 0; Index < NumBootInstances; ++Index) {
+    Instance = GetNextDevicePathInstance (&Walker, &InstanceSize);
+    if (Instance == NULL) {
+      return EFI_NOT_FOUND;
+    }
+
+    RemainingPath = Instance;
+    Status = OcOpenFileByDevicePath (
+      &RemainingPath,
+      &File,
+      EFI_FILE_MODE_READ,
+      0
+      );
+    FreePool (Instance);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Status = GetFileModifcationTime (File, &Times[Index]);
+    File->Close (File);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Compare two modification times ignoring padding and timezone data.
+
+  @param[in] Time1  First time.
+  @param[in] Time2  Second time.
+
+  @retval TRUE when times are equal.
+**/
+STATIC
+BOOLEAN
+InternalBooterTimesEqual (
+  IN CONST EFI_TIME  *Time1,
+  IN CONST EFI_TIME  *Time2
+  )
+{
+  return Time1->Year == Time2->Year
+    && Time1->Month == Time2->Month
+    && Time1->Day == Time2->Day
+    && Time1->Hour == Time2->Hour
+    && Time1->Minute == Time2->Minute
+    && Time1->Second == Time2->Second
+    && Time1->Nanosecond == Time2->Nanosecond;
+}
+
+/**
+  Check whether the volume boot files are unchanged since caching.
+
+  @param[in] Context         Picker context.
+  @param[in] Device          Volume handle.
+  @param[in] Entry           Scan cache entry.
+  @param[in] BlessedFile     Cached blessed system file information.
+  @param[in] BlessedFolder   Cached blessed system folder information.
+  @param[in] BootDevicePath  Cached multi-instance boot device path.
+  @param[in] BooterTimes     Cached unaligned boot device path instance times.
+  @param[in] Probes          Cached unaligned probes.
+
+  @retval TRUE when the volume is unchanged.
+**/
+STATIC
+BOOLEAN
+InternalIsScanCacheEntryValid (
+  IN OC_PICKER_CONTEXT                *Context,
+  IN EFI_HANDLE                       Device,
+  IN CONST INTERNAL_SCAN_CACHE_ENTRY  *Entry,
+  IN CONST UINT8                      *BlessedFile,
+  IN CONST UINT8                      *BlessedFolder,
+  IN EFI_DEVICE_PATH_PROTOCOL         *BootDevicePath,
+  IN CONST UINT8                      *BooterTimes,
+  IN CONST UINT8                      *Probes
+  )
+{
+  EFI_STATUS         Status;
+  EFI_FILE_PROTOCOL  *Root;
+  VOID               *CurrentFile;
+  VOID               *CurrentFolder;
+  UINTN              CurrentFileSize;
+  UINTN              CurrentFolderSize;
+  EFI_TIME           *Times;
+  EFI_TIME           CachedTime;
+  BOOLEAN            Valid;
+  UINTN              Index;
+
+  Status = InternalOpenScanCacheVolume (Device, &Root);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  //
+  // Blessing another booter does not touch the booters themselves.
+  //
+  InternalGetBlessInfo (
+    Root,
+    &CurrentFile,
+    &CurrentFileSize,
+    &CurrentFolder,
+    &CurrentFolderSize
+    );
+
+  Valid = CurrentFileSize == Entry->BlessedFileSize
+    && CurrentFolderSize == Entry->BlessedFolderSize
+    && (CurrentFileSize == 0 || CompareMem (CurrentFile, BlessedFile, CurrentFileSize) == 0)
+    && (CurrentFolderSize == 0 || CompareMem (CurrentFolder, BlessedFolder, CurrentFolderSize) == 0);
+
+  if (CurrentFile != NULL) {
+    FreePool (CurrentFile);
+  }
+
+  if (CurrentFolder != NULL) {
+    FreePool (CurrentFolder);
+  }
+
+  //
+  // Creating a booter with higher priority does not touch the cached booters.
+  //
+  if (Valid) {
+    Valid = InternalAreScanCacheProbesMissing (
+      Context,
+      Root,
+      BlessedFolder,
+      Entry->BlessedFolderSize,
+      Probes,
+      Entry->NumProbes
+      );
+  }
+
+  Root->Close (Root);
+
+  if (!Valid) {
+    return FALSE;
+  }
+
+  //
+  // Booter modification time changes with every update or reinstall.
+  //
+  Times = AllocatePool (Entry->NumBootInstances * sizeof (EFI_TIME));
+  if (Times == NULL) {
+    return FALSE;
+  }
+
+  Status = InternalGetBooterTimes (BootDevicePath, Entry->NumBootInstances, Times);
+  Valid  = !EFI_ERROR (Status);
+
+  for (Index = 0; Valid && Index < Entry->NumBootInstances; ++Index) {
+    CopyMem (&CachedTime, &BooterTimes[Index * sizeof (EFI_TIME)], sizeof (CachedTime));
+    Valid = InternalBooterTimesEqual (&Times[Index], &CachedTime);
+  }
+
+  FreePool (Times);
+  return Valid;
+}
+
+VOID *
+InternalLoadScanCache (
+  IN  OC_PICKER_CONTEXT  *Context,
+  IN  EFI_HANDLE         *Handles,
+  IN  UINTN              NoHandles,
+  OUT UINTN              *CacheSize
+  )
+{
+  EFI_STATUS                  Status;
+  VOID                        *Cache;
+  UINT8                       *VolumeSet;
+  UINTN                       VolumeSetSize;
+  INTERNAL_SCAN_CACHE_HEADER  Header;
+  BOOLEAN                     Valid;
+
+  Status = GetVariable2 (
+    OC_SCAN_CACHE_VARIABLE_NAME,
+    &gOcVendorVariableGuid,
+    &Cache,
+    CacheSize
+    );
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
+
+  if (*CacheSize < sizeof (Header) || *CacheSize > INTERNAL_SCAN_CACHE_MAX_SIZE) {
+    FreePool (Cache);
+    return NULL;
+  }
+
+  CopyMem (&Header, Cache, sizeof (Header));
+  if (Header.Signature != INTERNAL_SCAN_CACHE_SIGNATURE
+    || Header.ScanPolicy != Context->ScanPolicy
+    || Header.CustomBootPathsHash != InternalGetCustomBootPathsHash (Context)) {
+    DEBUG ((DEBUG_INFO, "OCB: Discarding outdated scan cache\n"));
+    FreePool (Cache);
+    return NULL;
+  }
+
+  VolumeSet = InternalGetScanCacheVolumeSet (Handles, NoHandles, &VolumeSetSize);
+  Valid     = VolumeSet != NULL
+    && Header.VolumeSetSize == VolumeSetSize
+    && VolumeSetSize <= *CacheSize - sizeof (Header)
+    && CompareMem ((UINT8 *) Cache + sizeof (Header), VolumeSet, VolumeSetSize) == 0;
+
+  if (VolumeSet != NULL) {
+    FreePool (VolumeSet);
+  }
+
+  if (!Valid) {
+    DEBUG ((DEBUG_INFO, "OCB: Discarding scan cache for changed volumes\n"));
+    FreePool (Cache);
+    return NULL;
+  }
+
+  return Cache;
+}
+
+EFI_STATUS
+InternalRestoreScanInfo (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     CONST VOID                   *Cache,
+  IN     UINTN                        CacheSize,
+  IN     EFI_HANDLE                   Device,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfo
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_DEVICE_PATH_PROTOCOL    *HdDevicePath;
+  EFI_DEVICE_PATH_PROTOCOL    *BootDevicePath;
+  INTERNAL_SCAN_CACHE_HEADER  Header;
+  INTERNAL_SCAN_CACHE_ENTRY   Entry;
+  CONST UINT8                 *EntryStart;
+  CONST UINT8                 *Walker;
+  CONST UINT8                 *BlessedFile;
+  CONST UINT8                 *BlessedFolder;
+  CONST UINT8                 *BooterTimes;
+  CONST UINT8                 *Probes;
+  UINTN                       Remaining;
+  UINTN                       DataSize;
+  UINTN                       VolumeSize;
+  BOOLEAN                     IsExternal;
+  BOOLEAN                     Found;
+
+  if (Device == Context->ExcludeHandle) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Status = gBS->HandleProtocol (
+    Device,
+    &gEfiDevicePathProtocolGuid,
+    (VOID **) &HdDevicePath
+    );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  VolumeSize = GetDevicePathSize (HdDevicePath);
+
+  //
+  // Volume set was validated by InternalLoadScanCache.
+  //
+  CopyMem (&Header, Cache, sizeof (Header));
+  Walker     = (CONST UINT8 *) Cache + sizeof (Header) + Header.VolumeSetSize;
+  Remaining  = CacheSize - sizeof (Header) - Header.VolumeSetSize;
+  EntryStart = NULL;
+  DataSize   = 0;
+  Found      = FALSE;
+
+  while (Remaining >= sizeof (Entry)) {
+    EntryStart = Walker;
+    CopyMem (&Entry, Walker, sizeof (Entry));
+    Walker    += sizeof (Entry);
+    Remaining -= sizeof (Entry);
+
+    if (!InternalGetScanCacheEntryDataSize (&Entry, &DataSize) || DataSize > Remaining) {
+      return EFI_NOT_FOUND;
+    }
+
+    if (Entry.VolumeSize == VolumeSize && CompareMem (Walker, HdDevicePath, VolumeSize) == 0) {
+      Found = TRUE;
+      break;
+    }
+
+    Walker    += DataSize;
+    Remaining -= DataSize;
+  }
+
+  if (!Found
+    || Entry.BootDevicePathSize < END_DEVICE_PATH_LENGTH
+    || Entry.NumBootInstances == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  BlessedFile   = Walker + Entry.VolumeSize;
+  BlessedFolder = BlessedFile + Entry.BlessedFileSize;
+  Walker        = BlessedFolder + Entry.BlessedFolderSize;
+  BooterTimes   = Walker + Entry.BootDevicePathSize;
+  Probes        = BooterTimes + Entry.NumBootInstances * sizeof (EFI_TIME);
+
+  //
+  // Scan policy may depend on the media, which could have changed.
+  //
+  Status = InternalCheckScanPolicy (Device, Context->ScanPolicy, &IsExternal);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  BootDevicePath = AllocateCopyPool (Entry.BootDevicePathSize, Walker);
+  if (BootDevicePath == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (!IsDevicePathValid (BootDevicePath, Entry.BootDevicePathSize)
+    || OcGetNumDevicePathInstances (BootDevicePath) != Entry.NumBootInstances
+    || !InternalIsScanCacheEntryValid (
+      Context,
+      Device,
+      &Entry,
+      BlessedFile,
+      BlessedFolder,
+      BootDevicePath,
+      BooterTimes,
+      Probes
+      )) {
+    FreePool (BootDevicePath);
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Only volumes with normal booters are cached, see InternalAppendScanCacheEntry.
+  //
+  DevPathScanInfo->Device             = Device;
+  DevPathScanInfo->BootDevicePath     = BootDevicePath;
+  DevPathScanInfo->NumBootInstances   = Entry.NumBootInstances;
+  DevPathScanInfo->HdDevicePath       = HdDevicePath;
+  DevPathScanInfo->HdPrefixSize       = VolumeSize - END_DEVICE_PATH_LENGTH;
+  DevPathScanInfo->IsExternal         = IsExternal;
+  DevPathScanInfo->SkipRecovery       = FALSE;
+  DevPathScanInfo->ScanCacheEntry     = EntryStart;
+  DevPathScanInfo->ScanCacheEntrySize = sizeof (Entry) + DataSize;
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCB: Filesystem %p restored %u entries from scan cache\n",
+    Device,
+    (UINT32) DevPathScanInfo->NumBootInstances
+    ));
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Append a scan cache entry for a freshly scanned volume. Booter lookup is
+  repeated to record the missing booter paths, and the volume is not cached
+  unless the result matches the scanned booters. Recovery-only volumes are
+  not cached either, as their booters are not found by the boot policy.
+
+  @param[in]     Context          Picker context.
+  @param[in]     Handles          Filesystem handles.
+  @param[in]     NoHandles        Number of filesystem handles.
+  @param[in,out] Cache            Scan cache buffer.
+  @param[in,out] CacheSize        Used scan cache size.
+  @param[in]     DevPathScanInfo  Volume scan info.
+
+  @retval EFI_SUCCESS on success.
+  @retval EFI_BUFFER_TOO_SMALL when the cache is full.
+**/
+STATIC
+EFI_STATUS
+InternalAppendScanCacheEntry (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     EFI_HANDLE                   *Handles,
+  IN     UINTN                        NoHandles,
+  IN OUT UINT8                        *Cache,
+  IN OUT UINTN                        *CacheSize,
+  IN     INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfo
+  )
+{
+  EFI_STATUS                 Status;
+  EFI_FILE_PROTOCOL          *Root;
+  EFI_DEVICE_PATH_PROTOCOL   *BootDevicePath;
+  INTERNAL_SCAN_CACHE_ENTRY  Entry;
+  INTERNAL_SCAN_CACHE_PROBE  *Probes;
+  EFI_TIME                   *Times;
+  VOID                       *BlessedFile;
+  VOID                       *BlessedFolder;
+  UINTN                      BlessedFileSize;
+  UINTN                      BlessedFolderSize;
+  UINTN                      VolumeSize;
+  UINTN                      BootDevicePathSize;
+  UINTN                      NumProbes;
+  UINTN                      ProbesSize;
+  UINTN                      TimesSize;
+  UINTN                      EntrySize;
+  UINTN                      Offset;
+
+  if (DevPathScanInfo->SkipRecovery) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (OcOverflowMulUN (DevPathScanInfo->NumBootInstances, sizeof (EFI_TIME), &TimesSize)
+    || OcOverflowMulUN (NoHandles + 2, sizeof (*Probes), &ProbesSize)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = InternalOpenScanCacheVolume (DevPathScanInfo->Device, &Root);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Probes = AllocateZeroPool (ProbesSize);
+  Times  = AllocatePool (TimesSize);
+  if (Probes == NULL || Times == NULL) {
+    if (Probes != NULL) {
+      FreePool (Probes);
+    }
+    if (Times != NULL) {
+      FreePool (Times);
+    }
+    Root->Close (Root);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  InternalGetBlessInfo (
+    Root,
+    &BlessedFile,
+    &BlessedFileSize,
+    &BlessedFolder,
+    &BlessedFolderSize
+    );
+
+  BootDevicePathSize = GetDevicePathSize (DevPathScanInfo->BootDevicePath);
+
+  Status = InternalFindScanCacheBooters (
+    Context,
+    Handles,
+    NoHandles,
+    DevPathScanInfo->Device,
+    Root,
+    BlessedFile,
+    BlessedFileSize,
+    BlessedFolder,
+    BlessedFolderSize,
+    Probes,
+    &NumProbes,
+    &BootDevicePath
+    );
+
+  Root->Close (Root);
+
+  if (!EFI_ERROR (Status)
+    && (GetDevicePathSize (BootDevicePath) != BootDevicePathSize
+      || CompareMem (BootDevicePath, DevPathScanInfo->BootDevicePath, BootDevicePathSize) != 0)) {
+    DEBUG ((DEBUG_INFO, "OCB: Filesystem %p booters changed, not caching\n", DevPathScanInfo->Device));
+    Status = EFI_UNSUPPORTED;
+  }
+
+  if (BootDevicePath != NULL) {
+    FreePool (BootDevicePath);
+  }
+
+  if (!EFI_ERROR (Status)) {
+    Status = InternalGetBooterTimes (
+      DevPathScanInfo->BootDevicePath,
+      DevPathScanInfo->NumBootInstances,
+      Times
+      );
+  }
+
+  if (!EFI_ERROR (Status)) {
+    VolumeSize = DevPathScanInfo->HdPrefixSize + END_DEVICE_PATH_LENGTH;
+    ProbesSize = NumProbes * sizeof (*Probes);
+
+    Entry.VolumeSize         = (UINT32) VolumeSize;
+    Entry.BlessedFileSize    = (UINT32) BlessedFileSize;
+    Entry.BlessedFolderSize  = (UINT32) BlessedFolderSize;
+    Entry.BootDevicePathSize = (UINT32) BootDevicePathSize;
+    Entry.NumBootInstances   = (UINT32) DevPathScanInfo->NumBootInstances;
+    Entry.NumProbes          = (UINT32) NumProbes;
+
+    if (InternalGetScanCacheEntryDataSize (&Entry, &EntrySize)
+      && EntrySize <= INTERNAL_SCAN_CACHE_MAX_SIZE - sizeof (Entry)
+      && EntrySize + sizeof (Entry) <= INTERNAL_SCAN_CACHE_MAX_SIZE - *CacheSize) {
+      Offset = *CacheSize;
+      CopyMem (&Cache[Offset], &Entry, sizeof (Entry));
+      Offset += sizeof (Entry);
+      CopyMem (&Cache[Offset], DevPathScanInfo->HdDevicePath, VolumeSize);
+      Offset += VolumeSize;
+      CopyMem (&Cache[Offset], BlessedFile, BlessedFileSize);
+      Offset += BlessedFileSize;
+      CopyMem (&Cache[Offset], BlessedFolder, BlessedFolderSize);
+      Offset += BlessedFolderSize;
+      CopyMem (&Cache[Offset], DevPathScanInfo->BootDevicePath, BootDevicePathSize);
+      Offset += BootDevicePathSize;
+      CopyMem (&Cache[Offset], Times, TimesSize);
+      Offset += TimesSize;
+      CopyMem (&Cache[Offset], Probes, ProbesSize);
+      *CacheSize = Offset + ProbesSize;
+    } else {
+      Status = EFI_BUFFER_TOO_SMALL;
+    }
+  }
+
+  if (BlessedFile != NULL) {
+    FreePool (BlessedFile);
+  }
+
+  if (BlessedFolder != NULL) {
+    FreePool (BlessedFolder);
+  }
+
+  FreePool (Probes);
+  FreePool (Times);
+  return Status;
+}
+
+VOID
+InternalSaveScanCache (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     EFI_HANDLE                   *Handles,
+  IN     UINTN                        NoHandles,
+  IN     CONST VOID                   *OldCache  OPTIONAL,
+  IN     UINTN                        OldCacheSize,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfos,
+  IN     UINTN                        NumScanInfos
+  )
+{
+  EFI_STATUS                   Status;
+  UINT8                        *Cache;
+  UINTN                        CacheSize;
+  UINT8                        *VolumeSet;
+  UINTN                        VolumeSetSize;
+  INTERNAL_SCAN_CACHE_HEADER   Header;
+  INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfo;
+  UINTN                        Index;
+
+  VolumeSet = InternalGetScanCacheVolumeSet (Handles, NoHandles, &VolumeSetSize);
+  if (VolumeSet == NULL) {
+    DEBUG ((DEBUG_INFO, "OCB: Too many volumes for scan cache\n"));
+    return;
+  }
+
+  Cache = AllocateZeroPool (INTERNAL_SCAN_CACHE_MAX_SIZE);
+  if (Cache == NULL) {
+    FreePool (VolumeSet);
+    return;
+  }
+
+  Header.Signature           = INTERNAL_SCAN_CACHE_SIGNATURE;
+  Header.ScanPolicy          = Context->ScanPolicy;
+  Header.CustomBootPathsHash = InternalGetCustomBootPathsHash (Context);
+  Header.VolumeSetSize       = (UINT32) VolumeSetSize;
+  CopyMem (Cache, &Header, sizeof (Header));
+  CopyMem (&Cache[sizeof (Header)], VolumeSet, VolumeSetSize);
+  CacheSize = sizeof (Header) + VolumeSetSize;
+  FreePool (VolumeSet);
+
+  for (Index = 0; Index < NumScanInfos; ++Index) {
+    DevPathScanInfo = &DevPathScanInfos[Index];
+
+    if (DevPathScanInfo->BootDevicePath == NULL
+      || DevPathScanInfo->Device == Context->ExcludeHandle) {
+      continue;
+    }
+
+    //
+    // Restored entries were just validated, keep them as is.
+    //
+    if (DevPathScanInfo->ScanCacheEntry != NULL) {
+      if (INTERNAL_SCAN_CACHE_MAX_SIZE - CacheSize < DevPathScanInfo->ScanCacheEntrySize) {
+        Status = EFI_BUFFER_TOO_SMALL;
+      } else {
+        CopyMem (&Cache[CacheSize], DevPathScanInfo->ScanCacheEntry, DevPathScanInfo->ScanCacheEntrySize);
+        CacheSize += DevPathScanInfo->ScanCacheEntrySize;
+        Status     = EFI_SUCCESS;
+      }
+    } else {
+      Status = InternalAppendScanCacheEntry (
+        Context,
+        Handles,
+        NoHandles,
+        Cache,
+        &CacheSize,
+        DevPathScanInfo
+        );
+    }
+
+    if (Status == EFI_BUFFER_TOO_SMALL) {
+      DEBUG ((DEBUG_INFO, "OCB: Scan cache is full at %u\n", (UINT32) Index));
+      break;
+    }
+  }
+
+  //
+  // Avoid NVRAM writes when nothing changed.
+  //
+  if (OldCache == NULL
+    || OldCacheSize != CacheSize
+    || CompareMem (OldCache, Cache, CacheSize) != 0) {
+    Status = gRT->SetVariable (
+      OC_SCAN_CACHE_VARIABLE_NAME,
+      &gOcVendorVariableGuid,
+      EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+      CacheSize,
+      Cache
+      );
+    DEBUG ((DEBUG_INFO, "OCB: Updated scan cache of %u bytes - %r\n", (UINT32) CacheSize, Status));
+  }
+
+  FreePool (Cache);
+}
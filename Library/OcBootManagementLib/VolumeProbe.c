@@ -0,0 +1,339 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include "BootManagementInternal.h"
+
+#include <Guid/AppleBless.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/OcDebugLogLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+
+//
+// Booter file names probed by Apple Boot Policy in this order when nothing
+// is blessed. Here they are only opened to warm up filesystem driver caches,
+// the results are discarded, as blessed files take precedence over them.
+//
+CONST CHAR16 *gInternalBootPathNames[] = {
+  APPLE_BOOTER_DEFAULT_FILE_NAME,
+  APPLE_REMOVABLE_MEDIA_FILE_NAME,
+  EFI_REMOVABLE_MEDIA_FILE_NAME,
+  APPLE_BOOTER_ROOT_FILE_NAME
+};
+
+CONST UINTN gInternalNumBootPathNames = ARRAY_SIZE (gInternalBootPathNames);
+
+typedef struct {
+  EFI_FILE_IO_TOKEN  Token;
+  EFI_FILE_PROTOCOL  *NewHandle;
+} INTERNAL_VOLUME_PROBE;
+
+/**
+  Issue a non-blocking open request for a booter path.
+
+  @param[in]     Root      Volume root, must be EFI_FILE_PROTOCOL_REVISION2.
+  @param[in]     PathName  Path to open.
+  @param[in,out] Probe     Probe to issue.
+
+  @retval EFI_SUCCESS  Request was queued and its event will be signalled.
+**/
+STATIC
+EFI_STATUS
+InternalIssueVolumeProbe (
+  IN     EFI_FILE_PROTOCOL      *Root,
+  IN     CONST CHAR16           *PathName,
+  IN OUT INTERNAL_VOLUME_PROBE  *Probe
+  )
+{
+  EFI_STATUS  Status;
+
+  Status = gBS->CreateEvent (0, 0, NULL, NULL, &Probe->Token.Event);
+  if (EFI_ERROR (Status)) {
+    Probe->Token.Event  = NULL;
+    Probe->Token.Status = Status;
+    return Status;
+  }
+
+  Probe->Token.Status = EFI_NOT_READY;
+  Probe->NewHandle    = NULL;
+
+  Status = Root->OpenEx (
+    Root,
+    &Probe->NewHandle,
+    (CHAR16 *) PathName,
+    EFI_FILE_MODE_READ,
+    0,
+    &Probe->Token
+    );
+  if (EFI_ERROR (Status)) {
+    //
+    // The event is not signalled when the request fails to queue.
+    //
+    gBS->CloseEvent (Probe->Token.Event);
+    Probe->Token.Event  = NULL;
+    Probe->Token.Status = Status;
+  }
+
+  return Status;
+}
+
+/**
+  Wait for all queued probes to complete and release their resources.
+
+  @param[in,out] Probes      Probe array.
+  @param[in]     NumProbes   Number of probes.
+  @param[in]     NumQueued   Number of probes with queued requests.
+**/
+STATIC
+VOID
+InternalCompleteVolumeProbes (
+  IN OUT INTERNAL_VOLUME_PROBE  *Probes,
+  IN     UINTN                  NumProbes,
+  IN     UINTN                  NumQueued
+  )
+{
+  EFI_STATUS             Status;
+  EFI_EVENT              *Events;
+  INTERNAL_VOLUME_PROBE  **Pending;
+  UINTN                  Index;
+  UINTN                  EventIndex;
+  UINTN                  NumPending;
+
+  if (NumQueued == 0) {
+    return;
+  }
+
+  Events  = AllocatePool (NumQueued * sizeof (*Events));
+  Pending = AllocatePool (NumQueued * sizeof (*Pending));
+
+  NumPending = 0;
+  for (Index = 0; Index < NumProbes; ++Index) {
+    if (Probes[Index].Token.Event != NULL) {
+      if (Events != NULL && Pending != NULL) {
+        Events[NumPending]  = Probes[Index].Token.Event;
+        Pending[NumPending] = &Probes[Index];
+        ++NumPending;
+      } else {
+        //
+        // Without memory for the wait list fall back to waiting in order.
+        //
+        gBS->WaitForEvent (1, &Probes[Index].Token.Event, &EventIndex);
+        gBS->CloseEvent (Probes[Index].Token.Event);
+        Probes[Index].Token.Event = NULL;
+      }
+    }
+  }
+
+  while (NumPending > 0) {
+    Status = gBS->WaitForEvent (NumPending, Events, &EventIndex);
+    if (EFI_ERROR (Status)) {
+      //
+      // Should not happen at TPL_APPLICATION, but the tokens must outlive
+      // the requests, so wait for the rest one by one.
+      //
+      for (Index = 0; Index < NumPending; ++Index) {
+        gBS->WaitForEvent (1, &Events[Index], &EventIndex);
+        gBS->CloseEvent (Events[Index]);
+        Pending[Index]->Token.Event = NULL;
+      }
+      break;
+    }
+
+    gBS->CloseEvent (Events[EventIndex]);
+    Pending[EventIndex]->Token.Event = NULL;
+
+    --NumPending;
+    Events[EventIndex]  = Events[NumPending];
+    Pending[EventIndex] = Pending[NumPending];
+  }
+
+  if (Events != NULL) {
+    FreePool (Events);
+  }
+
+  if (Pending != NULL) {
+    FreePool (Pending);
+  }
+
+  for (Index = 0; Index < NumProbes; ++Index) {
+    if (!EFI_ERROR (Probes[Index].Token.Status) && Probes[Index].NewHandle != NULL) {
+      Probes[Index].NewHandle->Close (Probes[Index].NewHandle);
+      Probes[Index].NewHandle = NULL;
+    }
+  }
+}
+
+/**
+  Record custom boot path probe results for the volume.
+  Results are only used when every custom path probe completed and
+  the outcome is unambiguous, otherwise the volume is probed as usual.
+
+  @param[in]     Context          Picker context.
+  @param[in]     Probes           Probes of the volume, custom boot paths first.
+  @param[in,out] DevPathScanInfo  Scan info of the volume.
+**/
+STATIC
+VOID
+InternalStoreVolumeProbeResult (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     INTERNAL_VOLUME_PROBE        *Probes,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfo
+  )
+{
+  UINTN  Index;
+
+  for (Index = 0; Index < Context->NumCustomBootPaths; ++Index) {
+    if (!EFI_ERROR (Probes[Index].Token.Status)) {
+      DevPathScanInfo->CustomBootPathProbed = TRUE;
+      DevPathScanInfo->CustomBootPathIndex  = Index;
+      return;
+    }
+
+    if (Probes[Index].Token.Status != EFI_NOT_FOUND) {
+      return;
+    }
+  }
+
+  DevPathScanInfo->CustomBootPathProbed = TRUE;
+  DevPathScanInfo->CustomBootPathIndex  = Context->NumCustomBootPaths;
+}
+
+VOID
+InternalProbeScanVolumes (
+  IN     OC_PICKER_CONTEXT            *Context,
+  IN     EFI_HANDLE                   *Handles,
+  IN     UINTN                        NoHandles,
+  IN OUT INTERNAL_DEV_PATH_SCAN_INFO  *DevPathScanInfos
+  )
+{
+  EFI_STATUS                       Status;
+  BOOLEAN                          Result;
+  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *SimpleFs;
+  EFI_FILE_PROTOCOL                **Roots;
+  INTERNAL_VOLUME_PROBE            *Probes;
+  INTERNAL_VOLUME_PROBE            *VolumeProbes;
+  UINTN                            ProbesPerVolume;
+  UINTN                            ProbesSize;
+  UINTN                            NumQueued;
+  UINTN                            NumVolumes;
+  UINTN                            Index;
+  UINTN                            PathIndex;
+  CONST CHAR16                     *PathName;
+
+  ProbesPerVolume = Context->NumCustomBootPaths + gInternalNumBootPathNames;
+
+  Result = OcOverflowTriMulUN (NoHandles, ProbesPerVolume, sizeof (*Probes), &ProbesSize);
+  if (Result) {
+    return;
+  }
+
+  Roots = AllocateZeroPool (NoHandles * sizeof (*Roots));
+  if (Roots == NULL) {
+    return;
+  }
+
+  Probes = AllocateZeroPool (ProbesSize);
+  if (Probes == NULL) {
+    FreePool (Roots);
+    return;
+  }
+
+  NumQueued  = 0;
+  NumVolumes = 0;
+
+  for (Index = 0; Index < NoHandles; ++Index) {
+    //
+    // Volumes restored from the scan cache need no probing.
+    //
+    if (Handles[Index] == Context->ExcludeHandle
+      || DevPathScanInfos[Index].BootDevicePath != NULL) {
+      continue;
+    }
+
+    Status = InternalCheckScanPolicy (Handles[Index], Context->ScanPolicy, NULL);
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Status = gBS->HandleProtocol (
+      Handles[Index],
+      &gEfiSimpleFileSystemProtocolGuid,
+      (VOID **) &SimpleFs
+      );
+    if (EFI_ERROR (Status)) {
+      continue;
+    }
+
+    Status = SimpleFs->OpenVolume (SimpleFs, &Roots[Index]);
+    if (EFI_ERROR (Status)) {
+      Roots[Index] = NULL;
+      continue;
+    }
+
+    if (Roots[Index]->Revision < EFI_FILE_PROTOCOL_REVISION2) {
+      Roots[Index]->Close (Roots[Index]);
+      Roots[Index] = NULL;
+      continue;
+    }
+
+    ++NumVolumes;
+
+    VolumeProbes = &Probes[Index * ProbesPerVolume];
+    for (PathIndex = 0; PathIndex < ProbesPerVolume; ++PathIndex) {
+      if (PathIndex < Context->NumCustomBootPaths) {
+        PathName = Context->CustomBootPaths[PathIndex];
+      } else {
+        PathName = gInternalBootPathNames[PathIndex - Context->NumCustomBootPaths];
+      }
+
+      Status = InternalIssueVolumeProbe (Roots[Index], PathName, &VolumeProbes[PathIndex]);
+      if (!EFI_ERROR (Status)) {
+        ++NumQueued;
+      }
+    }
+  }
+
+  DEBUG ((
+    DEBUG_INFO,
+    "OCB: Issued %u async probes for %u of %u filesystems\n",
+    (UINT32) NumQueued,
+    (UINT32) NumVolumes,
+    (UINT32) NoHandles
+    ));
+
+  //
+  // All volumes now have their requests in flight, collect them as they complete.
+  //
+  InternalCompleteVolumeProbes (Probes, NoHandles * ProbesPerVolume, NumQueued);
+
+  for (Index = 0; Index < NoHandles; ++Index) {
+    if (Roots[Index] == NULL) {
+      continue;
+    }
+
+    InternalStoreVolumeProbeResult (
+      Context,
+      &Probes[Index * ProbesPerVolume],
+      &DevPathScanInfos[Index]
+      );
+
+    Roots[Index]->Close (Roots[Index]);
+  }
+
+  FreePool (Probes);
+  FreePool (Roots);
+}
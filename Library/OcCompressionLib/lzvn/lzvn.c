@@ -76,32 +76,49 @@ typedef struct {
 
 } lzvn_decoder_state;
 
+//  memcpy maps to CopyMem, which is an out of line call in firmware builds.
+//  Use the builtin for fixed-size loads and stores so that they compile
+//  into plain unaligned moves.
+#if defined(__GNUC__) || defined(__clang__)
+#  define lzvn_copy_fixed(Dst, Src, Size) __builtin_memcpy((Dst), (Src), (Size))
+#else
+#  define lzvn_copy_fixed(Dst, Src, Size) memcpy((Dst), (Src), (Size))
+#endif
+
 /*! @abstract Load bytes from memory location SRC. */
 LZFSE_INLINE uint16_t load2(const void *ptr) {
   uint16_t data;
-  memcpy(&data, ptr, sizeof data);
+  lzvn_copy_fixed(&data, ptr, sizeof data);
   return data;
 }
 
 LZFSE_INLINE uint32_t load4(const void *ptr) {
   uint32_t data;
-  memcpy(&data, ptr, sizeof data);
+  lzvn_copy_fixed(&data, ptr, sizeof data);
   return data;
 }
 
 LZFSE_INLINE uint64_t load8(const void *ptr) {
   uint64_t data;
-  memcpy(&data, ptr, sizeof data);
+  lzvn_copy_fixed(&data, ptr, sizeof data);
   return data;
 }
 
 /*! @abstract Store bytes to memory location DST. */
 LZFSE_INLINE void store4(void *ptr, uint32_t data) {
-  memcpy(ptr, &data, sizeof data);
+  lzvn_copy_fixed(ptr, &data, sizeof data);
 }
 
 LZFSE_INLINE void store8(void *ptr, uint64_t data) {
-  memcpy(ptr, &data, sizeof data);
+  lzvn_copy_fixed(ptr, &data, sizeof data);
+}
+
+/*! @abstract Copy 16 bytes, source and destination must not overlap. */
+LZFSE_INLINE void copy16(void *dst, const void *src) {
+  uint64_t lo = load8(src);
+  uint64_t hi = load8((const unsigned char *)src + 8);
+  store8(dst, lo);
+  store8((unsigned char *)dst + 8, hi);
 }
 
 /*! @abstract Extracts \p width bits from \p container, starting with \p lsb; if
@@ -610,7 +627,9 @@ sml_m:
   UPDATE_GOOD;
   //  "small match": This opcode has no literal, and uses the previous match
   //  distance (i.e. it encodes only the match length), in a single byte as
-  //  1111MMMM.
+  //  1111MMMM. There must be a previous match distance.
+  if (D == 0)
+    goto invalid_match_distance;
   opc_len = 1;
   if (src_len <= opc_len)
     return; // source truncated
@@ -628,7 +647,10 @@ lrg_m:
   //  distance (i.e. it encodes only the match length). It is encoded in two
   //  bytes as 11110000 MMMMMMMM.  Because matches smaller than 16 bytes can
   //  be represented by sml_m, there is an implicit bias of 16 on the match
-  //  length; the representable values are [16,271].
+  //  length; the representable values are [16,271]. There must be a previous
+  //  match distance.
+  if (D == 0)
+    goto invalid_match_distance;
   opc_len = 2;
   if (src_len <= opc_len)
     return; // source truncated
@@ -817,6 +839,207 @@ invalid_match_distance:
 #endif
 }
 
+//  Fast path tail margins. The longest literal is 271 bytes (lrg_l) and
+//  the longest opcode is 3 bytes; the longest output of a single opcode is
+//  271 bytes (lrg_l or lrg_m). Wide copies below may read and write up to
+//  15 bytes past the exact end of a literal or match. As long as both
+//  buffers have this much room left no per-opcode bounds checks are needed.
+#define LZVN_FAST_SRC_MARGIN 320
+#define LZVN_FAST_DST_MARGIN 320
+
+/*! @abstract Copy match of \p M bytes at distance \p D to \p dst_ptr.
+ *  The copy may write past dst_ptr + M within LZVN_FAST_DST_MARGIN. */
+LZFSE_INLINE void lzvn_copy_match_fast(unsigned char *dst_ptr, size_t M,
+                                       size_t D) {
+  size_t i;
+
+  if (__builtin_expect(D >= 16, 1)) {
+    //  Source window ends before destination window for every 16 byte
+    //  chunk, so plain wide copies produce byte-by-byte semantics.
+    for (i = 0; i < M; i += 16)
+      copy16(&dst_ptr[i], dst_ptr + i - D);
+    return;
+  }
+
+  if (D >= 8) {
+    for (i = 0; i < M; i += 8)
+      store8(&dst_ptr[i], load8(dst_ptr + i - D));
+    return;
+  }
+
+  if (D == 1) {
+    //  Splat the previous byte.
+    uint64_t v = dst_ptr[-1] * 0x0101010101010101ULL;
+    for (i = 0; i < M; i += 8)
+      store8(&dst_ptr[i], v);
+    return;
+  }
+
+  //  The output is periodic with period D, hence also with any multiple
+  //  of D. Expand the first multiple of D not below 8 byte-by-byte and
+  //  continue with eight byte copies at that distance.
+  size_t P = D * ((8 + D - 1) / D);
+  for (i = 0; i < P && i < M; ++i)
+    dst_ptr[i] = *(dst_ptr + i - D);
+  for (; i < M; i += 8)
+    store8(&dst_ptr[i], load8(dst_ptr + i - P));
+}
+
+//  Fast path opcode table. Each entry describes one opcode byte:
+//    [1:0]   kind: 0 literal and match, 1 literal, 2 match, 3 stop
+//    [3:2]   opcode length in bytes (lrg_l and lrg_m take length from
+//            the second byte)
+//    [5:4]   literal length for literal and match opcodes
+//    [7:4]   literal length for sml_l (nop is sml_l of zero length)
+//    [11:6]  match length, for med_d without the two low bits of opc23
+//    [9:6]   match length for sml_m
+//    [13:12] distance: 0 sml_d, 1 med_d, 2 lrg_d, 3 pre_d
+//  Stop covers end-of-stream and undefined opcodes, they are left to
+//  lzvn_decode.
+static const uint16_t lzvn_fast_tbl[256] = {
+  0x00C8, 0x00C8, 0x00C8, 0x00C8, 0x00C8, 0x00C8, 0x0003, 0x20CC,
+  0x0108, 0x0108, 0x0108, 0x0108, 0x0108, 0x0108, 0x0005, 0x210C,
+  0x0148, 0x0148, 0x0148, 0x0148, 0x0148, 0x0148, 0x0005, 0x214C,
+  0x0188, 0x0188, 0x0188, 0x0188, 0x0188, 0x0188, 0x0003, 0x218C,
+  0x01C8, 0x01C8, 0x01C8, 0x01C8, 0x01C8, 0x01C8, 0x0003, 0x21CC,
+  0x0208, 0x0208, 0x0208, 0x0208, 0x0208, 0x0208, 0x0003, 0x220C,
+  0x0248, 0x0248, 0x0248, 0x0248, 0x0248, 0x0248, 0x0003, 0x224C,
+  0x0288, 0x0288, 0x0288, 0x0288, 0x0288, 0x0288, 0x0003, 0x228C,
+  0x00D8, 0x00D8, 0x00D8, 0x00D8, 0x00D8, 0x00D8, 0x30D4, 0x20DC,
+  0x0118, 0x0118, 0x0118, 0x0118, 0x0118, 0x0118, 0x3114, 0x211C,
+  0x0158, 0x0158, 0x0158, 0x0158, 0x0158, 0x0158, 0x3154, 0x215C,
+  0x0198, 0x0198, 0x0198, 0x0198, 0x0198, 0x0198, 0x3194, 0x219C,
+  0x01D8, 0x01D8, 0x01D8, 0x01D8, 0x01D8, 0x01D8, 0x31D4, 0x21DC,
+  0x0218, 0x0218, 0x0218, 0x0218, 0x0218, 0x0218, 0x3214, 0x221C,
+  0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003,
+  0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003,
+  0x00E8, 0x00E8, 0x00E8, 0x00E8, 0x00E8, 0x00E8, 0x30E4, 0x20EC,
+  0x0128, 0x0128, 0x0128, 0x0128, 0x0128, 0x0128, 0x3124, 0x212C,
+  0x0168, 0x0168, 0x0168, 0x0168, 0x0168, 0x0168, 0x3164, 0x216C,
+  0x01A8, 0x01A8, 0x01A8, 0x01A8, 0x01A8, 0x01A8, 0x31A4, 0x21AC,
+  0x10CC, 0x11CC, 0x12CC, 0x13CC, 0x14CC, 0x15CC, 0x16CC, 0x17CC,
+  0x10DC, 0x11DC, 0x12DC, 0x13DC, 0x14DC, 0x15DC, 0x16DC, 0x17DC,
+  0x10EC, 0x11EC, 0x12EC, 0x13EC, 0x14EC, 0x15EC, 0x16EC, 0x17EC,
+  0x10FC, 0x11FC, 0x12FC, 0x13FC, 0x14FC, 0x15FC, 0x16FC, 0x17FC,
+  0x00F8, 0x00F8, 0x00F8, 0x00F8, 0x00F8, 0x00F8, 0x30F4, 0x20FC,
+  0x0138, 0x0138, 0x0138, 0x0138, 0x0138, 0x0138, 0x3134, 0x213C,
+  0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003,
+  0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003, 0x0003,
+  0x0009, 0x0015, 0x0025, 0x0035, 0x0045, 0x0055, 0x0065, 0x0075,
+  0x0085, 0x0095, 0x00A5, 0x00B5, 0x00C5, 0x00D5, 0x00E5, 0x00F5,
+  0x000A, 0x0046, 0x0086, 0x00C6, 0x0106, 0x0146, 0x0186, 0x01C6,
+  0x0206, 0x0246, 0x0286, 0x02C6, 0x0306, 0x0346, 0x0386, 0x03C6,
+};
+
+/*! @abstract Decode source to destination while both are away from their
+ *  ends by the fast path margins. Stops when reaching the margins, an
+ *  end-of-stream or undefined opcode, or an invalid match distance, and
+ *  leaves the rest to lzvn_decode. Updates \p state (src,dst,d_prev) to
+ *  the last valid opcode like lzvn_decode does, so that lzvn_decode redoes
+ *  it and reports errors at exactly the same position. Must not be used
+ *  with a partially expanded match saved in \p state. */
+static void lzvn_decode_fast(lzvn_decoder_state *state) {
+  const unsigned char *src_ptr = state->src;
+  unsigned char *dst_ptr = state->dst;
+  size_t D = state->d_prev;
+  //  Start of the last valid opcode, see UPDATE_GOOD.
+  const unsigned char *good_src = src_ptr;
+  unsigned char *good_dst = dst_ptr;
+  size_t good_D = D;
+  const unsigned char *src_limit;
+  unsigned char *dst_limit;
+  size_t opc23;
+  size_t D_cand[4];
+  size_t L;
+  size_t M;
+  size_t i;
+  uint32_t ent;
+
+  if ((size_t)(state->src_end - src_ptr) <= LZVN_FAST_SRC_MARGIN ||
+      (size_t)(state->dst_end - dst_ptr) <= LZVN_FAST_DST_MARGIN)
+    return;
+
+  src_limit = state->src_end - LZVN_FAST_SRC_MARGIN;
+  dst_limit = state->dst_end - LZVN_FAST_DST_MARGIN;
+
+  while (src_ptr < src_limit && dst_ptr < dst_limit) {
+    ent = lzvn_fast_tbl[src_ptr[0]];
+
+    if (__builtin_expect((ent & 3) == 0, 1)) {
+      //  Literal and match opcodes (sml_d, med_d, lrg_d, pre_d), see
+      //  lzvn_decode for the encodings. All four are decoded without
+      //  branches: every distance candidate is computed and the right one
+      //  is picked by the table.
+      good_src = src_ptr;
+      good_dst = dst_ptr;
+      good_D = D;
+      opc23 = load2(&src_ptr[1]);
+      D_cand[0] = (size_t)(src_ptr[0] & 7) << 8 | (opc23 & 0xFF);
+      D_cand[1] = opc23 >> 2;
+      D_cand[2] = opc23;
+      D_cand[3] = D;
+      D = D_cand[(ent >> 12) & 3];
+      L = (ent >> 4) & 3;
+      M = ((ent >> 6) & 0x3F) + (((ent >> 12) & 3) == 1 ? (opc23 & 3) : 0);
+      src_ptr += (ent >> 2) & 3;
+      //  The literal is 0-3 bytes, copy four and advance by L.
+      store4(dst_ptr, load4(src_ptr));
+      src_ptr += L;
+      dst_ptr += L;
+      if (__builtin_expect(D > (size_t)(dst_ptr - state->dst_begin) || D == 0, 0))
+        break;
+      lzvn_copy_match_fast(dst_ptr, M, D);
+      dst_ptr += M;
+      continue;
+    }
+
+    if ((ent & 3) == 1) {
+      //  sml_l is always copied with a single 16 byte copy, lrg_l in
+      //  16 byte chunks.
+      good_src = src_ptr;
+      good_dst = dst_ptr;
+      good_D = D;
+      if (src_ptr[0] == 0xE0) {
+        L = src_ptr[1] + 16;
+        src_ptr += 2;
+        for (i = 0; i < L; i += 16)
+          copy16(&dst_ptr[i], &src_ptr[i]);
+      } else {
+        L = (ent >> 4) & 0xF;
+        src_ptr += 1;
+        copy16(dst_ptr, src_ptr);
+      }
+      src_ptr += L;
+      dst_ptr += L;
+      continue;
+    }
+
+    //  Leave end-of-stream, undefined opcodes, and matches without
+    //  a previous distance to lzvn_decode.
+    if ((ent & 3) == 3 || D == 0)
+      break;
+
+    //  sml_m and lrg_m, the distance was validated by the opcode that
+    //  has set it.
+    good_src = src_ptr;
+    good_dst = dst_ptr;
+    good_D = D;
+    if (src_ptr[0] == 0xF0) {
+      M = src_ptr[1] + 16;
+      src_ptr += 2;
+    } else {
+      M = (ent >> 6) & 0xF;
+      src_ptr += 1;
+    }
+    lzvn_copy_match_fast(dst_ptr, M, D);
+    dst_ptr += M;
+  }
+
+  state->src = good_src;
+  state->dst = good_dst;
+  state->d_prev = good_D;
+}
+
 size_t lzvn_decode_buffer(unsigned char *dst, size_t dst_size,
                           const unsigned char *src, size_t src_size) {
   // Init LZVN decoder state
@@ -837,7 +1060,8 @@ size_t lzvn_decode_buffer(unsigned char *dst, size_t dst_size,
   dstate.d_prev = 0;
   dstate.end_of_stream = 0;
 
-  // Run LZVN decoder
+  // Run LZVN decoder, fast path first and reference decoder for the tail
+  lzvn_decode_fast(&dstate);
   lzvn_decode(&dstate);
 
   // This is how much we decompressed
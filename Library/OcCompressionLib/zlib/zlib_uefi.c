@@ -78,4 +78,74 @@ DecompressZLIB (
   return 0;
 }
 
+struct OC_ZLIB_DECOMPRESSOR_ {
+  z_stream  Stream;
+};
+
+OC_ZLIB_DECOMPRESSOR *
+CreateZLIBDecompressor (
+  VOID
+  )
+{
+  OC_ZLIB_DECOMPRESSOR  *Decompressor;
+
+  Decompressor = AllocateZeroPool (sizeof (*Decompressor));
+  if (Decompressor == NULL) {
+    return NULL;
+  }
+
+  if (inflateInit (&Decompressor->Stream) != Z_OK) {
+    FreePool (Decompressor);
+    return NULL;
+  }
+
+  return Decompressor;
+}
+
+VOID
+FreeZLIBDecompressor (
+  IN OC_ZLIB_DECOMPRESSOR  *Decompressor
+  )
+{
+  inflateEnd (&Decompressor->Stream);
+  FreePool (Decompressor);
+}
+
+UINTN
+DecompressZLIBWith (
+  IN OUT OC_ZLIB_DECOMPRESSOR  *Decompressor,
+  OUT    UINT8                 *Dst,
+  IN     UINTN                 DstLen,
+  IN     CONST UINT8           *Src,
+  IN     UINTN                 SrcLen
+  )
+{
+  z_stream  *Stream;
+
+  if (SrcLen > OC_COMPRESSION_MAX_LENGTH || DstLen > OC_COMPRESSION_MAX_LENGTH) {
+    return 0;
+  }
+
+  Stream = &Decompressor->Stream;
+
+  if (inflateReset (Stream) != Z_OK) {
+    return 0;
+  }
+
+  Stream->next_in   = (z_const Bytef *) Src;
+  Stream->avail_in  = (uInt) SrcLen;
+  Stream->next_out  = Dst;
+  Stream->avail_out = (uInt) DstLen;
+
+  //
+  // Both buffers are complete, so a single call must reach the stream end.
+  // This also lets inflate skip sliding window allocation.
+  //
+  if (inflate (Stream, Z_FINISH) != Z_STREAM_END) {
+    return 0;
+  }
+
+  return Stream->total_out;
+}
+
 #endif // OC_USE_SSH_ZLIB
@@ -14,6 +14,8 @@
 
 #include <Uefi.h>
 
+#include <Guid/OcVariables.h>
+
 #include <IndustryStandard/CpuId.h>
 #include <IndustryStandard/GenericIch.h>
 #include <IndustryStandard/Pci.h>
@@ -31,8 +33,10 @@
 #include <Library/OcMiscLib.h>
 #include <Library/OcStringLib.h>
 #include <Library/OcTimerLib.h>
+#include <Library/PcdLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
 
 #include <ProcessorInfo.h>
 #include <Register/Microcode.h>
@@ -46,6 +50,38 @@
 //
 #define OC_CPU_FREQUENCY_TOLERANCE 50000000ULL // 50 Mhz
 
+//
+// TSC calibration against ACPI PM timer takes 10 samples 1 ms apart.
+// 3580 clocks of ACPI timer (1ms)
+//
+#define OC_TSC_CALIBRATION_SAMPLES      10U
+#define OC_TSC_CALIBRATION_SAMPLE_TICKS (V_ACPI_TMR_FREQUENCY / 1000)
+
+/**
+  Obtain CPU info snapshot published during this boot.
+
+  @retval CPU info or NULL when not yet published.
+**/
+STATIC
+CONST OC_CPU_INFO *
+InternalGetPublishedCpuInfo (
+  VOID
+  )
+{
+  EFI_STATUS         Status;
+  OC_CPU_INFO_TABLE  *Table;
+
+  Status = EfiGetSystemConfigurationTable (&gOcCpuInfoTableGuid, (VOID **) &Table);
+  if (EFI_ERROR (Status)
+    || Table == NULL
+    || Table->Revision != OC_CPU_INFO_TABLE_REVISION
+    || Table->Size != sizeof (*Table)) {
+    return NULL;
+  }
+
+  return &Table->CpuInfo;
+}
+
 STATIC
 UINT8
 DetectAppleMajorType (
@@ -676,6 +712,158 @@ OcGetPmTimerAddr (
   return TimerAddr;
 }
 
+/**
+  Calculate the amount of ACPI PM timer ticks passed between two reads.
+
+  @param[in] AcpiTick0  Earlier timer value.
+  @param[in] AcpiTick1  Later timer value.
+
+  @retval  Ticks passed.
+**/
+STATIC
+UINT32
+InternalGetPmTimerDelta (
+  IN UINT32  AcpiTick0,
+  IN UINT32  AcpiTick1
+  )
+{
+  //
+  // ACPI PM timers are usually of 24-bit length, but there are some less common cases of 32-bit length also.
+  // When the maximal number is reached, it overflows.
+  // The code below can handle overflow with deltas of up to 24-bit size,
+  // on both available sizes of ACPI PM Timers (24-bit and 32-bit).
+  //
+  if (AcpiTick0 <= AcpiTick1) {
+    //
+    // No overflow.
+    //
+    return AcpiTick1 - AcpiTick0;
+  }
+
+  if (AcpiTick0 - AcpiTick1 <= 0x00FFFFFF) {
+    //
+    // Overflow, 24-bit timer.
+    //
+    return 0x00FFFFFF - AcpiTick0 + AcpiTick1;
+  }
+
+  //
+  // Overflow, 32-bit timer.
+  //
+  return MAX_UINT32 - AcpiTick0 + AcpiTick1;
+}
+
+/**
+  Calibrate the TSC frequency against ACPI PM timer.
+
+  Instead of measuring a single 100 ms interval, take a number of
+  (PM timer, TSC) samples over a short window and fit the TSC rate with
+  least squares. This keeps the precision within tens of kHz while reducing
+  the time spent at TPL_HIGH_LEVEL by an order of magnitude.
+
+  @param[in] TimerAddr  ACPI PM timer address.
+
+  @retval  The calculated TSC frequency or 0.
+**/
+STATIC
+UINT64
+InternalCalibrateTSCFromPMTimer (
+  IN UINTN  TimerAddr
+  )
+{
+  UINT64   Tsc0;
+  UINT64   Tsc;
+  UINT64   TscBefore;
+  UINT32   AcpiTick0;
+  UINT32   AcpiTick;
+  UINT32   AcpiTickPrev;
+  UINT64   AcpiTicks;
+  UINT64   AcpiTicksTarget;
+  UINT64   SumX;
+  UINT64   SumY;
+  UINT64   SumXX;
+  UINT64   SumXY;
+  UINT64   Sxx;
+  UINT64   Sxy;
+  UINT64   Slope;
+  UINT64   Remainder;
+  UINT32   Index;
+  EFI_TPL  PrevTpl;
+
+  SumX  = 0;
+  SumY  = 0;
+  SumXX = 0;
+  SumXY = 0;
+
+  //
+  // Disable all events to ensure that nobody interrupts us.
+  //
+  PrevTpl = gBS->RaiseTPL (TPL_HIGH_LEVEL);
+
+  //
+  // Align to a timer edge to start with a fresh tick.
+  //
+  AcpiTick0 = IoRead32 (TimerAddr);
+  do {
+    AcpiTick = IoRead32 (TimerAddr);
+  } while (AcpiTick == AcpiTick0);
+
+  AcpiTick0    = AcpiTick;
+  AcpiTickPrev = AcpiTick;
+  AcpiTicks    = 0;
+  Tsc0         = AsmReadTsc ();
+
+  for (Index = 0; Index < OC_TSC_CALIBRATION_SAMPLES; ++Index) {
+    AcpiTicksTarget = MultU64x32 (Index + 1, OC_TSC_CALIBRATION_SAMPLE_TICKS);
+
+    do {
+      CpuPause ();
+
+      //
+      // Sample TSC on both sides of the timer read to reduce the I/O latency error.
+      //
+      TscBefore = AsmReadTsc ();
+      AcpiTick  = IoRead32 (TimerAddr);
+      Tsc       = AsmReadTsc ();
+
+      AcpiTicks   += InternalGetPmTimerDelta (AcpiTickPrev, AcpiTick);
+      AcpiTickPrev = AcpiTick;
+    } while (AcpiTicks < AcpiTicksTarget);
+
+    Tsc = TscBefore + DivU64x32 (Tsc - TscBefore, 2) - Tsc0;
+
+    SumX  += AcpiTicks;
+    SumY  += Tsc;
+    SumXX += MultU64x64 (AcpiTicks, AcpiTicks);
+    SumXY += MultU64x64 (AcpiTicks, Tsc);
+  }
+
+  //
+  // Restore to normal TPL.
+  //
+  gBS->RestoreTPL (PrevTpl);
+
+  //
+  // Slope (TSC ticks per PM timer tick) = Sxy / Sxx, where
+  // Sxy = n * Sum(x * y) - Sum(x) * Sum(y) and Sxx = n * Sum(x^2) - Sum(x)^2.
+  // With ~10 ms windows all the intermediate values fit in 64 bits.
+  //
+  Sxy = MultU64x32 (SumXY, OC_TSC_CALIBRATION_SAMPLES);
+  Sxx = MultU64x32 (SumXX, OC_TSC_CALIBRATION_SAMPLES) - MultU64x64 (SumX, SumX);
+  if (Sxx == 0 || Sxy <= MultU64x64 (SumX, SumY)) {
+    return 0;
+  }
+
+  Sxy -= MultU64x64 (SumX, SumY);
+
+  //
+  // Frequency = Slope * V_ACPI_TMR_FREQUENCY, split to avoid overflows.
+  //
+  Slope = DivU64x64Remainder (Sxy, Sxx, &Remainder);
+  return MultU64x32 (Slope, V_ACPI_TMR_FREQUENCY)
+    + DivU64x64Remainder (MultU64x32 (Remainder, V_ACPI_TMR_FREQUENCY), Sxx, NULL);
+}
+
 /**
   Calculate the TSC frequency via PM timer
 
@@ -696,23 +884,36 @@ OcCalculateTSCFromPMTimer (
   //
   STATIC UINT64 TSCFrequency = 0;
 
-  UINTN    TimerAddr;
-  UINT64   Tsc0;
-  UINT64   Tsc1;
-  UINT32   AcpiTick0;
-  UINT32   AcpiTick1;
-  UINT32   AcpiTicksDelta;
-  UINT32   AcpiTicksTarget;
-  UINT32   TimerResolution;
-  EFI_TPL  PrevTpl;
-  
+  EFI_STATUS  Status;
+  UINTN       TimerAddr;
+  UINT32      AcpiTick0;
+  UINT32      AcpiTick1;
+  UINTN       DataSize;
+
   if (Recalculate) {
     TSCFrequency = 0;
   }
 
+  //
+  // Other images calling into this library (e.g. drivers with own TimerLib
+  // instances) may have calibrated already during this boot.
+  //
+  if (TSCFrequency == 0 && !Recalculate) {
+    DataSize = sizeof (TSCFrequency);
+    Status = gRT->GetVariable (
+      OC_TSC_FREQUENCY_VARIABLE_NAME,
+      &gOcVendorVariableGuid,
+      NULL,
+      &DataSize,
+      &TSCFrequency
+      );
+    if (EFI_ERROR (Status) || DataSize != sizeof (TSCFrequency)) {
+      TSCFrequency = 0;
+    }
+  }
+
   if (TSCFrequency == 0) {
-    TimerAddr       = OcGetPmTimerAddr (NULL);
-    TimerResolution = 10;
+    TimerAddr = OcGetPmTimerAddr (NULL);
 
     if (TimerAddr != 0) {
       //
@@ -723,72 +924,20 @@ OcCalculateTSCFromPMTimer (
       AcpiTick1 = IoRead32 (TimerAddr);
 
       if (AcpiTick0 != AcpiTick1) {
-        //
-        // ACPI PM timers are usually of 24-bit length, but there are some less common cases of 32-bit length also.
-        // When the maximal number is reached, it overflows.
-        // The code below can handle overflow with AcpiTicksTarget of up to 24-bit size,
-        // on both available sizes of ACPI PM Timers (24-bit and 32-bit).
-        //
-        // 357954 clocks of ACPI timer (100ms)
-        //
-        AcpiTicksTarget = V_ACPI_TMR_FREQUENCY / TimerResolution;
-
-        //
-        // Disable all events to ensure that nobody interrupts us.
-        //
-        PrevTpl   = gBS->RaiseTPL (TPL_HIGH_LEVEL);
-
-        AcpiTick0 = IoRead32 (TimerAddr);
-        Tsc0      = AsmReadTsc ();
-
-        do {
-          CpuPause ();
-
-          //
-          // Check how many AcpiTicks have passed since we started.
-          //
-          AcpiTick1 = IoRead32 (TimerAddr);
-
-          if (AcpiTick0 <= AcpiTick1) {
-            //
-            // No overflow.
-            //
-            AcpiTicksDelta = AcpiTick1 - AcpiTick0;
-          } else if (AcpiTick0 - AcpiTick1 <= 0x00FFFFFF) {
-            //
-            // Overflow, 24-bit timer.
-            //
-            AcpiTicksDelta = 0x00FFFFFF - AcpiTick0 + AcpiTick1;
-          } else {
-            //
-            // Overflow, 32-bit timer.
-            //
-            AcpiTicksDelta = MAX_UINT32 - AcpiTick0 + AcpiTick1;
-          }
-
-          //
-          // Keep checking AcpiTicks until target is reached.
-          //
-        } while (AcpiTicksDelta < AcpiTicksTarget);
-
-        Tsc1 = AsmReadTsc ();
-
-        //
-        // On some systems we may end up waiting for notably longer than 100ms,
-        // despite disabling all events. Divide by actual time passed as suggested
-        // by asava's Clover patch r2668.
-        //
-        TSCFrequency = DivU64x32 (
-          MultU64x32 (Tsc1 - Tsc0, V_ACPI_TMR_FREQUENCY), AcpiTicksDelta
-          );
-
-        //
-        // Restore to normal TPL.
-        //
-        gBS->RestoreTPL (PrevTpl);
+        TSCFrequency = InternalCalibrateTSCFromPMTimer (TimerAddr);
       }
     }
 
+    if (TSCFrequency != 0) {
+      gRT->SetVariable (
+        OC_TSC_FREQUENCY_VARIABLE_NAME,
+        &gOcVendorVariableGuid,
+        EFI_VARIABLE_BOOTSERVICE_ACCESS,
+        sizeof (TSCFrequency),
+        &TSCFrequency
+        );
+    }
+
     DEBUG ((DEBUG_VERBOSE, "TscFrequency %lld\n", TSCFrequency));
   }
 
@@ -886,9 +1035,15 @@ OcCalcluateARTFrequencyIntel (
         //
         // Some Intel chips don't report their core crystal clock frequency.
         // Calculate it by dividing the TSC frequency by the TSC ratio.
+        // Prefer the nominal frequency from CPUID 0x16, as the TSC runs at it,
+        // and only calibrate against PM timer when it is not reported.
         //
         if (ARTFrequency == 0 && MaxId >= CPUID_PROCESSOR_FREQUENCY) {
-          CPUFrequencyFromTSC = OcCalculateTSCFromPMTimer (Recalculate);
+          AsmCpuid (CPUID_PROCESSOR_FREQUENCY, &CpuidFrequencyEax.Uint32, NULL, NULL, NULL);
+          CPUFrequencyFromTSC = MultU64x32 (CpuidFrequencyEax.Bits.ProcessorBaseFrequency, 1000000);
+          if (CPUFrequencyFromTSC == 0) {
+            CPUFrequencyFromTSC = OcCalculateTSCFromPMTimer (Recalculate);
+          }
           ARTFrequency = MultThenDivU64x64x32(
             CPUFrequencyFromTSC,
             CpuidDenominatorEax,
@@ -907,7 +1062,6 @@ OcCalcluateARTFrequencyIntel (
             //
             // Use the reported CPU frequency rather than deriving it from ARTFrequency
             //
-            AsmCpuid (CPUID_PROCESSOR_FREQUENCY, &CpuidFrequencyEax.Uint32, NULL, NULL, NULL);
             CPUFrequencyFromART = MultU64x32 (CpuidFrequencyEax.Bits.ProcessorBaseFrequency, 1000000);
           }
         }
@@ -953,7 +1107,23 @@ OcGetTSCFrequency (
   VOID
   )
 {
-  UINT64 CPUFrequency;
+  UINT64             CPUFrequency;
+  CONST OC_CPU_INFO  *Published;
+
+  //
+  // Reuse the frequencies measured by the full scan when it is published.
+  //
+  Published = InternalGetPublishedCpuInfo ();
+  if (Published != NULL) {
+    if (Published->CPUFrequencyFromART > 0) {
+      return Published->CPUFrequencyFromART;
+    }
+
+    if (Published->CPUFrequencyFromTSC > 0) {
+      return Published->CPUFrequencyFromTSC;
+    }
+  }
+
   //
   // For Intel platforms (the vendor check is covered by the callee), prefer
   // the CPU Frequency derieved from the ART, as the PM timer might not be
@@ -1298,14 +1468,185 @@ ScanAmdProcessor (
   }
 }
 
-/** Scan the processor and fill the cpu info structure with results
+/**
+  Publish CPU info snapshot for other images during this boot.
+
+  @param[in] Cpu  A pointer to the scanned cpu info.
+**/
+STATIC
+VOID
+InternalPublishCpuInfo (
+  IN CONST OC_CPU_INFO  *Cpu
+  )
+{
+  EFI_STATUS         Status;
+  OC_CPU_INFO_TABLE  *Table;
+
+  Table = AllocatePool (sizeof (*Table));
+  if (Table == NULL) {
+    return;
+  }
 
-  @param[in] Cpu  A pointer to the cpu info structure to fill with results
+  Table->Revision = OC_CPU_INFO_TABLE_REVISION;
+  Table->Size     = sizeof (*Table);
+  CopyMem (&Table->CpuInfo, Cpu, sizeof (Table->CpuInfo));
 
-  @retval EFI_SUCCESS  The scan was completed successfully.
+  Status = gBS->InstallConfigurationTable (&gOcCpuInfoTableGuid, Table);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCCPU: Failed to publish CPU info - %r\n", Status));
+    FreePool (Table);
+  }
+}
+
+/**
+  Read the values identifying the processor and its microcode.
+  These are compared against the persisted CPU info snapshot.
+
+  @param[out] Vendor             CPUID vendor (EBX of CPUID 0).
+  @param[out] Signature          CPUID signature (EAX of CPUID 1).
+  @param[out] MicrocodeRevision  Loaded microcode revision, Intel only.
 **/
+STATIC
 VOID
-OcCpuScanProcessor (
+InternalReadCpuKey (
+  OUT UINT32  *Vendor,
+  OUT UINT32  *Signature,
+  OUT UINT32  *MicrocodeRevision
+  )
+{
+  UINT32  MaxId;
+
+  *Signature         = 0;
+  *MicrocodeRevision = 0;
+
+  AsmCpuid (CPUID_SIGNATURE, &MaxId, Vendor, NULL, NULL);
+
+  if (MaxId >= CPUID_VERSION_INFO) {
+    //
+    // Same sequence as in the scan, see Intel SDM on microcode version read.
+    //
+    if (*Vendor == CPUID_VENDOR_INTEL) {
+      AsmWriteMsr64 (MSR_IA32_BIOS_SIGN_ID, 0);
+    }
+
+    AsmCpuid (CPUID_VERSION_INFO, Signature, NULL, NULL, NULL);
+
+    if (*Vendor == CPUID_VENDOR_INTEL) {
+      *MicrocodeRevision = (UINT32) RShiftU64 (AsmReadMsr64 (MSR_IA32_BIOS_SIGN_ID), 32);
+    }
+  }
+}
+
+/**
+  Load CPU info snapshot persisted on previous boots.
+
+  @param[out] Cpu  A pointer to the cpu info structure to fill.
+
+  @retval TRUE when a matching snapshot was loaded.
+**/
+STATIC
+BOOLEAN
+InternalLoadPersistedCpuInfo (
+  OUT OC_CPU_INFO  *Cpu
+  )
+{
+  EFI_STATUS         Status;
+  OC_CPU_INFO_TABLE  *Table;
+  UINTN              DataSize;
+  UINT32             Vendor;
+  UINT32             Signature;
+  UINT32             MicrocodeRevision;
+  BOOLEAN            Result;
+
+  Table = AllocatePool (sizeof (*Table));
+  if (Table == NULL) {
+    return FALSE;
+  }
+
+  DataSize = sizeof (*Table);
+  Status = gRT->GetVariable (
+    OC_CPU_INFO_VARIABLE_NAME,
+    &gOcVendorVariableGuid,
+    NULL,
+    &DataSize,
+    Table
+    );
+
+  Result = FALSE;
+
+  if (!EFI_ERROR (Status)
+    && DataSize == sizeof (*Table)
+    && Table->Revision == OC_CPU_INFO_TABLE_REVISION
+    && Table->Size == sizeof (*Table)) {
+    InternalReadCpuKey (&Vendor, &Signature, &MicrocodeRevision);
+
+    if (Table->CpuInfo.Vendor[0] == Vendor
+      && Table->CpuInfo.Signature == Signature
+      && Table->CpuInfo.MicrocodeRevision == MicrocodeRevision) {
+      CopyMem (Cpu, &Table->CpuInfo, sizeof (*Cpu));
+      Result = TRUE;
+    } else {
+      DEBUG ((
+        DEBUG_INFO,
+        "OCCPU: Persisted CPU info is stale - %X/%X vs %X/%X\n",
+        Table->CpuInfo.Signature,
+        Table->CpuInfo.MicrocodeRevision,
+        Signature,
+        MicrocodeRevision
+        ));
+    }
+  }
+
+  FreePool (Table);
+  return Result;
+}
+
+/**
+  Persist CPU info snapshot for next boots.
+
+  @param[in] Cpu  A pointer to the scanned cpu info.
+**/
+STATIC
+VOID
+InternalPersistCpuInfo (
+  IN CONST OC_CPU_INFO  *Cpu
+  )
+{
+  EFI_STATUS         Status;
+  OC_CPU_INFO_TABLE  *Table;
+
+  Table = AllocatePool (sizeof (*Table));
+  if (Table == NULL) {
+    return;
+  }
+
+  Table->Revision = OC_CPU_INFO_TABLE_REVISION;
+  Table->Size     = sizeof (*Table);
+  CopyMem (&Table->CpuInfo, Cpu, sizeof (Table->CpuInfo));
+
+  Status = gRT->SetVariable (
+    OC_CPU_INFO_VARIABLE_NAME,
+    &gOcVendorVariableGuid,
+    EFI_VARIABLE_BOOTSERVICE_ACCESS | EFI_VARIABLE_NON_VOLATILE,
+    sizeof (*Table),
+    Table
+    );
+
+  DEBUG ((DEBUG_INFO, "OCCPU: Persisting CPU info - %r\n", Status));
+
+  FreePool (Table);
+}
+
+/**
+  Scan the processor and fill the cpu info structure with results.
+
+  @param[in] Cpu  A pointer to the cpu info structure to fill with results.
+
+  @retval TRUE when the vendor is supported and the scan is complete.
+**/
+STATIC
+BOOLEAN
+InternalScanProcessor (
   IN OUT OC_CPU_INFO  *Cpu
   )
 {
@@ -1392,7 +1733,10 @@ OcCpuScanProcessor (
       );
 
     if (Cpu->Vendor[0] == CPUID_VENDOR_INTEL) {
-      Cpu->MicrocodeRevision = AsmReadMsr32 (MSR_IA32_BIOS_SIGN_ID);
+      //
+      // Microcode revision is reported in the upper half of the MSR.
+      //
+      Cpu->MicrocodeRevision = (UINT32) RShiftU64 (AsmReadMsr64 (MSR_IA32_BIOS_SIGN_ID), 32);
     }
 
     Cpu->Signature = Cpu->CpuidVerEax.Uint32;
@@ -1481,7 +1825,7 @@ OcCpuScanProcessor (
     ScanAmdProcessor (Cpu);
   } else {
     DEBUG ((DEBUG_WARN, "Found unsupported CPU vendor: %0X", Cpu->Vendor[0]));
-    return;
+    return FALSE;
   }
 
   DEBUG ((
@@ -1512,6 +1856,36 @@ OcCpuScanProcessor (
     Cpu->CoreCount,
     Cpu->ThreadCount
     ));
+
+  return TRUE;
+}
+
+VOID
+OcCpuScanProcessor (
+  IN OUT OC_CPU_INFO  *Cpu
+  )
+{
+  CONST OC_CPU_INFO  *Published;
+
+  ASSERT (Cpu != NULL);
+
+  //
+  // Another image (or an earlier call) has already scanned during this boot.
+  //
+  Published = InternalGetPublishedCpuInfo ();
+  if (Published != NULL) {
+    CopyMem (Cpu, Published, sizeof (*Cpu));
+    DEBUG ((DEBUG_INFO, "OCCPU: Reusing published CPU info for %a\n", Cpu->BrandString));
+    return;
+  }
+
+  if (FeaturePcdGet (PcdOcCpuPersistInfo) && InternalLoadPersistedCpuInfo (Cpu)) {
+    DEBUG ((DEBUG_INFO, "OCCPU: Reusing persisted CPU info for %a\n", Cpu->BrandString));
+  } else if (InternalScanProcessor (Cpu) && FeaturePcdGet (PcdOcCpuPersistInfo)) {
+    InternalPersistCpuInfo (Cpu);
+  }
+
+  InternalPublishCpuInfo (Cpu);
 }
 
 VOID
@@ -1604,10 +1978,16 @@ OcIsSandyOrIvy (
   BOOLEAN                            SandyOrIvy;
   UINT32                             CpuFamily;
   UINT32                             CpuModel;
+  CONST OC_CPU_INFO                  *Published;
 
   Sig.Uint32 = 0;
 
-  AsmCpuid (1, &Sig.Uint32, NULL, NULL, NULL);
+  Published = InternalGetPublishedCpuInfo ();
+  if (Published != NULL) {
+    Sig.Uint32 = Published->Signature;
+  } else {
+    AsmCpuid (1, &Sig.Uint32, NULL, NULL, NULL);
+  }
 
   CpuFamily = Sig.Bits.Family;
   if (CpuFamily == 15) {
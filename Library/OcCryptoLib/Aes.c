@@ -52,6 +52,11 @@ For more information, please refer to <http://unlicense.org/>
 This is an implementation of the AES algorithm, specifically CTR and CBC mode.
 Block size can be chosen in OcCryptoLib.h.
 
+This file uses the 32-bit T-table formulation of the cipher: every round is
+a set of table lookups combining SubBytes, ShiftRows and MixColumns per column,
+and decryption uses the equivalent inverse cipher with pre-mixed round keys.
+Tables are stored once and rotated to save firmware space.
+
 The implementation is verified against the test vectors in:
   National Institute of Standards and Technology Special Publication 800-38A 2001 ED
 
@@ -84,9 +89,33 @@ NOTE:   String length must be evenly divisible by 16byte (str_len % 16 == 0)
 #endif
 
 //
-// state - array holding the intermediate results during decryption.
+// Number of blocks processed at once by the bulk CTR and CBC decryption paths.
 //
-typedef UINT8 AES_INTERNAL_STATE[4][4];
+#define AES_BULK_BLOCKS 4
+
+//
+// Word load and store helpers. State columns are kept as little endian words,
+// so that row N of a column is stored in byte N of the word.
+//
+#define AES_LOAD32(Ptr) \
+  ((UINT32) (Ptr)[0] | ((UINT32) (Ptr)[1] << 8U) | ((UINT32) (Ptr)[2] << 16U) | ((UINT32) (Ptr)[3] << 24U))
+
+#define AES_STORE32(Ptr, Value) \
+  do { \
+    (Ptr)[0] = (UINT8) (Value); \
+    (Ptr)[1] = (UINT8) ((Value) >> 8U); \
+    (Ptr)[2] = (UINT8) ((Value) >> 16U); \
+    (Ptr)[3] = (UINT8) ((Value) >> 24U); \
+  } while (0)
+
+#define AES_ROTL8(Value)  (((Value) << 8U)  | ((Value) >> 24U))
+#define AES_ROTL16(Value) (((Value) << 16U) | ((Value) >> 16U))
+#define AES_ROTL24(Value) (((Value) << 24U) | ((Value) >> 8U))
+
+#define AES_BYTE0(Value) ((Value) & 0xFFU)
+#define AES_BYTE1(Value) (((Value) >> 8U) & 0xFFU)
+#define AES_BYTE2(Value) (((Value) >> 16U) & 0xFFU)
+#define AES_BYTE3(Value) ((Value) >> 24U)
 
 //
 // The lookup-tables are marked CONST so they can be placed in read-only storage instead of RAM
@@ -151,6 +180,106 @@ STATIC CONST UINT8 Rcon[11] = {
  */
 
 
+//
+// Encryption T-table: Te0[x] = {02, 01, 01, 03} * Sbox[x] as a little endian column.
+// Tables for rows 1-3 are obtained by rotating this one by 8, 16 and 24 bits.
+//
+STATIC CONST UINT32 Te0[256] = {
+  0xa56363c6U, 0x847c7cf8U, 0x997777eeU, 0x8d7b7bf6U, 0x0df2f2ffU, 0xbd6b6bd6U,
+  0xb16f6fdeU, 0x54c5c591U, 0x50303060U, 0x03010102U, 0xa96767ceU, 0x7d2b2b56U,
+  0x19fefee7U, 0x62d7d7b5U, 0xe6abab4dU, 0x9a7676ecU, 0x45caca8fU, 0x9d82821fU,
+  0x40c9c989U, 0x877d7dfaU, 0x15fafaefU, 0xeb5959b2U, 0xc947478eU, 0x0bf0f0fbU,
+  0xecadad41U, 0x67d4d4b3U, 0xfda2a25fU, 0xeaafaf45U, 0xbf9c9c23U, 0xf7a4a453U,
+  0x967272e4U, 0x5bc0c09bU, 0xc2b7b775U, 0x1cfdfde1U, 0xae93933dU, 0x6a26264cU,
+  0x5a36366cU, 0x413f3f7eU, 0x02f7f7f5U, 0x4fcccc83U, 0x5c343468U, 0xf4a5a551U,
+  0x34e5e5d1U, 0x08f1f1f9U, 0x937171e2U, 0x73d8d8abU, 0x53313162U, 0x3f15152aU,
+  0x0c040408U, 0x52c7c795U, 0x65232346U, 0x5ec3c39dU, 0x28181830U, 0xa1969637U,
+  0x0f05050aU, 0xb59a9a2fU, 0x0907070eU, 0x36121224U, 0x9b80801bU, 0x3de2e2dfU,
+  0x26ebebcdU, 0x6927274eU, 0xcdb2b27fU, 0x9f7575eaU, 0x1b090912U, 0x9e83831dU,
+  0x742c2c58U, 0x2e1a1a34U, 0x2d1b1b36U, 0xb26e6edcU, 0xee5a5ab4U, 0xfba0a05bU,
+  0xf65252a4U, 0x4d3b3b76U, 0x61d6d6b7U, 0xceb3b37dU, 0x7b292952U, 0x3ee3e3ddU,
+  0x712f2f5eU, 0x97848413U, 0xf55353a6U, 0x68d1d1b9U, 0x00000000U, 0x2cededc1U,
+  0x60202040U, 0x1ffcfce3U, 0xc8b1b179U, 0xed5b5bb6U, 0xbe6a6ad4U, 0x46cbcb8dU,
+  0xd9bebe67U, 0x4b393972U, 0xde4a4a94U, 0xd44c4c98U, 0xe85858b0U, 0x4acfcf85U,
+  0x6bd0d0bbU, 0x2aefefc5U, 0xe5aaaa4fU, 0x16fbfbedU, 0xc5434386U, 0xd74d4d9aU,
+  0x55333366U, 0x94858511U, 0xcf45458aU, 0x10f9f9e9U, 0x06020204U, 0x817f7ffeU,
+  0xf05050a0U, 0x443c3c78U, 0xba9f9f25U, 0xe3a8a84bU, 0xf35151a2U, 0xfea3a35dU,
+  0xc0404080U, 0x8a8f8f05U, 0xad92923fU, 0xbc9d9d21U, 0x48383870U, 0x04f5f5f1U,
+  0xdfbcbc63U, 0xc1b6b677U, 0x75dadaafU, 0x63212142U, 0x30101020U, 0x1affffe5U,
+  0x0ef3f3fdU, 0x6dd2d2bfU, 0x4ccdcd81U, 0x140c0c18U, 0x35131326U, 0x2fececc3U,
+  0xe15f5fbeU, 0xa2979735U, 0xcc444488U, 0x3917172eU, 0x57c4c493U, 0xf2a7a755U,
+  0x827e7efcU, 0x473d3d7aU, 0xac6464c8U, 0xe75d5dbaU, 0x2b191932U, 0x957373e6U,
+  0xa06060c0U, 0x98818119U, 0xd14f4f9eU, 0x7fdcdca3U, 0x66222244U, 0x7e2a2a54U,
+  0xab90903bU, 0x8388880bU, 0xca46468cU, 0x29eeeec7U, 0xd3b8b86bU, 0x3c141428U,
+  0x79dedea7U, 0xe25e5ebcU, 0x1d0b0b16U, 0x76dbdbadU, 0x3be0e0dbU, 0x56323264U,
+  0x4e3a3a74U, 0x1e0a0a14U, 0xdb494992U, 0x0a06060cU, 0x6c242448U, 0xe45c5cb8U,
+  0x5dc2c29fU, 0x6ed3d3bdU, 0xefacac43U, 0xa66262c4U, 0xa8919139U, 0xa4959531U,
+  0x37e4e4d3U, 0x8b7979f2U, 0x32e7e7d5U, 0x43c8c88bU, 0x5937376eU, 0xb76d6ddaU,
+  0x8c8d8d01U, 0x64d5d5b1U, 0xd24e4e9cU, 0xe0a9a949U, 0xb46c6cd8U, 0xfa5656acU,
+  0x07f4f4f3U, 0x25eaeacfU, 0xaf6565caU, 0x8e7a7af4U, 0xe9aeae47U, 0x18080810U,
+  0xd5baba6fU, 0x887878f0U, 0x6f25254aU, 0x722e2e5cU, 0x241c1c38U, 0xf1a6a657U,
+  0xc7b4b473U, 0x51c6c697U, 0x23e8e8cbU, 0x7cdddda1U, 0x9c7474e8U, 0x211f1f3eU,
+  0xdd4b4b96U, 0xdcbdbd61U, 0x868b8b0dU, 0x858a8a0fU, 0x907070e0U, 0x423e3e7cU,
+  0xc4b5b571U, 0xaa6666ccU, 0xd8484890U, 0x05030306U, 0x01f6f6f7U, 0x120e0e1cU,
+  0xa36161c2U, 0x5f35356aU, 0xf95757aeU, 0xd0b9b969U, 0x91868617U, 0x58c1c199U,
+  0x271d1d3aU, 0xb99e9e27U, 0x38e1e1d9U, 0x13f8f8ebU, 0xb398982bU, 0x33111122U,
+  0xbb6969d2U, 0x70d9d9a9U, 0x898e8e07U, 0xa7949433U, 0xb69b9b2dU, 0x221e1e3cU,
+  0x92878715U, 0x20e9e9c9U, 0x49cece87U, 0xff5555aaU, 0x78282850U, 0x7adfdfa5U,
+  0x8f8c8c03U, 0xf8a1a159U, 0x80898909U, 0x170d0d1aU, 0xdabfbf65U, 0x31e6e6d7U,
+  0xc6424284U, 0xb86868d0U, 0xc3414182U, 0xb0999929U, 0x772d2d5aU, 0x110f0f1eU,
+  0xcbb0b07bU, 0xfc5454a8U, 0xd6bbbb6dU, 0x3a16162cU
+};
+
+//
+// Decryption T-table: Td0[x] = {0e, 09, 0d, 0b} * RsBox[x] as a little endian column.
+// Tables for rows 1-3 are obtained by rotating this one by 8, 16 and 24 bits.
+//
+STATIC CONST UINT32 Td0[256] = {
+  0x50a7f451U, 0x5365417eU, 0xc3a4171aU, 0x965e273aU, 0xcb6bab3bU, 0xf1459d1fU,
+  0xab58faacU, 0x9303e34bU, 0x55fa3020U, 0xf66d76adU, 0x9176cc88U, 0x254c02f5U,
+  0xfcd7e54fU, 0xd7cb2ac5U, 0x80443526U, 0x8fa362b5U, 0x495ab1deU, 0x671bba25U,
+  0x980eea45U, 0xe1c0fe5dU, 0x02752fc3U, 0x12f04c81U, 0xa397468dU, 0xc6f9d36bU,
+  0xe75f8f03U, 0x959c9215U, 0xeb7a6dbfU, 0xda595295U, 0x2d83bed4U, 0xd3217458U,
+  0x2969e049U, 0x44c8c98eU, 0x6a89c275U, 0x78798ef4U, 0x6b3e5899U, 0xdd71b927U,
+  0xb64fe1beU, 0x17ad88f0U, 0x66ac20c9U, 0xb43ace7dU, 0x184adf63U, 0x82311ae5U,
+  0x60335197U, 0x457f5362U, 0xe07764b1U, 0x84ae6bbbU, 0x1ca081feU, 0x942b08f9U,
+  0x58684870U, 0x19fd458fU, 0x876cde94U, 0xb7f87b52U, 0x23d373abU, 0xe2024b72U,
+  0x578f1fe3U, 0x2aab5566U, 0x0728ebb2U, 0x03c2b52fU, 0x9a7bc586U, 0xa50837d3U,
+  0xf2872830U, 0xb2a5bf23U, 0xba6a0302U, 0x5c8216edU, 0x2b1ccf8aU, 0x92b479a7U,
+  0xf0f207f3U, 0xa1e2694eU, 0xcdf4da65U, 0xd5be0506U, 0x1f6234d1U, 0x8afea6c4U,
+  0x9d532e34U, 0xa055f3a2U, 0x32e18a05U, 0x75ebf6a4U, 0x39ec830bU, 0xaaef6040U,
+  0x069f715eU, 0x51106ebdU, 0xf98a213eU, 0x3d06dd96U, 0xae053eddU, 0x46bde64dU,
+  0xb58d5491U, 0x055dc471U, 0x6fd40604U, 0xff155060U, 0x24fb9819U, 0x97e9bdd6U,
+  0xcc434089U, 0x779ed967U, 0xbd42e8b0U, 0x888b8907U, 0x385b19e7U, 0xdbeec879U,
+  0x470a7ca1U, 0xe90f427cU, 0xc91e84f8U, 0x00000000U, 0x83868009U, 0x48ed2b32U,
+  0xac70111eU, 0x4e725a6cU, 0xfbff0efdU, 0x5638850fU, 0x1ed5ae3dU, 0x27392d36U,
+  0x64d90f0aU, 0x21a65c68U, 0xd1545b9bU, 0x3a2e3624U, 0xb1670a0cU, 0x0fe75793U,
+  0xd296eeb4U, 0x9e919b1bU, 0x4fc5c080U, 0xa220dc61U, 0x694b775aU, 0x161a121cU,
+  0x0aba93e2U, 0xe52aa0c0U, 0x43e0223cU, 0x1d171b12U, 0x0b0d090eU, 0xadc78bf2U,
+  0xb9a8b62dU, 0xc8a91e14U, 0x8519f157U, 0x4c0775afU, 0xbbdd99eeU, 0xfd607fa3U,
+  0x9f2601f7U, 0xbcf5725cU, 0xc53b6644U, 0x347efb5bU, 0x7629438bU, 0xdcc623cbU,
+  0x68fcedb6U, 0x63f1e4b8U, 0xcadc31d7U, 0x10856342U, 0x40229713U, 0x2011c684U,
+  0x7d244a85U, 0xf83dbbd2U, 0x1132f9aeU, 0x6da129c7U, 0x4b2f9e1dU, 0xf330b2dcU,
+  0xec52860dU, 0xd0e3c177U, 0x6c16b32bU, 0x99b970a9U, 0xfa489411U, 0x2264e947U,
+  0xc48cfca8U, 0x1a3ff0a0U, 0xd82c7d56U, 0xef903322U, 0xc74e4987U, 0xc1d138d9U,
+  0xfea2ca8cU, 0x360bd498U, 0xcf81f5a6U, 0x28de7aa5U, 0x268eb7daU, 0xa4bfad3fU,
+  0xe49d3a2cU, 0x0d927850U, 0x9bcc5f6aU, 0x62467e54U, 0xc2138df6U, 0xe8b8d890U,
+  0x5ef7392eU, 0xf5afc382U, 0xbe805d9fU, 0x7c93d069U, 0xa92dd56fU, 0xb31225cfU,
+  0x3b99acc8U, 0xa77d1810U, 0x6e639ce8U, 0x7bbb3bdbU, 0x097826cdU, 0xf418596eU,
+  0x01b79aecU, 0xa89a4f83U, 0x656e95e6U, 0x7ee6ffaaU, 0x08cfbc21U, 0xe6e815efU,
+  0xd99be7baU, 0xce366f4aU, 0xd4099feaU, 0xd67cb029U, 0xafb2a431U, 0x31233f2aU,
+  0x3094a5c6U, 0xc066a235U, 0x37bc4e74U, 0xa6ca82fcU, 0xb0d090e0U, 0x15d8a733U,
+  0x4a9804f1U, 0xf7daec41U, 0x0e50cd7fU, 0x2ff69117U, 0x8dd64d76U, 0x4db0ef43U,
+  0x544daaccU, 0xdf0496e4U, 0xe3b5d19eU, 0x1b886a4cU, 0xb81f2cc1U, 0x7f516546U,
+  0x04ea5e9dU, 0x5d358c01U, 0x737487faU, 0x2e410bfbU, 0x5a1d67b3U, 0x52d2db92U,
+  0x335610e9U, 0x1347d66dU, 0x8c61d79aU, 0x7a0ca137U, 0x8e14f859U, 0x893c13ebU,
+  0xee27a9ceU, 0x35c961b7U, 0xede51ce1U, 0x3cb1477aU, 0x59dfd29cU, 0x3f73f255U,
+  0x79ce1418U, 0xbf37c773U, 0xeacdf753U, 0x5baafd5fU, 0x146f3ddfU, 0x86db4478U,
+  0x81f3afcaU, 0x3ec468b9U, 0x2c342438U, 0x5f40a3c2U, 0x72c31d16U, 0x0c25e2bcU,
+  0x8b493c28U, 0x41950dffU, 0x7101a839U, 0xdeb30c08U, 0x9ce4b4d8U, 0x90c15664U,
+  0x6184cb7bU, 0x70b632d5U, 0x745c6c48U, 0x4257b8d0U
+};
+
 //
 // Private functions:
 //
@@ -257,346 +386,257 @@ KeyExpansion (
   }
 }
 
-VOID
-AesInitCtxIv (
-  AES_CONTEXT  *Context,
-  CONST UINT8  *Key,
-  CONST UINT8  *Iv
-  )
-{
-  KeyExpansion (Context->RoundKey, Key);
-  CopyMem (Context->Iv, Iv, AES_BLOCK_SIZE);
-}
-
-VOID
-AesCtxSetIv (
-  AES_CONTEXT  *Context,
-  CONST UINT8  *Iv
-  )
-{
-  CopyMem (Context->Iv, Iv, AES_BLOCK_SIZE);
-}
 
 //
-// This function adds the round key to state.
-// The round key is added to the state by an XOR function.
+// Expands byte round keys into little endian column words and derives
+// the round keys for the equivalent inverse cipher.
 //
 STATIC
 VOID
-AddRoundKey (
-  UINT8               Round,
-  AES_INTERNAL_STATE  *State,
-  CONST UINT8         *RoundKey
+WordKeyExpansion (
+  UINT32       *EncRoundKey,
+  UINT32       *DecRoundKey,
+  CONST UINT8  *RoundKey
   )
 {
-  UINT8  I, J;
+  UINT32  Index;
+  UINT32  Round;
+  UINT32  Word;
 
-  for (I = 0; I < 4; ++I)
-  {
-    for (J = 0; J < 4; ++J)
-    {
-      (*State)[I][J] ^= RoundKey[(Round * Nb * 4) + (I * Nb) + J];
-    }
+  for (Index = 0; Index < Nb * (Nr + 1); ++Index) {
+    EncRoundKey[Index] = AES_LOAD32 (&RoundKey[Index * 4]);
   }
-}
-
-//
-// The SubBytes Function Substitutes the values in the
-// state matrix with values in an S-box.
-//
-STATIC 
-VOID
-SubBytes (
-  AES_INTERNAL_STATE  *State
-  )
-{
-  UINT8  I, J;
-
-  for (I = 0; I < 4; ++I)
-  {
-    for (J = 0; J < 4; ++J)
-    {
-      (*State)[J][I] = GetSboxValue((*State)[J][I]);
-    }
-  }
-}
-
-//
-// The ShiftRows() function shifts the rows in the state to the left.
-// Each row is shifted with different offset.
-// Offset = Row number. So the first row is not shifted.
-//
-STATIC 
-VOID
-ShiftRows (
-  AES_INTERNAL_STATE  *State
-  )
-{
-  UINT8  Temp;
 
   //
-  // Rotate first row 1 columns to left
+  // Decryption uses encryption round keys in reverse order, and all but
+  // the first and the last have InvMixColumns applied to them.
   //
-  Temp           = (*State)[0][1];
-  (*State)[0][1] = (*State)[1][1];
-  (*State)[1][1] = (*State)[2][1];
-  (*State)[2][1] = (*State)[3][1];
-  (*State)[3][1] = Temp;
-
-  //
-  // Rotate second row 2 columns to left
-  //
-  Temp           = (*State)[0][2];
-  (*State)[0][2] = (*State)[2][2];
-  (*State)[2][2] = Temp;
-
-  Temp           = (*State)[1][2];
-  (*State)[1][2] = (*State)[3][2];
-  (*State)[3][2] = Temp;
-
-  //
-  // Rotate third row 3 columns to left
-  //
-  Temp           = (*State)[0][3];
-  (*State)[0][3] = (*State)[3][3];
-  (*State)[3][3] = (*State)[2][3];
-  (*State)[2][3] = (*State)[1][3];
-  (*State)[1][3] = Temp;
-}
-
-STATIC 
-UINT8
-XTime (
-  UINT8 X
-  )
-{
-  return (UINT8) (((UINT32) X << 1u) ^ ((((UINT32) X >> 7u) & 1u) * 0x1bu));
-}
-
-//
-// MixColumns function mixes the columns of the state matrix
-//
-STATIC 
-VOID
-MixColumns (
-  AES_INTERNAL_STATE  *State
-  )
-{
-  UINT8  I, Tmp, Tm, T;
-
-  for (I = 0; I < 4; ++I)
-  {
-    T   = (*State)[I][0];
-    Tmp = (UINT8) ((UINT32) ((*State) [I][0]) ^ (UINT32) ((*State) [I][1])
-          ^ (UINT32) ((*State) [I][2]) ^ (UINT32) ((*State) [I][3]));
-    Tm  = (*State) [I][0] ^ (*State) [I][1];
-    Tm = XTime (Tm);
-    (*State) [I][0] ^= Tm ^ Tmp;
-    Tm  = (*State)[I][1] ^ (*State)[I][2];
-    Tm = XTime (Tm);
-    (*State) [I][1] ^= Tm ^ Tmp;
-    Tm  = (*State) [I][2] ^ (*State) [I][3];
-    Tm = XTime (Tm);
-    (*State) [I][2] ^= Tm ^ Tmp;
-    Tm  = (*State)[I][3] ^ T ;
-    Tm = XTime (Tm);
-    (*State) [I][3] ^= Tm ^ Tmp ;
+  for (Index = 0; Index < Nb; ++Index) {
+    DecRoundKey[Index]           = EncRoundKey[Nr * Nb + Index];
+    DecRoundKey[Nr * Nb + Index] = EncRoundKey[Index];
   }
-}
 
-//
-// Multiply is used to multiply numbers in the field GF(2^8)
-// Note: The last call to XTime() is unneeded, but often ends up generating a smaller binary
-//       The compiler seems to be able to vectorize the operation better this way.
-//       See https://github.com/kokke/tiny-AES-c/pull/34
-//
-#define Multiply(x, y)                                    \
-      (   (((y) & 1u) * (x)) ^                            \
-      (((y)>>1u & 1u) * XTime(x)) ^                       \
-      (((y)>>2u & 1u) * XTime(XTime(x))) ^                \
-      (((y)>>3u & 1u) * XTime(XTime(XTime(x)))) ^         \
-      (((y)>>4u & 1u) * XTime(XTime(XTime(XTime(x))))))   \
-
-//
-// MixColumns function mixes the columns of the state matrix.
-// The method used to multiply may be difficult to understand for the inexperienced.
-// Please use the references to gain more information.
-//
-STATIC 
-VOID
-InvMixColumns (
-  AES_INTERNAL_STATE  *State
-  )
-{
-  UINT8  I, A, B, C, D;
-
-  for (I = 0; I < 4; ++I)
-  {
-    A = (*State) [I][0];
-    B = (*State) [I][1];
-    C = (*State) [I][2];
-    D = (*State) [I][3];
-
-    (*State)[I][0] = (UINT8) ((UINT32) Multiply(A, 0x0eu) ^ (UINT32) Multiply(B, 0x0bu)
-                     ^ (UINT32) Multiply(C, 0x0du) ^ (UINT32) Multiply(D, 0x09u));
-    (*State)[I][1] = (UINT8) ((UINT32) Multiply(A, 0x09u) ^ (UINT32) Multiply(B, 0x0eu)
-                     ^ (UINT32) Multiply(C, 0x0bu) ^ (UINT32) Multiply(D, 0x0du));
-    (*State)[I][2] = (UINT8) ((UINT32) Multiply(A, 0x0du) ^ (UINT32) Multiply(B, 0x09u)
-                     ^ (UINT32) Multiply(C, 0x0eu) ^ (UINT32) Multiply(D, 0x0bu));
-    (*State)[I][3] = (UINT8) ((UINT32) Multiply(A, 0x0bu) ^ (UINT32) Multiply(B, 0x0du)
-                     ^ (UINT32) Multiply(C, 0x09u) ^ (UINT32) Multiply(D, 0x0eu));
+  for (Round = 1; Round < Nr; ++Round) {
+    for (Index = 0; Index < Nb; ++Index) {
+      Word = EncRoundKey[(Nr - Round) * Nb + Index];
+      DecRoundKey[Round * Nb + Index] =
+        Td0[GetSboxValue (AES_BYTE0 (Word))]
+        ^ AES_ROTL8 (Td0[GetSboxValue (AES_BYTE1 (Word))])
+        ^ AES_ROTL16 (Td0[GetSboxValue (AES_BYTE2 (Word))])
+        ^ AES_ROTL24 (Td0[GetSboxValue (AES_BYTE3 (Word))]);
+    }
   }
 }
 
-//
-// The SubBytes Function Substitutes the values in the
-// state matrix with values in an S-box.
-//
-STATIC
 VOID
-InvSubBytes (
-  AES_INTERNAL_STATE  *State
+AesInitCtxIv (
+  AES_CONTEXT  *Context,
+  CONST UINT8  *Key,
+  CONST UINT8  *Iv
   )
 {
-  UINT8  I, J;
-
-  for (I = 0; I < 4; ++I)
-  {
-    for (J = 0; J < 4; ++J)
-    {
-      (*State)[J][I] = GetSBoxInvert ((*State)[J][I]);
-    }
-  }
+  KeyExpansion (Context->RoundKey, Key);
+  WordKeyExpansion (Context->EncRoundKey, Context->DecRoundKey, Context->RoundKey);
+  CopyMem (Context->Iv, Iv, AES_BLOCK_SIZE);
 }
 
-STATIC
 VOID
-InvShiftRows (
-  AES_INTERNAL_STATE  *State
+AesCtxSetIv (
+  AES_CONTEXT  *Context,
+  CONST UINT8  *Iv
   )
 {
-  UINT8  Temp;
-
-  //
-  // Rotate first row 1 columns to right
-  //
-  Temp = (*State)[3][1];
-  (*State)[3][1] = (*State)[2][1];
-  (*State)[2][1] = (*State)[1][1];
-  (*State)[1][1] = (*State)[0][1];
-  (*State)[0][1] = Temp;
-
-  //
-  // Rotate second row 2 columns to right
-  //
-  Temp = (*State)[0][2];
-  (*State)[0][2] = (*State)[2][2];
-  (*State)[2][2] = Temp;
-
-  Temp = (*State)[1][2];
-  (*State)[1][2] = (*State)[3][2];
-  (*State)[3][2] = Temp;
-
-  //
-  // Rotate third row 3 columns to right
-  //
-  Temp = (*State)[0][3];
-  (*State)[0][3] = (*State)[1][3];
-  (*State)[1][3] = (*State)[2][3];
-  (*State)[2][3] = (*State)[3][3];
-  (*State)[3][3] = Temp;
+  CopyMem (Context->Iv, Iv, AES_BLOCK_SIZE);
 }
 
 //
 // Cipher is the main function that encrypts the PlainText.
+// State is made of 4 column words, round keys are EncRoundKey words.
 //
 STATIC
 VOID
 Cipher (
-  AES_INTERNAL_STATE  *State,
-  UINT8               *RoundKey
+  UINT32        *State,
+  CONST UINT32  *RoundKey
   )
 {
-  UINT8  Round;
+  UINT32  Round;
+  UINT32  S0, S1, S2, S3;
+  UINT32  T0, T1, T2, T3;
 
   //
   // Add the First round key to the state before starting the rounds.
   //
-  AddRoundKey(0, State, RoundKey);
+  S0 = State[0] ^ RoundKey[0];
+  S1 = State[1] ^ RoundKey[1];
+  S2 = State[2] ^ RoundKey[2];
+  S3 = State[3] ^ RoundKey[3];
 
   //
   // There will be Nr rounds.
-  // The first Nr-1 rounds are identical.
-  // These Nr-1 rounds are executed in the loop below.
-  //
-  for (Round = 1; Round < Nr; ++Round)
-  {
-    SubBytes (State);
-    ShiftRows (State);
-    MixColumns (State);
-    AddRoundKey (Round, State, RoundKey);
+  // The first Nr-1 rounds perform SubBytes, ShiftRows and MixColumns
+  // through T-table lookups, followed by AddRoundKey.
+  //
+  for (Round = 1; Round < Nr; ++Round) {
+    RoundKey += Nb;
+
+    T0 = Te0[AES_BYTE0 (S0)] ^ AES_ROTL8 (Te0[AES_BYTE1 (S1)])
+      ^ AES_ROTL16 (Te0[AES_BYTE2 (S2)]) ^ AES_ROTL24 (Te0[AES_BYTE3 (S3)]) ^ RoundKey[0];
+    T1 = Te0[AES_BYTE0 (S1)] ^ AES_ROTL8 (Te0[AES_BYTE1 (S2)])
+      ^ AES_ROTL16 (Te0[AES_BYTE2 (S3)]) ^ AES_ROTL24 (Te0[AES_BYTE3 (S0)]) ^ RoundKey[1];
+    T2 = Te0[AES_BYTE0 (S2)] ^ AES_ROTL8 (Te0[AES_BYTE1 (S3)])
+      ^ AES_ROTL16 (Te0[AES_BYTE2 (S0)]) ^ AES_ROTL24 (Te0[AES_BYTE3 (S1)]) ^ RoundKey[2];
+    T3 = Te0[AES_BYTE0 (S3)] ^ AES_ROTL8 (Te0[AES_BYTE1 (S0)])
+      ^ AES_ROTL16 (Te0[AES_BYTE2 (S1)]) ^ AES_ROTL24 (Te0[AES_BYTE3 (S2)]) ^ RoundKey[3];
+
+    S0 = T0;
+    S1 = T1;
+    S2 = T2;
+    S3 = T3;
   }
 
   //
   // The last round is given below.
   // The MixColumns function is not here in the last round.
   //
-  SubBytes (State);
-  ShiftRows (State);
-  AddRoundKey (Nr, State, RoundKey);
+  RoundKey += Nb;
+
+  State[0] = ((UINT32) GetSboxValue (AES_BYTE0 (S0))
+    | ((UINT32) GetSboxValue (AES_BYTE1 (S1)) << 8U)
+    | ((UINT32) GetSboxValue (AES_BYTE2 (S2)) << 16U)
+    | ((UINT32) GetSboxValue (AES_BYTE3 (S3)) << 24U)) ^ RoundKey[0];
+  State[1] = ((UINT32) GetSboxValue (AES_BYTE0 (S1))
+    | ((UINT32) GetSboxValue (AES_BYTE1 (S2)) << 8U)
+    | ((UINT32) GetSboxValue (AES_BYTE2 (S3)) << 16U)
+    | ((UINT32) GetSboxValue (AES_BYTE3 (S0)) << 24U)) ^ RoundKey[1];
+  State[2] = ((UINT32) GetSboxValue (AES_BYTE0 (S2))
+    | ((UINT32) GetSboxValue (AES_BYTE1 (S3)) << 8U)
+    | ((UINT32) GetSboxValue (AES_BYTE2 (S0)) << 16U)
+    | ((UINT32) GetSboxValue (AES_BYTE3 (S1)) << 24U)) ^ RoundKey[2];
+  State[3] = ((UINT32) GetSboxValue (AES_BYTE0 (S3))
+    | ((UINT32) GetSboxValue (AES_BYTE1 (S0)) << 8U)
+    | ((UINT32) GetSboxValue (AES_BYTE2 (S1)) << 16U)
+    | ((UINT32) GetSboxValue (AES_BYTE3 (S2)) << 24U)) ^ RoundKey[3];
 }
 
+//
+// InvCipher decrypts the CipherText with the equivalent inverse cipher.
+// State is made of 4 column words, round keys are DecRoundKey words.
+//
 STATIC
 VOID
 InvCipher (
-  AES_INTERNAL_STATE  *State,
-  UINT8               *RoundKey
+  UINT32        *State,
+  CONST UINT32  *RoundKey
   )
 {
-  UINT8  Round;
+  UINT32  Round;
+  UINT32  S0, S1, S2, S3;
+  UINT32  T0, T1, T2, T3;
 
   //
   // Add the First round key to the state before starting the rounds.
   //
-  AddRoundKey (Nr, State, RoundKey);
+  S0 = State[0] ^ RoundKey[0];
+  S1 = State[1] ^ RoundKey[1];
+  S2 = State[2] ^ RoundKey[2];
+  S3 = State[3] ^ RoundKey[3];
 
   //
   // There will be Nr rounds.
-  // The first Nr-1 rounds are identical.
-  // These Nr-1 rounds are executed in the loop below.
-  //
-  for (Round = (Nr - 1); Round > 0; --Round)
-  {
-    InvShiftRows (State);
-    InvSubBytes (State);
-    AddRoundKey (Round, State, RoundKey);
-    InvMixColumns (State);
+  // The first Nr-1 rounds perform InvShiftRows, InvSubBytes and InvMixColumns
+  // through T-table lookups, followed by AddRoundKey with pre-mixed keys.
+  //
+  for (Round = 1; Round < Nr; ++Round) {
+    RoundKey += Nb;
+
+    T0 = Td0[AES_BYTE0 (S0)] ^ AES_ROTL8 (Td0[AES_BYTE1 (S3)])
+      ^ AES_ROTL16 (Td0[AES_BYTE2 (S2)]) ^ AES_ROTL24 (Td0[AES_BYTE3 (S1)]) ^ RoundKey[0];
+    T1 = Td0[AES_BYTE0 (S1)] ^ AES_ROTL8 (Td0[AES_BYTE1 (S0)])
+      ^ AES_ROTL16 (Td0[AES_BYTE2 (S3)]) ^ AES_ROTL24 (Td0[AES_BYTE3 (S2)]) ^ RoundKey[1];
+    T2 = Td0[AES_BYTE0 (S2)] ^ AES_ROTL8 (Td0[AES_BYTE1 (S1)])
+      ^ AES_ROTL16 (Td0[AES_BYTE2 (S0)]) ^ AES_ROTL24 (Td0[AES_BYTE3 (S3)]) ^ RoundKey[2];
+    T3 = Td0[AES_BYTE0 (S3)] ^ AES_ROTL8 (Td0[AES_BYTE1 (S2)])
+      ^ AES_ROTL16 (Td0[AES_BYTE2 (S1)]) ^ AES_ROTL24 (Td0[AES_BYTE3 (S0)]) ^ RoundKey[3];
+
+    S0 = T0;
+    S1 = T1;
+    S2 = T2;
+    S3 = T3;
   }
 
   //
   // The last round is given below.
-  // The MixColumns function is not here in the last round.
-  //
-  InvShiftRows (State);
-  InvSubBytes (State);
-  AddRoundKey (0, State, RoundKey);
+  // The InvMixColumns function is not here in the last round.
+  //
+  RoundKey += Nb;
+
+  State[0] = ((UINT32) GetSBoxInvert (AES_BYTE0 (S0))
+    | ((UINT32) GetSBoxInvert (AES_BYTE1 (S3)) << 8U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE2 (S2)) << 16U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE3 (S1)) << 24U)) ^ RoundKey[0];
+  State[1] = ((UINT32) GetSBoxInvert (AES_BYTE0 (S1))
+    | ((UINT32) GetSBoxInvert (AES_BYTE1 (S0)) << 8U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE2 (S3)) << 16U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE3 (S2)) << 24U)) ^ RoundKey[1];
+  State[2] = ((UINT32) GetSBoxInvert (AES_BYTE0 (S2))
+    | ((UINT32) GetSBoxInvert (AES_BYTE1 (S1)) << 8U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE2 (S0)) << 16U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE3 (S3)) << 24U)) ^ RoundKey[2];
+  State[3] = ((UINT32) GetSBoxInvert (AES_BYTE0 (S3))
+    | ((UINT32) GetSBoxInvert (AES_BYTE1 (S2)) << 8U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE2 (S1)) << 16U)
+    | ((UINT32) GetSBoxInvert (AES_BYTE3 (S0)) << 24U)) ^ RoundKey[3];
 }
 
 STATIC
 VOID
-XorWithIv (
-  UINT8       *Buf,
-  CONST UINT8 *Iv
+LoadBlock (
+  UINT32       *State,
+  CONST UINT8  *Buf
   )
 {
-  UINT8  I;
+  State[0] = AES_LOAD32 (&Buf[0]);
+  State[1] = AES_LOAD32 (&Buf[4]);
+  State[2] = AES_LOAD32 (&Buf[8]);
+  State[3] = AES_LOAD32 (&Buf[12]);
+}
 
-  //
-  // The block in AES is always 128bit no matter the key size
-  //
-  for (I = 0; I < AES_BLOCK_SIZE; ++I)
-  {
-    Buf[I] ^= Iv[I];
+STATIC
+VOID
+StoreBlock (
+  UINT8         *Buf,
+  CONST UINT32  *State
+  )
+{
+  AES_STORE32 (&Buf[0], State[0]);
+  AES_STORE32 (&Buf[4], State[1]);
+  AES_STORE32 (&Buf[8], State[2]);
+  AES_STORE32 (&Buf[12], State[3]);
+}
+
+//
+// Increments big endian counter block.
+//
+STATIC
+VOID
+IncrementCounter (
+  UINT8  *Counter
+  )
+{
+  INT32  Index;
+
+  for (Index = AES_BLOCK_SIZE - 1; Index >= 0; --Index) {
+    //
+    // Inc will owerflow
+    //
+    if (Counter[Index] == 255) {
+      Counter[Index] = 0;
+      continue;
+    }
+
+    Counter[Index] += 1;
+    break;
   }
 }
 
@@ -612,20 +652,27 @@ AesCbcEncryptBuffer (
   )
 {
   UINT32  I;
-  UINT8   *Iv = Context->Iv;
-
-  for (I = 0; I < Len; I += AES_BLOCK_SIZE)
-  {
-    XorWithIv (Data, Iv);
-    Cipher ((AES_INTERNAL_STATE *) Data, Context->RoundKey);
-    Iv = Data;
+  UINT32  State[Nb];
+  UINT32  Iv[Nb];
+
+  LoadBlock (Iv, Context->Iv);
+
+  for (I = 0; I < Len; I += AES_BLOCK_SIZE) {
+    LoadBlock (State, Data);
+    State[0] ^= Iv[0];
+    State[1] ^= Iv[1];
+    State[2] ^= Iv[2];
+    State[3] ^= Iv[3];
+    Cipher (State, Context->EncRoundKey);
+    StoreBlock (Data, State);
+    CopyMem (Iv, State, sizeof (Iv));
     Data += AES_BLOCK_SIZE;
   }
 
   //
   // Store Iv in Context for next call
   //
-  CopyMem (Context->Iv, Iv, AES_BLOCK_SIZE);
+  StoreBlock (Context->Iv, Iv);
 }
 
 VOID
@@ -636,17 +683,44 @@ AesCbcDecryptBuffer (
   )
 {
   UINT32  I;
-  UINT8   StoreNextIv[AES_BLOCK_SIZE];
+  UINT32  Block;
+  UINT32  Blocks;
+  UINT32  State[AES_BULK_BLOCKS][Nb];
+  UINT32  Prev[AES_BULK_BLOCKS + 1][Nb];
 
-  for (I = 0; I < Len; I += AES_BLOCK_SIZE)
-  {
-    CopyMem (StoreNextIv, Data, AES_BLOCK_SIZE);
-    InvCipher ((AES_INTERNAL_STATE *) Data, Context->RoundKey);
-    XorWithIv (Data, Context->Iv);
-    CopyMem (Context->Iv, StoreNextIv, AES_BLOCK_SIZE);
-    Data += AES_BLOCK_SIZE;
+  LoadBlock (Prev[0], Context->Iv);
+
+  for (I = 0; I < Len; I += Blocks * AES_BLOCK_SIZE) {
+    //
+    // Blocks are decrypted independently, so process several of them
+    // at once and chain them afterwards to save the in-place copies.
+    //
+    Blocks = (Len - I) / AES_BLOCK_SIZE;
+    if (Blocks > AES_BULK_BLOCKS) {
+      Blocks = AES_BULK_BLOCKS;
+    } else if (Blocks == 0) {
+      break;
+    }
+
+    for (Block = 0; Block < Blocks; ++Block) {
+      LoadBlock (Prev[Block + 1], &Data[Block * AES_BLOCK_SIZE]);
+      CopyMem (State[Block], Prev[Block + 1], sizeof (State[Block]));
+      InvCipher (State[Block], Context->DecRoundKey);
+    }
+
+    for (Block = 0; Block < Blocks; ++Block) {
+      State[Block][0] ^= Prev[Block][0];
+      State[Block][1] ^= Prev[Block][1];
+      State[Block][2] ^= Prev[Block][2];
+      State[Block][3] ^= Prev[Block][3];
+      StoreBlock (&Data[Block * AES_BLOCK_SIZE], State[Block]);
+    }
+
+    CopyMem (Prev[0], Prev[Blocks], sizeof (Prev[0]));
+    Data += Blocks * AES_BLOCK_SIZE;
   }
 
+  StoreBlock (Context->Iv, Prev[0]);
 }
 
 //
@@ -660,42 +734,44 @@ AesCtrXcryptBuffer (
   UINT32       Len
   )
 {
-  UINT8  Buffer[AES_BLOCK_SIZE];
-  UINT32 I;
-  INT32  Bi;
+  UINT32  Stream[AES_BULK_BLOCKS * Nb];
+  UINT32  Size;
+  UINT32  Index;
+  UINT32  Word;
+  UINT8   Buffer[AES_BLOCK_SIZE];
 
-  for (I = 0, Bi = AES_BLOCK_SIZE; I < Len; ++I, ++Bi)
-  {
+  while (Len > 0) {
     //
-    // We need to regen xor compliment in buffer
+    // Generate keystream for several counter values at once.
     //
-    if (Bi == AES_BLOCK_SIZE)
-    {
+    for (Index = 0; Index < AES_BULK_BLOCKS && Index * AES_BLOCK_SIZE < Len; ++Index) {
+      LoadBlock (&Stream[Index * Nb], Context->Iv);
+      Cipher (&Stream[Index * Nb], Context->EncRoundKey);
+      IncrementCounter (Context->Iv);
+    }
 
-      CopyMem (Buffer, Context->Iv, AES_BLOCK_SIZE);
-      Cipher ((AES_INTERNAL_STATE *) Buffer, Context->RoundKey);
+    Size = Index * AES_BLOCK_SIZE;
+    if (Size > Len) {
+      Size = Len;
+    }
 
-      //
-      // Increment Iv and handle overflow
-      //
-      for (Bi = (AES_BLOCK_SIZE - 1); Bi >= 0; --Bi)
-      {
-        //
-        // Inc will owerflow
-        //
-        if (Context->Iv[Bi] == 255)
-        {
-          Context->Iv[Bi] = 0;
-          continue;
-        }
-
-        Context->Iv[Bi] += 1;
-        break;
-      }
+    //
+    // XOR whole words first, and the remaining bytes of the last block after.
+    // Keystream left in the last block is discarded as in byte-wise implementation.
+    //
+    for (Index = 0; Index < Size / sizeof (UINT32); ++Index) {
+      Word = AES_LOAD32 (&Data[Index * sizeof (UINT32)]) ^ Stream[Index];
+      AES_STORE32 (&Data[Index * sizeof (UINT32)], Word);
+    }
 
-      Bi = 0;
+    if (Size % sizeof (UINT32) != 0) {
+      StoreBlock (Buffer, &Stream[(Size / AES_BLOCK_SIZE) * Nb]);
+      for (Index = Size & ~(sizeof (UINT32) - 1); Index < Size; ++Index) {
+        Data[Index] ^= Buffer[Index % AES_BLOCK_SIZE];
+      }
     }
 
-    Data[I] = (Data[I] ^ Buffer[Bi]);
+    Data += Size;
+    Len  -= Size;
   }
 }
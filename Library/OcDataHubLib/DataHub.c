@@ -15,6 +15,92 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 //
 DATA_HUB_INSTANCE mPrivateData;
 
+/**
+  Ensure that the data log array has room for one more record.
+
+  @param Private                Data hub instance.
+
+  @retval TRUE   If there is room for one more record.
+  @retval FALSE  If the array could not be grown.
+**/
+STATIC
+BOOLEAN
+InternalReserveRecordSlot (
+  IN OUT DATA_HUB_INSTANCE    *Private
+  )
+{
+  EFI_DATA_RECORD_HEADER  **NewRecords;
+  UINTN                   NewCapacity;
+
+  if (Private->RecordCount < Private->RecordCapacity) {
+    return TRUE;
+  }
+
+  if (Private->RecordCapacity == 0) {
+    NewCapacity = DATA_HUB_INITIAL_RECORD_CAPACITY;
+  } else {
+    NewCapacity = Private->RecordCapacity * 2;
+  }
+
+  NewRecords = ReallocatePool (
+    Private->RecordCapacity * sizeof (Private->Records[0]),
+    NewCapacity * sizeof (Private->Records[0]),
+    Private->Records
+    );
+  if (NewRecords == NULL) {
+    return FALSE;
+  }
+
+  Private->Records        = NewRecords;
+  Private->RecordCapacity = NewCapacity;
+  return TRUE;
+}
+
+/**
+  Allocate storage for a new record from the record pool.
+  Records are never freed, so the pool is a simple bump allocator.
+
+  @param Private                Data hub instance.
+  @param RecordSize             Record size in bytes.
+
+  @retval Allocated record or NULL.
+**/
+STATIC
+EFI_DATA_RECORD_HEADER *
+InternalAllocateRecord (
+  IN OUT DATA_HUB_INSTANCE    *Private,
+  IN     UINT32               RecordSize
+  )
+{
+  UINTN  Size;
+  VOID   *Record;
+
+  Size = ALIGN_VALUE (RecordSize, sizeof (UINT64));
+
+  //
+  // Large records would waste too much of a chunk, allocate them separately.
+  //
+  if (Size > DATA_HUB_RECORD_POOL_SIZE / 2) {
+    return AllocatePool (Size);
+  }
+
+  if (Private->RecordPool == NULL || Private->RecordPoolSize - Private->RecordPoolUsed < Size) {
+    Private->RecordPool = AllocatePool (DATA_HUB_RECORD_POOL_SIZE);
+    if (Private->RecordPool == NULL) {
+      Private->RecordPoolUsed = 0;
+      Private->RecordPoolSize = 0;
+      return NULL;
+    }
+
+    Private->RecordPoolUsed = 0;
+    Private->RecordPoolSize = DATA_HUB_RECORD_POOL_SIZE;
+  }
+
+  Record = Private->RecordPool + Private->RecordPoolUsed;
+  Private->RecordPoolUsed += Size;
+  return Record;
+}
+
 /**
   Log data record into the data logging hub
 
@@ -42,8 +128,6 @@ DataHubLogData (
 {
   EFI_STATUS              Status;
   DATA_HUB_INSTANCE       *Private;
-  EFI_DATA_ENTRY          *LogEntry;
-  UINT32                  TotalSize;
   UINT32                  RecordSize;
   EFI_DATA_RECORD_HEADER  *Record;
   VOID                    *Raw;
@@ -55,13 +139,11 @@ DataHubLogData (
   Private = DATA_HUB_INSTANCE_FROM_THIS (This);
 
   //
-  // Combine the storage for the internal structs and a copy of the log record.
-  //  Record follows PrivateLogEntry. The consumer will be returned a pointer
-  //  to Record so we don't what it to be the thing that was allocated from
-  //  pool, so the consumer can't free an data record by mistake.
+  // The record is stored in the record pool and referenced by the data log
+  //  array. The consumer will be returned a pointer to Record, which is not
+  //  a standalone pool allocation, so it must never be freed by the consumer.
   //
   RecordSize  = sizeof (EFI_DATA_RECORD_HEADER) + RawDataSize;
-  TotalSize   = sizeof (EFI_DATA_ENTRY) + RecordSize;
 
   //
   // First try to get log time at TPL level <= TPL_CALLBACK.
@@ -84,16 +166,20 @@ DataHubLogData (
     return Status;
   }
 
-  LogEntry = AllocatePool (TotalSize);
+  if (!InternalReserveRecordSlot (Private)) {
+    EfiReleaseLock (&Private->DataLock);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Record = InternalAllocateRecord (Private, RecordSize);
 
-  if (LogEntry == NULL) {
+  if (Record == NULL) {
     EfiReleaseLock (&Private->DataLock);
     return EFI_OUT_OF_RESOURCES;
   }
 
-  ZeroMem (LogEntry, TotalSize);
+  ZeroMem (Record, sizeof (EFI_DATA_RECORD_HEADER));
 
-  Record  = (EFI_DATA_RECORD_HEADER *) (LogEntry + 1);
   Raw     = (VOID *) (Record + 1);
 
   //
@@ -114,12 +200,11 @@ DataHubLogData (
   CopyMem (&Record->LogTime, &LogTime, sizeof (LogTime));
 
   //
-  // Insert log into the internal linked list.
+  // Append log to the data log array, the index matches LogMonotonicCount.
   //
-  LogEntry->Signature   = EFI_DATA_ENTRY_SIGNATURE;
-  LogEntry->Record      = Record;
-  LogEntry->RecordSize  = sizeof (EFI_DATA_ENTRY) + RawDataSize;
-  InsertTailList (&Private->DataListHead, &LogEntry->Link);
+  ASSERT (Record->LogMonotonicCount == Private->FirstMonotonicCount + Private->RecordCount);
+  Private->Records[Private->RecordCount] = Record;
+  ++Private->RecordCount;
 
   CopyMem (Raw, RawData, RawDataSize);
 
@@ -143,74 +228,99 @@ DataHubLogData (
 }
 
 /**
-  Search the Head doubly linked list for the passed in MTC. Return the
-  matching element in Head and the MTC on the next entry.
+  Search the data log for the first record matching ClassFilter
+  starting at Index.
+
+  @param Private          Data hub instance.
+  @param Index            Index to start the search from.
+  @param ClassFilter      Class to match.
+
+  @retval Index of the matching record or RecordCount if none is found.
+
+**/
+STATIC
+UINTN
+InternalFindRecordByClass (
+  IN  DATA_HUB_INSTANCE   *Private,
+  IN  UINTN               Index,
+  IN  UINT64              ClassFilter
+  )
+{
+  while (Index < Private->RecordCount
+    && (Private->Records[Index]->DataRecordClass & ClassFilter) == 0) {
+    ++Index;
+  }
+
+  return Index;
+}
+
+/**
+  Search the data log for the passed in MTC. Return the
+  matching record and the MTC on the next entry.
+
+  Records are indexed by their MTC, so the lookup is constant time
+  and finding the next entry only visits the records in between.
 
-  @param Head             Head of Data Log linked list.
+  @param Private          Data hub instance.
   @param ClassFilter      Only match the MTC if it is in the same Class as the
                           ClassFilter.
   @param PtrCurrentMTC    On IN contians MTC to search for. On OUT contians next
                           MTC in the data log list or zero if at end of the list.
 
-  @retval EFI_DATA_LOG_ENTRY  Return pointer to data log data from Head list.
+  @retval EFI_DATA_LOG_ENTRY  Return pointer to data log data from the data log.
   @retval NULL                If no data record exists.
 
 **/
 EFI_DATA_RECORD_HEADER *
 GetNextDataRecord (
-  IN  LIST_ENTRY          *Head,
+  IN  DATA_HUB_INSTANCE   *Private,
   IN  UINT64              ClassFilter,
   IN OUT  UINT64          *PtrCurrentMTC
   )
 
 {
-  EFI_DATA_ENTRY          *LogEntry;
-  LIST_ENTRY              *Link;
-  BOOLEAN                 ReturnFirstEntry;
+  UINTN                   Index;
+  UINTN                   NextIndex;
   EFI_DATA_RECORD_HEADER  *Record;
-  EFI_DATA_ENTRY          *NextLogEntry;
 
-  //
-  // If MonotonicCount == 0 just return the first one
-  //
-  ReturnFirstEntry  = (BOOLEAN) (*PtrCurrentMTC == 0);
+  if (*PtrCurrentMTC == 0) {
+    //
+    // If MonotonicCount == 0 just return the first one
+    //
+    Index = InternalFindRecordByClass (Private, 0, ClassFilter);
+    if (Index == Private->RecordCount) {
+      return NULL;
+    }
+  } else {
+    if (*PtrCurrentMTC < Private->FirstMonotonicCount
+      || *PtrCurrentMTC - Private->FirstMonotonicCount >= Private->RecordCount) {
+      return NULL;
+    }
 
-  Record            = NULL;
-  for (Link = GetFirstNode(Head); Link != Head; Link = GetNextNode(Head, Link)) {
-    LogEntry = DATA_ENTRY_FROM_LINK (Link);
-    if ((LogEntry->Record->DataRecordClass & ClassFilter) == 0) {
+    Index = (UINTN) (*PtrCurrentMTC - Private->FirstMonotonicCount);
+
+    if ((Private->Records[Index]->DataRecordClass & ClassFilter) == 0) {
       //
       // Skip any entry that does not have the correct ClassFilter
       //
-      continue;
+      return NULL;
     }
+  }
 
-    if ((LogEntry->Record->LogMonotonicCount == *PtrCurrentMTC) || ReturnFirstEntry) {
-      //
-      // Return record to the user
-      //
-      Record = LogEntry->Record;
+  //
+  // Return record to the user
+  //
+  Record = Private->Records[Index];
 
-      //
-      // Calculate the next MTC value. If there is no next entry set
-      // MTC to zero.
-      //
-      *PtrCurrentMTC = 0;
-      for (Link = GetNextNode(Head, Link); Link != Head; Link = GetNextNode(Head, Link)) {
-        NextLogEntry = DATA_ENTRY_FROM_LINK (Link);
-        if ((NextLogEntry->Record->DataRecordClass & ClassFilter) != 0) {
-          //
-          // Return the MTC of the next thing to search for if found
-          //
-          *PtrCurrentMTC = NextLogEntry->Record->LogMonotonicCount;
-          break;
-        }
-      }
-      //
-      // Record found exit loop and return
-      //
-      break;
-    }
+  //
+  // Calculate the next MTC value. If there is no next entry set
+  // MTC to zero.
+  //
+  NextIndex = InternalFindRecordByClass (Private, Index + 1, ClassFilter);
+  if (NextIndex < Private->RecordCount) {
+    *PtrCurrentMTC = Private->Records[NextIndex]->LogMonotonicCount;
+  } else {
+    *PtrCurrentMTC = 0;
   }
 
   return Record;
@@ -300,7 +410,7 @@ DataHubGetNextRecord (
   // If FilterDriverEvent is NULL, then return the next record
   //
   if (FilterDriverEvent == NULL) {
-    *Record = GetNextDataRecord (&Private->DataListHead, ClassFilter, MonotonicCount);
+    *Record = GetNextDataRecord (Private, ClassFilter, MonotonicCount);
     if (*Record == NULL) {
       return EFI_NOT_FOUND;
     }
@@ -328,7 +438,7 @@ DataHubGetNextRecord (
   // Retrieve the next record or the first record.
   //
   if (*MonotonicCount != 0 || FilterDriver->GetNextMonotonicCount == 0) {
-    *Record = GetNextDataRecord (&Private->DataListHead, ClassFilter, MonotonicCount);
+    *Record = GetNextDataRecord (Private, ClassFilter, MonotonicCount);
     if (*Record == NULL) {
       return EFI_NOT_FOUND;
     }
@@ -357,7 +467,7 @@ DataHubGetNextRecord (
   // Retrieve the last record successfuly read again, but do not return it since
   // it has already been returned before.
   //
-  *Record = GetNextDataRecord (&Private->DataListHead, ClassFilter, MonotonicCount);
+  *Record = GetNextDataRecord (Private, ClassFilter, MonotonicCount);
   if (*Record == NULL) {
     return EFI_NOT_FOUND;
   }
@@ -371,7 +481,7 @@ DataHubGetNextRecord (
     //
     // Retrieve the record after the last record successfuly read
     //
-    *Record = GetNextDataRecord (&Private->DataListHead, ClassFilter, MonotonicCount);
+    *Record = GetNextDataRecord (Private, ClassFilter, MonotonicCount);
     if (*Record == NULL) {
       return EFI_NOT_FOUND;
     }
@@ -543,7 +653,12 @@ DataHubInstall (
   // Initialize Private Data in CORE_LOGGING_HUB_INSTANCE that is
   // required by this protocol
   //
-  InitializeListHead (&mPrivateData.DataListHead);
+  mPrivateData.Records        = NULL;
+  mPrivateData.RecordCount    = 0;
+  mPrivateData.RecordCapacity = 0;
+  mPrivateData.RecordPool     = NULL;
+  mPrivateData.RecordPoolUsed = 0;
+  mPrivateData.RecordPoolSize = 0;
   InitializeListHead (&mPrivateData.FilterDriverListHead);
 
   EfiInitializeLock (&mPrivateData.DataLock, TPL_NOTIFY);
@@ -560,6 +675,11 @@ DataHubInstall (
   } else {
     mPrivateData.GlobalMonotonicCount = LShiftU64 ((UINT64) HighMontonicCount, 32);
   }
+
+  //
+  // The first logged record will get the next MTC.
+  //
+  mPrivateData.FirstMonotonicCount = mPrivateData.GlobalMonotonicCount + 1;
   //
   // Make a new handle and install the protocol
   //
@@ -51,10 +51,24 @@ typedef struct {
   UINT64                GlobalMonotonicCount;
 
   //
-  // List of EFI_DATA_ENTRY structures. This is the data log! The list
-  //  must be in assending order of LogMonotonicCount.
+  // Array of logged records. This is the data log! The array is in
+  //  assending order of LogMonotonicCount, and since LogMonotonicCount
+  //  is incremented for every record, record N has LogMonotonicCount
+  //  of FirstMonotonicCount + N.
   //
-  LIST_ENTRY            DataListHead;
+  EFI_DATA_RECORD_HEADER  **Records;
+  UINTN                   RecordCount;
+  UINTN                   RecordCapacity;
+  UINT64                  FirstMonotonicCount;
+
+  //
+  // Current record pool chunk. Records are never freed, so they are
+  //  carved sequentially from larger chunks instead of being allocated
+  //  one by one.
+  //
+  UINT8                   *RecordPool;
+  UINTN                   RecordPoolUsed;
+  UINTN                   RecordPoolSize;
 
   //
   // List of EFI_DATA_HUB_FILTER_DRIVER structures. Represents all
@@ -67,22 +81,14 @@ typedef struct {
 #define DATA_HUB_INSTANCE_FROM_THIS(this) CR (this, DATA_HUB_INSTANCE, DataHub, DATA_HUB_INSTANCE_SIGNATURE)
 
 //
-// Private data structure to contain the data log. One record per
-//  structure. Head pointer to the list is the Log member of
-//  EFI_DATA_ENTRY. Record is a copy of the data passed in.
+// Initial amount of record pointers in the data log array.
 //
-#define EFI_DATA_ENTRY_SIGNATURE  SIGNATURE_32 ('D', 'r', 'e', 'c')
-typedef struct {
-  UINT32                  Signature;
-  LIST_ENTRY              Link;
-
-  EFI_DATA_RECORD_HEADER  *Record;
+#define DATA_HUB_INITIAL_RECORD_CAPACITY  64
 
-  UINTN                   RecordSize;
-
-} EFI_DATA_ENTRY;
-
-#define DATA_ENTRY_FROM_LINK(link)  CR (link, EFI_DATA_ENTRY, Link, EFI_DATA_ENTRY_SIGNATURE)
+//
+// Size of a single record pool chunk. Larger records get own chunks.
+//
+#define DATA_HUB_RECORD_POOL_SIZE         (64 * 1024)
 
 //
 // Private data to contain the filter driver Event and it's
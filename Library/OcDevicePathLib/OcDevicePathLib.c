@@ -641,6 +641,121 @@ IsDevicePathChild (
   return InternalDevicePathCmpWorker (ParentPath, ChildPath, TRUE);
 }
 
+UINT32
+OcHashDevicePathData (
+  IN CONST VOID  *Data,
+  IN UINTN       Size
+  )
+{
+  CONST UINT8  *Bytes;
+  UINT32       Hash;
+
+  //
+  // 32-bit FNV-1a.
+  //
+  Bytes = Data;
+  Hash  = 0x811C9DC5U;
+
+  while (Size > 0) {
+    Hash = (Hash ^ *Bytes) * 0x01000193U;
+    ++Bytes;
+    --Size;
+  }
+
+  return Hash;
+}
+
+STATIC
+UINT32
+InternalHashFilePathChar (
+  IN UINT32  Hash,
+  IN CHAR16  Char
+  )
+{
+  Hash = (Hash ^ (UINT8) Char) * 0x01000193U;
+  Hash = (Hash ^ (UINT8) (Char >> 8U)) * 0x01000193U;
+  return Hash;
+}
+
+BOOLEAN
+OcGetFileDevicePathHash (
+  IN  CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  OUT UINT32                          *Hash
+  )
+{
+  CONST FILEPATH_DEVICE_PATH  *FilePath;
+  UINTN                       Length;
+  UINTN                       Index;
+  BOOLEAN                     HasComponents;
+
+  ASSERT (DevicePath != NULL);
+  ASSERT (Hash != NULL);
+
+  *Hash         = 0x811C9DC5U;
+  HasComponents = FALSE;
+
+  //
+  // Mirror InternalFileDevicePathsEqualWorker normalisation: every node is
+  // stripped of one leading and one trailing separator, empty nodes are skipped,
+  // node boundaries are treated as separators and characters are upper-cased.
+  //
+  while (DevicePathType (DevicePath) == MEDIA_DEVICE_PATH
+    && DevicePathSubType (DevicePath) == MEDIA_FILEPATH_DP) {
+    FilePath = (CONST FILEPATH_DEVICE_PATH *) DevicePath;
+    Length   = OcFileDevicePathNameLen (FilePath);
+    Index    = 0;
+
+    if (Length > 0 && FilePath->PathName[0] == L'\\') {
+      Index = 1;
+      --Length;
+    }
+
+    if (Length > 0 && FilePath->PathName[Index + Length - 1] == L'\\') {
+      --Length;
+    }
+
+    if (Length > 0) {
+      if (HasComponents) {
+        *Hash = InternalHashFilePathChar (*Hash, L'\\');
+      }
+
+      for (; Length > 0; ++Index, --Length) {
+        *Hash = InternalHashFilePathChar (*Hash, CharToUpper (FilePath->PathName[Index]));
+      }
+
+      HasComponents = TRUE;
+    }
+
+    DevicePath = NextDevicePathNode (DevicePath);
+  }
+
+  return IsDevicePathEnd (DevicePath);
+}
+
+VOID
+OcGetDevicePathFingerprint (
+  IN  CONST EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  OUT OC_DEVICE_PATH_FINGERPRINT      *Fingerprint
+  )
+{
+  CONST EFI_DEVICE_PATH_PROTOCOL  *Walker;
+
+  ASSERT (DevicePath != NULL);
+  ASSERT (Fingerprint != NULL);
+
+  Walker = DevicePath;
+  while (!IsDevicePathEnd (Walker)
+    && (DevicePathType (Walker) != MEDIA_DEVICE_PATH
+      || DevicePathSubType (Walker) != MEDIA_FILEPATH_DP)) {
+    Walker = NextDevicePathNode (Walker);
+  }
+
+  Fingerprint->Size            = GetDevicePathSize (DevicePath);
+  Fingerprint->RootSize        = (UINTN) Walker - (UINTN) DevicePath;
+  Fingerprint->RootHash        = OcHashDevicePathData (DevicePath, Fingerprint->RootSize);
+  Fingerprint->HasFilePathHash = OcGetFileDevicePathHash (Walker, &Fingerprint->FilePathHash);
+}
+
 UINTN
 OcFileDevicePathNameSize (
   IN CONST FILEPATH_DEVICE_PATH  *FilePath
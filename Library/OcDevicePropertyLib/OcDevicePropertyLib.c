@@ -28,6 +28,7 @@
 #include <Library/PrintLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 #include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/OcDevicePathLib.h>
 #include <Library/OcGuardLib.h>
 #include <Library/OcMiscLib.h>
 
@@ -43,12 +44,26 @@
     DEVICE_PATH_PROPERTY_DATA_SIGNATURE       \
     )
 
+//
+// Number of device path hash buckets, must be a power of two.
+//
+#define DEVICE_PATH_PROPERTY_HASH_BUCKETS  64
+
 // DEVICE_PATH_PROPERTY_DATABASE
 typedef struct {
   UINTN                                      Signature;
   LIST_ENTRY                                 Nodes;
   EFI_DEVICE_PATH_PROPERTY_DATABASE_PROTOCOL Protocol;
   BOOLEAN                                    Modified;
+  ///
+  /// Nodes hashed by their device path.
+  ///
+  LIST_ENTRY                                 NodeBuckets[DEVICE_PATH_PROPERTY_HASH_BUCKETS];
+  ///
+  /// Serialised property buffer, valid until the next modification.
+  ///
+  EFI_DEVICE_PATH_PROPERTY_BUFFER            *CachedBuffer;
+  UINTN                                      CachedBufferSize;
 } DEVICE_PATH_PROPERTY_DATA;
 
 #define APPLE_PATH_PROPERTIES_VARIABLE_NAME    L"AAPL,PathProperties"
@@ -68,8 +83,18 @@ typedef struct {
       )                                        \
     ))
 
+#define PROPERTY_NODE_FROM_HASH_ENTRY(Entry)   \
+  ((EFI_DEVICE_PATH_PROPERTY_NODE *)(          \
+    CR (                                       \
+      Entry,                                   \
+      EFI_DEVICE_PATH_PROPERTY_NODE_HDR,       \
+      HashLink,                                \
+      EFI_DEVICE_PATH_PROPERTY_NODE_SIGNATURE  \
+      )                                        \
+    ))
+
 #define EFI_DEVICE_PATH_PROPERTY_NODE_SIZE(Node)  \
-  (sizeof (EFI_DEVICE_PATH_PROPERTY_BUFFER_NODE_HDR) + GetDevicePathSize (&(Node)->DevicePath))
+  (sizeof (EFI_DEVICE_PATH_PROPERTY_BUFFER_NODE_HDR) + (Node)->Hdr.DevicePathSize)
 
 // EFI_DEVICE_PATH_PROPERTY_NODE_HDR
 typedef struct {
@@ -77,6 +102,9 @@ typedef struct {
   LIST_ENTRY Link;                ///<
   UINTN      NumberOfProperties;  ///<
   LIST_ENTRY Properties;          ///<
+  LIST_ENTRY HashLink;            ///< Link in database hash bucket.
+  UINTN      DevicePathSize;      ///< Size of DevicePath in bytes.
+  UINT32     DevicePathHash;      ///< Hash of DevicePath.
 } EFI_DEVICE_PATH_PROPERTY_NODE_HDR;
 
 // DEVICE_PATH_PROPERTY_NODE
@@ -115,6 +143,7 @@ typedef struct {
   LIST_ENTRY                    Link;       ///<
   EFI_DEVICE_PATH_PROPERTY_DATA *Name;      ///<
   EFI_DEVICE_PATH_PROPERTY_DATA *Value;     ///<
+  UINT32                        NameHash;   ///< Hash of Name data.
 } EFI_DEVICE_PATH_PROPERTY;
 
 // TODO: Move to own header
@@ -133,26 +162,38 @@ EFI_GUID mAppleThunderboltNativeHostInterfaceProtocolGuid = APPLE_THUNDERBOLT_NA
 STATIC
 EFI_DEVICE_PATH_PROPERTY_NODE *
 InternalGetPropertyNode (
-  IN DEVICE_PATH_PROPERTY_DATA  *DevicePathPropertyData,
-  IN EFI_DEVICE_PATH_PROTOCOL   *DevicePath
+  IN  DEVICE_PATH_PROPERTY_DATA  *DevicePathPropertyData,
+  IN  EFI_DEVICE_PATH_PROTOCOL   *DevicePath,
+  OUT UINTN                      *DevicePathSize OPTIONAL,
+  OUT UINT32                     *DevicePathHash OPTIONAL
   )
 {
-  LIST_ENTRY  *Node;
-  UINTN       DevicePathSize;
-  UINTN       DevicePathSize2;
+  LIST_ENTRY                     *Bucket;
+  LIST_ENTRY                     *Entry;
+  EFI_DEVICE_PATH_PROPERTY_NODE  *Node;
+  UINTN                          Size;
+  UINT32                         Hash;
+
+  Size   = GetDevicePathSize (DevicePath);
+  Hash   = OcHashDevicePathData (DevicePath, Size);
+  Bucket = &DevicePathPropertyData->NodeBuckets[Hash & (DEVICE_PATH_PROPERTY_HASH_BUCKETS - 1)];
+
+  if (DevicePathSize != NULL) {
+    *DevicePathSize = Size;
+  }
 
-  Node = GetFirstNode (&DevicePathPropertyData->Nodes);
-  DevicePathSize = GetDevicePathSize (DevicePath);
+  if (DevicePathHash != NULL) {
+    *DevicePathHash = Hash;
+  }
 
-  while (!IsNull (&DevicePathPropertyData->Nodes, Node)) {
-    DevicePathSize2 = GetDevicePathSize (&PROPERTY_NODE_FROM_LIST_ENTRY (Node)->DevicePath);
+  for (Entry = GetFirstNode (Bucket); !IsNull (Bucket, Entry); Entry = GetNextNode (Bucket, Entry)) {
+    Node = PROPERTY_NODE_FROM_HASH_ENTRY (Entry);
 
-    if (DevicePathSize == DevicePathSize2
-      && CompareMem (DevicePath, &PROPERTY_NODE_FROM_LIST_ENTRY (Node)->DevicePath, DevicePathSize) == 0) {
-      return PROPERTY_NODE_FROM_LIST_ENTRY (Node);
+    if (Node->Hdr.DevicePathHash == Hash
+      && Node->Hdr.DevicePathSize == Size
+      && CompareMem (DevicePath, &Node->DevicePath, Size) == 0) {
+      return Node;
     }
-
-    Node = GetNextNode (&DevicePathPropertyData->Nodes, Node);
   }
 
   return NULL;
@@ -162,26 +203,53 @@ InternalGetPropertyNode (
 STATIC
 EFI_DEVICE_PATH_PROPERTY *
 InternalGetProperty (
-  IN EFI_DEVICE_PATH_PROPERTY_NODE  *Node,
-  IN CONST CHAR16                   *Name
+  IN  EFI_DEVICE_PATH_PROPERTY_NODE  *Node,
+  IN  CONST CHAR16                   *Name,
+  OUT UINT32                         *NameHash OPTIONAL
   )
 {
-  LIST_ENTRY  *Property;
+  LIST_ENTRY                *Entry;
+  EFI_DEVICE_PATH_PROPERTY  *Property;
+  UINT32                    Hash;
+
+  Hash = OcHashDevicePathData (Name, StrSize (Name));
+
+  if (NameHash != NULL) {
+    *NameHash = Hash;
+  }
 
+  Entry = GetFirstNode (&Node->Hdr.Properties);
 
-  Property = GetFirstNode (&Node->Hdr.Properties);
+  while (!IsNull (&Node->Hdr.Properties, Entry)) {
+    Property = EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Entry);
 
-  while (!IsNull (&Node->Hdr.Properties, Property)) {
-    if (StrCmp (Name, (CONST CHAR16 *) &EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Property)->Name->Data[0]) == 0) {
-      return EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Property);
+    if (Property->NameHash == Hash
+      && StrCmp (Name, (CONST CHAR16 *) &Property->Name->Data[0]) == 0) {
+      return Property;
     }
 
-    Property = GetNextNode (&Node->Hdr.Properties, Property);
+    Entry = GetNextNode (&Node->Hdr.Properties, Entry);
   }
 
   return NULL;
 }
 
+// InternalInvalidatePropertyBuffer
+STATIC
+VOID
+InternalInvalidatePropertyBuffer (
+  IN DEVICE_PATH_PROPERTY_DATA  *DevicePathPropertyData
+  )
+{
+  DevicePathPropertyData->Modified = TRUE;
+
+  if (DevicePathPropertyData->CachedBuffer != NULL) {
+    FreePool (DevicePathPropertyData->CachedBuffer);
+    DevicePathPropertyData->CachedBuffer     = NULL;
+    DevicePathPropertyData->CachedBufferSize = 0;
+  }
+}
+
 // InternalSyncWithThunderboltDevices
 STATIC
 VOID
@@ -262,12 +330,12 @@ DppDbGetProperty (
   BOOLEAN                           BufferTooSmall;
 
   Database = PROPERTY_DATABASE_FROM_PROTOCOL (This);
-  Node     = InternalGetPropertyNode (Database, DevicePath);
+  Node     = InternalGetPropertyNode (Database, DevicePath, NULL, NULL);
   if (Node == NULL) {
     return EFI_NOT_FOUND;
   }
 
-  Property = InternalGetProperty (Node, Name);
+  Property = InternalGetProperty (Node, Name, NULL);
   if (Property == NULL) {
     return EFI_NOT_FOUND;
   }
@@ -312,24 +380,27 @@ DppDbSetProperty (
   DEVICE_PATH_PROPERTY_DATA     *Database;
   EFI_DEVICE_PATH_PROPERTY_NODE *Node;
   UINTN                         DevicePathSize;
+  UINT32                        DevicePathHash;
   EFI_DEVICE_PATH_PROPERTY      *Property;
+  UINT32                        NameHash;
   UINTN                         PropertyNameSize;
   UINTN                         PropertyValueSize;
   EFI_DEVICE_PATH_PROPERTY_DATA *PropertyName;
   EFI_DEVICE_PATH_PROPERTY_DATA *PropertyValue;
 
   Database = PROPERTY_DATABASE_FROM_PROTOCOL (This);
-  Node     = InternalGetPropertyNode (Database, DevicePath);
+  Node     = InternalGetPropertyNode (Database, DevicePath, &DevicePathSize, &DevicePathHash);
 
   if (Node == NULL) {
-    DevicePathSize = GetDevicePathSize (DevicePath);
     Node           = AllocateZeroPool (sizeof (*Node) + DevicePathSize);
 
     if (Node == NULL) {
       return EFI_OUT_OF_RESOURCES;
     }
 
-    Node->Hdr.Signature = EFI_DEVICE_PATH_PROPERTY_NODE_SIGNATURE;
+    Node->Hdr.Signature      = EFI_DEVICE_PATH_PROPERTY_NODE_SIGNATURE;
+    Node->Hdr.DevicePathSize = DevicePathSize;
+    Node->Hdr.DevicePathHash = DevicePathHash;
 
     InitializeListHead (&Node->Hdr.Properties);
 
@@ -340,11 +411,15 @@ DppDbSetProperty (
       );
 
     InsertTailList (&Database->Nodes, &Node->Hdr.Link);
+    InsertTailList (
+      &Database->NodeBuckets[DevicePathHash & (DEVICE_PATH_PROPERTY_HASH_BUCKETS - 1)],
+      &Node->Hdr.HashLink
+      );
 
-    Database->Modified = TRUE;
+    InternalInvalidatePropertyBuffer (Database);
   }
 
-  Property = InternalGetProperty (Node, Name);
+  Property = InternalGetProperty (Node, Name, &NameHash);
 
   if (Property != NULL) {
     if (Property->Value->Size == Size + sizeof (UINT32)
@@ -361,7 +436,7 @@ DppDbSetProperty (
     FreePool (Property);
   }
 
-  Database->Modified = TRUE;
+  InternalInvalidatePropertyBuffer (Database);
   Property           = AllocateZeroPool (sizeof (*Property));
   
   if (Property == NULL) {
@@ -387,6 +462,7 @@ DppDbSetProperty (
   }
   
   Property->Signature = EFI_DEVICE_PATH_PROPERTY_SIGNATURE;
+  Property->NameHash  = NameHash;
 
   CopyMem (&Property->Name->Data[0], Name, PropertyNameSize - sizeof (*PropertyName));
   Property->Name->Size = (UINT32) PropertyNameSize;
@@ -426,17 +502,17 @@ DppDbRemoveProperty (
   EFI_DEVICE_PATH_PROPERTY      *Property;
 
   DevicePathPropertyData = PROPERTY_DATABASE_FROM_PROTOCOL (This);
-  Node = InternalGetPropertyNode (DevicePathPropertyData, DevicePath);
+  Node = InternalGetPropertyNode (DevicePathPropertyData, DevicePath, NULL, NULL);
   if (Node == NULL) {
     return EFI_NOT_FOUND;
   }
 
-  Property = InternalGetProperty (Node, Name);
+  Property = InternalGetProperty (Node, Name, NULL);
   if (Property == NULL) {
     return EFI_NOT_FOUND;
   }
 
-  DevicePathPropertyData->Modified = TRUE;
+  InternalInvalidatePropertyBuffer (DevicePathPropertyData);
 
   RemoveEntryList (&Property->Link);
 
@@ -448,6 +524,7 @@ DppDbRemoveProperty (
 
   if (Node->Hdr.NumberOfProperties == 0) {
     RemoveEntryList (&Node->Hdr.Link);
+    RemoveEntryList (&Node->Hdr.HashLink);
 
     FreePool (Node);
   }
@@ -455,102 +532,84 @@ DppDbRemoveProperty (
   return EFI_SUCCESS;
 }
 
-// DppDbGetPropertyBuffer
-/** Returns a Buffer of all device properties into Buffer.
-
-  @param[in]      This    A pointer to the protocol instance.
-  @param[out]     Buffer  The Buffer allocated by the caller to return the
-                          property Buffer into.
-  @param[in, out] Size    On input the size of the allocated Buffer.
-                          On output the size required to fill the Buffer.
-
-  @return                       The status of the operation is returned.
-  @retval EFI_BUFFER_TOO_SMALL  The memory required to return the value exceeds
-                                the size of the allocated Buffer.
-                                The required size to complete the operation has
-                                been returned into Size.
-  @retval EFI_SUCCESS           The operation completed successfully.
-**/
-EFI_STATUS
-EFIAPI
-DppDbGetPropertyBuffer (
-  IN     EFI_DEVICE_PATH_PROPERTY_DATABASE_PROTOCOL  *This,
-  OUT    EFI_DEVICE_PATH_PROPERTY_BUFFER             *Buffer OPTIONAL,
-  IN OUT UINTN                                       *Size
+// InternalGetPropertyBufferSize
+STATIC
+UINTN
+InternalGetPropertyBufferSize (
+  IN  DEVICE_PATH_PROPERTY_DATA  *Database,
+  OUT UINT32                     *NumberOfNodes
   )
 {
-  LIST_ENTRY                           *Nodes;
-  LIST_ENTRY                           *NodeWalker;
-  UINTN                                BufferSize;
-  LIST_ENTRY                           *Property;
-  UINT32                               NumberOfNodes;
-  EFI_DEVICE_PATH_PROPERTY_BUFFER_NODE *BufferNode;
-  UINT8                                *BufferPtr;
-  BOOLEAN                              BufferTooSmall;
-
-  Nodes  = &(PROPERTY_DATABASE_FROM_PROTOCOL (This))->Nodes;
-
-  if (IsListEmpty (Nodes)) {
-    *Size  = 0;
-    return EFI_SUCCESS;
-  }
-
-  if (PcdGetBool (PcdEnableAppleThunderboltSync)) {
-    InternalSyncWithThunderboltDevices ();
-  }
+  LIST_ENTRY                     *NodeWalker;
+  LIST_ENTRY                     *Property;
+  EFI_DEVICE_PATH_PROPERTY_NODE  *Node;
+  UINTN                          BufferSize;
 
-  NodeWalker    = GetFirstNode (Nodes);
-  BufferSize    = sizeof (*Buffer);
-  NumberOfNodes = 0;
+  NodeWalker     = GetFirstNode (&Database->Nodes);
+  BufferSize     = sizeof (EFI_DEVICE_PATH_PROPERTY_BUFFER);
+  *NumberOfNodes = 0;
 
-  while (!IsNull (Nodes, NodeWalker)) {
-    Property = GetFirstNode (&PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.Properties);
+  while (!IsNull (&Database->Nodes, NodeWalker)) {
+    Node     = PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker);
+    Property = GetFirstNode (&Node->Hdr.Properties);
 
-    while (!IsNull (&PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.Properties, Property)) {
+    while (!IsNull (&Node->Hdr.Properties, Property)) {
       BufferSize += EFI_DEVICE_PATH_PROPERTY_SIZE (EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Property));
-      Property = GetNextNode (&PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.Properties, Property);
+      Property = GetNextNode (&Node->Hdr.Properties, Property);
     }
 
-    BufferSize += EFI_DEVICE_PATH_PROPERTY_NODE_SIZE (PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker));
+    BufferSize += EFI_DEVICE_PATH_PROPERTY_NODE_SIZE (Node);
 
-    NodeWalker = GetNextNode (Nodes, NodeWalker);
+    NodeWalker = GetNextNode (&Database->Nodes, NodeWalker);
 
-    ++NumberOfNodes;
+    ++*NumberOfNodes;
   }
 
-  DEBUG ((DEBUG_VERBOSE, "Saving to %p, given %u, requested %u\n", Buffer, (UINT32) *Size, (UINT32) BufferSize));
+  return BufferSize;
+}
 
-  BufferTooSmall = *Size < BufferSize;
-  *Size  = BufferSize;
-  if (BufferTooSmall) {
-    return EFI_BUFFER_TOO_SMALL;
-  }
+// InternalSerializePropertyBuffer
+STATIC
+VOID
+InternalSerializePropertyBuffer (
+  IN  DEVICE_PATH_PROPERTY_DATA        *Database,
+  OUT EFI_DEVICE_PATH_PROPERTY_BUFFER  *Buffer,
+  IN  UINTN                            BufferSize,
+  IN  UINT32                           NumberOfNodes
+  )
+{
+  LIST_ENTRY                           *NodeWalker;
+  LIST_ENTRY                           *Property;
+  EFI_DEVICE_PATH_PROPERTY_NODE        *Node;
+  EFI_DEVICE_PATH_PROPERTY_BUFFER_NODE *BufferNode;
+  UINT8                                *BufferPtr;
 
   Buffer->Size          = (UINT32) BufferSize;
   Buffer->Version       = EFI_DEVICE_PATH_PROPERTY_DATABASE_VERSION;
   Buffer->NumberOfNodes = NumberOfNodes;
 
-  NodeWalker = GetFirstNode (Nodes);
+  NodeWalker = GetFirstNode (&Database->Nodes);
 
   BufferNode = &Buffer->Nodes[0];
 
-  while (!IsNull (Nodes, NodeWalker)) {
-    BufferSize = GetDevicePathSize (&PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->DevicePath);
+  while (!IsNull (&Database->Nodes, NodeWalker)) {
+    Node       = PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker);
+    BufferSize = Node->Hdr.DevicePathSize;
 
     CopyMem (
       &BufferNode->DevicePath,
-      &PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->DevicePath,
+      &Node->DevicePath,
       BufferSize
       );
 
-    BufferNode->Hdr.NumberOfProperties = (UINT32) PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.NumberOfProperties;
+    BufferNode->Hdr.NumberOfProperties = (UINT32) Node->Hdr.NumberOfProperties;
 
-    Property = GetFirstNode (&PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.Properties);
+    Property = GetFirstNode (&Node->Hdr.Properties);
 
     BufferSize += sizeof (BufferNode->Hdr);
     BufferPtr   = (UINT8 *) BufferNode + BufferSize;
 
-    while (!IsNull (&PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.Properties, Property)) {
+    while (!IsNull (&Node->Hdr.Properties, Property)) {
       CopyMem (
         BufferPtr,
         EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Property)->Name,
@@ -565,10 +624,7 @@ DppDbGetPropertyBuffer (
 
       BufferPtr  += EFI_DEVICE_PATH_PROPERTY_SIZE (EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Property));
       BufferSize += EFI_DEVICE_PATH_PROPERTY_SIZE (EFI_DEVICE_PATH_PROPERTY_FROM_LIST_ENTRY (Property));
-      Property    = GetNextNode (
-                        &PROPERTY_NODE_FROM_LIST_ENTRY (NodeWalker)->Hdr.Properties,
-                        Property
-                        );
+      Property    = GetNextNode (&Node->Hdr.Properties, Property);
     }
 
     BufferNode->Hdr.Size = (UINT32) BufferSize;
@@ -576,7 +632,83 @@ DppDbGetPropertyBuffer (
                               (UINTN) BufferNode + BufferSize
                               );
 
-    NodeWalker = GetNextNode (Nodes, NodeWalker);
+    NodeWalker = GetNextNode (&Database->Nodes, NodeWalker);
+  }
+}
+
+// DppDbGetPropertyBuffer
+/** Returns a Buffer of all device properties into Buffer.
+
+  The serialised buffer is cached until the database is modified.
+
+  @param[in]      This    A pointer to the protocol instance.
+  @param[out]     Buffer  The Buffer allocated by the caller to return the
+                          property Buffer into.
+  @param[in, out] Size    On input the size of the allocated Buffer.
+                          On output the size required to fill the Buffer.
+
+  @return                       The status of the operation is returned.
+  @retval EFI_BUFFER_TOO_SMALL  The memory required to return the value exceeds
+                                the size of the allocated Buffer.
+                                The required size to complete the operation has
+                                been returned into Size.
+  @retval EFI_SUCCESS           The operation completed successfully.
+**/
+EFI_STATUS
+EFIAPI
+DppDbGetPropertyBuffer (
+  IN     EFI_DEVICE_PATH_PROPERTY_DATABASE_PROTOCOL  *This,
+  OUT    EFI_DEVICE_PATH_PROPERTY_BUFFER             *Buffer OPTIONAL,
+  IN OUT UINTN                                       *Size
+  )
+{
+  DEVICE_PATH_PROPERTY_DATA            *Database;
+  UINTN                                BufferSize;
+  UINT32                               NumberOfNodes;
+  BOOLEAN                              BufferTooSmall;
+
+  Database      = PROPERTY_DATABASE_FROM_PROTOCOL (This);
+  NumberOfNodes = 0;
+
+  if (IsListEmpty (&Database->Nodes)) {
+    *Size  = 0;
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Thunderbolt devices may update their properties, invalidating the cache.
+  //
+  if (PcdGetBool (PcdEnableAppleThunderboltSync)) {
+    InternalSyncWithThunderboltDevices ();
+  }
+
+  if (Database->CachedBuffer != NULL) {
+    BufferSize = Database->CachedBufferSize;
+  } else {
+    BufferSize = InternalGetPropertyBufferSize (Database, &NumberOfNodes);
+
+    Database->CachedBuffer = AllocatePool (BufferSize);
+    if (Database->CachedBuffer != NULL) {
+      Database->CachedBufferSize = BufferSize;
+      InternalSerializePropertyBuffer (Database, Database->CachedBuffer, BufferSize, NumberOfNodes);
+    }
+  }
+
+  DEBUG ((DEBUG_VERBOSE, "Saving to %p, given %u, requested %u\n", Buffer, (UINT32) *Size, (UINT32) BufferSize));
+
+  BufferTooSmall = *Size < BufferSize;
+  *Size  = BufferSize;
+  if (BufferTooSmall) {
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if (Database->CachedBuffer != NULL) {
+    CopyMem (Buffer, Database->CachedBuffer, BufferSize);
+  } else {
+    //
+    // Serialise directly when there is no memory for the cache.
+    //
+    InternalSerializePropertyBuffer (Database, Buffer, BufferSize, NumberOfNodes);
   }
 
   return EFI_SUCCESS;
@@ -794,6 +926,7 @@ OcDevicePathPropertyInstallProtocol (
   UINTN                                       VariableSize;
   UINT32                                      Attributes;
   EFI_HANDLE                                  Handle;
+  UINTN                                       Index;
 
   if (Reinstall) {
     Status = UninstallAllProtocolInstances (&gEfiDevicePathPropertyDatabaseProtocolGuid);
@@ -828,6 +961,10 @@ OcDevicePathPropertyInstallProtocol (
 
   InitializeListHead (&DevicePathPropertyData->Nodes);
 
+  for (Index = 0; Index < DEVICE_PATH_PROPERTY_HASH_BUCKETS; ++Index) {
+    InitializeListHead (&DevicePathPropertyData->NodeBuckets[Index]);
+  }
+
   if (PcdGetBool (PcNvramInitDevicePropertyDatabase)) {
     Status = InternalReadEfiVariableProperties (
                &gAppleVendorVariableGuid,
@@ -0,0 +1,226 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+#include <Protocol/SimpleFileSystem.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcFileLib.h>
+#include <Library/OcGuardLib.h>
+
+/**
+  Read from the underlying file, seeking only when the tracked position
+  differs from the requested one.
+
+  @param[in,out] Reader    Buffered file reader.
+  @param[in]     Position  Position to read data from.
+  @param[in,out] Size      On input the size to read, on output the size read.
+  @param[out]    Buffer    Buffer to read data to.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalFileReaderReadRaw (
+  IN OUT OC_FILE_READER  *Reader,
+  IN     UINT32          Position,
+  IN OUT UINTN           *Size,
+     OUT UINT8           *Buffer
+  )
+{
+  EFI_STATUS  Status;
+
+  if (!Reader->HasFilePosition || Reader->FilePosition != Position) {
+    Status = Reader->File->SetPosition (Reader->File, Position);
+    if (EFI_ERROR (Status)) {
+      Reader->HasFilePosition = FALSE;
+      return Status;
+    }
+
+    Reader->FilePosition    = Position;
+    Reader->HasFilePosition = TRUE;
+  }
+
+  Status = Reader->File->Read (Reader->File, Size, Buffer);
+  if (EFI_ERROR (Status)) {
+    Reader->HasFilePosition = FALSE;
+    return Status;
+  }
+
+  Reader->FilePosition += *Size;
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcFileReaderInit (
+  OUT OC_FILE_READER     *Reader,
+  IN  EFI_FILE_PROTOCOL  *File,
+  IN  UINT32             WindowSize,
+  IN  UINT32             BlockSize
+  )
+{
+  ASSERT (Reader != NULL);
+  ASSERT (File != NULL);
+
+  if (BlockSize == 0) {
+    BlockSize = 1;
+  }
+
+  if ((BlockSize & (BlockSize - 1)) != 0
+    || (WindowSize > 0 && BlockSize > WindowSize)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Reader, sizeof (*Reader));
+  Reader->File       = File;
+  Reader->WindowSize = WindowSize;
+  Reader->BlockSize  = BlockSize;
+
+  if (WindowSize > 0) {
+    Reader->Window = AllocatePool (WindowSize);
+    if (Reader->Window == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+VOID
+OcFileReaderFree (
+  IN OUT OC_FILE_READER  *Reader
+  )
+{
+  ASSERT (Reader != NULL);
+
+  if (Reader->Window != NULL) {
+    FreePool (Reader->Window);
+    Reader->Window = NULL;
+  }
+
+  Reader->WindowSize   = 0;
+  Reader->WindowLength = 0;
+}
+
+EFI_STATUS
+OcFileReaderRead (
+  IN OUT OC_FILE_READER  *Reader,
+  IN     UINT32          Position,
+  IN     UINT32          Size,
+     OUT UINT8           *Buffer
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      EndPosition;
+  UINT32      WindowOffset;
+  UINT32      ChunkSize;
+  UINTN       ReadSize;
+
+  ASSERT (Reader != NULL);
+  ASSERT (Buffer != NULL || Size == 0);
+
+  if (OcOverflowAddU32 (Position, Size, &EndPosition)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  while (Size > 0) {
+    //
+    // Serve the leading part from the window when it is there.
+    //
+    if (Position >= Reader->WindowPosition
+      && Position - Reader->WindowPosition < Reader->WindowLength) {
+      WindowOffset = Position - Reader->WindowPosition;
+      ChunkSize    = MIN (Size, Reader->WindowLength - WindowOffset);
+      CopyMem (Buffer, Reader->Window + WindowOffset, ChunkSize);
+      Position += ChunkSize;
+      Buffer   += ChunkSize;
+      Size     -= ChunkSize;
+      continue;
+    }
+    //
+    // Reads not smaller than the window gain nothing from buffering,
+    // do them in one go right into the destination.
+    //
+    if (Size >= Reader->WindowSize) {
+      ReadSize = Size;
+      Status   = InternalFileReaderReadRaw (Reader, Position, &ReadSize, Buffer);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+
+      if (ReadSize != Size) {
+        return EFI_BAD_BUFFER_SIZE;
+      }
+
+      return EFI_SUCCESS;
+    }
+    //
+    // Refill the window from the block containing the requested data.
+    // Reads past the end of file are short, which is fine for the window.
+    //
+    Reader->WindowPosition = Position & ~(Reader->BlockSize - 1);
+    Reader->WindowLength   = 0;
+
+    ReadSize = Reader->WindowSize;
+    Status   = InternalFileReaderReadRaw (
+                 Reader,
+                 Reader->WindowPosition,
+                 &ReadSize,
+                 Reader->Window
+                 );
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Reader->WindowLength = (UINT32) ReadSize;
+
+    if (Position - Reader->WindowPosition >= Reader->WindowLength) {
+      return EFI_BAD_BUFFER_SIZE;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+EFI_STATUS
+OcFileReaderGetSize (
+  IN OUT OC_FILE_READER  *Reader,
+     OUT UINT32          *Size
+  )
+{
+  EFI_STATUS  Status;
+
+  ASSERT (Reader != NULL);
+  ASSERT (Size != NULL);
+
+  if (!Reader->HasFileSize) {
+    //
+    // Sizing moves the file position to the end of file.
+    //
+    Reader->HasFilePosition = FALSE;
+
+    Status = GetFileSize (Reader->File, &Reader->FileSize);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+
+    Reader->HasFileSize = TRUE;
+  }
+
+  *Size = Reader->FileSize;
+  return EFI_SUCCESS;
+}
@@ -30,12 +30,48 @@
 #include <Library/OcGuardLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
+#include "OcFileLibInternal.h"
+
+//
+// Size of the partition entry array most partitioning tools create right
+// after the GPT header: 128 entries of 128 bytes each. It is read along with
+// the header so that the common layout needs just one disk request.
+//
+#define INTERNAL_GPT_PREFETCH_ENTRIES_SIZE  (128U * sizeof (EFI_PARTITION_ENTRY))
+
+//
+// Minimal size of the partition GUID index, must be a power of two.
+//
+#define INTERNAL_PARTITION_GUID_INDEX_MIN_SIZE  64U
+
 typedef struct {
   UINT32              NumPartitions;
   UINT32              PartitionEntrySize;
+  //
+  // Index of the first EFI System Partition or MAX_UINT32.
+  //
+  UINT32              EspIndex;
+  //
+  // Open addressing hash of unique partition GUIDs, each slot stores
+  // the partition index plus one, 0 marks free slots.
+  //
+  UINT32              HashMask;
+  UINT32              *HashTable;
   EFI_PARTITION_ENTRY FirstEntry[];
 } INTERNAL_PARTITION_ENTRIES;
 
+typedef struct {
+  EFI_GUID            PartitionGuid;
+  EFI_HANDLE          DiskHandle;
+  EFI_HANDLE          FsHandle;
+  BOOLEAN             HasBlockIo2;
+  //
+  // Set when different file system handles were seen with this GUID,
+  // e.g. for cloned disks. Lookups then scan handles in handle order.
+  //
+  BOOLEAN             HasDuplicateFs;
+} INTERNAL_PARTITION_GUID_INDEX_ENTRY;
+
 STATIC EFI_GUID mInternalDiskPartitionEntriesProtocolGuid = {
   0x1A81704, 0x3442, 0x4A7D, { 0x87, 0x40, 0xF4, 0xEC, 0x5B, 0xBE, 0x59, 0x77 }
 };
@@ -44,6 +80,334 @@ STATIC EFI_GUID mInternalPartitionEntryProtocolGuid = {
   0x9FC6B19, 0xB8A1, 0x4A01, { 0x8D, 0xB1, 0x87, 0x94, 0xE7, 0x63, 0x4C, 0xA5 }
 };
 
+//
+// Global unique partition GUID index shared by all disks.
+// Like the protocol caches it may refer to detached handles,
+// hence every lookup result is validated before use.
+// For duplicated GUIDs the first handle seen is kept.
+//
+STATIC INTERNAL_PARTITION_GUID_INDEX_ENTRY *mPartitionGuidIndex;
+STATIC UINT32                              mPartitionGuidIndexSize;
+STATIC UINT32                              mPartitionGuidIndexCount;
+
+STATIC
+CONST INTERNAL_PARTITION_ENTRIES *
+InternalGetDiskPartitions (
+  IN EFI_HANDLE  DiskHandle,
+  IN BOOLEAN     HasBlockIo2
+  );
+
+STATIC
+UINT32
+InternalHashPartitionGuid (
+  IN CONST GUID  *Guid
+  )
+{
+  //
+  // GUIDs may come unaligned from HD Device Path nodes, hash them bytewise.
+  //
+  return OcHashDevicePathData (Guid, sizeof (*Guid));
+}
+
+/**
+  Find the partition GUID index slot for a GUID.
+
+  @param[in] Index      Index slots.
+  @param[in] IndexSize  Number of index slots, a power of two.
+  @param[in] Guid       GUID to look up.
+
+  @retval slot with a matching GUID or the free slot to insert it into.
+**/
+STATIC
+INTERNAL_PARTITION_GUID_INDEX_ENTRY *
+InternalPartitionGuidIndexSlot (
+  IN INTERNAL_PARTITION_GUID_INDEX_ENTRY  *Index,
+  IN UINT32                               IndexSize,
+  IN CONST GUID                           *Guid
+  )
+{
+  UINT32  Slot;
+
+  Slot = InternalHashPartitionGuid (Guid) & (IndexSize - 1);
+
+  while (!IsZeroGuid (&Index[Slot].PartitionGuid)
+    && !CompareGuid (&Index[Slot].PartitionGuid, Guid)) {
+    Slot = (Slot + 1) & (IndexSize - 1);
+  }
+
+  return &Index[Slot];
+}
+
+STATIC
+INTERNAL_PARTITION_GUID_INDEX_ENTRY *
+InternalPartitionGuidIndexLookup (
+  IN CONST GUID  *Guid
+  )
+{
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY  *Entry;
+
+  if (mPartitionGuidIndexCount == 0) {
+    return NULL;
+  }
+
+  Entry = InternalPartitionGuidIndexSlot (
+            mPartitionGuidIndex,
+            mPartitionGuidIndexSize,
+            Guid
+            );
+  if (IsZeroGuid (&Entry->PartitionGuid)) {
+    return NULL;
+  }
+
+  return Entry;
+}
+
+/**
+  Find or insert a partition GUID index entry.
+
+  @param[in] Guid  GUID to insert, must not be zero.
+
+  @retval index entry or NULL on allocation failure.
+**/
+STATIC
+INTERNAL_PARTITION_GUID_INDEX_ENTRY *
+InternalPartitionGuidIndexInsert (
+  IN CONST GUID  *Guid
+  )
+{
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY  *NewIndex;
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY  *Entry;
+  UINT32                               NewSize;
+  UINT32                               Index;
+
+  ASSERT (!IsZeroGuid (Guid));
+
+  //
+  // Keep the load factor under 3/4 so that probe sequences stay short.
+  //
+  if ((mPartitionGuidIndexCount + 1) * 4 > mPartitionGuidIndexSize * 3) {
+    if (mPartitionGuidIndexSize >= BASE_1GB / sizeof (*NewIndex)) {
+      return NULL;
+    }
+
+    NewSize = MAX (mPartitionGuidIndexSize * 2, INTERNAL_PARTITION_GUID_INDEX_MIN_SIZE);
+    NewIndex = AllocateZeroPool (NewSize * sizeof (*NewIndex));
+    if (NewIndex == NULL) {
+      return NULL;
+    }
+
+    for (Index = 0; Index < mPartitionGuidIndexSize; ++Index) {
+      if (!IsZeroGuid (&mPartitionGuidIndex[Index].PartitionGuid)) {
+        Entry = InternalPartitionGuidIndexSlot (
+                  NewIndex,
+                  NewSize,
+                  &mPartitionGuidIndex[Index].PartitionGuid
+                  );
+        CopyMem (Entry, &mPartitionGuidIndex[Index], sizeof (*Entry));
+      }
+    }
+
+    if (mPartitionGuidIndex != NULL) {
+      FreePool (mPartitionGuidIndex);
+    }
+
+    mPartitionGuidIndex     = NewIndex;
+    mPartitionGuidIndexSize = NewSize;
+  }
+
+  Entry = InternalPartitionGuidIndexSlot (
+            mPartitionGuidIndex,
+            mPartitionGuidIndexSize,
+            Guid
+            );
+  if (IsZeroGuid (&Entry->PartitionGuid)) {
+    CopyGuid (&Entry->PartitionGuid, Guid);
+    ++mPartitionGuidIndexCount;
+  }
+
+  return Entry;
+}
+
+CONST GUID *
+InternalGetPartitionGuid (
+  IN EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  )
+{
+  CONST HARDDRIVE_DEVICE_PATH  *HdNode;
+
+  ASSERT (DevicePath != NULL);
+
+  HdNode = (HARDDRIVE_DEVICE_PATH *)(
+             FindDevicePathNodeWithType (
+               DevicePath,
+               MEDIA_DEVICE_PATH,
+               MEDIA_HARDDRIVE_DP
+               )
+             );
+  if (HdNode == NULL || HdNode->SignatureType != SIGNATURE_TYPE_GUID) {
+    return NULL;
+  }
+
+  return (CONST GUID *) HdNode->Signature;
+}
+
+EFI_HANDLE
+InternalPartitionGuidGetFsHandle (
+  IN CONST GUID  *PartitionGuid
+  )
+{
+  EFI_STATUS                           Status;
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY  *Entry;
+  EFI_DEVICE_PATH_PROTOCOL             *DevicePath;
+  CONST GUID                           *HandleGuid;
+  VOID                                 *Interface;
+
+  ASSERT (PartitionGuid != NULL);
+
+  Entry = InternalPartitionGuidIndexLookup (PartitionGuid);
+  if (Entry == NULL || Entry->FsHandle == NULL || Entry->HasDuplicateFs) {
+    return NULL;
+  }
+  //
+  // The handle may have been uninstalled or reused since, make sure it
+  // still describes the very same partition and has a file system.
+  //
+  Status = gBS->HandleProtocol (
+                  Entry->FsHandle,
+                  &gEfiDevicePathProtocolGuid,
+                  (VOID **)&DevicePath
+                  );
+  if (!EFI_ERROR (Status)) {
+    HandleGuid = InternalGetPartitionGuid (DevicePath);
+    if (HandleGuid != NULL && CompareGuid (HandleGuid, PartitionGuid)) {
+      Status = gBS->HandleProtocol (
+                      Entry->FsHandle,
+                      &gEfiSimpleFileSystemProtocolGuid,
+                      &Interface
+                      );
+      if (!EFI_ERROR (Status)) {
+        return Entry->FsHandle;
+      }
+    }
+  }
+
+  Entry->FsHandle = NULL;
+  return NULL;
+}
+
+VOID
+InternalPartitionGuidSetFsHandle (
+  IN CONST GUID  *PartitionGuid,
+  IN EFI_HANDLE  FsHandle
+  )
+{
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY  *Entry;
+
+  ASSERT (PartitionGuid != NULL);
+  ASSERT (FsHandle != NULL);
+
+  if (IsZeroGuid (PartitionGuid)) {
+    return;
+  }
+
+  Entry = InternalPartitionGuidIndexInsert (PartitionGuid);
+  if (Entry == NULL) {
+    return;
+  }
+
+  if (Entry->FsHandle == NULL) {
+    Entry->FsHandle = FsHandle;
+  } else if (Entry->FsHandle != FsHandle) {
+    Entry->HasDuplicateFs = TRUE;
+  }
+}
+
+/**
+  Retrieve the partition entries of the disk a partition is known to be on.
+
+  @param[in] DevicePath    The Device Path of the partition.
+  @param[in] HdNodeOffset  The offset of the HD node within DevicePath.
+  @param[in] Guid          The unique GUID of the partition.
+
+  @retval partition entries or NULL when the disk is unknown.
+**/
+STATIC
+CONST INTERNAL_PARTITION_ENTRIES *
+InternalPartitionGuidGetDiskPartitions (
+  IN EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  IN UINTN                     HdNodeOffset,
+  IN CONST GUID                *Guid
+  )
+{
+  EFI_STATUS                           Status;
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY  *Entry;
+  EFI_DEVICE_PATH_PROTOCOL             *DiskDevicePath;
+  UINTN                                DiskDpSize;
+
+  Entry = InternalPartitionGuidIndexLookup (Guid);
+  if (Entry == NULL || Entry->DiskHandle == NULL) {
+    return NULL;
+  }
+  //
+  // Cloned disks share partition GUIDs, only trust the index when the disk
+  // Device Path is exactly the prefix of the partition Device Path.
+  //
+  Status = gBS->HandleProtocol (
+                  Entry->DiskHandle,
+                  &gEfiDevicePathProtocolGuid,
+                  (VOID **)&DiskDevicePath
+                  );
+  if (EFI_ERROR (Status)) {
+    Entry->DiskHandle = NULL;
+    return NULL;
+  }
+
+  DiskDpSize = GetDevicePathSize (DiskDevicePath);
+  if (DiskDpSize != HdNodeOffset + END_DEVICE_PATH_LENGTH
+    || CompareMem (DiskDevicePath, DevicePath, HdNodeOffset) != 0) {
+    return NULL;
+  }
+
+  return InternalGetDiskPartitions (Entry->DiskHandle, Entry->HasBlockIo2);
+}
+
+/**
+  Find a partition entry by its unique GUID.
+
+  @param[in] Partitions  Partition entries of the disk.
+  @param[in] Guid        The unique GUID of the partition.
+
+  @retval partition index or MAX_UINT32.
+**/
+STATIC
+UINT32
+InternalFindDiskPartition (
+  IN CONST INTERNAL_PARTITION_ENTRIES  *Partitions,
+  IN CONST GUID                        *Guid
+  )
+{
+  CONST EFI_PARTITION_ENTRY  *PartEntry;
+  UINT32                     Slot;
+  UINT32                     Index;
+
+  Slot = InternalHashPartitionGuid (Guid) & Partitions->HashMask;
+
+  while (Partitions->HashTable[Slot] != 0) {
+    Index     = Partitions->HashTable[Slot] - 1;
+    PartEntry = (EFI_PARTITION_ENTRY *)(
+                  (UINTN)Partitions->FirstEntry
+                  + (UINTN)Index * Partitions->PartitionEntrySize
+                  );
+    if (CompareGuid (&PartEntry->UniquePartitionGUID, Guid)) {
+      return Index;
+    }
+
+    Slot = (Slot + 1) & Partitions->HashMask;
+  }
+
+  return MAX_UINT32;
+}
+
 STATIC
 VOID
 InternalDebugPrintPartitionEntry (
@@ -197,6 +561,62 @@ OcPartitionGetDiskHandle (
            );
 }
 
+/**
+  Retrieve the unique GUID of the disk's EFI System Partition from its
+  partition table.
+
+  @param[in] DiskDevicePath  The Device Path of the disk.
+  @param[in] DiskDpSize      The size of DiskDevicePath.
+
+  @retval partition GUID or NULL.
+**/
+STATIC
+CONST GUID *
+InternalDiskGetSystemPartitionGuid (
+  IN CONST EFI_DEVICE_PATH_PROTOCOL  *DiskDevicePath,
+  IN UINTN                           DiskDpSize
+  )
+{
+  CONST INTERNAL_PARTITION_ENTRIES *Partitions;
+  CONST EFI_PARTITION_ENTRY        *PartEntry;
+  EFI_DEVICE_PATH_PROTOCOL         *HandleDevicePath;
+  EFI_HANDLE                       DiskHandle;
+  BOOLEAN                          HasBlockIo2;
+
+  ASSERT (DiskDpSize > END_DEVICE_PATH_LENGTH);
+
+  DiskHandle = InternalPartitionGetDiskHandle (
+                 (EFI_DEVICE_PATH_PROTOCOL *)DiskDevicePath,
+                 DiskDpSize - END_DEVICE_PATH_LENGTH,
+                 &HasBlockIo2
+                 );
+  if (DiskHandle == NULL) {
+    return NULL;
+  }
+  //
+  // Device Path location may stop at a parent node with Block I/O,
+  // e.g. for nested partitions, only accept the disk itself.
+  //
+  HandleDevicePath = DevicePathFromHandle (DiskHandle);
+  if (HandleDevicePath == NULL
+    || GetDevicePathSize (HandleDevicePath) != DiskDpSize
+    || CompareMem (HandleDevicePath, DiskDevicePath, DiskDpSize) != 0) {
+    return NULL;
+  }
+
+  Partitions = InternalGetDiskPartitions (DiskHandle, HasBlockIo2);
+  if (Partitions == NULL || Partitions->EspIndex == MAX_UINT32) {
+    return NULL;
+  }
+
+  PartEntry = (EFI_PARTITION_ENTRY *)(
+                (UINTN)Partitions->FirstEntry
+                + (UINTN)Partitions->EspIndex * Partitions->PartitionEntrySize
+                );
+
+  return &PartEntry->UniquePartitionGUID;
+}
+
 /**
   Locate the disk's EFI System Partition.
 
@@ -227,6 +647,9 @@ OcDiskFindSystemPartitionPath (
   UINTN                     HdDpSize;
 
   CONST EFI_PARTITION_ENTRY *PartEntry;
+  CONST GUID                *EspGuid;
+  CONST GUID                *HdGuid;
+  BOOLEAN                   MatchGuid;
 
   ASSERT (DiskDevicePath != NULL);
   ASSERT (EspDevicePathSize != NULL);
@@ -237,20 +660,6 @@ OcDiskFindSystemPartitionPath (
     (EFI_DEVICE_PATH_PROTOCOL *)DiskDevicePath
     );
 
-  Status = gBS->LocateHandleBuffer (
-                  ByProtocol,
-                  &gEfiSimpleFileSystemProtocolGuid,
-                  NULL,
-                  &NumHandles,
-                  &Handles
-                  );
-  if (EFI_ERROR (Status)) {
-    DEBUG ((DEBUG_INFO, "OCPI: Failed to locate FS handles\n"));
-    return NULL;
-  }
-
-  EspDevicePath = NULL;
-
   DiskDpSize = GetDevicePathSize (DiskDevicePath);
   //
   // The partition's Device Path must be at least as big as the disk's (prefix)
@@ -265,49 +674,120 @@ OcDiskFindSystemPartitionPath (
     DEBUG ((DEBUG_INFO, "OCPI: HD node would overflow DP\n"));
     return NULL;
   }
+  //
+  // When the disk itself can be located, its partition table names the ESP
+  // and only the file system handle of that partition has to be found.
+  // It is usually known from an earlier lookup.
+  //
+  EspGuid = NULL;
+  if (DiskDpSize > END_DEVICE_PATH_LENGTH) {
+    EspGuid = InternalDiskGetSystemPartitionGuid (DiskDevicePath, DiskDpSize);
+  }
 
-  for (Index = 0; Index < NumHandles; ++Index) {
-    Handle = Handles[Index];
-
-    HdDevicePath = DevicePathFromHandle (Handle);
-    if (HdDevicePath == NULL) {
-      continue;
+  if (EspGuid != NULL) {
+    Handle = InternalPartitionGuidGetFsHandle (EspGuid);
+    if (Handle != NULL) {
+      HdDevicePath = DevicePathFromHandle (Handle);
+      ASSERT (HdDevicePath != NULL);
+      HdDpSize = GetDevicePathSize (HdDevicePath);
+      if (HdDpSize >= DiskDpCmpSize
+        && CompareMem (HdDevicePath, DiskDevicePath, DiskDpSize - END_DEVICE_PATH_LENGTH) == 0) {
+        DebugPrintDevicePath (DEBUG_INFO, "OCPI: Located indexed ESP", HdDevicePath);
+        *EspDevicePathSize = HdDpSize;
+        return HdDevicePath;
+      }
     }
+  }
 
-    HdDpSize = GetDevicePathSize (HdDevicePath);
-    if (HdDpSize < DiskDpCmpSize) {
-      continue;
-    }
-    //
-    // Verify the partition's Device Path has the disk's prefixed.
-    //
-    CmpResult = CompareMem (
-                  HdDevicePath,
-                  DiskDevicePath,
-                  DiskDpSize - END_DEVICE_PATH_LENGTH
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiSimpleFileSystemProtocolGuid,
+                  NULL,
+                  &NumHandles,
+                  &Handles
                   );
-    if (CmpResult != 0) {
-      continue;
-    }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_INFO, "OCPI: Failed to locate FS handles\n"));
+    return NULL;
+  }
 
-    DebugPrintDevicePath (DEBUG_INFO, "OCPI: Discovered HD DP", HdDevicePath);
+  EspDevicePath = NULL;
 
-    PartEntry = OcGetGptPartitionEntry (Handle);
-    if (PartEntry == NULL) {
-      continue;
+  //
+  // The first ESP of the disk may have no file system, while another ESP
+  // does. Fall back to checking the partition type of every handle then.
+  //
+  for (MatchGuid = EspGuid != NULL; EspDevicePath == NULL; MatchGuid = FALSE) {
+    for (Index = 0; Index < NumHandles; ++Index) {
+      Handle = Handles[Index];
+
+      HdDevicePath = DevicePathFromHandle (Handle);
+      if (HdDevicePath == NULL) {
+        continue;
+      }
+
+      HdDpSize = GetDevicePathSize (HdDevicePath);
+      if (HdDpSize < DiskDpCmpSize) {
+        continue;
+      }
+      //
+      // Verify the partition's Device Path has the disk's prefixed.
+      //
+      CmpResult = CompareMem (
+                    HdDevicePath,
+                    DiskDevicePath,
+                    DiskDpSize - END_DEVICE_PATH_LENGTH
+                    );
+      if (CmpResult != 0) {
+        continue;
+      }
+
+      DebugPrintDevicePath (DEBUG_INFO, "OCPI: Discovered HD DP", HdDevicePath);
+
+      if (MatchGuid) {
+        //
+        // The ESP is known, match the HD node signature without reading
+        // any more partition information.
+        //
+        HdGuid = InternalGetPartitionGuid (HdDevicePath);
+        if (HdGuid == NULL) {
+          continue;
+        }
+
+        InternalPartitionGuidSetFsHandle (HdGuid, Handle);
+
+        if (CompareGuid (HdGuid, EspGuid)) {
+          EspDevicePath = HdDevicePath;
+          *EspDevicePathSize = HdDpSize;
+          break;
+        }
+
+        continue;
+      }
+
+      PartEntry = OcGetGptPartitionEntry (Handle);
+      if (PartEntry == NULL) {
+        continue;
+      }
+
+      InternalDebugPrintPartitionEntry (
+        DEBUG_INFO,
+        "OCPI: Discovered PartEntry",
+        PartEntry
+        );
+
+      if (CompareGuid (&PartEntry->PartitionTypeGUID, &gEfiPartTypeSystemPartGuid)) {
+        EspDevicePath = HdDevicePath;
+        *EspDevicePathSize = HdDpSize;
+        break;
+      }
     }
 
-    InternalDebugPrintPartitionEntry (
-      DEBUG_INFO,
-      "OCPI: Discovered PartEntry",
-      PartEntry
-      );
-
-    if (CompareGuid (&PartEntry->PartitionTypeGUID, &gEfiPartTypeSystemPartGuid)) {
-      EspDevicePath = HdDevicePath;
-      *EspDevicePathSize = HdDpSize;
+    if (!MatchGuid) {
       break;
     }
+
+    DEBUG ((DEBUG_INFO, "OCPI: Indexed ESP has no file system, checking types\n"));
   }
 
   FreePool (Handles);
@@ -339,7 +819,16 @@ InternalGetDiskPartitions (
   UINT32                     PartEntrySize;
   UINTN                      PartEntriesSize;
   UINTN                      PartEntriesStructSize;
+  UINTN                      HashTableOffset;
+  UINT32                     HashTableSize;
+  UINTN                      ReadSize;
+  UINTN                      Prefetched;
+  UINT8                      *ReadBuffer;
   EFI_PARTITION_TABLE_HEADER *GptHeader;
+  EFI_PARTITION_ENTRY        *PartEntry;
+  INTERNAL_PARTITION_GUID_INDEX_ENTRY *IndexEntry;
+  UINT32                     Index;
+  UINT32                     Slot;
 
   ASSERT (DiskHandle != NULL);
   //
@@ -405,15 +894,6 @@ InternalGetDiskPartitions (
       ));
     return NULL;
   }
-  //
-  // Retrieve the GPT header.
-  //
-  GptHeader = AllocatePool (sizeof (*GptHeader));
-  if (GptHeader == NULL) {
-    DEBUG ((DEBUG_INFO, "OCPI: GPT header allocation error\n"));
-    return NULL;
-  }
-
   if (HasBlockIo2) {
     BlockSize = BlockIo2->Media->BlockSize;
     MediaId   = BlockIo2->Media->MediaId;
@@ -422,29 +902,62 @@ InternalGetDiskPartitions (
     MediaId   = BlockIo->Media->MediaId;
   }
 
+  if (BlockSize < sizeof (*GptHeader)) {
+    DEBUG ((DEBUG_INFO, "OCPI: Block size %u is not supported\n", BlockSize));
+    return NULL;
+  }
+  //
+  // Retrieve the GPT header along with the partition entries that usually
+  // follow it right away.
+  //
+  ReadSize   = BlockSize + INTERNAL_GPT_PREFETCH_ENTRIES_SIZE;
+  ReadBuffer = AllocatePool (ReadSize);
+  if (ReadBuffer == NULL) {
+    DEBUG ((DEBUG_INFO, "OCPI: GPT header allocation error\n"));
+    return NULL;
+  }
+
   Status = InternalReadDisk (
              DiskIo,
              DiskIo2,
              MediaId,
              (PRIMARY_PART_HEADER_LBA * BlockSize),
-             sizeof (*GptHeader),
-             GptHeader
+             ReadSize,
+             ReadBuffer
              );
+  Prefetched = ReadSize;
+  if (EFI_ERROR (Status)) {
+    //
+    // The disk may be too small for the prefetch, retry with the header only.
+    //
+    ReadSize   = sizeof (*GptHeader);
+    Prefetched = 0;
+    Status = InternalReadDisk (
+               DiskIo,
+               DiskIo2,
+               MediaId,
+               (PRIMARY_PART_HEADER_LBA * BlockSize),
+               ReadSize,
+               ReadBuffer
+               );
+  }
   if (EFI_ERROR (Status)) {
-    FreePool (GptHeader);
+    FreePool (ReadBuffer);
     DEBUG ((DEBUG_INFO, "OCPI: ReadDisk1 %r\n", Status));
     return NULL;
   }
 
+  GptHeader = (EFI_PARTITION_TABLE_HEADER *)ReadBuffer;
+
   if (GptHeader->Header.Signature != EFI_PTAB_HEADER_ID) {
-    FreePool (GptHeader);
+    FreePool (ReadBuffer);
     DEBUG ((DEBUG_INFO, "OCPI: Partition table not supported\n"));
     return NULL;
   }
 
   PartEntrySize = GptHeader->SizeOfPartitionEntry;
   if (PartEntrySize < sizeof (EFI_PARTITION_ENTRY)) {
-    FreePool (GptHeader);
+    FreePool (ReadBuffer);
     DEBUG ((DEBUG_INFO, "OCPI: GPT header is malformed\n"));
     return NULL;
   }
@@ -452,48 +965,105 @@ InternalGetDiskPartitions (
   NumPartitions = GptHeader->NumberOfPartitionEntries;
   PartEntryLBA  = GptHeader->PartitionEntryLBA;
 
-  FreePool (GptHeader);
-
   Result = OcOverflowMulUN (NumPartitions, PartEntrySize, &PartEntriesSize);
+  //
+  // Hash with at least twice as many slots as there are partitions.
+  //
+  if (!Result) {
+    Result = NumPartitions > BASE_1GB / sizeof (UINT32);
+  }
   if (Result) {
+    FreePool (ReadBuffer);
     DEBUG ((DEBUG_INFO, "OCPI: Partition entries size overflows\n"));
     return NULL;
   }
 
-  Result = OcOverflowAddUN (
-             sizeof (PartEntries),
-             PartEntriesSize,
-             &PartEntriesStructSize
-             );
+  HashTableSize   = GetPowerOfTwo32 (MAX (NumPartitions, 8U) * 2 - 1) * 2;
+  HashTableOffset = ALIGN_VALUE (sizeof (*PartEntries) + PartEntriesSize, sizeof (UINT32));
+
+  Result = HashTableOffset < PartEntriesSize
+    || OcOverflowAddUN (
+         HashTableOffset,
+         HashTableSize * sizeof (UINT32),
+         &PartEntriesStructSize
+         );
   if (Result) {
+    FreePool (ReadBuffer);
     DEBUG ((DEBUG_INFO, "OCPI: Partition entries struct size overflows\n"));
     return NULL;
   }
   //
   // Retrieve the GPT partition entries.
   //
-  PartEntries = AllocatePool (PartEntriesStructSize);
+  PartEntries = AllocateZeroPool (PartEntriesStructSize);
   if (PartEntries == NULL) {
+    FreePool (ReadBuffer);
     DEBUG ((DEBUG_INFO, "OCPI: Partition entries allocation error\n"));
     return NULL;
   }
 
-  Status = InternalReadDisk (
-             DiskIo,
-             DiskIo2,
-             MediaId,
-             MultU64x32 (PartEntryLBA, BlockSize),
-             PartEntriesSize,
-             PartEntries->FirstEntry
-             );
-  if (EFI_ERROR (Status)) {
-    FreePool (PartEntries);
-    DEBUG ((DEBUG_INFO, "OCPI: ReadDisk2 %r\n", Status));
-    return NULL;
+  if (PartEntryLBA == PRIMARY_PART_HEADER_LBA + 1
+    && Prefetched >= BlockSize
+    && PartEntriesSize <= Prefetched - BlockSize) {
+    CopyMem (PartEntries->FirstEntry, ReadBuffer + BlockSize, PartEntriesSize);
+  } else {
+    Status = InternalReadDisk (
+               DiskIo,
+               DiskIo2,
+               MediaId,
+               MultU64x32 (PartEntryLBA, BlockSize),
+               PartEntriesSize,
+               PartEntries->FirstEntry
+               );
+    if (EFI_ERROR (Status)) {
+      FreePool (ReadBuffer);
+      FreePool (PartEntries);
+      DEBUG ((DEBUG_INFO, "OCPI: ReadDisk2 %r\n", Status));
+      return NULL;
+    }
   }
 
+  FreePool (ReadBuffer);
+
   PartEntries->NumPartitions      = NumPartitions;
   PartEntries->PartitionEntrySize = PartEntrySize;
+  PartEntries->EspIndex           = MAX_UINT32;
+  PartEntries->HashMask           = HashTableSize - 1;
+  PartEntries->HashTable          = (UINT32 *)((UINTN)PartEntries + HashTableOffset);
+  //
+  // Index the used partitions by their unique GUID, both per disk and globally.
+  //
+  for (Index = 0; Index < NumPartitions; ++Index) {
+    PartEntry = (EFI_PARTITION_ENTRY *)(
+                  (UINTN)PartEntries->FirstEntry + (UINTN)Index * PartEntrySize
+                  );
+    if (IsZeroGuid (&PartEntry->PartitionTypeGUID)
+      || IsZeroGuid (&PartEntry->UniquePartitionGUID)) {
+      continue;
+    }
+
+    if (PartEntries->EspIndex == MAX_UINT32
+      && CompareGuid (&PartEntry->PartitionTypeGUID, &gEfiPartTypeSystemPartGuid)) {
+      PartEntries->EspIndex = Index;
+    }
+
+    if (InternalFindDiskPartition (PartEntries, &PartEntry->UniquePartitionGUID) != MAX_UINT32) {
+      DEBUG ((DEBUG_INFO, "OCPI: Duplicate partition GUID %g\n", &PartEntry->UniquePartitionGUID));
+      continue;
+    }
+
+    Slot = InternalHashPartitionGuid (&PartEntry->UniquePartitionGUID) & PartEntries->HashMask;
+    while (PartEntries->HashTable[Slot] != 0) {
+      Slot = (Slot + 1) & PartEntries->HashMask;
+    }
+    PartEntries->HashTable[Slot] = Index + 1;
+
+    IndexEntry = InternalPartitionGuidIndexInsert (&PartEntry->UniquePartitionGUID);
+    if (IndexEntry != NULL && IndexEntry->DiskHandle == NULL) {
+      IndexEntry->DiskHandle  = DiskHandle;
+      IndexEntry->HasBlockIo2 = HasBlockIo2;
+    }
+  }
   //
   // FIXME: This causes the handle to be dangling if the device is detached.
   //
@@ -532,6 +1102,9 @@ OcGetGptPartitionEntry (
   EFI_HANDLE                       DiskHandle;
   BOOLEAN                          HasBlockIo2;
   UINTN                            Offset;
+  UINTN                            HdNodeOffset;
+  CONST GUID                       *PartitionGuid;
+  UINT32                           PartitionIndex;
 
   ASSERT (FsHandle != NULL);
 
@@ -565,36 +1138,66 @@ OcGetGptPartitionEntry (
     return NULL;
   }
 
-  DiskHandle = InternalPartitionGetDiskHandle (
-                 FsDevicePath,
-                 (UINTN)HdNode - (UINTN)FsDevicePath,
-                 &HasBlockIo2
-                 );
-  if (DiskHandle == NULL) {
-    DebugPrintDevicePath (
-      DEBUG_INFO,
-      "OCPI: Could not locate partition's disk",
-      FsDevicePath
-      );
-    return NULL;
-  }
+  HdNodeOffset  = (UINTN)HdNode - (UINTN)FsDevicePath;
+  PartitionGuid = InternalGetPartitionGuid (FsDevicePath);
   //
-  // Get the disk's GPT partition entries.
+  // Partitions of an already read disk are indexed by GUID, which avoids
+  // the disk Device Path location.
   //
-  Partitions = InternalGetDiskPartitions (DiskHandle, HasBlockIo2);
+  Partitions = NULL;
+  if (PartitionGuid != NULL) {
+    Partitions = InternalPartitionGuidGetDiskPartitions (
+                   FsDevicePath,
+                   HdNodeOffset,
+                   PartitionGuid
+                   );
+  }
+
   if (Partitions == NULL) {
-    DEBUG ((DEBUG_INFO, "OCPI: Failed to retrieve disk info\n"));
-    return NULL;
+    DiskHandle = InternalPartitionGetDiskHandle (
+                   FsDevicePath,
+                   HdNodeOffset,
+                   &HasBlockIo2
+                   );
+    if (DiskHandle == NULL) {
+      DebugPrintDevicePath (
+        DEBUG_INFO,
+        "OCPI: Could not locate partition's disk",
+        FsDevicePath
+        );
+      return NULL;
+    }
+    //
+    // Get the disk's GPT partition entries.
+    //
+    Partitions = InternalGetDiskPartitions (DiskHandle, HasBlockIo2);
+    if (Partitions == NULL) {
+      DEBUG ((DEBUG_INFO, "OCPI: Failed to retrieve disk info\n"));
+      return NULL;
+    }
   }
 
-  if (HdNode->PartitionNumber > Partitions->NumPartitions) {
-    DEBUG ((DEBUG_INFO, "OCPI: Partition is OOB\n"));
-    return NULL;
+  PartitionIndex = MAX_UINT32;
+  if (PartitionGuid != NULL) {
+    PartitionIndex = InternalFindDiskPartition (Partitions, PartitionGuid);
   }
 
-  ASSERT (HdNode->PartitionNumber > 0);
-  Offset = ((UINTN)(HdNode->PartitionNumber - 1) * Partitions->PartitionEntrySize);
+  if (PartitionIndex == MAX_UINT32) {
+    if (HdNode->PartitionNumber > Partitions->NumPartitions) {
+      DEBUG ((DEBUG_INFO, "OCPI: Partition is OOB\n"));
+      return NULL;
+    }
+
+    ASSERT (HdNode->PartitionNumber > 0);
+    PartitionIndex = HdNode->PartitionNumber - 1;
+  }
+
+  Offset = ((UINTN)PartitionIndex * Partitions->PartitionEntrySize);
   PartEntry = (EFI_PARTITION_ENTRY *)((UINTN)Partitions->FirstEntry + Offset);
+
+  if (PartitionGuid != NULL) {
+    InternalPartitionGuidSetFsHandle (PartitionGuid, FsHandle);
+  }
   //
   // FIXME: This causes the handle to be dangling if the device is detached.
   //
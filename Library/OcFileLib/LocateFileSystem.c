@@ -25,6 +25,8 @@
 #include <Library/OcFileLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
+#include "OcFileLibInternal.h"
+
 EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *
 LocateFileSystem (
   IN  EFI_HANDLE                         DeviceHandle  OPTIONAL,
@@ -115,13 +117,29 @@ LocateFileSystemByGuid (
 
   UINTN                           NumHandles;
   EFI_HANDLE                      *HandleBuffer;
+  EFI_HANDLE                      Handle;
   UINTN                           Index;
 
   EFI_DEVICE_PATH_PROTOCOL        *DevicePath;
-  CONST HARDDRIVE_DEVICE_PATH     *HardDrive;
+  CONST GUID                      *PartitionGuid;
 
   ASSERT (Guid != NULL);
 
+  //
+  // Partitions seen before are found through the GUID index.
+  //
+  Handle = InternalPartitionGuidGetFsHandle (Guid);
+  if (Handle != NULL) {
+    Status = gBS->HandleProtocol (
+                    Handle,
+                    &gEfiSimpleFileSystemProtocolGuid,
+                    (VOID **)&SimpleFs
+                    );
+    if (!EFI_ERROR (Status)) {
+      return SimpleFs;
+    }
+  }
+
   Status = gBS->LocateHandleBuffer (
                   ByProtocol,
                   &gEfiSimpleFileSystemProtocolGuid,
@@ -135,6 +153,10 @@ LocateFileSystemByGuid (
 
   SimpleFs = NULL;
 
+  //
+  // Index every partition on the way, so that later lookups of other
+  // volumes need no scan either.
+  //
   for (Index = 0; Index < NumHandles; ++Index) {
     Status = gBS->HandleProtocol (
                     HandleBuffer[Index],
@@ -145,18 +167,14 @@ LocateFileSystemByGuid (
       continue;
     }
 
-    HardDrive = (HARDDRIVE_DEVICE_PATH *)(
-                  FindDevicePathNodeWithType (
-                    DevicePath,
-                    MEDIA_DEVICE_PATH,
-                    MEDIA_HARDDRIVE_DP
-                    )
-                  );
-    if ((HardDrive == NULL) || (HardDrive->SignatureType != 0x02)) {
+    PartitionGuid = InternalGetPartitionGuid (DevicePath);
+    if (PartitionGuid == NULL) {
       continue;
     }
 
-    if (CompareGuid (Guid, (GUID *)HardDrive->Signature)) {
+    InternalPartitionGuidSetFsHandle (PartitionGuid, HandleBuffer[Index]);
+
+    if (SimpleFs == NULL && CompareGuid (Guid, PartitionGuid)) {
       Status = gBS->HandleProtocol (
                       HandleBuffer[Index],
                       &gEfiSimpleFileSystemProtocolGuid,
@@ -165,8 +183,6 @@ LocateFileSystemByGuid (
       if (EFI_ERROR (Status)) {
         SimpleFs = NULL;
       }
-
-      break;
     }
   }
 
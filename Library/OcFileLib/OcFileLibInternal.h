@@ -0,0 +1,58 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#ifndef OC_FILE_LIB_INTERNAL_H
+#define OC_FILE_LIB_INTERNAL_H
+
+#include <Uefi.h>
+#include <Protocol/DevicePath.h>
+
+/**
+  Retrieve the GPT unique partition GUID from a partition's Device Path.
+
+  @param[in] DevicePath  The Device Path of the partition.
+
+  @retval partition GUID or NULL when the Device Path has no GPT HD node.
+**/
+CONST GUID *
+InternalGetPartitionGuid (
+  IN EFI_DEVICE_PATH_PROTOCOL  *DevicePath
+  );
+
+/**
+  Retrieve the last known file system handle of a partition.
+  The handle is validated to still describe the partition.
+
+  @param[in] PartitionGuid  The unique GUID of the partition.
+
+  @retval file system handle or NULL.
+**/
+EFI_HANDLE
+InternalPartitionGuidGetFsHandle (
+  IN CONST GUID  *PartitionGuid
+  );
+
+/**
+  Remember the file system handle of a partition.
+
+  @param[in] PartitionGuid  The unique GUID of the partition.
+  @param[in] FsHandle       The file system handle of the partition.
+**/
+VOID
+InternalPartitionGuidSetFsHandle (
+  IN CONST GUID  *PartitionGuid,
+  IN EFI_HANDLE  FsHandle
+  );
+
+#endif // OC_FILE_LIB_INTERNAL_H
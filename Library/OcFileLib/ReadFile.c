@@ -29,6 +29,170 @@
 #include <Library/OcFileLib.h>
 #include <Library/OcGuardLib.h>
 
+//
+// File information with room for common file names, so that the file
+// can be sized with a single request.
+//
+typedef struct {
+  EFI_FILE_INFO  FileInfo;
+  CHAR16         FileName[256];
+} INTERNAL_FILE_INFO;
+
+/**
+  Determine file size from file information without changing file position.
+
+  @param[in]  File         A pointer to the file protocol.
+  @param[out] Size         32-bit file size.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
+EFI_STATUS
+InternalGetFileSizeFromInfo (
+  IN  EFI_FILE_PROTOCOL  *File,
+  OUT UINT32             *Size
+  )
+{
+  EFI_STATUS          Status;
+  INTERNAL_FILE_INFO  FileInfo;
+  UINTN               FileInfoSize;
+
+  FileInfoSize = sizeof (FileInfo);
+  Status = File->GetInfo (File, &gEfiFileInfoGuid, &FileInfoSize, &FileInfo);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (FileInfoSize < SIZE_OF_EFI_FILE_INFO
+    || (UINT32) FileInfo.FileInfo.FileSize != FileInfo.FileInfo.FileSize) {
+    return EFI_UNSUPPORTED;
+  }
+
+  *Size = (UINT32) FileInfo.FileInfo.FileSize;
+  return EFI_SUCCESS;
+}
+
+VOID *
+OcGetFileContents (
+  IN  EFI_FILE_PROTOCOL  *File,
+  OUT UINT32             *FileSize    OPTIONAL,
+  IN  UINT32             MaxFileSize  OPTIONAL
+  )
+{
+  EFI_STATUS  Status;
+  UINT8       *FileBuffer;
+  UINT8       *NewBuffer;
+  UINT32      FileBufferSize;
+  UINT32      FileReadSize;
+  UINT32      TotalSize;
+  UINTN       ReadSize;
+  BOOLEAN     HasPosition;
+
+  ASSERT (File != NULL);
+
+  //
+  // Most files fit the read-ahead window, read them in one request without
+  // sizing. Request one extra byte to tell files of window size apart.
+  //
+  FileBufferSize = OC_FILE_READER_WINDOW_SIZE + 1;
+  if (MaxFileSize > 0 && MaxFileSize < OC_FILE_READER_WINDOW_SIZE) {
+    FileBufferSize = MaxFileSize + 1;
+  }
+
+  FileBuffer = AllocatePool (FileBufferSize + sizeof (CHAR16));
+  if (FileBuffer == NULL) {
+    return NULL;
+  }
+
+  Status = File->SetPosition (File, 0);
+  if (EFI_ERROR (Status)) {
+    FreePool (FileBuffer);
+    return NULL;
+  }
+
+  ReadSize = FileBufferSize;
+  Status = File->Read (File, &ReadSize, FileBuffer);
+  if (EFI_ERROR (Status) || ReadSize > FileBufferSize) {
+    FreePool (FileBuffer);
+    return NULL;
+  }
+
+  FileReadSize = (UINT32) ReadSize;
+
+  if (FileReadSize == FileBufferSize) {
+    //
+    // The file is larger than the window, size it and read the rest.
+    // Sizing through file information keeps the position after the read
+    // data, fall back to seeking when it is not available.
+    //
+    HasPosition = TRUE;
+    Status = InternalGetFileSizeFromInfo (File, &TotalSize);
+    if (EFI_ERROR (Status)) {
+      HasPosition = FALSE;
+      Status = GetFileSize (File, &TotalSize);
+    }
+
+    if (EFI_ERROR (Status)
+      || TotalSize < FileReadSize
+      || OcOverflowAddU32 (TotalSize, sizeof (CHAR16), &FileBufferSize)
+      || (MaxFileSize > 0 && TotalSize > MaxFileSize)) {
+      FreePool (FileBuffer);
+      return NULL;
+    }
+
+    NewBuffer = ReallocatePool (FileReadSize + sizeof (CHAR16), FileBufferSize, FileBuffer);
+    if (NewBuffer == NULL) {
+      FreePool (FileBuffer);
+      return NULL;
+    }
+
+    FileBuffer = NewBuffer;
+
+    if (HasPosition) {
+      ReadSize = TotalSize - FileReadSize;
+      Status = File->Read (File, &ReadSize, &FileBuffer[FileReadSize]);
+      if (!EFI_ERROR (Status) && ReadSize != TotalSize - FileReadSize) {
+        Status = EFI_BAD_BUFFER_SIZE;
+      }
+    } else {
+      Status = GetFileData (
+        File,
+        FileReadSize,
+        TotalSize - FileReadSize,
+        &FileBuffer[FileReadSize]
+        );
+    }
+
+    if (EFI_ERROR (Status)) {
+      FreePool (FileBuffer);
+      return NULL;
+    }
+
+    FileReadSize = TotalSize;
+  } else if (FileReadSize < FileBufferSize / 2) {
+    //
+    // Do not keep the unused part of the window allocated.
+    //
+    NewBuffer = ReallocatePool (
+      FileBufferSize + sizeof (CHAR16),
+      FileReadSize + sizeof (CHAR16),
+      FileBuffer
+      );
+    if (NewBuffer != NULL) {
+      FileBuffer = NewBuffer;
+    }
+  }
+
+  FileBuffer[FileReadSize]     = 0;
+  FileBuffer[FileReadSize + 1] = 0;
+
+  if (FileSize != NULL) {
+    *FileSize = FileReadSize;
+  }
+
+  return FileBuffer;
+}
+
 VOID *
 ReadFile (
   IN  EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *FileSystem,
@@ -41,8 +205,6 @@ ReadFile (
   EFI_FILE_HANDLE                 Volume;
   EFI_FILE_HANDLE                 FileHandle;
   UINT8                           *FileBuffer;
-  UINT32                          FileBufferSize;
-  UINT32                          FileReadSize;
 
   ASSERT (FileSystem != NULL);
   ASSERT (FilePath != NULL);
@@ -69,37 +231,7 @@ ReadFile (
     return NULL;
   }
 
-  Status = GetFileSize (
-    FileHandle,
-    &FileReadSize
-    );
-  if (EFI_ERROR (Status)
-    || OcOverflowAddU32 (FileReadSize, sizeof (CHAR16), &FileBufferSize)
-    || (MaxFileSize > 0 && FileReadSize > MaxFileSize)) {
-    FileHandle->Close (FileHandle);
-    return NULL;
-  }
-
-  FileBuffer = AllocatePool (FileBufferSize);
-  if (FileBuffer != NULL) {
-    Status = GetFileData (
-      FileHandle,
-      0,
-      FileReadSize,
-      FileBuffer
-      );
-
-    if (!EFI_ERROR (Status)) {
-      FileBuffer[FileReadSize] = 0;
-      FileBuffer[FileReadSize + 1] = 0;
-      if (FileSize != NULL) {
-        *FileSize = FileReadSize;
-      }
-    } else {
-      FreePool (FileBuffer);
-      FileBuffer = NULL;
-    }
-  }
+  FileBuffer = OcGetFileContents (FileHandle, FileSize, MaxFileSize);
 
   FileHandle->Close (FileHandle);
   return FileBuffer;
@@ -147,5 +279,6 @@ ReadFileSize (
     Size
     );
 
+  FileHandle->Close (FileHandle);
   return Status;
 }
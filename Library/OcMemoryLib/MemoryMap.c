@@ -105,9 +105,11 @@ GetCurrentMemoryMapAlloc (
 {
   EFI_STATUS           Status;
   EFI_PHYSICAL_ADDRESS MemoryMapAlloc;
+  EFI_PHYSICAL_ADDRESS TopAddress;
 
   *MemoryMapSize = 0;
   *MemoryMap     = NULL;
+  TopAddress     = 0;
 
   if (GetMemoryMap == NULL) {
     GetMemoryMap = gBS->GetMemoryMap;
@@ -126,6 +128,13 @@ GetCurrentMemoryMapAlloc (
     return Status;
   }
 
+  if (TopMemory != NULL) {
+    //
+    // TopMemory is overwritten with the page count below, keep the address for retries.
+    //
+    TopAddress = *TopMemory;
+  }
+
   do {
     //
     // This is done because extra allocations may increase memory map size.
@@ -137,7 +146,7 @@ GetCurrentMemoryMapAlloc (
     // This may be needed, because the pool memory may collide with the kernel.
     //
     if (TopMemory != NULL) {
-      MemoryMapAlloc = *TopMemory;
+      MemoryMapAlloc = TopAddress;
       *TopMemory     = EFI_SIZE_TO_PAGES (*MemoryMapSize);
 
       Status = AllocatePagesFromTop (
@@ -192,6 +201,30 @@ GetCurrentMemoryMapAlloc (
   return Status;
 }
 
+/**
+  Check whether memory descriptor type can be joined by ShrinkMemoryMap.
+
+  @param[in]  Type  Memory descriptor type.
+
+  @retval TRUE when the type is not used after ExitBootServices.
+**/
+STATIC
+BOOLEAN
+IsJoinableMemoryType (
+  IN UINT32  Type
+  )
+{
+  //
+  // It *should* be safe to join this with conventional memory, because the firmware should not use
+  // GetMemoryMap for allocation, and for the kernel it does not matter, since it joins them.
+  //
+  return Type == EfiBootServicesCode
+    || Type == EfiBootServicesData
+    || Type == EfiConventionalMemory
+    || Type == EfiLoaderCode
+    || Type == EfiLoaderData;
+}
+
 VOID
 ShrinkMemoryMap (
   IN OUT UINTN                  *MemoryMapSize,
@@ -199,66 +232,88 @@ ShrinkMemoryMap (
   IN     UINTN                  DescriptorSize
   )
 {
-  UINTN                   SizeFromDescToEnd;
-  UINT64                  Bytes;
+  EFI_MEMORY_DESCRIPTOR   *MemoryMapEnd;
   EFI_MEMORY_DESCRIPTOR   *PrevDesc;
   EFI_MEMORY_DESCRIPTOR   *Desc;
-  BOOLEAN                 CanBeJoined;
-  BOOLEAN                 HasEntriesToRemove;
-
-  PrevDesc           = MemoryMap;
-  Desc               = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
-  SizeFromDescToEnd  = *MemoryMapSize - DescriptorSize;
-  *MemoryMapSize     = DescriptorSize;
-  HasEntriesToRemove = FALSE;
-
-  while (SizeFromDescToEnd > 0) {
-    Bytes = EFI_PAGES_TO_SIZE (PrevDesc->NumberOfPages);
-    CanBeJoined = FALSE;
-    if (Desc->Attribute == PrevDesc->Attribute
-      && PrevDesc->PhysicalStart + Bytes == Desc->PhysicalStart) {
-      //
-      // It *should* be safe to join this with conventional memory, because the firmware should not use
-      // GetMemoryMap for allocation, and for the kernel it does not matter, since it joins them.
-      //
-      CanBeJoined = (Desc->Type == EfiBootServicesCode ||
-        Desc->Type == EfiBootServicesData ||
-        Desc->Type == EfiConventionalMemory ||
-        Desc->Type == EfiLoaderCode ||
-        Desc->Type == EfiLoaderData) && (
-        PrevDesc->Type == EfiBootServicesCode ||
-        PrevDesc->Type == EfiBootServicesData ||
-        PrevDesc->Type == EfiConventionalMemory ||
-        PrevDesc->Type == EfiLoaderCode ||
-        PrevDesc->Type == EfiLoaderData);
-    }
 
-    if (CanBeJoined) {
+  if (*MemoryMapSize < DescriptorSize) {
+    return;
+  }
+
+  //
+  // Compact the map in a single pass: PrevDesc is the last written descriptor,
+  // Desc is the descriptor being read. Joined descriptors are never moved,
+  // every other descriptor is copied at most once right after PrevDesc.
+  //
+  MemoryMapEnd   = NEXT_MEMORY_DESCRIPTOR (MemoryMap, *MemoryMapSize);
+  PrevDesc       = MemoryMap;
+  Desc           = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+  *MemoryMapSize = DescriptorSize;
+
+  for (; Desc < MemoryMapEnd; Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize)) {
+    if (Desc->Attribute == PrevDesc->Attribute
+      && PrevDesc->PhysicalStart + EFI_PAGES_TO_SIZE (PrevDesc->NumberOfPages) == Desc->PhysicalStart
+      && IsJoinableMemoryType (Desc->Type)
+      && IsJoinableMemoryType (PrevDesc->Type)) {
       //
       // Two entries are the same/similar - join them
       //
       PrevDesc->Type           = EfiConventionalMemory;
       PrevDesc->NumberOfPages += Desc->NumberOfPages;
-      HasEntriesToRemove       = TRUE;
     } else {
       //
       // Cannot be joined - we need to move to next
       //
       *MemoryMapSize += DescriptorSize;
       PrevDesc        = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
-      if (HasEntriesToRemove) {
-        //
-        // Have entries between PrevDesc and Desc which are joined to PrevDesc,
-        // we need to copy [Desc, end of list] to PrevDesc + 1
-        //
-        CopyMem (PrevDesc, Desc, SizeFromDescToEnd);
-        Desc = PrevDesc;
-        HasEntriesToRemove = FALSE;
+      if (PrevDesc != Desc) {
+        CopyMem (PrevDesc, Desc, DescriptorSize);
       }
     }
+  }
+}
 
-    Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize);
-    SizeFromDescToEnd -= DescriptorSize;
+VOID
+SortMemoryMap (
+  IN     UINTN                  MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  EFI_MEMORY_DESCRIPTOR   *MemoryMapEnd;
+  EFI_MEMORY_DESCRIPTOR   *Desc;
+  EFI_MEMORY_DESCRIPTOR   *PrevDesc;
+  UINT8                   *Left;
+  UINT8                   *Right;
+  UINT8                   Byte;
+  UINTN                   Index;
+
+  //
+  // Firmware memory maps are almost always sorted already or have a few
+  // entries out of order, so insertion sort is linear in practice and
+  // needs no descriptor-sized temporary storage.
+  //
+  MemoryMapEnd = NEXT_MEMORY_DESCRIPTOR (MemoryMap, MemoryMapSize - MemoryMapSize % DescriptorSize);
+
+  for (
+    Desc = NEXT_MEMORY_DESCRIPTOR (MemoryMap, DescriptorSize);
+    Desc < MemoryMapEnd;
+    Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize)) {
+
+    for (
+      PrevDesc = Desc;
+      PrevDesc > MemoryMap
+        && PREV_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize)->PhysicalStart > PrevDesc->PhysicalStart;
+      PrevDesc = PREV_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize)) {
+
+      Left  = (UINT8 *) PREV_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+      Right = (UINT8 *) PrevDesc;
+      for (Index = 0; Index < DescriptorSize; ++Index) {
+        Byte         = Left[Index];
+        Left[Index]  = Right[Index];
+        Right[Index] = Byte;
+      }
+    }
   }
 }
 
@@ -279,6 +334,7 @@ AllocatePagesFromTop (
   UINT32                  DescriptorVersion;
   EFI_MEMORY_DESCRIPTOR   *MemoryMapEnd;
   EFI_MEMORY_DESCRIPTOR   *Desc;
+  EFI_PHYSICAL_ADDRESS    Address;
 
   Status = GetCurrentMemoryMapAlloc (
     &MemoryMapSize,
@@ -294,6 +350,12 @@ AllocatePagesFromTop (
     return Status;
   }
 
+  //
+  // Firmware memory maps are not guaranteed to be sorted, and walking
+  // an unsorted one backwards may not find the top-most block.
+  //
+  SortMemoryMap (MemoryMapSize, MemoryMap, DescriptorSize);
+
   Status = EFI_NOT_FOUND;
 
   MemoryMapEnd = NEXT_MEMORY_DESCRIPTOR (MemoryMap, MemoryMapSize);
@@ -314,18 +376,18 @@ AllocatePagesFromTop (
         //
         // The whole block is under Memory: allocate from the top of the block
         //
-        *Memory = Desc->PhysicalStart + EFI_PAGES_TO_SIZE (Desc->NumberOfPages - Pages);
+        Address = Desc->PhysicalStart + EFI_PAGES_TO_SIZE (Desc->NumberOfPages - Pages);
       } else {
         //
         // The block contains enough pages under Memory, but spans above it - allocate below Memory
         //
-        *Memory = *Memory - EFI_PAGES_TO_SIZE (Pages);
+        Address = *Memory - EFI_PAGES_TO_SIZE (Pages);
       }
 
       //
       // Ensure that the found block does not overlap with the restricted area.
       //
-      if (CheckRange != NULL && CheckRange (*Memory, EFI_PAGES_TO_SIZE (Pages))) {
+      if (CheckRange != NULL && CheckRange (Address, EFI_PAGES_TO_SIZE (Pages))) {
         continue;
       }
 
@@ -333,9 +395,13 @@ AllocatePagesFromTop (
         AllocateAddress,
         MemoryType,
         Pages,
-        Memory
+        &Address
         );
 
+      if (!EFI_ERROR (Status)) {
+        *Memory = Address;
+      }
+
       break;
     }
   }
@@ -51,9 +51,13 @@
  *                     - Made pool initialization external to avoid memset deps
  *                       and to support initialization state
  *                     - Switched to UEFI types, pragmas, renamed external API
+ *                     - Replaced the single free list with segregated size
+ *                       class lists and a bitmap of non-empty classes to make
+ *                       allocation and free O(1) in the common case
  * ----------------------------------------------------------------------------
  */
 
+#include <Library/BaseLib.h>
 #include <Library/OcMemoryLib.h>
 
 STATIC UINT8   *default_umm_heap;
@@ -62,8 +66,6 @@ STATIC UINT32  default_umm_heap_size;
 #define UMM_MALLOC_CFG_HEAP_SIZE default_umm_heap_size
 #define UMM_MALLOC_CFG_HEAP_ADDR default_umm_heap
 
-#define UMM_BEST_FIT
-
 #define DBGLOG_DEBUG(format, ...) do { } while (0)
 #define DBGLOG_TRACE(froamt, ...) do { } while (0)
 
@@ -113,6 +115,72 @@ UINT32 umm_numblocks = 0;
 
 /* ------------------------------------------------------------------------ */
 
+/*
+ * Free blocks are kept in segregated lists by their size in blocks. Classes
+ * below UMM_EXACT_CLASSES hold blocks of exactly (class + 1) blocks, the rest
+ * hold blocks within [2^(class - UMM_CLASS_SHIFT), 2^(class - UMM_CLASS_SHIFT + 1)),
+ * and the last class holds everything larger.
+ *
+ * The heads of the lists are the body free pointers of the first
+ * UMM_FREE_CLASSES blocks, which are all covered by the 0th `umm_block`.
+ * Each list is circular with its head acting as the sentinel, so that
+ * disconnecting a block never needs to know which class it is in.
+ *
+ * umm_free_bitmap has a bit set for every non-empty class, so looking up
+ * a class with a block large enough is a single bit scan.
+ */
+
+#define UMM_FREE_CLASSES  32
+#define UMM_EXACT_CLASSES 16
+#define UMM_CLASS_SHIFT   12
+
+STATIC UINT32 umm_free_bitmap;
+
+/* ------------------------------------------------------------------------ */
+
+STATIC UINT32 umm_block_size( UINT32 c ) {
+  return (UMM_NBLOCK(c) & UMM_BLOCKNO_MASK) - c;
+}
+
+/* ------------------------------------------------------------------------ */
+
+STATIC UINT32 umm_size_class( UINT32 blocks ) {
+  UINT32 cls;
+
+  if( blocks <= UMM_EXACT_CLASSES )
+    return( blocks - 1 );
+
+  cls = UMM_CLASS_SHIFT + (UINT32) HighBitSet32( blocks );
+
+  if( cls >= UMM_FREE_CLASSES )
+    return( UMM_FREE_CLASSES - 1 );
+
+  return( cls );
+}
+
+/* ------------------------------------------------------------------------ */
+
+STATIC VOID umm_connect_to_free_list( UINT32 c ) {
+  UINT32 cls;
+
+  /* Add this block to the head of the list of its class */
+
+  cls = umm_size_class( umm_block_size(c) );
+
+  UMM_NFREE(c)            = UMM_NFREE(cls);
+  UMM_PFREE(c)            = cls;
+  UMM_PFREE(UMM_NFREE(c)) = c;
+  UMM_NFREE(cls)          = c;
+
+  umm_free_bitmap |= 1U << cls;
+
+  /* And set the free block indicator */
+
+  UMM_NBLOCK(c) |= UMM_FREELIST_MASK;
+}
+
+/* ------------------------------------------------------------------------ */
+
 STATIC UINT32 umm_blocks( UINT32 size ) {
 
   /*
@@ -160,11 +228,20 @@ STATIC VOID umm_split_block( UINT32 c,
 /* ------------------------------------------------------------------------ */
 
 STATIC VOID umm_disconnect_from_free_list( UINT32 c ) {
+  UINT32 cls;
+
   /* Disconnect this block from the FREE list */
 
   UMM_NFREE(UMM_PFREE(c)) = UMM_NFREE(c);
   UMM_PFREE(UMM_NFREE(c)) = UMM_PFREE(c);
 
+  /* Mark the class empty if this was its last block */
+
+  cls = umm_size_class( umm_block_size(c) );
+
+  if( UMM_NFREE(cls) == cls )
+    umm_free_bitmap &= ~(1U << cls);
+
   /* And clear the free block indicator */
 
   UMM_NBLOCK(c) &= (~UMM_FREELIST_MASK);
@@ -212,6 +289,8 @@ STATIC UINT32 umm_assimilate_down( UINT32 c, UINT32 freemask ) {
 /* ------------------------------------------------------------------------ */
 
 VOID umm_init( VOID ) {
+  UINT32 cls;
+
   /* init heap pointer and size, and memset it to 0 */
   umm_heap = (umm_block *)UMM_MALLOC_CFG_HEAP_ADDR;
   umm_numblocks = (UMM_MALLOC_CFG_HEAP_SIZE / sizeof(umm_block));
@@ -221,42 +300,42 @@ VOID umm_init( VOID ) {
    * memset(umm_heap, 0x00, UMM_MALLOC_CFG_HEAP_SIZE);
    */
 
+  /* setup empty free lists, each head points to itself */
+  for( cls = 0; cls < UMM_FREE_CLASSES; ++cls ) {
+    UMM_NFREE(cls) = cls;
+    UMM_PFREE(cls) = cls;
+  }
+
+  umm_free_bitmap = 0;
+
   /* setup initial blank heap structure */
   {
     /* index of the 0th `umm_block` */
     CONST UINT32 block_0th = 0;
-    /* index of the 1st `umm_block` */
-    CONST UINT32 block_1th = 1;
+    /* index of the 1st `umm_block` after the free list heads */
+    CONST UINT32 block_1th = UMM_FREE_CLASSES;
     /* index of the latest `umm_block` */
     CONST UINT32 block_last = UMM_NUMBLOCKS - 1;
 
-    /* setup the 0th `umm_block`, which just points to the 1st */
-    UMM_NBLOCK(block_0th) = block_1th;
-    UMM_NFREE(block_0th)  = block_1th;
-    UMM_PFREE(block_0th)  = block_1th;
-
     /*
-     * Now, we need to set the whole heap space as a huge free block. We should
-     * not touch the 0th `umm_block`, since it's special: the 0th `umm_block`
-     * is the head of the free block list. It's a part of the heap invariant.
-     *
-     * See the detailed explanation at the beginning of the file.
+     * setup the 0th `umm_block`, which spans all the free list heads and
+     * just points to the 1st. It is never free, so it is never assimilated.
      */
+    UMM_NBLOCK(block_0th) = block_1th;
+    UMM_PBLOCK(block_0th) = block_0th;
 
     /*
+     * Now, we need to set the whole heap space as a huge free block.
+     *
      * 1th `umm_block` has pointers:
      *
      * - next `umm_block`: the latest one
      * - prev `umm_block`: the 0th
      *
-     * Plus, it's a free `umm_block`, so we need to apply `UMM_FREELIST_MASK`
-     *
-     * And it's the last free block, so the next free block is 0.
+     * Plus, it's a free `umm_block`, so it goes to the list of its class.
      */
-    UMM_NBLOCK(block_1th) = block_last | UMM_FREELIST_MASK;
-    UMM_NFREE(block_1th)  = 0;
+    UMM_NBLOCK(block_1th) = block_last;
     UMM_PBLOCK(block_1th) = block_0th;
-    UMM_PFREE(block_1th)  = block_0th;
 
     /*
      * latest `umm_block` has pointers:
@@ -268,6 +347,8 @@ VOID umm_init( VOID ) {
      */
     UMM_NBLOCK(block_last) = 0;
     UMM_PBLOCK(block_last) = block_1th;
+
+    umm_connect_to_free_list( block_1th );
   }
 }
 
@@ -280,6 +361,13 @@ BOOLEAN UmmInitialized ( VOID ) {
 /* ------------------------------------------------------------------------ */
 
 VOID UmmSetHeap( VOID *heap, UINT32 size ) {
+  /* The heap must fit the free list heads, one free block and the last one */
+  if( size / sizeof(umm_block) < UMM_FREE_CLASSES + 2 ) {
+    default_umm_heap = NULL;
+    default_umm_heap_size = 0;
+    return;
+  }
+
   default_umm_heap = (UINT8 *)heap;
   default_umm_heap_size = size;
   umm_init();
@@ -331,28 +419,23 @@ BOOLEAN UmmFree( VOID *ptr ) {
 
   umm_assimilate_up( c );
 
-  /* Then assimilate with the previous block if possible */
+  /*
+   * Then assimilate with the previous block if possible. Its size changes,
+   * so it has to be moved to the list of its new class.
+   */
 
   if( UMM_NBLOCK(UMM_PBLOCK(c)) & UMM_FREELIST_MASK ) {
 
     DBGLOG_DEBUG( "Assimilate down to next block, which is FREE\n" );
 
-    c = umm_assimilate_down(c, UMM_FREELIST_MASK);
-  } else {
-    /*
-     * The previous block is not a free block, so add this one to the head
-     * of the free list
-     */
+    umm_disconnect_from_free_list( UMM_PBLOCK(c) );
 
-    DBGLOG_DEBUG( "Just add to head of free list\n" );
+    c = umm_assimilate_down(c, 0);
+  }
 
-    UMM_PFREE(UMM_NFREE(0)) = c;
-    UMM_NFREE(c)            = UMM_NFREE(0);
-    UMM_PFREE(c)            = 0;
-    UMM_NFREE(0)            = c;
+  DBGLOG_DEBUG( "Add to head of free list of its class\n" );
 
-    UMM_NBLOCK(c)          |= UMM_FREELIST_MASK;
-  }
+  umm_connect_to_free_list( c );
 
   /* Release the critical section... */
   UMM_CRITICAL_EXIT();
@@ -364,11 +447,13 @@ BOOLEAN UmmFree( VOID *ptr ) {
 
 VOID *UmmMalloc( UINT32 size ) {
   UINT32 blocks;
-  UINT32 blockSize = 0;
+  UINT32 blockSize;
 
   UINT32 bestSize;
   UINT32 bestBlock;
 
+  UINT32 cls;
+  UINT32 larger;
   UINT32 cf;
 
   /* If we are not initialised, reuturn false! */
@@ -392,96 +477,85 @@ VOID *UmmMalloc( UINT32 size ) {
   UMM_CRITICAL_ENTRY();
 
   blocks = umm_blocks( size );
+  cls    = umm_size_class( blocks );
 
-  /*
-   * Now we can scan through the free list until we find a space that's big
-   * enough to hold the number of blocks we need.
-   *
-   * This part may be customized to be a best-fit, worst-fit, or first-fit
-   * algorithm
-   */
+  bestBlock = 0;
+  bestSize  = 0x7FFFFFFF;
+
+  if( umm_free_bitmap & (1U << cls) ) {
+    if( cls < UMM_EXACT_CLASSES ) {
+      /* Every block in an exact class fits. */
+      bestBlock = UMM_NFREE(cls);
+      bestSize  = blocks;
+    } else {
+      /*
+       * Blocks in a ranged class may be smaller than requested, so scan it
+       * for the best fit. This is the only list that is ever scanned.
+       */
+      cf = UMM_NFREE(cls);
 
-  cf = UMM_NFREE(0);
+      while( cf != cls ) {
+        blockSize = umm_block_size( cf );
 
-  bestBlock = UMM_NFREE(0);
-  bestSize  = 0x7FFFFFFF;
+        DBGLOG_TRACE( "Looking at block %6i size %6i\n", cf, blockSize );
 
-  while( cf ) {
-    blockSize = (UMM_NBLOCK(cf) & UMM_BLOCKNO_MASK) - cf;
+        if( (blockSize >= blocks) && (blockSize < bestSize) ) {
+          bestBlock = cf;
+          bestSize  = blockSize;
 
-    DBGLOG_TRACE( "Looking at block %6i size %6i\n", cf, blockSize );
+          if( blockSize == blocks )
+            break;
+        }
 
-#if defined UMM_BEST_FIT
-    if( (blockSize >= blocks) && (blockSize < bestSize) ) {
-      bestBlock = cf;
-      bestSize  = blockSize;
+        cf = UMM_NFREE(cf);
+      }
     }
-#elif defined UMM_FIRST_FIT
-    /* This is the first block that fits! */
-    if( (blockSize >= blocks) )
-      break;
-#else
-#  error "No UMM_*_FIT is defined - check umm_malloc_cfg.h"
-#endif
-
-    cf = UMM_NFREE(cf);
-  }
-
-  if( 0x7FFFFFFF != bestSize ) {
-    cf        = bestBlock;
-    blockSize = bestSize;
   }
 
-  if( UMM_NBLOCK(cf) & UMM_BLOCKNO_MASK && blockSize >= blocks ) {
+  if( 0 == bestBlock ) {
     /*
-     * This is an existing block in the memory heap, we just need to split off
-     * what we need, unlink it from the free list and mark it as in use, and
-     * link the rest of the block back into the freelist as if it was a new
-     * block on the free list...
+     * Any block in a larger class fits, take the smallest non-empty class.
+     * Note, that 2U << 31 wraps to 0, which leaves no larger classes.
      */
+    larger = umm_free_bitmap & ~((2U << cls) - 1);
 
-    if( blockSize == blocks ) {
-      /* It's an exact fit and we don't neet to split off a block. */
-      DBGLOG_DEBUG( "Allocating %6i blocks starting at %6i - exact\n", blocks, cf );
+    if( 0 == larger ) {
+      /* Out of memory */
 
-      /* Disconnect this block from the FREE list */
+      DBGLOG_DEBUG(  "Can't allocate %5i blocks\n", blocks );
 
-      umm_disconnect_from_free_list( cf );
+      /* Release the critical section... */
+      UMM_CRITICAL_EXIT();
 
-    } else {
-      /* It's not an exact fit and we need to split off a block. */
-      DBGLOG_DEBUG( "Allocating %6i blocks starting at %6i - existing\n", blocks, cf );
+      return( (VOID *)NULL );
+    }
 
-      /*
-       * split current free block `cf` into two blocks. The first one will be
-       * returned to user, so it's not free, and the second one will be free.
-       */
-      umm_split_block( cf, blocks, UMM_FREELIST_MASK /*new block is free*/ );
+    bestBlock = UMM_NFREE((UINT32) LowBitSet32( larger ));
+    bestSize  = umm_block_size( bestBlock );
+  }
 
-      /*
-       * `umm_split_block()` does not update the free pointers (it affects
-       * only free flags), but effectively we've just moved beginning of the
-       * free block from `cf` to `cf + blocks`. So we have to adjust pointers
-       * to and from adjacent free blocks.
-       */
+  cf        = bestBlock;
+  blockSize = bestSize;
 
-      /* previous free block */
-      UMM_NFREE( UMM_PFREE(cf) ) = cf + blocks;
-      UMM_PFREE( cf + blocks ) = UMM_PFREE(cf);
+  /* Disconnect this block from the FREE list */
 
-      /* next free block */
-      UMM_PFREE( UMM_NFREE(cf) ) = cf + blocks;
-      UMM_NFREE( cf + blocks ) = UMM_NFREE(cf);
-    }
-  } else {
-    /* Out of memory */
+  umm_disconnect_from_free_list( cf );
 
-    DBGLOG_DEBUG(  "Can't allocate %5i blocks\n", blocks );
+  if( blockSize == blocks ) {
+    /* It's an exact fit and we don't neet to split off a block. */
+    DBGLOG_DEBUG( "Allocating %6i blocks starting at %6i - exact\n", blocks, cf );
+  } else {
+    /* It's not an exact fit and we need to split off a block. */
+    DBGLOG_DEBUG( "Allocating %6i blocks starting at %6i - existing\n", blocks, cf );
 
-    /* Release the critical section... */
-    UMM_CRITICAL_EXIT();
+    /*
+     * split current free block `cf` into two blocks. The first one will be
+     * returned to user, so it's not free, and the second one will be free
+     * and goes to the list of its own class.
+     */
+    umm_split_block( cf, blocks, 0 );
 
-    return( (VOID *)NULL );
+    umm_connect_to_free_list( cf + blocks );
   }
 
   /* Release the critical section... */
@@ -15,6 +15,9 @@
 
 #include <Uefi.h>
 
+#include <Register/Cpuid.h>
+
+#include <Library/BaseLib.h>
 #include <Library/UefiLib.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/OcDebugLogLib.h>
@@ -186,12 +189,50 @@ VmAllocatePages (
   return AllocatedPages;
 }
 
+/**
+  Check whether the processor supports 1 GB pages.
+
+  @retval TRUE when 1 GB pages can be used.
+**/
+STATIC
+BOOLEAN
+VmIsPage1GbSupported (
+  VOID
+  )
+{
+  UINT32                      MaxExtId;
+  CPUID_EXTENDED_CPU_SIG_EDX  ExtEdx;
+
+  AsmCpuid (CPUID_EXTENDED_FUNCTION, &MaxExtId, NULL, NULL, NULL);
+  if (MaxExtId < CPUID_EXTENDED_CPU_SIG) {
+    return FALSE;
+  }
+
+  AsmCpuid (CPUID_EXTENDED_CPU_SIG, NULL, NULL, NULL, &ExtEdx.Uint32);
+  return ExtEdx.Bits.Page1GB != 0;
+}
+
+/**
+  Map (remap) given page of BASE_4KB, BASE_2MB, or BASE_1GB size at physical
+  address to given virtual address in the specified page table. Both addresses
+  must be aligned to PageSize.
+
+  @param[in,out]  Context       Virtual memory pool context.
+  @param[in]      PageTable     Page table to update.
+  @param[in]      VirtualAddr   Virtual memory address to map at.
+  @param[in]      PhysicalAddr  Physical memory address to map from.
+  @param[in]      PageSize      Page size to map with.
+
+  @retval EFI_SUCCESS on success.
+**/
+STATIC
 EFI_STATUS
-VmMapVirtualPage (
+VmMapVirtualPageWithSize (
   IN OUT OC_VMEM_CONTEXT                 *Context,
-  IN OUT PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable  OPTIONAL,
+  IN OUT PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable,
   IN     EFI_VIRTUAL_ADDRESS             VirtualAddr,
-  IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr
+  IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr,
+  IN     UINT64                          PageSize
   )
 {
   EFI_PHYSICAL_ADDRESS            Start;
@@ -207,9 +248,9 @@ VmMapVirtualPage (
   PAGE_TABLE_1G_ENTRY             *PTE1G;
   UINTN                           Index;
 
-  if (PageTable == NULL) {
-    PageTable = GetCurrentPageTable (NULL);
-  }
+  ASSERT (PageSize == BASE_4KB || PageSize == BASE_2MB || PageSize == BASE_1GB);
+  ASSERT ((VirtualAddr & (PageSize - 1)) == 0);
+  ASSERT ((PhysicalAddr & (PageSize - 1)) == 0);
 
   VA.Uint64 = (UINT64) VirtualAddr;
 
@@ -276,6 +317,19 @@ VmMapVirtualPage (
   VAStart.Pg4K.PDPOffset = VA.Pg4K.PDPOffset;
   VAEnd.Pg4K.PDPOffset = VA.Pg4K.PDPOffset;
 
+  if (PageSize == BASE_1GB) {
+    //
+    // Put it to PDPE as 1 GB page. Any PDE array previously referenced
+    // stays in the pool unused, as pool memory is never returned.
+    //
+    PTE1G = (PAGE_TABLE_1G_ENTRY *) PDPE;
+    PTE1G->Uint64 = ((UINT64) PhysicalAddr) & PAGING_1G_ADDRESS_MASK_64;
+    PTE1G->Bits.ReadWrite = 1;
+    PTE1G->Bits.Present = 1;
+    PTE1G->Bits.MustBe1 = 1;
+    return EFI_SUCCESS;
+  }
+
   if (!PDPE->Bits.Present || (PDPE->Bits.MustBeZero & 0x1)) {
     PDE = (PAGE_MAP_AND_DIRECTORY_POINTER *) VmAllocatePages(Context, 1);
 
@@ -319,6 +373,18 @@ VmMapVirtualPage (
   VAStart.Pg4K.PDOffset = VA.Pg4K.PDOffset;
   VAEnd.Pg4K.PDOffset = VA.Pg4K.PDOffset;
 
+  if (PageSize == BASE_2MB) {
+    //
+    // Put it to PDE as 2 MB page.
+    //
+    PTE2M = (PAGE_TABLE_2M_ENTRY *) PDE;
+    PTE2M->Uint64 = ((UINT64) PhysicalAddr) & PAGING_2M_ADDRESS_MASK_64;
+    PTE2M->Bits.ReadWrite = 1;
+    PTE2M->Bits.Present = 1;
+    PTE2M->Bits.MustBe1 = 1;
+    return EFI_SUCCESS;
+  }
+
   if (!PDE->Bits.Present || (PDE->Bits.MustBeZero & 0x1)) {
     PTE4K = (PAGE_TABLE_4K_ENTRY *) VmAllocatePages (Context, 1);
 
@@ -371,6 +437,27 @@ VmMapVirtualPage (
   return EFI_SUCCESS;
 }
 
+EFI_STATUS
+VmMapVirtualPage (
+  IN OUT OC_VMEM_CONTEXT                 *Context,
+  IN OUT PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable  OPTIONAL,
+  IN     EFI_VIRTUAL_ADDRESS             VirtualAddr,
+  IN     EFI_PHYSICAL_ADDRESS            PhysicalAddr
+  )
+{
+  if (PageTable == NULL) {
+    PageTable = GetCurrentPageTable (NULL);
+  }
+
+  return VmMapVirtualPageWithSize (
+    Context,
+    PageTable,
+    VirtualAddr,
+    PhysicalAddr,
+    BASE_4KB
+    );
+}
+
 EFI_STATUS
 VmMapVirtualPages (
   IN OUT OC_VMEM_CONTEXT                 *Context,
@@ -381,24 +468,43 @@ VmMapVirtualPages (
   )
 {
   EFI_STATUS  Status;
+  BOOLEAN     Page1GbSupported;
+  UINT64      PageSize;
 
   if (PageTable == NULL) {
     PageTable = GetCurrentPageTable (NULL);
   }
 
-  Status = EFI_SUCCESS;
+  Page1GbSupported = VmIsPage1GbSupported ();
+  Status           = EFI_SUCCESS;
 
   while (NumPages > 0 && !EFI_ERROR (Status)) {
-    Status = VmMapVirtualPage (
+    //
+    // Use the largest page size the remaining range and alignment permit.
+    // Large RT MMIO and reserved regions need just a few entries this way.
+    //
+    if (Page1GbSupported
+      && NumPages >= EFI_SIZE_TO_PAGES (BASE_1GB)
+      && ((VirtualAddr | PhysicalAddr) & (BASE_1GB - 1)) == 0) {
+      PageSize = BASE_1GB;
+    } else if (NumPages >= EFI_SIZE_TO_PAGES (BASE_2MB)
+      && ((VirtualAddr | PhysicalAddr) & (BASE_2MB - 1)) == 0) {
+      PageSize = BASE_2MB;
+    } else {
+      PageSize = BASE_4KB;
+    }
+
+    Status = VmMapVirtualPageWithSize (
       Context,
       PageTable,
       VirtualAddr,
-      PhysicalAddr
+      PhysicalAddr,
+      PageSize
       );
 
-    VirtualAddr  += EFI_PAGE_SIZE;
-    PhysicalAddr += EFI_PAGE_SIZE;
-    NumPages--;
+    VirtualAddr  += PageSize;
+    PhysicalAddr += PageSize;
+    NumPages     -= EFI_SIZE_TO_PAGES (PageSize);
   }
 
   return Status;
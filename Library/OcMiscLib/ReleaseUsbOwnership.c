@@ -21,6 +21,8 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
 #include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
 #include <Library/UefiBootServicesTableLib.h>
 
 #define XHC_HCCPARAMS_OFFSET      0x10
@@ -36,26 +38,71 @@
 #define EHC_USBSTS_OFFSET         0x4    ///< USB Status Register Offset
 #define EHC_USBINT_OFFSET         0x8    ///< USB Interrupt Enable Register
 
+#define USB_HANDOFF_POLL_DELAY    500    ///< Microseconds between ownership polls
+#define USB_HANDOFF_STAGE_POLLS   40     ///< Ownership polls per handoff stage
+
+typedef enum {
+  UsbHandoffDone,
+  UsbHandoffXhciBiosOwned,   ///< XHCI BIOS ownership release requested
+  UsbHandoffEhciConflict,    ///< EHCI OS ownership soft reset requested
+  UsbHandoffEhciBiosOwned,   ///< EHCI BIOS ownership release requested
+  UsbHandoffEhciHardReset,   ///< EHCI BIOS ownership hard reset requested
+  UsbHandoffUhciReset,       ///< UHCI global reset started
+  UsbHandoffUhciResume       ///< UHCI legacy support cleared
+} USB_HANDOFF_STAGE;
+
+typedef struct {
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  CONST CHAR8          *Name;
+  USB_HANDOFF_STAGE    Stage;
+  UINT32               PollsLeft;
+  UINT32               ExtendCap;
+  UINT32               PortBase;
+  UINT64               StartTime;
+  UINT64               EndTime;
+  EFI_STATUS           Status;
+} USB_HANDOFF_CONTEXT;
+
 /**
-  Release XHCI USB controllers ownership.
+  Enter the next handoff stage of a USB controller.
+
+  @param[in,out]  Context  Controller handoff context.
+  @param[in]      Stage    Stage to enter.
+**/
+STATIC
+VOID
+UsbHandoffSetStage (
+  IN OUT USB_HANDOFF_CONTEXT  *Context,
+  IN     USB_HANDOFF_STAGE    Stage
+  )
+{
+  Context->Stage     = Stage;
+  Context->PollsLeft = USB_HANDOFF_STAGE_POLLS;
+
+  if (Stage == UsbHandoffDone) {
+    Context->EndTime = GetPerformanceCounter ();
+  }
+}
 
-  @param[in]  PciIo  PCI I/O protocol for the device.
+/**
+  Request XHCI USB controller ownership.
 
-  @retval EFI_NOT_FOUND  No XHCI controllers had ownership incorrectly set.
-  @retval EFI_SUCCESS    Corrected XHCI controllers ownership to OS.
+  @param[in,out]  Context  Controller handoff context.
 **/
 STATIC
-EFI_STATUS
-XhciReleaseOwnership (
-  IN  EFI_PCI_IO_PROTOCOL   *PciIo
+VOID
+XhciRequestOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
   )
 {
-  EFI_STATUS  Status;
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
 
   UINT32  HcCapParams;
   UINT32  ExtendCap;
   UINT32  Value;
-  INT32   TimeOut;
+
+  PciIo = Context->PciIo;
 
   //
   // XHCI controller, then disable legacy support, if enabled.
@@ -105,119 +152,181 @@ XhciReleaseOwnership (
         &Value
         );
 
-      TimeOut = 40;
-      while (TimeOut--) {
-        gBS->Stall (500);
+      Context->ExtendCap = ExtendCap;
+      Context->Status    = Status;
+      UsbHandoffSetStage (Context, UsbHandoffXhciBiosOwned);
+      return;
+    }
 
-        Status = PciIo->Mem.Read (
-          PciIo,
-          EfiPciIoWidthUint32,
-          XHC_USBCMD_OFFSET,
-          ExtendCap,
-          1,
-          &Value
-          );
+    if (!(Value & XHC_NEXT_CAPABILITY_MASK)) {
+      break;
+    }
 
-        if (EFI_ERROR(Status) || !(Value & BIT16)) {
-          break;
-        }
-      }
+    ExtendCap += ((Value >> 6U) & 0x3FCU);
+  }
 
-      //
-      // Disable all SMI in USBLEGCTLSTS
-      //
-      Status = PciIo->Mem.Read (
-        PciIo,
-        EfiPciIoWidthUint32,
-        XHC_USBCMD_OFFSET,
-        ExtendCap + 4,
-        1,
-        &Value
-        );
+  Context->Status = Status;
+  UsbHandoffSetStage (Context, UsbHandoffDone);
+}
 
-      if (EFI_ERROR(Status)) {
-        break;
-      }
+/**
+  Complete XHCI USB controller ownership handoff.
 
-      Value &= 0x1F1FEEU;
-      Value |= 0xE0000000U;
+  @param[in,out]  Context  Controller handoff context.
+**/
+STATIC
+VOID
+XhciCompleteOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Value;
 
-      PciIo->Mem.Write (
-        PciIo,
-        EfiPciIoWidthUint32,
-        XHC_USBCMD_OFFSET,
-        ExtendCap + 4,
-        1,
-        &Value
-        );
+  PciIo = Context->PciIo;
 
-      //
-      // Clear all ownership
-      //
-      Status = PciIo->Mem.Read (
-        PciIo,
-        EfiPciIoWidthUint32,
-        XHC_USBCMD_OFFSET,
-        ExtendCap,
-        1,
-        &Value
-        );
+  //
+  // Disable all SMI in USBLEGCTLSTS
+  //
+  Status = PciIo->Mem.Read (
+    PciIo,
+    EfiPciIoWidthUint32,
+    XHC_USBCMD_OFFSET,
+    Context->ExtendCap + 4,
+    1,
+    &Value
+    );
 
-      if (EFI_ERROR(Status)) {
-        break;
-      }
+  if (!EFI_ERROR (Status)) {
+    Value &= 0x1F1FEEU;
+    Value |= 0xE0000000U;
+
+    PciIo->Mem.Write (
+      PciIo,
+      EfiPciIoWidthUint32,
+      XHC_USBCMD_OFFSET,
+      Context->ExtendCap + 4,
+      1,
+      &Value
+      );
+
+    //
+    // Clear all ownership
+    //
+    Status = PciIo->Mem.Read (
+      PciIo,
+      EfiPciIoWidthUint32,
+      XHC_USBCMD_OFFSET,
+      Context->ExtendCap,
+      1,
+      &Value
+      );
 
+    if (!EFI_ERROR (Status)) {
       Value &= ~(BIT24 | BIT16);
       PciIo->Mem.Write (
         PciIo,
         EfiPciIoWidthUint32,
         XHC_USBCMD_OFFSET,
-        ExtendCap,
+        Context->ExtendCap,
         1,
         &Value
         );
-
-      break;
-    }
-
-    if (!(Value & XHC_NEXT_CAPABILITY_MASK)) {
-      break;
     }
-
-    ExtendCap += ((Value >> 6U) & 0x3FCU);
   }
 
-  return Status;
+  Context->Status = Status;
+  UsbHandoffSetStage (Context, UsbHandoffDone);
 }
 
 /**
- Release EHCI USB controllers ownership.
+  Poll XHCI USB controller ownership handoff.
 
- @param[in]  PciIo  PCI I/O protocol for the device.
+  @param[in,out]  Context  Controller handoff context.
+**/
+STATIC
+VOID
+XhciPollOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
+  )
+{
+  EFI_STATUS  Status;
+  UINT32      Value;
 
- @retval EFI_NOT_FOUND  No EHCI controllers had ownership incorrectly set.
- @retval EFI_SUCCESS    Corrected EHCI controllers ownership to OS.
- **/
+  Status = Context->PciIo->Mem.Read (
+    Context->PciIo,
+    EfiPciIoWidthUint32,
+    XHC_USBCMD_OFFSET,
+    Context->ExtendCap,
+    1,
+    &Value
+    );
+
+  if (EFI_ERROR (Status) || !(Value & BIT16) || --Context->PollsLeft == 0) {
+    XhciCompleteOwnership (Context);
+  }
+}
+
+/**
+  Request EHCI OS ownership semaphore.
+
+  @param[in,out]  Context  Controller handoff context.
+**/
 STATIC
-EFI_STATUS
-EhciReleaseOwnership (
-  IN  EFI_PCI_IO_PROTOCOL   *PciIo
+VOID
+EhciSetOsOwned (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
   )
 {
-  EFI_STATUS       Status;
-  UINT32           Value;
-  UINT32           Base;
-  UINT32           OpAddr;
-  UINT32           ExtendCap;
-  UINT32           UsbCmd;
-  UINT32           UsbLegSup;
-  UINT32           UsbLegCtlSts;
-  UINTN            IsOsOwned;
-  UINTN            IsBiosOwned;
-  BOOLEAN          IsOwnershipConflict;
-  UINT32           HcCapParams;
-  INT32            TimeOut;
+  UINT32  Value;
 
+  Context->PciIo->Pci.Read (
+    Context->PciIo,
+    EfiPciIoWidthUint32,
+    Context->ExtendCap,
+    1,
+    &Value
+    );
+
+  Value |= BIT24;
+  Context->PciIo->Pci.Write (
+    Context->PciIo,
+    EfiPciIoWidthUint32,
+    Context->ExtendCap,
+    1,
+    &Value
+    );
+
+  UsbHandoffSetStage (Context, UsbHandoffEhciBiosOwned);
+}
+
+/**
+  Request EHCI USB controller ownership.
+
+  @param[in,out]  Context  Controller handoff context.
+**/
+STATIC
+VOID
+EhciRequestOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
+  )
+{
+  EFI_STATUS           Status;
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Value;
+  UINT32               Base;
+  UINT32               OpAddr;
+  UINT32               ExtendCap;
+  UINT32               UsbCmd;
+  UINT32               UsbLegSup;
+  UINT32               UsbLegCtlSts;
+  UINTN                IsOsOwned;
+  UINTN                IsBiosOwned;
+  BOOLEAN              IsOwnershipConflict;
+  UINT32               HcCapParams;
+
+  PciIo = Context->PciIo;
   Value = 0x0002;
 
   PciIo->Pci.Write (
@@ -242,7 +351,9 @@ EhciReleaseOwnership (
     //
     // Config space too small: no legacy implementation.
     //
-    return EFI_NOT_FOUND;
+    Context->Status = EFI_NOT_FOUND;
+    UsbHandoffSetStage (Context, UsbHandoffDone);
+    return;
   }
 
   //
@@ -277,7 +388,9 @@ EhciReleaseOwnership (
     //
     // No BIOS ownership, ignore.
     //
-    return EFI_NOT_FOUND;
+    Context->Status = EFI_NOT_FOUND;
+    UsbHandoffSetStage (Context, UsbHandoffDone);
+    return;
   }
 
   //
@@ -358,6 +471,9 @@ EhciReleaseOwnership (
     &UsbLegSup
     );
 
+  Context->ExtendCap = ExtendCap;
+  Context->Status    = Status;
+
   IsOwnershipConflict = IsBiosOwned && IsOsOwned;
 
   if (IsOwnershipConflict) {
@@ -373,60 +489,61 @@ EhciReleaseOwnership (
       &Value
       );
 
-    TimeOut = 40;
-    while (TimeOut--) {
-      gBS->Stall (500);
+    UsbHandoffSetStage (Context, UsbHandoffEhciConflict);
+    return;
+  }
 
-      PciIo->Pci.Read (
-        PciIo,
-        EfiPciIoWidthUint32,
-        ExtendCap,
-        1,
-        &Value
-        );
+  EhciSetOsOwned (Context);
+}
 
-      if ((Value & BIT24) == 0x0) {
-        break;
-      }
-    }
-  }
+/**
+  Poll EHCI USB controller ownership handoff.
+
+  @param[in,out]  Context  Controller handoff context.
+**/
+STATIC
+VOID
+EhciPollOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
+  )
+{
+  EFI_PCI_IO_PROTOCOL  *PciIo;
+  UINT32               Value;
+  UINT32               UsbLegCtlSts;
+  BOOLEAN              IsStageDone;
+
+  PciIo = Context->PciIo;
 
   PciIo->Pci.Read (
     PciIo,
     EfiPciIoWidthUint32,
-    ExtendCap,
+    Context->ExtendCap,
     1,
     &Value
     );
 
-  Value |= BIT24;
-  PciIo->Pci.Write (
-    PciIo,
-    EfiPciIoWidthUint32,
-    ExtendCap,
-    1,
-    &Value
-    );
+  if (Context->Stage == UsbHandoffEhciConflict) {
+    IsStageDone = (Value & BIT24) == 0x0;
+  } else {
+    IsStageDone = (Value & BIT16) == 0x0;
+  }
 
-  TimeOut = 40;
-  while (TimeOut--) {
-    gBS->Stall (500);
+  --Context->PollsLeft;
+  if (!IsStageDone && Context->PollsLeft > 0) {
+    return;
+  }
 
-    PciIo->Pci.Read (
-      PciIo,
-      EfiPciIoWidthUint32,
-      ExtendCap,
-      1,
-      &Value
-      );
+  if (Context->Stage == UsbHandoffEhciConflict) {
+    EhciSetOsOwned (Context);
+    return;
+  }
 
-    if ((Value & BIT16) == 0x0) {
-      break;
+  if (Context->Stage == UsbHandoffEhciBiosOwned) {
+    if (IsStageDone) {
+      UsbHandoffSetStage (Context, UsbHandoffDone);
+      return;
     }
-  }
 
-  IsOwnershipConflict = (Value & BIT16) != 0x0;
-  if (IsOwnershipConflict) {
     //
     // Soft reset has failed. Assume SMI being ignored and do hard reset.
     //
@@ -434,109 +551,113 @@ EhciReleaseOwnership (
     PciIo->Pci.Write (
       PciIo,
       EfiPciIoWidthUint8,
-      ExtendCap + 2,
+      Context->ExtendCap + 2,
       1,
       &Value
       );
 
-    TimeOut = 40;
-    while (TimeOut--) {
-      gBS->Stall (500);
-
-      PciIo->Pci.Read (
-        PciIo,
-        EfiPciIoWidthUint32,
-        ExtendCap,
-        1,
-        &Value
-        );
-
-      if ((Value & BIT16) == 0x0) {
-        break;
-      }
-    }
+    UsbHandoffSetStage (Context, UsbHandoffEhciHardReset);
+    return;
+  }
 
-    //
-    // Disable further SMI events.
-    //
-    PciIo->Pci.Read (
-      PciIo,
-      EfiPciIoWidthUint32,
-      ExtendCap + 0x4,
-      1,
-      &UsbLegCtlSts
-      );
+  //
+  // Disable further SMI events.
+  //
+  PciIo->Pci.Read (
+    PciIo,
+    EfiPciIoWidthUint32,
+    Context->ExtendCap + 0x4,
+    1,
+    &UsbLegCtlSts
+    );
 
-    UsbLegCtlSts &= 0xFFFF0000U;
-    PciIo->Pci.Write (
-      PciIo,
-      EfiPciIoWidthUint32,
-      ExtendCap + 0x4,
-      1,
-      &UsbLegCtlSts
-      );
-  }
+  UsbLegCtlSts &= 0xFFFF0000U;
+  PciIo->Pci.Write (
+    PciIo,
+    EfiPciIoWidthUint32,
+    Context->ExtendCap + 0x4,
+    1,
+    &UsbLegCtlSts
+    );
 
-  if (Value & BIT16) {
+  if (!IsStageDone) {
     //
     // EHCI controller unable to take control from BIOS.
     //
-    Status = EFI_NOT_FOUND;
+    Context->Status = EFI_NOT_FOUND;
   }
 
-  return Status;
+  UsbHandoffSetStage (Context, UsbHandoffDone);
 }
 
 /**
- Release UHCI USB controllers ownership.
-
- @param[in]  PciIo  PCI I/O protocol for the device.
+  Request UHCI USB controller ownership.
 
- @retval EFI_NOT_FOUND  No UHCI controllers had ownership incorrectly set.
- @retval EFI_SUCCESS    Corrected UHCI controllers ownership to OS.
- **/
+  @param[in,out]  Context  Controller handoff context.
+**/
 STATIC
-EFI_STATUS
-UhciReleaseOwnership (
-  IN  EFI_PCI_IO_PROTOCOL   *PciIo
+VOID
+UhciRequestOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
   )
 {
   EFI_STATUS  Status;
   UINT32      Base;
-  UINT32      PortBase;
   UINT16      Command;
 
   Base = 0;
 
-  Status = PciIo->Pci.Read(
-    PciIo,
+  Status = Context->PciIo->Pci.Read(
+    Context->PciIo,
     EfiPciIoWidthUint32,
     0x20,
     1,
     &Base
     );
 
-  PortBase = (Base >> 5) & 0x07ff;
+  Context->PortBase = (Base >> 5) & 0x07ff;
 
   Command = 0x8f00;
 
-  Status = PciIo->Pci.Write (
-    PciIo,
+  Context->Status = Context->PciIo->Pci.Write (
+    Context->PciIo,
     EfiPciIoWidthUint16,
     0xC0,
     1,
     &Command
     );
 
-  if (PortBase) {
-    IoWrite16 (PortBase, 0x0002);
-    gBS->Stall (500);
-    IoWrite16 (PortBase + 4, 0);
-    gBS->Stall (500);
-    IoWrite16 (PortBase, 0);
+  if (Context->PortBase) {
+    IoWrite16 (Context->PortBase, 0x0002);
+    UsbHandoffSetStage (Context, UsbHandoffUhciReset);
+    Context->PollsLeft = 1;
+    return;
+  }
+
+  UsbHandoffSetStage (Context, UsbHandoffDone);
+}
+
+/**
+  Poll UHCI USB controller ownership handoff.
+  Each stage lasts for a single poll delay.
+
+  @param[in,out]  Context  Controller handoff context.
+**/
+STATIC
+VOID
+UhciPollOwnership (
+  IN OUT USB_HANDOFF_CONTEXT  *Context
+  )
+{
+  if (Context->Stage == UsbHandoffUhciReset) {
+    IoWrite16 (Context->PortBase + 4, 0);
+    UsbHandoffSetStage (Context, UsbHandoffUhciResume);
+    Context->PollsLeft = 1;
+    return;
   }
 
-  return Status;
+  IoWrite16 (Context->PortBase, 0);
+  UsbHandoffSetStage (Context, UsbHandoffDone);
 }
 
 EFI_STATUS
@@ -551,6 +672,10 @@ ReleaseUsbOwnership (
   UINTN                 Index;
   EFI_PCI_IO_PROTOCOL   *PciIo;
   PCI_TYPE00            Pci;
+  USB_HANDOFF_CONTEXT   *Contexts;
+  USB_HANDOFF_CONTEXT   *Context;
+  UINTN                 ContextCount;
+  UINTN                 PendingCount;
 
   Status = gBS->LocateHandleBuffer (
                     ByProtocol,
@@ -564,8 +689,19 @@ ReleaseUsbOwnership (
     return Status;
   }
 
-  Result = EFI_UNSUPPORTED;
+  Contexts = AllocateZeroPool (HandleArrayCount * sizeof (*Contexts));
+  if (Contexts == NULL) {
+    gBS->FreePool (HandleArray);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  ContextCount = 0;
+  PendingCount = 0;
 
+  //
+  // Request ownership from every controller first, so that the firmware
+  // releases them all at the same time.
+  //
   for (Index = 0; Index < HandleArrayCount; ++Index) {
     Status = gBS->HandleProtocol (
       HandleArray[Index],
@@ -591,15 +727,81 @@ ReleaseUsbOwnership (
       continue;
     }
 
+    Context            = &Contexts[ContextCount];
+    Context->PciIo     = PciIo;
+    Context->StartTime = GetPerformanceCounter ();
+
     if (Pci.Hdr.ClassCode[0] == PCI_IF_XHCI) {
-      Result = XhciReleaseOwnership (PciIo);
+      Context->Name = "XHCI";
+      XhciRequestOwnership (Context);
     } else if (Pci.Hdr.ClassCode[0] == PCI_IF_EHCI) {
-      Result = EhciReleaseOwnership (PciIo);
+      Context->Name = "EHCI";
+      EhciRequestOwnership (Context);
     } else if (Pci.Hdr.ClassCode[0] == PCI_IF_UHCI) {
-      Result = UhciReleaseOwnership (PciIo);
+      Context->Name = "UHCI";
+      UhciRequestOwnership (Context);
+    } else {
+      continue;
+    }
+
+    if (Context->Stage != UsbHandoffDone) {
+      ++PendingCount;
     }
+
+    ++ContextCount;
   }
 
   gBS->FreePool (HandleArray);
+
+  //
+  // Then poll all of them together, the total wait is bounded by the slowest
+  // controller instead of the sum of all.
+  //
+  while (PendingCount > 0) {
+    gBS->Stall (USB_HANDOFF_POLL_DELAY);
+
+    for (Index = 0; Index < ContextCount; ++Index) {
+      Context = &Contexts[Index];
+
+      switch (Context->Stage) {
+        case UsbHandoffXhciBiosOwned:
+          XhciPollOwnership (Context);
+          break;
+        case UsbHandoffEhciConflict:
+        case UsbHandoffEhciBiosOwned:
+        case UsbHandoffEhciHardReset:
+          EhciPollOwnership (Context);
+          break;
+        case UsbHandoffUhciReset:
+        case UsbHandoffUhciResume:
+          UhciPollOwnership (Context);
+          break;
+        default:
+          continue;
+      }
+
+      if (Context->Stage == UsbHandoffDone) {
+        --PendingCount;
+      }
+    }
+  }
+
+  Result = EFI_UNSUPPORTED;
+
+  for (Index = 0; Index < ContextCount; ++Index) {
+    Context = &Contexts[Index];
+    Result  = Context->Status;
+
+    DEBUG ((
+      DEBUG_INFO,
+      "OCMISC: %a controller %u ownership handoff took %Lu us - %r\n",
+      Context->Name,
+      (UINT32) Index,
+      DivU64x32 (GetTimeInNanoSecond (Context->EndTime - Context->StartTime), 1000),
+      Context->Status
+      ));
+  }
+
+  FreePool (Contexts);
   return Result;
 }
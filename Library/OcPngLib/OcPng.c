@@ -18,8 +18,88 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Base.h>
 #include <Library/DebugLib.h>
 #include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcCompressionLib.h>
+#include <Library/OcGuardLib.h>
 #include "lodepng.h"
 
+//
+// ZLIB decompressor shared by all decoded images.
+//
+STATIC OC_ZLIB_DECOMPRESSOR  *mPngDecompressor;
+
+/**
+  Decompress PNG image data with OcCompressionLib ZLIB decompressor.
+  Its table driven inflater is considerably faster than lodepng one,
+  and its state is allocated only once for all the images.
+  Adler32 is verified by the inflater just like lodepng does.
+
+  @param  Out       Output buffer, preallocated for Settings->expected_size
+  @param  OutSize   Output buffer size
+  @param  In        Compressed data
+  @param  InSize    Compressed data size
+  @param  Settings  Decompression settings
+
+  @return 0 on success or lodepng error code.
+**/
+STATIC
+unsigned
+InternalPngZlibDecompress (
+  unsigned char                    **Out,
+  size_t                           *OutSize,
+  const unsigned char              *In,
+  size_t                           InSize,
+  const LodePNGDecompressSettings  *Settings
+  )
+{
+  UINTN  Size;
+
+  //
+  // Data of unknown size is left to lodepng.
+  //
+  if (Settings->expected_size == 0 || *Out == NULL) {
+    return lodepng_zlib_decompress (Out, OutSize, In, InSize, Settings);
+  }
+
+  Size = DecompressZLIBWith (
+    (OC_ZLIB_DECOMPRESSOR *) Settings->custom_context,
+    *Out,
+    Settings->expected_size,
+    In,
+    InSize
+    );
+
+  if (Size == 0) {
+    return 52;
+  }
+
+  *OutSize = Size;
+  return 0;
+}
+
+/**
+  Initialise lodepng state for decoding.
+
+  @param  State  lodepng state
+**/
+STATIC
+VOID
+InternalPngStateInit (
+  OUT LodePNGState  *State
+  )
+{
+  lodepng_state_init (State);
+
+  if (mPngDecompressor == NULL) {
+    mPngDecompressor = CreateZLIBDecompressor ();
+  }
+
+  if (mPngDecompressor != NULL) {
+    State->decoder.zlibsettings.custom_zlib    = InternalPngZlibDecompress;
+    State->decoder.zlibsettings.custom_context = mPngDecompressor;
+  }
+}
+
 /**
   Retrieves PNG image dimensions
 
@@ -101,7 +181,7 @@ DecodePng (
   //
   // Init lodepng state
   //
-  lodepng_state_init (&State);
+  InternalPngStateInit (&State);
 
   //
   // It should return 0 on success
@@ -133,6 +213,77 @@ DecodePng (
 
 }
 
+/**
+  Decodes PNG image into EFI_UGA_PIXEL buffer with inverted alpha in Reserved.
+  8-bit RGBA images are decoded without any intermediate image buffer.
+
+  @param  Buffer                 Buffer with desired png image
+  @param  Size                   Size of input image
+  @param  RawData                Output EFI_UGA_PIXEL buffer, free with FreePool
+  @param  RawDataSize            Output buffer size
+  @param  Width                  Image width at output
+  @param  Height                 Image height at output
+
+  @return EFI_SUCCESS            The function completed successfully.
+  @return EFI_OUT_OF_RESOURCES   There are not enough resources to init state.
+  @return EFI_INVALID_PARAMETER  Passed wrong parameter
+**/
+EFI_STATUS
+DecodePngToUga (
+  IN   VOID    *Buffer,
+  IN   UINTN   Size,
+  OUT  VOID    **RawData,
+  OUT  UINTN   *RawDataSize,
+  OUT  UINT32  *Width,
+  OUT  UINT32  *Height
+  )
+{
+  LodePNGState      State;
+  unsigned          Error;
+  unsigned          W;
+  unsigned          H;
+  UINTN             DataSize;
+  VOID              *Data;
+
+  //
+  // Init lodepng state
+  //
+  InternalPngStateInit (&State);
+
+  //
+  // Read the dimensions to allocate the output buffer first
+  //
+  Error = lodepng_inspect (&W, &H, &State, Buffer, Size);
+  if (Error || OcOverflowTriMulUN (W, H, sizeof (UINT32), &DataSize)) {
+    lodepng_state_cleanup (&State);
+    DEBUG ((DEBUG_INFO, "OcPngLib: Error while getting image dimensions from PNG header\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Data = AllocatePool (DataSize);
+  if (Data == NULL) {
+    lodepng_state_cleanup (&State);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Error = lodepng_decode_bgra_inverted (Data, W, H, &State, Buffer, Size);
+
+  lodepng_state_cleanup (&State);
+
+  if (Error) {
+    FreePool (Data);
+    DEBUG ((DEBUG_INFO, "OcPngLib: Error while decoding PNG image\n"));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  *RawData     = Data;
+  *RawDataSize = DataSize;
+  *Width       = W;
+  *Height      = H;
+
+  return EFI_SUCCESS;
+}
+
 /**
   Frees image buffer
 
@@ -2145,9 +2145,10 @@ void lodepng_decompress_settings_init(LodePNGDecompressSettings* settings) {
   settings->custom_zlib = 0;
   settings->custom_inflate = 0;
   settings->custom_context = 0;
+  settings->expected_size = 0;
 }
 
-const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0};
+const LodePNGDecompressSettings lodepng_default_decompress_settings = {0, 0, 0, 0, 0};
 
 #endif /*LODEPNG_COMPILE_DECODER*/
 
@@ -4404,9 +4405,12 @@ unsigned lodepng_inspect_chunk(LodePNGState* state, size_t pos,
 }
 
 /*read a PNG, the result will be in the same color type as the PNG (hence "generic")*/
+/*dest, if not NULL, is a destsize bytes buffer to unfilter 8-bit RGBA images of
+exactly that raw size into instead of allocating *out*/
 static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
                           LodePNGState* state,
-                          const unsigned char* in, size_t insize) {
+                          const unsigned char* in, size_t insize,
+                          unsigned char* dest, size_t destsize) {
   unsigned char IEND = 0;
   const unsigned char* chunk;
   size_t i;
@@ -4414,6 +4418,7 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   ucvector scanlines;
   size_t predict;
   size_t outsize = 0;
+  LodePNGDecompressSettings zlibsettings;
 
   /*for unknown chunk order*/
   unsigned unknown = 0;
@@ -4574,16 +4579,24 @@ static void decodeGeneric(unsigned char** out, unsigned* w, unsigned* h,
   }
   if(!state->error && !ucvector_reserve(&scanlines, predict)) state->error = 83; /*alloc fail*/
   if(!state->error) {
+    /*scanlines already has room for the predicted size, let custom zlib use it*/
+    zlibsettings = state->decoder.zlibsettings;
+    zlibsettings.expected_size = predict;
     state->error = zlib_decompress(&scanlines.data, &scanlines.size, idat.data,
-                                   idat.size, &state->decoder.zlibsettings);
+                                   idat.size, &zlibsettings);
     if(!state->error && scanlines.size != predict) state->error = 91; /*decompressed size doesn't match prediction*/
   }
   ucvector_cleanup(&idat);
 
   if(!state->error) {
     outsize = lodepng_get_raw_size(*w, *h, &state->info_png.color);
-    *out = (unsigned char*)lodepng_malloc(outsize);
-    if(!*out) state->error = 83; /*alloc fail*/
+    if(dest && outsize == destsize
+       && state->info_png.color.colortype == LCT_RGBA && state->info_png.color.bitdepth == 8) {
+      *out = dest;
+    } else {
+      *out = (unsigned char*)lodepng_malloc(outsize);
+      if(!*out) state->error = 83; /*alloc fail*/
+    }
   }
   if(!state->error) {
     memset(*out, 0, outsize * sizeof((*out)[i]));
@@ -4596,7 +4609,7 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize) {
   *out = 0;
-  decodeGeneric(out, w, h, state, in, insize);
+  decodeGeneric(out, w, h, state, in, insize, 0, 0);
   if(state->error) return state->error;
   if(!state->decoder.color_convert || lodepng_color_mode_equal(&state->info_raw, &state->info_png.color)) {
     /*same color type, no copying or converting of data needed*/
@@ -4630,6 +4643,34 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
   return state->error;
 }
 
+unsigned lodepng_decode_bgra_inverted(unsigned char* out, unsigned w, unsigned h,
+                                      LodePNGState* state,
+                                      const unsigned char* in, size_t insize) {
+  unsigned char* raw = 0;
+  unsigned raw_w = 0, raw_h = 0;
+  size_t i;
+  size_t numpixels = (size_t)w * (size_t)h;
+  unsigned char tmp;
+
+  decodeGeneric(&raw, &raw_w, &raw_h, state, in, insize, out, numpixels * 4);
+  if(!state->error && (raw_w != w || raw_h != h)) state->error = 84; /*image does not match the buffer*/
+  if(!state->error && raw != out) {
+    /*not 8-bit RGBA, expand into the output buffer*/
+    getPixelColorsRGBA8(out, numpixels, 1, raw, &state->info_png.color);
+  }
+  if(raw != out) lodepng_free(raw);
+  if(state->error) return state->error;
+
+  for(i = 0; i != numpixels; ++i, out += 4) {
+    tmp = out[0];
+    out[0] = out[2];
+    out[2] = tmp;
+    out[3] = 255 - out[3];
+  }
+
+  return 0;
+}
+
 unsigned lodepng_decode_memory(unsigned char** out, unsigned* w, unsigned* h, const unsigned char* in,
                                size_t insize, LodePNGColorType colortype, unsigned bitdepth) {
   unsigned error;
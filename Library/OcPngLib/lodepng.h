@@ -308,6 +308,11 @@ struct LodePNGDecompressSettings {
                              const LodePNGDecompressSettings*);
 
   const void* custom_context; /*optional custom settings for custom functions*/
+
+  /*decompressed size expected by the decoder or 0 if unknown (default: 0). When not 0,
+  the *out buffer passed to custom_zlib already has room for expected_size bytes, so
+  it can decompress in place without any reallocation*/
+  size_t expected_size;
 };
 
 extern const LodePNGDecompressSettings lodepng_default_decompress_settings;
@@ -791,6 +796,17 @@ unsigned lodepng_decode(unsigned char** out, unsigned* w, unsigned* h,
                         LodePNGState* state,
                         const unsigned char* in, size_t insize);
 
+/*
+Same as lodepng_decode, but decodes into the caller provided out buffer of
+w * h * 4 bytes as 8-bit BGRA with inverted alpha (0 is opaque), which is the
+EFI_UGA_PIXEL layout. w and h must be the image dimensions, e.g. from lodepng_inspect.
+8-bit RGBA images are unfiltered straight into out without an intermediate buffer.
+The contents of out are undefined on error.
+*/
+unsigned lodepng_decode_bgra_inverted(unsigned char* out, unsigned w, unsigned h,
+                                      LodePNGState* state,
+                                      const unsigned char* in, size_t insize);
+
 /*
 Read the PNG header, but not the actual data. This returns only the information
 that is in the IHDR chunk of the PNG, such as width, height and color type. The
@@ -364,22 +364,9 @@ OcStorageReadFileUnicode (
     return NULL;
   }
 
-  Status = GetFileSize (File, &Size);
-  if (EFI_ERROR (Status) || Size >= MAX_UINT32 - 1) {
-    File->Close (File);
-    return NULL;
-  }
-
-  FileBuffer = AllocatePool (Size + 2);
-  if (FileBuffer == NULL) {
-    File->Close (File);
-    return NULL;
-  }
-
-  Status = GetFileData (File, 0, Size, FileBuffer);
+  FileBuffer = OcGetFileContents (File, &Size, 0);
   File->Close (File);
-  if (EFI_ERROR (Status)) {
-    FreePool (FileBuffer);
+  if (FileBuffer == NULL) {
     return NULL;
   }
 
@@ -392,9 +379,6 @@ OcStorageReadFileUnicode (
     }
   }
 
-  FileBuffer[Size]     = 0;
-  FileBuffer[Size + 1] = 0;
-
   if (FileSize != NULL) {
     *FileSize = Size;
   }
@@ -27,6 +27,38 @@
 
 #include "VirtualFsInternal.h"
 
+/**
+  Pass the volume and path of a real directory to a real file opened from it.
+
+  @param[in] Parent     Real directory data.
+  @param[in] NewHandle  Opened file protocol.
+  @param[in] FileName   Opened file name.
+  @param[in] OpenMode   Opened file mode.
+**/
+STATIC
+VOID
+InternalInheritFilePath (
+  IN VIRTUAL_FILE_DATA  *Parent,
+  IN EFI_FILE_PROTOCOL  *NewHandle,
+  IN CHAR16             *FileName,
+  IN UINT64             OpenMode
+  )
+{
+  VIRTUAL_FILE_DATA  *Data;
+
+  //
+  // Open callbacks may return foreign protocols or virtual files.
+  //
+  if (Parent->FilePath == NULL || NewHandle->Open != Parent->Protocol.Open) {
+    return;
+  }
+
+  Data = VIRTUAL_FILE_FROM_PROTOCOL (NewHandle);
+  if (Data->OriginalProtocol != NULL && Data->FilePath == NULL) {
+    VirtualFileCacheSetPath (Data, Parent->Volume, Parent->FilePath, FileName, OpenMode);
+  }
+}
+
 STATIC
 EFI_STATUS
 EFIAPI
@@ -44,13 +76,17 @@ VirtualFileOpen (
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
   if (Data->OpenCallback != NULL) {
-    return Data->OpenCallback (
+    Status = Data->OpenCallback (
       Data->OriginalProtocol,
       NewHandle,
       FileName,
       OpenMode,
       Attributes
       );
+    if (!EFI_ERROR (Status)) {
+      InternalInheritFilePath (Data, *NewHandle, FileName, OpenMode);
+    }
+    return Status;
   }
 
   if (Data->OriginalProtocol != NULL) {
@@ -62,7 +98,10 @@ VirtualFileOpen (
       Attributes
       );
     if (!EFI_ERROR (Status)) {
-      return CreateRealFile (*NewHandle, NULL, TRUE, NewHandle);
+      Status = CreateRealFile (*NewHandle, NULL, TRUE, NewHandle);
+      if (!EFI_ERROR (Status)) {
+        InternalInheritFilePath (Data, *NewHandle, FileName, OpenMode);
+      }
     }
     return Status;
   }
@@ -94,6 +133,8 @@ VirtualFileClose (
     return EFI_SUCCESS;
   }
 
+  VirtualFileCacheFree (Data);
+
   Status = Data->OriginalProtocol->Close (
     Data->OriginalProtocol
     );
@@ -124,6 +165,9 @@ VirtualFileDelete (
     return EFI_WARN_DELETE_FAILURE;
   }
 
+  VirtualFileCacheDetach (Data);
+  VirtualFileCacheFree (Data);
+
   Status = Data->OriginalProtocol->Close (
     Data->OriginalProtocol
     );
@@ -147,7 +191,11 @@ VirtualFileRead (
 
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
-  if (Data->OriginalProtocol == NULL) {
+  if (Data->OriginalProtocol != NULL) {
+    VirtualFileCacheAttach (Data);
+  }
+
+  if (Data->OriginalProtocol == NULL || Data->CacheEntry != NULL) {
     if (Data->FilePosition > Data->FileSize) {
       //
       // On entry, the current file position is beyond the end of the file.
@@ -203,6 +251,8 @@ VirtualFileWrite (
     return EFI_WRITE_PROTECTED;
   }
 
+  VirtualFileCacheDetach (Data);
+
   return Data->OriginalProtocol->Write (
     Data->OriginalProtocol,
     BufferSize,
@@ -222,7 +272,7 @@ VirtualFileSetPosition (
 
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
-  if (Data->OriginalProtocol == NULL) {
+  if (Data->OriginalProtocol == NULL || Data->CacheEntry != NULL) {
     if (Position == 0xFFFFFFFFFFFFFFFFULL) {
       Data->FilePosition = Data->FileSize;
     } else {
@@ -253,7 +303,7 @@ VirtualFileGetPosition (
 
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
-  if (Data->OriginalProtocol == NULL) {
+  if (Data->OriginalProtocol == NULL || Data->CacheEntry != NULL) {
     *Position = Data->FilePosition;
     return EFI_SUCCESS;
   }
@@ -363,6 +413,8 @@ VirtualFileSetInfo (
     return EFI_WRITE_PROTECTED;
   }
 
+  VirtualFileCacheDetach (Data);
+
   return Data->OriginalProtocol->SetInfo (
     Data->OriginalProtocol,
     InformationType,
@@ -447,8 +499,12 @@ VirtualFileReadEx (
 
   Data = VIRTUAL_FILE_FROM_PROTOCOL (This);
 
-  if (Data->OriginalProtocol == NULL) {
-    Status = VirtualFileRead (This, Token->Buffer, &Token->BufferSize);
+  if (Data->OriginalProtocol != NULL) {
+    VirtualFileCacheAttach (Data);
+  }
+
+  if (Data->OriginalProtocol == NULL || Data->CacheEntry != NULL) {
+    Status = VirtualFileRead (This, &Token->BufferSize, Token->Buffer);
 
     if (!EFI_ERROR (Status) && Token->Event != NULL) {
       Token->Status = EFI_SUCCESS;
@@ -456,7 +512,7 @@ VirtualFileReadEx (
     }
   } else {
     Status = Data->OriginalProtocol->ReadEx (
-      This,
+      Data->OriginalProtocol,
       Token
       );
   }
@@ -483,8 +539,10 @@ VirtualFileWriteEx (
     return EFI_WRITE_PROTECTED;
   }
 
+  VirtualFileCacheDetach (Data);
+
   return Data->OriginalProtocol->WriteEx (
-    This,
+    Data->OriginalProtocol,
     Token
     );
 }
@@ -509,7 +567,7 @@ VirtualFileFlushEx (
   }
 
   return Data->OriginalProtocol->FlushEx (
-    This,
+    Data->OriginalProtocol,
     Token
     );
 }
@@ -563,6 +621,10 @@ CreateVirtualFile (
   Data->FilePosition     = 0;
   Data->OpenCallback     = NULL;
   Data->OriginalProtocol = NULL;
+  Data->Volume           = NULL;
+  Data->FilePath         = NULL;
+  Data->CacheEntry       = NULL;
+  Data->CacheProbed      = FALSE;
   CopyMem (&Data->Protocol, &mVirtualFileProtocolTemplate, sizeof (Data->Protocol));
   if (ModificationTime != NULL) {
     CopyMem (&Data->ModificationTime, ModificationTime, sizeof (*ModificationTime));
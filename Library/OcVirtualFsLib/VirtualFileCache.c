@@ -0,0 +1,468 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Uefi.h>
+
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/OcGuardLib.h>
+#include <Library/OcVirtualFsLib.h>
+
+#include <Guid/FileInfo.h>
+
+#include "VirtualFsInternal.h"
+
+//
+// Cached real files, most recently used first.
+// Referenced entries are never evicted, stale entries are unlinked
+// and freed once the last file using them is closed.
+//
+STATIC LIST_ENTRY  mVirtualFileCache = INITIALIZE_LIST_HEAD_VARIABLE (mVirtualFileCache);
+STATIC UINTN       mVirtualFileCacheUsed;
+STATIC UINTN       mVirtualFileCacheMaxSize;
+
+STATIC
+VOID
+InternalCacheEntryFree (
+  IN VIRTUAL_FILE_CACHE_ENTRY  *Entry
+  )
+{
+  FreePool (Entry->FileBuffer);
+  FreePool (Entry->FilePath);
+  FreePool (Entry);
+}
+
+STATIC
+VOID
+InternalCacheEntryRemove (
+  IN VIRTUAL_FILE_CACHE_ENTRY  *Entry
+  )
+{
+  RemoveEntryList (&Entry->Link);
+  mVirtualFileCacheUsed -= (UINTN) Entry->FileSize;
+  Entry->Stale = TRUE;
+
+  if (Entry->RefCount == 0) {
+    InternalCacheEntryFree (Entry);
+  }
+}
+
+/**
+  Evict least recently used unreferenced entries to fit new data.
+
+  @param[in] Size  Size of the data to fit.
+
+  @retval TRUE when the data fits the cache.
+**/
+STATIC
+BOOLEAN
+InternalCacheReserve (
+  IN UINTN  Size
+  )
+{
+  LIST_ENTRY                *Link;
+  LIST_ENTRY                *PrevLink;
+  VIRTUAL_FILE_CACHE_ENTRY  *Entry;
+
+  if (Size > mVirtualFileCacheMaxSize) {
+    return FALSE;
+  }
+
+  Link = GetPreviousNode (&mVirtualFileCache, &mVirtualFileCache);
+  while (mVirtualFileCacheMaxSize - Size < mVirtualFileCacheUsed
+    && !IsNull (&mVirtualFileCache, Link)) {
+    PrevLink = GetPreviousNode (&mVirtualFileCache, Link);
+    Entry    = VIRTUAL_FILE_CACHE_ENTRY_FROM_LINK (Link);
+    if (Entry->RefCount == 0) {
+      DEBUG ((DEBUG_VERBOSE, "OCVFS: Evicting cached %s\n", Entry->FilePath));
+      InternalCacheEntryRemove (Entry);
+    }
+    Link = PrevLink;
+  }
+
+  return mVirtualFileCacheMaxSize - Size >= mVirtualFileCacheUsed;
+}
+
+STATIC
+VIRTUAL_FILE_CACHE_ENTRY *
+InternalCacheLookup (
+  IN VIRTUAL_FILESYSTEM_DATA  *Volume,
+  IN CONST CHAR16             *FilePath,
+  IN CONST EFI_TIME           *ModificationTime,
+  IN UINT64                   FileSize
+  )
+{
+  LIST_ENTRY                *Link;
+  VIRTUAL_FILE_CACHE_ENTRY  *Entry;
+
+  for (
+    Link = GetFirstNode (&mVirtualFileCache);
+    !IsNull (&mVirtualFileCache, Link);
+    Link = GetNextNode (&mVirtualFileCache, Link)) {
+    Entry = VIRTUAL_FILE_CACHE_ENTRY_FROM_LINK (Link);
+    if (Entry->Volume == Volume
+      && Entry->FileSize == FileSize
+      && CompareMem (&Entry->ModificationTime, ModificationTime, sizeof (*ModificationTime)) == 0
+      && StrCmp (Entry->FilePath, FilePath) == 0) {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+STATIC
+VOID
+InternalCacheInvalidatePath (
+  IN VIRTUAL_FILESYSTEM_DATA  *Volume,
+  IN CONST CHAR16             *FilePath
+  )
+{
+  LIST_ENTRY                *Link;
+  LIST_ENTRY                *NextLink;
+  VIRTUAL_FILE_CACHE_ENTRY  *Entry;
+
+  Link = GetFirstNode (&mVirtualFileCache);
+  while (!IsNull (&mVirtualFileCache, Link)) {
+    NextLink = GetNextNode (&mVirtualFileCache, Link);
+    Entry    = VIRTUAL_FILE_CACHE_ENTRY_FROM_LINK (Link);
+    if (Entry->Volume == Volume && StrCmp (Entry->FilePath, FilePath) == 0) {
+      InternalCacheEntryRemove (Entry);
+    }
+    Link = NextLink;
+  }
+}
+
+STATIC
+VOID
+InternalCacheRelease (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  )
+{
+  VIRTUAL_FILE_CACHE_ENTRY  *Entry;
+
+  Entry = Data->CacheEntry;
+  if (Entry == NULL) {
+    return;
+  }
+
+  Data->CacheEntry   = NULL;
+  Data->FileBuffer   = NULL;
+  Data->FileSize     = 0;
+  Data->FilePosition = 0;
+
+  ASSERT (Entry->RefCount > 0);
+  --Entry->RefCount;
+  if (Entry->Stale && Entry->RefCount == 0) {
+    InternalCacheEntryFree (Entry);
+  }
+}
+
+/**
+  Retrieve file information of a real file.
+
+  @param[in] File  Real file protocol.
+
+  @retval allocated file information or NULL.
+**/
+STATIC
+EFI_FILE_INFO *
+InternalGetFileInfo (
+  IN EFI_FILE_PROTOCOL  *File
+  )
+{
+  EFI_STATUS     Status;
+  EFI_FILE_INFO  *FileInfo;
+  UINTN          InfoSize;
+
+  InfoSize = 0;
+  Status   = File->GetInfo (File, &gEfiFileInfoGuid, &InfoSize, NULL);
+  if (Status != EFI_BUFFER_TOO_SMALL || InfoSize < sizeof (EFI_FILE_INFO)) {
+    return NULL;
+  }
+
+  FileInfo = AllocatePool (InfoSize);
+  if (FileInfo == NULL) {
+    return NULL;
+  }
+
+  Status = File->GetInfo (File, &gEfiFileInfoGuid, &InfoSize, FileInfo);
+  if (EFI_ERROR (Status)) {
+    FreePool (FileInfo);
+    return NULL;
+  }
+
+  return FileInfo;
+}
+
+VOID
+VirtualFileCacheSetPath (
+  IN OUT VIRTUAL_FILE_DATA        *Data,
+  IN     VIRTUAL_FILESYSTEM_DATA  *Volume,
+  IN     CONST CHAR16             *ParentPath  OPTIONAL,
+  IN     CONST CHAR16             *FileName,
+  IN     UINT64                   OpenMode
+  )
+{
+  CHAR16        *FilePath;
+  UINTN         PathLength;
+  UINTN         Size;
+  CONST CHAR16  *Component;
+  UINTN         ComponentLength;
+
+  ASSERT (Data->OriginalProtocol != NULL);
+  ASSERT (Data->FilePath == NULL);
+
+  if (mVirtualFileCacheMaxSize == 0 && mVirtualFileCacheUsed == 0) {
+    return;
+  }
+
+  if (ParentPath == NULL || *FileName == L'\\') {
+    ParentPath = L"";
+  }
+
+  if (OcOverflowAddUN (StrLen (ParentPath), StrLen (FileName), &Size)
+    || OcOverflowAddUN (Size, 2, &Size)
+    || OcOverflowMulUN (Size, sizeof (CHAR16), &Size)) {
+    return;
+  }
+
+  FilePath = AllocatePool (Size);
+  if (FilePath == NULL) {
+    return;
+  }
+
+  //
+  // Build a normalised absolute path without trailing separators,
+  // volume root is represented by an empty string.
+  //
+  PathLength = StrLen (ParentPath);
+  CopyMem (FilePath, ParentPath, PathLength * sizeof (CHAR16));
+
+  while (*FileName != L'\0') {
+    while (*FileName == L'\\') {
+      ++FileName;
+    }
+
+    Component       = FileName;
+    ComponentLength = 0;
+    while (Component[ComponentLength] != L'\\' && Component[ComponentLength] != L'\0') {
+      ++ComponentLength;
+    }
+    FileName += ComponentLength;
+
+    if (ComponentLength == 0 || (ComponentLength == 1 && Component[0] == L'.')) {
+      continue;
+    }
+
+    if (ComponentLength == 2 && Component[0] == L'.' && Component[1] == L'.') {
+      while (PathLength > 0 && FilePath[PathLength - 1] != L'\\') {
+        --PathLength;
+      }
+      if (PathLength > 0) {
+        --PathLength;
+      }
+      continue;
+    }
+
+    FilePath[PathLength++] = L'\\';
+    CopyMem (&FilePath[PathLength], Component, ComponentLength * sizeof (CHAR16));
+    PathLength += ComponentLength;
+  }
+
+  FilePath[PathLength] = L'\0';
+
+  Data->Volume   = Volume;
+  Data->FilePath = FilePath;
+
+  if ((OpenMode & EFI_FILE_MODE_WRITE) != 0) {
+    InternalCacheInvalidatePath (Volume, FilePath);
+    Data->CacheProbed = TRUE;
+  }
+}
+
+VOID
+VirtualFileCacheAttach (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  )
+{
+  EFI_STATUS                Status;
+  EFI_FILE_INFO             *FileInfo;
+  VIRTUAL_FILE_CACHE_ENTRY  *Entry;
+  UINT64                    Position;
+  UINTN                     ReadSize;
+
+  ASSERT (Data->OriginalProtocol != NULL);
+
+  if (Data->CacheProbed || Data->FilePath == NULL || mVirtualFileCacheMaxSize == 0) {
+    return;
+  }
+
+  Data->CacheProbed = TRUE;
+
+  FileInfo = InternalGetFileInfo (Data->OriginalProtocol);
+  if (FileInfo == NULL) {
+    return;
+  }
+
+  if ((FileInfo->Attribute & EFI_FILE_DIRECTORY) != 0
+    || FileInfo->FileSize == 0
+    || FileInfo->FileSize > mVirtualFileCacheMaxSize) {
+    FreePool (FileInfo);
+    return;
+  }
+
+  Status = Data->OriginalProtocol->GetPosition (Data->OriginalProtocol, &Position);
+  if (EFI_ERROR (Status)) {
+    FreePool (FileInfo);
+    return;
+  }
+
+  Entry = InternalCacheLookup (
+    Data->Volume,
+    Data->FilePath,
+    &FileInfo->ModificationTime,
+    FileInfo->FileSize
+    );
+
+  if (Entry != NULL) {
+    RemoveEntryList (&Entry->Link);
+  } else {
+    if (!InternalCacheReserve ((UINTN) FileInfo->FileSize)) {
+      FreePool (FileInfo);
+      return;
+    }
+
+    Entry = AllocateZeroPool (sizeof (*Entry));
+    if (Entry == NULL) {
+      FreePool (FileInfo);
+      return;
+    }
+
+    Entry->Volume     = Data->Volume;
+    Entry->FileSize   = FileInfo->FileSize;
+    Entry->FilePath   = AllocateCopyPool (StrSize (Data->FilePath), Data->FilePath);
+    Entry->FileBuffer = AllocatePool ((UINTN) FileInfo->FileSize);
+    CopyMem (&Entry->ModificationTime, &FileInfo->ModificationTime, sizeof (Entry->ModificationTime));
+
+    //
+    // Read the whole file at once, original position is restored on detach.
+    //
+    Status = EFI_OUT_OF_RESOURCES;
+    if (Entry->FilePath != NULL && Entry->FileBuffer != NULL) {
+      Status = Data->OriginalProtocol->SetPosition (Data->OriginalProtocol, 0);
+      if (!EFI_ERROR (Status)) {
+        ReadSize = (UINTN) Entry->FileSize;
+        Status   = Data->OriginalProtocol->Read (Data->OriginalProtocol, &ReadSize, Entry->FileBuffer);
+        if (!EFI_ERROR (Status) && ReadSize != Entry->FileSize) {
+          Status = EFI_BAD_BUFFER_SIZE;
+        }
+      }
+    }
+
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "OCVFS: Failed to cache %s - %r\n", Data->FilePath, Status));
+      Data->OriginalProtocol->SetPosition (Data->OriginalProtocol, Position);
+      if (Entry->FileBuffer != NULL) {
+        FreePool (Entry->FileBuffer);
+      }
+      if (Entry->FilePath != NULL) {
+        FreePool (Entry->FilePath);
+      }
+      FreePool (Entry);
+      FreePool (FileInfo);
+      return;
+    }
+
+    DEBUG ((DEBUG_VERBOSE, "OCVFS: Cached %s of %Lu bytes\n", Data->FilePath, Entry->FileSize));
+    mVirtualFileCacheUsed += (UINTN) Entry->FileSize;
+  }
+
+  InsertHeadList (&mVirtualFileCache, &Entry->Link);
+  ++Entry->RefCount;
+
+  Data->CacheEntry   = Entry;
+  Data->FileBuffer   = Entry->FileBuffer;
+  Data->FileSize     = Entry->FileSize;
+  Data->FilePosition = Position;
+
+  FreePool (FileInfo);
+}
+
+VOID
+VirtualFileCacheDetach (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  )
+{
+  ASSERT (Data->OriginalProtocol != NULL);
+
+  if (Data->CacheEntry != NULL) {
+    Data->OriginalProtocol->SetPosition (Data->OriginalProtocol, Data->FilePosition);
+    InternalCacheRelease (Data);
+  }
+
+  if (Data->FilePath != NULL) {
+    InternalCacheInvalidatePath (Data->Volume, Data->FilePath);
+  }
+
+  Data->CacheProbed = TRUE;
+}
+
+VOID
+VirtualFileCacheFree (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  )
+{
+  InternalCacheRelease (Data);
+
+  if (Data->FilePath != NULL) {
+    FreePool (Data->FilePath);
+    Data->FilePath = NULL;
+  }
+}
+
+EFI_STATUS
+EnableVirtualFsCache (
+  IN UINTN  MaxCacheSize
+  )
+{
+  if (MaxCacheSize == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  mVirtualFileCacheMaxSize = MaxCacheSize;
+
+  //
+  // Shrink the cache when the limit was lowered.
+  //
+  InternalCacheReserve (0);
+
+  return EFI_SUCCESS;
+}
+
+VOID
+DisableVirtualFsCache (
+  VOID
+  )
+{
+  mVirtualFileCacheMaxSize = 0;
+
+  while (!IsListEmpty (&mVirtualFileCache)) {
+    InternalCacheEntryRemove (
+      VIRTUAL_FILE_CACHE_ENTRY_FROM_LINK (GetFirstNode (&mVirtualFileCache))
+      );
+  }
+}
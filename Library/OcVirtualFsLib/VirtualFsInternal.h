@@ -40,8 +40,16 @@
     VIRTUAL_FILE_DATA_SIGNATURE  \
     )
 
+#define VIRTUAL_FILE_CACHE_ENTRY_FROM_LINK(ListEntry) \
+  BASE_CR (                     \
+    ListEntry,                  \
+    VIRTUAL_FILE_CACHE_ENTRY,   \
+    Link                        \
+    )
+
 typedef struct VIRTUAL_FILESYSTEM_DATA_ VIRTUAL_FILESYSTEM_DATA;
 typedef struct VIRTUAL_FILE_DATA_ VIRTUAL_FILE_DATA;
+typedef struct VIRTUAL_FILE_CACHE_ENTRY_ VIRTUAL_FILE_CACHE_ENTRY;
 
 struct VIRTUAL_FILE_DATA_ {
   UINT32                   Signature;
@@ -52,9 +60,30 @@ struct VIRTUAL_FILE_DATA_ {
   EFI_TIME                 ModificationTime;
   EFI_FILE_OPEN            OpenCallback;
   EFI_FILE_PROTOCOL        *OriginalProtocol;
+  //
+  // Real file volume and absolute path for read caching, NULL when unknown.
+  //
+  VIRTUAL_FILESYSTEM_DATA  *Volume;
+  CHAR16                   *FilePath;
+  //
+  // Cached contents of a real file, FileBuffer and FileSize refer to it.
+  //
+  VIRTUAL_FILE_CACHE_ENTRY *CacheEntry;
+  BOOLEAN                  CacheProbed;
   EFI_FILE_PROTOCOL        Protocol;
 };
 
+struct VIRTUAL_FILE_CACHE_ENTRY_ {
+  LIST_ENTRY               Link;
+  VIRTUAL_FILESYSTEM_DATA  *Volume;
+  CHAR16                   *FilePath;
+  EFI_TIME                 ModificationTime;
+  UINT8                    *FileBuffer;
+  UINT64                   FileSize;
+  UINT32                   RefCount;
+  BOOLEAN                  Stale;
+};
+
 struct VIRTUAL_FILESYSTEM_DATA_ {
   UINT32                           Signature;
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  *OriginalFileSystem;
@@ -62,4 +91,59 @@ struct VIRTUAL_FILESYSTEM_DATA_ {
   EFI_SIMPLE_FILE_SYSTEM_PROTOCOL  FileSystem;
 };
 
+/**
+  Assign the volume and absolute path to a newly opened real file.
+  Files opened for writing drop cached contents of their path
+  and are never cached themselves.
+
+  @param[in,out] Data        Newly opened real file data.
+  @param[in]     Volume      Virtual volume the file belongs to.
+  @param[in]     ParentPath  Absolute path of the directory the file
+                             was opened from, NULL for volume root.
+  @param[in]     FileName    File name relative to ParentPath or absolute.
+  @param[in]     OpenMode    File open mode.
+**/
+VOID
+VirtualFileCacheSetPath (
+  IN OUT VIRTUAL_FILE_DATA        *Data,
+  IN     VIRTUAL_FILESYSTEM_DATA  *Volume,
+  IN     CONST CHAR16             *ParentPath  OPTIONAL,
+  IN     CONST CHAR16             *FileName,
+  IN     UINT64                   OpenMode
+  );
+
+/**
+  Attach cached contents to a real file on its first read.
+  Nothing is done when caching is disabled, the file path is unknown,
+  the file is a directory, or it does not fit the cache.
+
+  @param[in,out] Data  Real file data.
+**/
+VOID
+VirtualFileCacheAttach (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  );
+
+/**
+  Detach cached contents from a real file before it is modified,
+  restoring the original file position and dropping cached contents
+  of its path.
+
+  @param[in,out] Data  Real file data.
+**/
+VOID
+VirtualFileCacheDetach (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  );
+
+/**
+  Release cache references and path of a real file being closed.
+
+  @param[in,out] Data  Real file data.
+**/
+VOID
+VirtualFileCacheFree (
+  IN OUT VIRTUAL_FILE_DATA  *Data
+  );
+
 #endif // VIRTUAL_FS_INTERNAL_H
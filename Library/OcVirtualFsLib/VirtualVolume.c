@@ -53,7 +53,16 @@ VirtualFsOpenVolume (
     );
 
   if (!EFI_ERROR (Status)) {
-    return CreateRealFile (NewFile, Data->OpenCallback, TRUE, Root);
+    Status = CreateRealFile (NewFile, Data->OpenCallback, TRUE, Root);
+    if (!EFI_ERROR (Status)) {
+      VirtualFileCacheSetPath (
+        VIRTUAL_FILE_FROM_PROTOCOL (*Root),
+        Data,
+        NULL,
+        L"",
+        EFI_FILE_MODE_READ
+        );
+    }
   }
 
   return Status;
@@ -0,0 +1,378 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/OcFileLib.h>
+
+/*
+ clang -g -fsanitize=undefined,address -fshort-wchar -I../Include -I../../Include -I../../../EfiPkg/Include/ -I../../../MdePkg/Include/ -include ../Include/Base.h FileReader.c ../../Library/OcFileLib/FileReader.c ../../Library/OcFileLib/FileProtocol.c ../../Library/OcFileLib/ReadFile.c -o FileReader
+
+ rm -rf FileReader.dSYM FileReader
+*/
+
+#define TEST_KERNEL_SIZE      (12 * 1024 * 1024)
+#define TEST_FAT_OFFSET       4096
+#define TEST_HEADER_SIZE      (2 * EFI_PAGE_SIZE)
+#define TEST_COMP_HEADER_SIZE 384
+#define TEST_SMALL_READS      20000
+
+typedef struct {
+  UINT64  SetPosition;
+  UINT64  GetPosition;
+  UINT64  GetInfo;
+  UINT64  Read;
+  UINT64  ReadBytes;
+} TEST_FILE_STATS;
+
+//
+// Mock file over a memory buffer, the protocol must be the first field.
+//
+typedef struct {
+  EFI_FILE_PROTOCOL  Protocol;
+  UINT8              *Data;
+  UINT64             Size;
+  UINT64             Position;
+  TEST_FILE_STATS    Stats;
+} TEST_FILE;
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestSetPosition (
+  IN EFI_FILE_PROTOCOL  *This,
+  IN UINT64             Position
+  )
+{
+  TEST_FILE  *File;
+
+  File = (TEST_FILE *) This;
+  ++File->Stats.SetPosition;
+
+  if (Position == 0xFFFFFFFFFFFFFFFFULL) {
+    File->Position = File->Size;
+  } else {
+    File->Position = Position;
+  }
+
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestGetPosition (
+  IN  EFI_FILE_PROTOCOL  *This,
+  OUT UINT64             *Position
+  )
+{
+  TEST_FILE  *File;
+
+  File = (TEST_FILE *) This;
+  ++File->Stats.GetPosition;
+
+  *Position = File->Position;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestRead (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN OUT UINTN              *BufferSize,
+     OUT VOID               *Buffer
+  )
+{
+  TEST_FILE  *File;
+  UINT64     Size;
+
+  File = (TEST_FILE *) This;
+  ++File->Stats.Read;
+
+  if (File->Position > File->Size) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  Size = File->Size - File->Position;
+  if (Size > *BufferSize) {
+    Size = *BufferSize;
+  }
+
+  memcpy (Buffer, File->Data + File->Position, Size);
+  File->Position  += Size;
+  File->Stats.ReadBytes += Size;
+  *BufferSize = (UINTN) Size;
+  return EFI_SUCCESS;
+}
+
+STATIC
+EFI_STATUS
+EFIAPI
+TestGetInfo (
+  IN     EFI_FILE_PROTOCOL  *This,
+  IN     EFI_GUID           *InformationType,
+  IN OUT UINTN              *BufferSize,
+     OUT VOID               *Buffer
+  )
+{
+  TEST_FILE      *File;
+  EFI_FILE_INFO  *FileInfo;
+
+  File = (TEST_FILE *) This;
+  ++File->Stats.GetInfo;
+
+  if (*BufferSize < SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16)) {
+    *BufferSize = SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16);
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  FileInfo = Buffer;
+  memset (FileInfo, 0, SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16));
+  FileInfo->Size     = SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16);
+  FileInfo->FileSize = File->Size;
+  *BufferSize        = SIZE_OF_EFI_FILE_INFO + sizeof (CHAR16);
+  return EFI_SUCCESS;
+}
+
+STATIC
+VOID
+TestInitFile (
+  OUT TEST_FILE  *File,
+  IN  UINT8      *Data,
+  IN  UINT64     Size
+  )
+{
+  memset (File, 0, sizeof (*File));
+  File->Protocol.SetPosition = TestSetPosition;
+  File->Protocol.GetPosition = TestGetPosition;
+  File->Protocol.Read        = TestRead;
+  File->Protocol.GetInfo     = TestGetInfo;
+  File->Data                 = Data;
+  File->Size                 = Size;
+}
+
+STATIC
+VOID
+TestPrintStats (
+  IN CONST CHAR8      *Name,
+  IN TEST_FILE_STATS  *Stats
+  )
+{
+  printf (
+    "%-28s %8llu calls (%llu seek, %llu tell, %llu info, %llu read) %10llu bytes\n",
+    Name,
+    (unsigned long long) (Stats->SetPosition + Stats->GetPosition + Stats->GetInfo + Stats->Read),
+    (unsigned long long) Stats->SetPosition,
+    (unsigned long long) Stats->GetPosition,
+    (unsigned long long) Stats->GetInfo,
+    (unsigned long long) Stats->Read,
+    (unsigned long long) Stats->ReadBytes
+    );
+}
+
+STATIC
+UINTN
+TestWholeFile (
+  IN UINT8   *Data,
+  IN UINT32  Size
+  )
+{
+  TEST_FILE  File;
+  UINT8      *Buffer;
+  UINT32     ReadSize;
+  CHAR8      Name[64];
+  UINTN      Failures;
+
+  Failures = 0;
+
+  //
+  // Former ReadFile pattern: size the file, then read it.
+  //
+  TestInitFile (&File, Data, Size);
+  Buffer = malloc (Size + 2);
+  if (Buffer == NULL
+    || EFI_ERROR (GetFileSize (&File.Protocol, &ReadSize))
+    || ReadSize != Size
+    || EFI_ERROR (GetFileData (&File.Protocol, 0, Size, Buffer))
+    || memcmp (Buffer, Data, Size) != 0) {
+    ++Failures;
+  }
+  free (Buffer);
+  snprintf (Name, sizeof (Name), "%u bytes sized read", Size);
+  TestPrintStats (Name, &File.Stats);
+
+  TestInitFile (&File, Data, Size);
+  Buffer = OcGetFileContents (&File.Protocol, &ReadSize, 0);
+  if (Buffer == NULL
+    || ReadSize != Size
+    || memcmp (Buffer, Data, Size) != 0
+    || Buffer[Size] != 0
+    || Buffer[Size + 1] != 0) {
+    ++Failures;
+  }
+  free (Buffer);
+  snprintf (Name, sizeof (Name), "%u bytes contents", Size);
+  TestPrintStats (Name, &File.Stats);
+
+  //
+  // Files above the limit must be rejected.
+  //
+  if (Size > 1) {
+    TestInitFile (&File, Data, Size);
+    Buffer = OcGetFileContents (&File.Protocol, &ReadSize, Size - 1);
+    if (Buffer != NULL) {
+      free (Buffer);
+      ++Failures;
+    }
+  }
+
+  return Failures;
+}
+
+STATIC
+UINTN
+TestKernelPattern (
+  IN UINT8  *Data
+  )
+{
+  TEST_FILE       File;
+  OC_FILE_READER  Reader;
+  UINT8           *Buffer;
+  UINT32          CompressedSize;
+  UINTN           Failures;
+  UINTN           Pass;
+
+  Failures       = 0;
+  CompressedSize = TEST_KERNEL_SIZE - TEST_FAT_OFFSET - TEST_COMP_HEADER_SIZE;
+  Buffer         = malloc (TEST_KERNEL_SIZE);
+  if (Buffer == NULL) {
+    return 1;
+  }
+
+  //
+  // Fat header, compressed header in the x86_64 slice, then compressed data,
+  // as ReadAppleKernel does for prelinkedkernel.
+  //
+  for (Pass = 0; Pass < 2; ++Pass) {
+    TestInitFile (&File, Data, TEST_KERNEL_SIZE);
+
+    if (Pass == 0) {
+      Failures += EFI_ERROR (GetFileData (&File.Protocol, 0, TEST_HEADER_SIZE, Buffer));
+      Failures += memcmp (Buffer, Data, TEST_HEADER_SIZE) != 0;
+      Failures += EFI_ERROR (GetFileData (&File.Protocol, TEST_FAT_OFFSET, TEST_HEADER_SIZE, Buffer));
+      Failures += memcmp (Buffer, Data + TEST_FAT_OFFSET, TEST_HEADER_SIZE) != 0;
+      Failures += EFI_ERROR (GetFileData (&File.Protocol, TEST_FAT_OFFSET + TEST_COMP_HEADER_SIZE, CompressedSize, Buffer));
+      Failures += memcmp (Buffer, Data + TEST_FAT_OFFSET + TEST_COMP_HEADER_SIZE, CompressedSize) != 0;
+      TestPrintStats ("kernel unbuffered", &File.Stats);
+    } else {
+      Failures += EFI_ERROR (OcFileReaderInit (&Reader, &File.Protocol, OC_FILE_READER_WINDOW_SIZE, OC_FILE_READER_BLOCK_SIZE));
+      Failures += EFI_ERROR (OcFileReaderRead (&Reader, 0, TEST_HEADER_SIZE, Buffer));
+      Failures += memcmp (Buffer, Data, TEST_HEADER_SIZE) != 0;
+      Failures += EFI_ERROR (OcFileReaderRead (&Reader, TEST_FAT_OFFSET, TEST_HEADER_SIZE, Buffer));
+      Failures += memcmp (Buffer, Data + TEST_FAT_OFFSET, TEST_HEADER_SIZE) != 0;
+      Failures += EFI_ERROR (OcFileReaderRead (&Reader, TEST_FAT_OFFSET + TEST_COMP_HEADER_SIZE, CompressedSize, Buffer));
+      Failures += memcmp (Buffer, Data + TEST_FAT_OFFSET + TEST_COMP_HEADER_SIZE, CompressedSize) != 0;
+      TestPrintStats ("kernel buffered", &File.Stats);
+      //
+      // Reading past the end must fail.
+      //
+      Failures += !EFI_ERROR (OcFileReaderRead (&Reader, TEST_KERNEL_SIZE - 16, 32, Buffer));
+      OcFileReaderFree (&Reader);
+    }
+  }
+
+  free (Buffer);
+  return Failures;
+}
+
+STATIC
+UINTN
+TestSmallReads (
+  IN UINT8   *Data,
+  IN UINT32  WindowSize,
+  IN UINT32  BlockSize
+  )
+{
+  TEST_FILE       File;
+  OC_FILE_READER  Reader;
+  UINT8           Buffer[1024];
+  UINT32          Position;
+  UINT32          Size;
+  UINTN           Index;
+  UINTN           Failures;
+  CHAR8           Name[64];
+
+  Failures = 0;
+  TestInitFile (&File, Data, TEST_KERNEL_SIZE);
+
+  if (EFI_ERROR (OcFileReaderInit (&Reader, &File.Protocol, WindowSize, BlockSize))) {
+    return 1;
+  }
+
+  //
+  // Mostly forward small reads with occasional jumps, like parsers do.
+  //
+  srand (1);
+  Position = 0;
+  for (Index = 0; Index < TEST_SMALL_READS; ++Index) {
+    Size = 1 + rand () % sizeof (Buffer);
+    if (rand () % 16 == 0) {
+      Position = rand () % (TEST_KERNEL_SIZE - sizeof (Buffer));
+    } else if (Position + 2 * sizeof (Buffer) < TEST_KERNEL_SIZE) {
+      Position += rand () % sizeof (Buffer);
+    }
+
+    if (EFI_ERROR (OcFileReaderRead (&Reader, Position, Size, Buffer))
+      || memcmp (Buffer, Data + Position, Size) != 0) {
+      ++Failures;
+    }
+  }
+
+  OcFileReaderFree (&Reader);
+
+  snprintf (Name, sizeof (Name), "small reads %u/%u", WindowSize, BlockSize);
+  TestPrintStats (Name, &File.Stats);
+  return Failures;
+}
+
+int main (int argc, char** argv) {
+  UINT8   *Data;
+  UINTN   Index;
+  UINTN   Failures;
+
+  Data = malloc (TEST_KERNEL_SIZE);
+  if (Data == NULL) {
+    return 1;
+  }
+
+  srand (argc > 1 ? atoi (argv[1]) : 1);
+  for (Index = 0; Index < TEST_KERNEL_SIZE; ++Index) {
+    Data[Index] = (UINT8) rand ();
+  }
+
+  Failures  = TestWholeFile (Data, 1);
+  Failures += TestWholeFile (Data, 2000);
+  Failures += TestWholeFile (Data, OC_FILE_READER_WINDOW_SIZE);
+  Failures += TestWholeFile (Data, OC_FILE_READER_WINDOW_SIZE + 1);
+  Failures += TestWholeFile (Data, 200000);
+  Failures += TestKernelPattern (Data);
+  Failures += TestSmallReads (Data, 0, 0);
+  Failures += TestSmallReads (Data, BASE_16KB, 512);
+  Failures += TestSmallReads (Data, OC_FILE_READER_WINDOW_SIZE, OC_FILE_READER_BLOCK_SIZE);
+
+  free (Data);
+
+  printf ("%u failures\n", (UINT32) Failures);
+
+  return Failures != 0;
+}
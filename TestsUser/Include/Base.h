@@ -1363,6 +1363,22 @@ HighBitSet32 (
   return BitIndex;
 }
 
+STATIC
+INTN
+LowBitSet32 (
+  IN      UINT32                    Operand
+  )
+{
+  INTN                              BitIndex;
+
+  if (Operand == 0) {
+    return -1;
+  }
+
+  for (BitIndex = 0; 0 == (Operand & 1); BitIndex++, Operand >>= 1);
+  return BitIndex;
+}
+
 
 STATIC
 UINT32
@@ -1828,6 +1844,7 @@ EFI_STATUS
 //
 #define _PCD_GET_MODE_BOOL_PcdEnableAppleThunderboltSync false
 #define _PCD_GET_MODE_BOOL_PcNvramInitDevicePropertyDatabase false
+#define _PCD_GET_MODE_BOOL_PcdOcCpuPersistInfo false
 #define _PCD_GET_MODE_32_PcdMaximumDevicePathNodeCount 11
 #define _PCD_GET_MODE_32_PcdMaximumUnicodeStringLength 0xFFFFFFFF
 
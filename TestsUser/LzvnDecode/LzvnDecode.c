@@ -0,0 +1,250 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <IndustryStandard/AppleCompressedBinaryImage.h>
+#include <IndustryStandard/AppleFatBinaryImage.h>
+
+//
+// Include the decoder directly to reach the reference state machine.
+//
+#include "../../Library/OcCompressionLib/lzvn/lzvn.c"
+
+#include <sys/time.h>
+
+/*
+ clang -O2 -fshort-wchar -I../Include -I../../Include -I../../../MdePkg/Include/ -I../../../EfiPkg/Include/ -include ../Include/Base.h LzvnDecode.c -o LzvnDecode
+
+ ./LzvnDecode [-r rounds] prelinkedkernel ...
+
+ rm -rf LzvnDecode.dSYM LzvnDecode
+*/
+
+#define TEST_DEFAULT_ROUNDS 10
+
+long long current_timestamp() {
+  struct timeval te;
+  gettimeofday(&te, NULL); // get current time
+  long long microseconds = te.tv_sec*1000000LL + te.tv_usec;
+  return microseconds;
+}
+
+uint8_t *readFile(const char *str, uint32_t *size) {
+  FILE *f = fopen(str, "rb");
+
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long fsize = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *string = malloc(fsize + 1);
+  fread(string, fsize, 1, f);
+  fclose(f);
+
+  string[fsize] = 0;
+  *size = fsize;
+
+  return string;
+}
+
+//
+// Locate LZVN compressed kernel, optionally within x86_64 fat slice.
+//
+static MACH_COMP_HEADER *findCompHeader(uint8_t *buffer, uint32_t size) {
+  MACH_FAT_HEADER  *FatHeader;
+  MACH_COMP_HEADER *CompHeader;
+  BOOLEAN          Swap;
+  uint32_t         Count;
+  uint32_t         Offset;
+  uint32_t         i;
+
+  if (size < sizeof (MACH_FAT_HEADER)) {
+    return NULL;
+  }
+
+  Offset    = 0;
+  FatHeader = (MACH_FAT_HEADER *) buffer;
+  if (FatHeader->Signature == MACH_FAT_BINARY_SIGNATURE
+    || FatHeader->Signature == MACH_FAT_BINARY_INVERT_SIGNATURE) {
+    Swap  = FatHeader->Signature == MACH_FAT_BINARY_INVERT_SIGNATURE;
+    Count = Swap ? SwapBytes32 (FatHeader->NumberOfFatArch) : FatHeader->NumberOfFatArch;
+    if (Count > (size - sizeof (MACH_FAT_HEADER)) / sizeof (MACH_FAT_ARCH)) {
+      return NULL;
+    }
+
+    for (i = 0; i < Count; ++i) {
+      if ((Swap ? SwapBytes32 (FatHeader->FatArch[i].CpuType) : FatHeader->FatArch[i].CpuType) == MachCpuTypeX8664) {
+        Offset = Swap ? SwapBytes32 (FatHeader->FatArch[i].Offset) : FatHeader->FatArch[i].Offset;
+        break;
+      }
+    }
+
+    if (i == Count) {
+      return NULL;
+    }
+  }
+
+  if (Offset > size || size - Offset < sizeof (MACH_COMP_HEADER)) {
+    return NULL;
+  }
+
+  CompHeader = (MACH_COMP_HEADER *) (buffer + Offset);
+  if (CompHeader->Signature != MACH_COMPRESSED_BINARY_INVERT_SIGNATURE
+    || CompHeader->Compression != MACH_COMPRESSED_BINARY_INVERT_LZVN
+    || SwapBytes32 (CompHeader->Compressed) > size - Offset - sizeof (MACH_COMP_HEADER)) {
+    return NULL;
+  }
+
+  return CompHeader;
+}
+
+//
+// Decode with the reference state machine only, as OcCompressionLib did before.
+//
+static size_t decodeReference(unsigned char *dst, size_t dst_size, const unsigned char *src, size_t src_size) {
+  lzvn_decoder_state dstate;
+
+  memset(&dstate, 0x00, sizeof(dstate));
+  dstate.src = src;
+  dstate.src_end = src + src_size;
+
+  dstate.dst_begin = dst;
+  dstate.dst = dst;
+  dstate.dst_end = dst + dst_size;
+
+  lzvn_decode(&dstate);
+
+  return dstate.dst - dst;
+}
+
+int main(int argc, char** argv) {
+  uint32_t   rounds = TEST_DEFAULT_ROUNDS;
+  uint32_t   count;
+  uint8_t    **files;
+  uint32_t   *sizes;
+  MACH_COMP_HEADER **headers;
+  uint8_t    *expected;
+  uint8_t    *actual;
+  uint64_t   total = 0;
+  uint32_t   maxSize = 0;
+  uint32_t   i, r;
+  int        first = 1;
+  long long  start;
+  long long  referenceTime;
+  long long  fastTime;
+
+  if (argc > 2 && strcmp (argv[1], "-r") == 0) {
+    rounds = (uint32_t) strtoul (argv[2], NULL, 0);
+    first  = 3;
+  }
+
+  if (argc <= first || rounds == 0) {
+    printf ("Usage: %s [-r rounds] prelinkedkernel ...\n", argv[0]);
+    return -1;
+  }
+
+  count   = argc - first;
+  files   = calloc (count, sizeof (*files));
+  sizes   = calloc (count, sizeof (*sizes));
+  headers = calloc (count, sizeof (*headers));
+
+  for (i = 0; i < count; ++i) {
+    files[i] = readFile (argv[first + i], &sizes[i]);
+    if (files[i] == NULL) {
+      printf ("Failed to read %s\n", argv[first + i]);
+      return -1;
+    }
+
+    headers[i] = findCompHeader (files[i], sizes[i]);
+    if (headers[i] == NULL) {
+      printf ("No LZVN compressed kernel in %s\n", argv[first + i]);
+      return -1;
+    }
+
+    if (SwapBytes32 (headers[i]->Decompressed) > maxSize) {
+      maxSize = SwapBytes32 (headers[i]->Decompressed);
+    }
+
+    total += SwapBytes32 (headers[i]->Decompressed);
+  }
+
+  expected = malloc (maxSize);
+  actual   = malloc (maxSize);
+  if (expected == NULL || actual == NULL) {
+    printf ("Failed to allocate %u bytes\n", maxSize);
+    return -1;
+  }
+
+  //
+  // Check both decoders agree on every kernel.
+  //
+  for (i = 0; i < count; ++i) {
+    uint32_t Decompressed = SwapBytes32 (headers[i]->Decompressed);
+    uint32_t Compressed   = SwapBytes32 (headers[i]->Compressed);
+    uint8_t  *Data        = (uint8_t *) (headers[i] + 1);
+
+    if (decodeReference (expected, Decompressed, Data, Compressed) != Decompressed) {
+      printf ("Reference decoder failed on %s\n", argv[first + i]);
+      return -1;
+    }
+
+    if (DecompressLZVN (actual, Decompressed, Data, Compressed) != Decompressed
+      || memcmp (expected, actual, Decompressed) != 0) {
+      printf ("Decoder mismatch in %s\n", argv[first + i]);
+      return -1;
+    }
+  }
+
+  start = current_timestamp ();
+  for (r = 0; r < rounds; ++r) {
+    for (i = 0; i < count; ++i) {
+      decodeReference (expected, SwapBytes32 (headers[i]->Decompressed),
+        (uint8_t *) (headers[i] + 1), SwapBytes32 (headers[i]->Compressed));
+    }
+  }
+  referenceTime = current_timestamp () - start;
+
+  start = current_timestamp ();
+  for (r = 0; r < rounds; ++r) {
+    for (i = 0; i < count; ++i) {
+      DecompressLZVN (actual, SwapBytes32 (headers[i]->Decompressed),
+        (uint8_t *) (headers[i] + 1), SwapBytes32 (headers[i]->Compressed));
+    }
+  }
+  fastTime = current_timestamp () - start;
+
+  if (referenceTime == 0) {
+    referenceTime = 1;
+  }
+
+  if (fastTime == 0) {
+    fastTime = 1;
+  }
+
+  printf ("%u kernels, %u rounds, %llu bytes decompressed per round\n", count, rounds, (unsigned long long) total);
+  printf ("reference: %lld us, %.2f GB/s\n", referenceTime, (double) total * rounds / referenceTime / 1000);
+  printf ("fast path: %lld us, %.2f GB/s\n", fastTime, (double) total * rounds / fastTime / 1000);
+
+  for (i = 0; i < count; ++i) {
+    free (files[i]);
+  }
+
+  free (files);
+  free (sizes);
+  free (headers);
+  free (expected);
+  free (actual);
+
+  return 0;
+}
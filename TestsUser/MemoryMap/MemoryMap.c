@@ -0,0 +1,442 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/OcMemoryLib.h>
+
+#include <sys/time.h>
+
+/*
+ clang -g -fsanitize=undefined,address -fshort-wchar -I../Include -I../../Include -I../../../EfiPkg/Include/ -I../../../MdePkg/Include/ -I../../../UefiCpuPkg/Include/ -include ../Include/Base.h MemoryMap.c ../../Library/OcMemoryLib/MemoryMap.c -o MemoryMap
+
+ rm -rf MemoryMap.dSYM MemoryMap
+
+ ./MemoryMap [seed]                   - fuzz against reference implementation and benchmark.
+ ./MemoryMap memmap.bin [descsize]    - replay a raw memory map dump, e.g. saved from GetMemoryMap.
+*/
+
+#define TEST_DESCRIPTOR_SIZE  48
+#define TEST_MAX_DESCRIPTORS  1024
+#define TEST_FUZZ_ROUNDS      20000
+#define TEST_BENCH_ROUNDS     2000
+
+/**
+  Original ShrinkMemoryMap implementation moving the tail on every join.
+**/
+STATIC
+VOID
+ReferenceShrinkMemoryMap (
+  IN OUT UINTN                  *MemoryMapSize,
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  DescriptorSize
+  )
+{
+  UINTN                   SizeFromDescToEnd;
+  UINT64                  Bytes;
+  EFI_MEMORY_DESCRIPTOR   *PrevDesc;
+  EFI_MEMORY_DESCRIPTOR   *Desc;
+  BOOLEAN                 CanBeJoined;
+  BOOLEAN                 HasEntriesToRemove;
+
+  PrevDesc           = MemoryMap;
+  Desc               = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+  SizeFromDescToEnd  = *MemoryMapSize - DescriptorSize;
+  *MemoryMapSize     = DescriptorSize;
+  HasEntriesToRemove = FALSE;
+
+  while (SizeFromDescToEnd > 0) {
+    Bytes = EFI_PAGES_TO_SIZE (PrevDesc->NumberOfPages);
+    CanBeJoined = FALSE;
+    if (Desc->Attribute == PrevDesc->Attribute
+      && PrevDesc->PhysicalStart + Bytes == Desc->PhysicalStart) {
+      CanBeJoined = (Desc->Type == EfiBootServicesCode ||
+        Desc->Type == EfiBootServicesData ||
+        Desc->Type == EfiConventionalMemory ||
+        Desc->Type == EfiLoaderCode ||
+        Desc->Type == EfiLoaderData) && (
+        PrevDesc->Type == EfiBootServicesCode ||
+        PrevDesc->Type == EfiBootServicesData ||
+        PrevDesc->Type == EfiConventionalMemory ||
+        PrevDesc->Type == EfiLoaderCode ||
+        PrevDesc->Type == EfiLoaderData);
+    }
+
+    if (CanBeJoined) {
+      PrevDesc->Type           = EfiConventionalMemory;
+      PrevDesc->NumberOfPages += Desc->NumberOfPages;
+      HasEntriesToRemove       = TRUE;
+    } else {
+      *MemoryMapSize += DescriptorSize;
+      PrevDesc        = NEXT_MEMORY_DESCRIPTOR (PrevDesc, DescriptorSize);
+      if (HasEntriesToRemove) {
+        CopyMem (PrevDesc, Desc, SizeFromDescToEnd);
+        Desc = PrevDesc;
+        HasEntriesToRemove = FALSE;
+      }
+    }
+
+    Desc = NEXT_MEMORY_DESCRIPTOR (Desc, DescriptorSize);
+    SizeFromDescToEnd -= DescriptorSize;
+  }
+}
+
+STATIC
+UINT64
+Now (
+  VOID
+  )
+{
+  struct timeval  Time;
+
+  gettimeofday (&Time, NULL);
+  return (UINT64) Time.tv_sec * 1000000ULL + Time.tv_usec;
+}
+
+/**
+  Generate firmware-like memory map: mostly contiguous, with boot services
+  allocations fragmenting conventional memory and runtime areas or holes
+  in between. Fuzz mode randomises attributes and types more aggressively.
+**/
+STATIC
+UINTN
+GenerateMemoryMap (
+  OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN  UINTN                  NumDescriptors,
+  IN  BOOLEAN                Fuzz
+  )
+{
+  STATIC CONST UINT32  mTypes[] = {
+    EfiConventionalMemory,
+    EfiConventionalMemory,
+    EfiBootServicesData,
+    EfiBootServicesData,
+    EfiBootServicesCode,
+    EfiLoaderData,
+    EfiLoaderCode,
+    EfiRuntimeServicesData,
+    EfiRuntimeServicesCode,
+    EfiReservedMemoryType,
+    EfiACPIReclaimMemory,
+    EfiACPIMemoryNVS,
+    EfiMemoryMappedIO
+  };
+
+  EFI_MEMORY_DESCRIPTOR  *Desc;
+  EFI_PHYSICAL_ADDRESS   Address;
+  UINTN                  Index;
+
+  ZeroMem (MemoryMap, NumDescriptors * TEST_DESCRIPTOR_SIZE);
+
+  Address = 0;
+  Desc    = MemoryMap;
+  for (Index = 0; Index < NumDescriptors; ++Index) {
+    Desc->Type          = mTypes[rand () % (Fuzz ? ARRAY_SIZE (mTypes) : ARRAY_SIZE (mTypes) - 4)];
+    Desc->PhysicalStart = Address;
+    Desc->NumberOfPages = 1 + rand () % (rand () % 8 == 0 ? 0x10000 : 64);
+    Desc->Attribute     = EFI_MEMORY_UC | EFI_MEMORY_WC | EFI_MEMORY_WT | EFI_MEMORY_WB;
+    if (Desc->Type == EfiRuntimeServicesData || Desc->Type == EfiRuntimeServicesCode) {
+      Desc->Attribute |= EFI_MEMORY_RUNTIME;
+    }
+
+    if (Fuzz && rand () % 16 == 0) {
+      Desc->Attribute = rand () % 4;
+    }
+
+    Address += EFI_PAGES_TO_SIZE (Desc->NumberOfPages);
+    if (rand () % (Fuzz ? 8 : 64) == 0) {
+      Address += EFI_PAGES_TO_SIZE (1 + rand () % 256);
+    }
+
+    Desc = NEXT_MEMORY_DESCRIPTOR (Desc, TEST_DESCRIPTOR_SIZE);
+  }
+
+  return NumDescriptors * TEST_DESCRIPTOR_SIZE;
+}
+
+/**
+  Move a few descriptors out of order, like some firmwares report them.
+**/
+STATIC
+VOID
+ShuffleMemoryMap (
+  IN OUT EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN     UINTN                  MemoryMapSize
+  )
+{
+  UINT8   Temp[TEST_DESCRIPTOR_SIZE];
+  UINTN   NumDescriptors;
+  UINTN   Count;
+  UINT8   *Left;
+  UINT8   *Right;
+
+  NumDescriptors = MemoryMapSize / TEST_DESCRIPTOR_SIZE;
+  for (Count = rand () % 8; Count > 0; --Count) {
+    Left  = (UINT8 *) MemoryMap + (rand () % NumDescriptors) * TEST_DESCRIPTOR_SIZE;
+    Right = (UINT8 *) MemoryMap + (rand () % NumDescriptors) * TEST_DESCRIPTOR_SIZE;
+    CopyMem (Temp, Left, TEST_DESCRIPTOR_SIZE);
+    CopyMem (Left, Right, TEST_DESCRIPTOR_SIZE);
+    CopyMem (Right, Temp, TEST_DESCRIPTOR_SIZE);
+  }
+}
+
+STATIC
+UINT64
+TotalPages (
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                  MemoryMapSize,
+  IN UINTN                  DescriptorSize
+  )
+{
+  UINT64  Pages;
+  UINTN   Index;
+
+  Pages = 0;
+  for (Index = 0; Index < MemoryMapSize / DescriptorSize; ++Index) {
+    Pages += MemoryMap->NumberOfPages;
+    MemoryMap = NEXT_MEMORY_DESCRIPTOR (MemoryMap, DescriptorSize);
+  }
+
+  return Pages;
+}
+
+STATIC
+BOOLEAN
+IsSorted (
+  IN EFI_MEMORY_DESCRIPTOR  *MemoryMap,
+  IN UINTN                  MemoryMapSize,
+  IN UINTN                  DescriptorSize
+  )
+{
+  UINTN  Index;
+
+  for (Index = 1; Index < MemoryMapSize / DescriptorSize; ++Index) {
+    if (MemoryMap->PhysicalStart > NEXT_MEMORY_DESCRIPTOR (MemoryMap, DescriptorSize)->PhysicalStart) {
+      return FALSE;
+    }
+
+    MemoryMap = NEXT_MEMORY_DESCRIPTOR (MemoryMap, DescriptorSize);
+  }
+
+  return TRUE;
+}
+
+STATIC
+UINTN
+FuzzMemoryMap (
+  VOID
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  EFI_MEMORY_DESCRIPTOR  *Reference;
+  UINTN                  MemoryMapSize;
+  UINTN                  ReferenceSize;
+  UINT64                 Pages;
+  UINTN                  Round;
+  UINTN                  Failures;
+
+  MemoryMap = AllocatePool (TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE);
+  Reference = AllocatePool (TEST_MAX_DESCRIPTORS * TEST_DESCRIPTOR_SIZE);
+  if (MemoryMap == NULL || Reference == NULL) {
+    abort ();
+  }
+
+  Failures = 0;
+
+  for (Round = 0; Round < TEST_FUZZ_ROUNDS; ++Round) {
+    MemoryMapSize = GenerateMemoryMap (MemoryMap, 1 + rand () % TEST_MAX_DESCRIPTORS, TRUE);
+    ReferenceSize = MemoryMapSize;
+    CopyMem (Reference, MemoryMap, MemoryMapSize);
+
+    ReferenceShrinkMemoryMap (&ReferenceSize, Reference, TEST_DESCRIPTOR_SIZE);
+    ShrinkMemoryMap (&MemoryMapSize, MemoryMap, TEST_DESCRIPTOR_SIZE);
+
+    if (MemoryMapSize != ReferenceSize || CompareMem (MemoryMap, Reference, MemoryMapSize) != 0) {
+      printf ("Shrink mismatch in round %u\n", (UINT32) Round);
+      ++Failures;
+    }
+
+    MemoryMapSize = GenerateMemoryMap (MemoryMap, 1 + rand () % TEST_MAX_DESCRIPTORS, FALSE);
+    Pages         = TotalPages (MemoryMap, MemoryMapSize, TEST_DESCRIPTOR_SIZE);
+    ReferenceSize = MemoryMapSize;
+    CopyMem (Reference, MemoryMap, MemoryMapSize);
+
+    ShuffleMemoryMap (MemoryMap, MemoryMapSize);
+    SortMemoryMap (MemoryMapSize, MemoryMap, TEST_DESCRIPTOR_SIZE);
+
+    //
+    // Generated descriptors have unique addresses, so the sorted map must match the original.
+    //
+    if (!IsSorted (MemoryMap, MemoryMapSize, TEST_DESCRIPTOR_SIZE)
+      || CompareMem (MemoryMap, Reference, MemoryMapSize) != 0) {
+      printf ("Sort mismatch in round %u\n", (UINT32) Round);
+      ++Failures;
+    }
+
+    ShrinkMemoryMap (&MemoryMapSize, MemoryMap, TEST_DESCRIPTOR_SIZE);
+    if (TotalPages (MemoryMap, MemoryMapSize, TEST_DESCRIPTOR_SIZE) != Pages) {
+      printf ("Page count mismatch in round %u\n", (UINT32) Round);
+      ++Failures;
+    }
+  }
+
+  FreePool (Reference);
+  FreePool (MemoryMap);
+
+  return Failures;
+}
+
+STATIC
+VOID
+BenchmarkMemoryMap (
+  IN UINTN  NumDescriptors
+  )
+{
+  EFI_MEMORY_DESCRIPTOR  *Original;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  UINTN                  OriginalSize;
+  UINTN                  MemoryMapSize;
+  UINTN                  Round;
+  UINT64                 Start;
+  UINT64                 ReferenceTime;
+  UINT64                 ShrinkTime;
+  UINT64                 SortTime;
+
+  Original  = AllocatePool (NumDescriptors * TEST_DESCRIPTOR_SIZE);
+  MemoryMap = AllocatePool (NumDescriptors * TEST_DESCRIPTOR_SIZE);
+  if (Original == NULL || MemoryMap == NULL) {
+    abort ();
+  }
+
+  OriginalSize  = GenerateMemoryMap (Original, NumDescriptors, FALSE);
+  ReferenceTime = 0;
+  ShrinkTime    = 0;
+  SortTime      = 0;
+
+  for (Round = 0; Round < TEST_BENCH_ROUNDS; ++Round) {
+    MemoryMapSize = OriginalSize;
+    CopyMem (MemoryMap, Original, OriginalSize);
+    Start = Now ();
+    ReferenceShrinkMemoryMap (&MemoryMapSize, MemoryMap, TEST_DESCRIPTOR_SIZE);
+    ReferenceTime += Now () - Start;
+
+    MemoryMapSize = OriginalSize;
+    CopyMem (MemoryMap, Original, OriginalSize);
+    Start = Now ();
+    SortMemoryMap (MemoryMapSize, MemoryMap, TEST_DESCRIPTOR_SIZE);
+    SortTime += Now () - Start;
+    Start = Now ();
+    ShrinkMemoryMap (&MemoryMapSize, MemoryMap, TEST_DESCRIPTOR_SIZE);
+    ShrinkTime += Now () - Start;
+  }
+
+  printf (
+    "%4u -> %4u descriptors: reference %llu ns, shrink %llu ns, sort %llu ns\n",
+    (UINT32) NumDescriptors,
+    (UINT32) (MemoryMapSize / TEST_DESCRIPTOR_SIZE),
+    (unsigned long long) (ReferenceTime * 1000 / TEST_BENCH_ROUNDS),
+    (unsigned long long) (ShrinkTime * 1000 / TEST_BENCH_ROUNDS),
+    (unsigned long long) (SortTime * 1000 / TEST_BENCH_ROUNDS)
+    );
+
+  FreePool (MemoryMap);
+  FreePool (Original);
+}
+
+STATIC
+int
+ReplayMemoryMap (
+  IN CONST char  *Path,
+  IN UINTN       DescriptorSize
+  )
+{
+  FILE                   *File;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  EFI_MEMORY_DESCRIPTOR  *Reference;
+  UINTN                  MemoryMapSize;
+  UINTN                  ReferenceSize;
+  UINT64                 Pages;
+
+  if (DescriptorSize < sizeof (EFI_MEMORY_DESCRIPTOR)) {
+    printf ("Invalid descriptor size %u\n", (UINT32) DescriptorSize);
+    return -1;
+  }
+
+  File = fopen (Path, "rb");
+  if (File == NULL) {
+    printf ("Cannot open %s\n", Path);
+    return -1;
+  }
+
+  MemoryMap     = AllocatePool (TEST_MAX_DESCRIPTORS * DescriptorSize);
+  Reference     = AllocatePool (TEST_MAX_DESCRIPTORS * DescriptorSize);
+  if (MemoryMap == NULL || Reference == NULL) {
+    abort ();
+  }
+
+  MemoryMapSize = fread (MemoryMap, 1, TEST_MAX_DESCRIPTORS * DescriptorSize, File);
+  MemoryMapSize -= MemoryMapSize % DescriptorSize;
+  fclose (File);
+
+  if (MemoryMapSize == 0) {
+    printf ("No descriptors in %s\n", Path);
+    FreePool (Reference);
+    FreePool (MemoryMap);
+    return -1;
+  }
+
+  Pages         = TotalPages (MemoryMap, MemoryMapSize, DescriptorSize);
+  ReferenceSize = MemoryMapSize;
+  CopyMem (Reference, MemoryMap, MemoryMapSize);
+
+  printf (
+    "%u descriptors, %s\n",
+    (UINT32) (MemoryMapSize / DescriptorSize),
+    IsSorted (MemoryMap, MemoryMapSize, DescriptorSize) ? "sorted" : "unsorted"
+    );
+
+  ReferenceShrinkMemoryMap (&ReferenceSize, Reference, DescriptorSize);
+  SortMemoryMap (MemoryMapSize, MemoryMap, DescriptorSize);
+  ShrinkMemoryMap (&MemoryMapSize, MemoryMap, DescriptorSize);
+
+  printf (
+    "reference shrink %u descriptors, sort and shrink %u descriptors, pages %s\n",
+    (UINT32) (ReferenceSize / DescriptorSize),
+    (UINT32) (MemoryMapSize / DescriptorSize),
+    TotalPages (MemoryMap, MemoryMapSize, DescriptorSize) == Pages ? "match" : "MISMATCH"
+    );
+
+  FreePool (Reference);
+  FreePool (MemoryMap);
+
+  return 0;
+}
+
+int main (int argc, char** argv) {
+  UINTN  Failures;
+
+  if (argc > 1 && atoi (argv[1]) == 0) {
+    return ReplayMemoryMap (argv[1], argc > 2 ? atoi (argv[2]) : TEST_DESCRIPTOR_SIZE);
+  }
+
+  srand (argc > 1 ? atoi (argv[1]) : 1);
+
+  Failures = FuzzMemoryMap ();
+
+  BenchmarkMemoryMap (64);
+  BenchmarkMemoryMap (256);
+  BenchmarkMemoryMap (1024);
+
+  printf ("%u failures\n", (UINT32) Failures);
+
+  return Failures != 0;
+}
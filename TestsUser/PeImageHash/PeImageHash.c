@@ -0,0 +1,277 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/OcAppleImageVerificationLib.h>
+
+#include <sys/time.h>
+
+/*
+ clang -O2 -fshort-wchar -I../Include -I../../Include -I../../../EfiPkg/Include/ -I../../../MdePkg/Include/ -include ../Include/Base.h PeImageHash.c ../../Library/OcAppleImageVerificationLib/OcAppleImageVerification.c ../../Library/OcAppleKeysLib/OcAppleKeysLib.c ../../Library/OcCryptoLib/Sha2.c ../../Library/OcCryptoLib/RsaDigitalSign.c ../../Library/OcCryptoLib/BigNumPrimitives.c ../../Library/OcCryptoLib/BigNumMontgomery.c ../../Library/OcCryptoLib/X64/BigNumWordMul64.c -o PeImageHash
+
+ ./PeImageHash [-r rounds] [-s size_mb] [apfs.efi ...]
+
+ Synthetic unsigned image of size_mb megabytes is always benchmarked, it fails
+ public key lookup, but is hashed completely. Apple images passed as arguments
+ must verify.
+
+ rm -rf PeImageHash.dSYM PeImageHash
+*/
+
+#define TEST_DEFAULT_ROUNDS    20
+#define TEST_DEFAULT_SIZE_MB   16
+#define TEST_READ_SIZE         (64 * 1024)
+#define TEST_HEADERS_SIZE      0x400
+#define TEST_SECTIONS          4
+
+EFI_GUID gAppleEfiCertificateGuid      = { 0x45E7BC51, 0x913C, 0x42AC, { 0x96, 0xA2, 0x10, 0x71, 0x2F, 0xFB, 0xEB, 0xA7 } };
+EFI_GUID gEfiCertTypeRsa2048Sha256Guid = { 0xA7717414, 0xC616, 0x4977, { 0x94, 0x20, 0x84, 0x47, 0x12, 0xA7, 0x35, 0xBF } };
+
+long long current_timestamp() {
+  struct timeval te;
+  gettimeofday(&te, NULL); // get current time
+  long long microseconds = te.tv_sec*1000000LL + te.tv_usec;
+  return microseconds;
+}
+
+uint8_t *readFile(const char *str, uint32_t *size) {
+  FILE *f = fopen(str, "rb");
+
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long fsize = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *string = malloc(fsize + 1);
+  fread(string, fsize, 1, f);
+  fclose(f);
+
+  string[fsize] = 0;
+  *size = fsize;
+
+  return string;
+}
+
+//
+// Build PE32+ image with an Apple signature directory around PayloadSize
+// bytes of section data.
+//
+static uint8_t *buildImage(uint32_t PayloadSize, uint32_t *ImageSize) {
+  uint8_t                     *Image;
+  uint32_t                    SignatureOffset;
+  uint32_t                    Index;
+  EFI_IMAGE_DOS_HEADER        *DosHdr;
+  EFI_IMAGE_NT_HEADERS64      *PeHdr;
+  EFI_IMAGE_SECTION_HEADER    *Sections;
+  APPLE_EFI_CERTIFICATE_INFO  *CertInfo;
+  APPLE_EFI_CERTIFICATE       *Cert;
+
+  PayloadSize    &= ~(TEST_SECTIONS - 1U);
+  SignatureOffset = TEST_HEADERS_SIZE + PayloadSize;
+  *ImageSize      = SignatureOffset + sizeof (*CertInfo) + sizeof (*Cert);
+
+  Image = calloc (1, *ImageSize);
+  if (Image == NULL) {
+    return NULL;
+  }
+
+  DosHdr           = (EFI_IMAGE_DOS_HEADER *) Image;
+  DosHdr->e_magic  = EFI_IMAGE_DOS_SIGNATURE;
+  DosHdr->e_lfanew = 0x80;
+
+  PeHdr = (EFI_IMAGE_NT_HEADERS64 *) (Image + DosHdr->e_lfanew);
+  PeHdr->Signature                           = EFI_IMAGE_NT_SIGNATURE;
+  PeHdr->FileHeader.Machine                  = IMAGE_FILE_MACHINE_X64;
+  PeHdr->FileHeader.NumberOfSections         = TEST_SECTIONS;
+  PeHdr->FileHeader.SizeOfOptionalHeader     = sizeof (PeHdr->OptionalHeader);
+  PeHdr->FileHeader.Characteristics          = EFI_IMAGE_FILE_EXECUTABLE_IMAGE;
+  PeHdr->OptionalHeader.Magic                = EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC;
+  PeHdr->OptionalHeader.SizeOfImage          = SignatureOffset;
+  PeHdr->OptionalHeader.SizeOfHeaders        = TEST_HEADERS_SIZE;
+  PeHdr->OptionalHeader.NumberOfRvaAndSizes  = EFI_IMAGE_NUMBER_OF_DIRECTORY_ENTRIES;
+  PeHdr->OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_SECURITY].VirtualAddress = SignatureOffset;
+  PeHdr->OptionalHeader.DataDirectory[EFI_IMAGE_DIRECTORY_ENTRY_SECURITY].Size           = APPLE_SIGNATURE_SECENTRY_SIZE;
+
+  Sections = (EFI_IMAGE_SECTION_HEADER *) (PeHdr + 1);
+  for (Index = 0; Index < TEST_SECTIONS; ++Index) {
+    Sections[Index].VirtualAddress   = TEST_HEADERS_SIZE + Index * (PayloadSize / TEST_SECTIONS);
+    Sections[Index].PointerToRawData = Sections[Index].VirtualAddress;
+    Sections[Index].SizeOfRawData    = PayloadSize / TEST_SECTIONS;
+    Sections[Index].Misc.VirtualSize = PayloadSize / TEST_SECTIONS;
+  }
+
+  for (Index = TEST_HEADERS_SIZE; Index < SignatureOffset; ++Index) {
+    Image[Index] = (uint8_t) (Index * 2654435761U >> 24);
+  }
+
+  CertInfo             = (APPLE_EFI_CERTIFICATE_INFO *) (Image + SignatureOffset);
+  CertInfo->CertOffset = SignatureOffset + sizeof (*CertInfo);
+  CertInfo->CertSize   = sizeof (*Cert);
+
+  Cert           = (APPLE_EFI_CERTIFICATE *) (CertInfo + 1);
+  Cert->CertSize = sizeof (*Cert);
+  Cert->CertType = APPLE_EFI_CERTIFICATE_TYPE;
+  CopyMem (&Cert->AppleSignatureGuid, &gAppleEfiCertificateGuid, sizeof (EFI_GUID));
+  CopyMem (&Cert->CertData.HashType, &gEfiCertTypeRsa2048Sha256Guid, sizeof (EFI_GUID));
+
+  return Image;
+}
+
+//
+// Read the whole image, then hash it with the separate passes.
+//
+static EFI_STATUS hashLegacy(uint8_t *Disk, uint32_t Size, uint8_t *Image, uint8_t *Hash) {
+  APPLE_PE_COFF_LOADER_IMAGE_CONTEXT  Context;
+  UINTN                               ImageSize;
+  uint32_t                            Offset;
+
+  for (Offset = 0; Offset < Size; Offset += TEST_READ_SIZE) {
+    memcpy (Image + Offset, Disk + Offset, MIN (TEST_READ_SIZE, Size - Offset));
+  }
+
+  ZeroMem (&Context, sizeof (Context));
+  ImageSize = Size;
+  if (EFI_ERROR (BuildPeContext (Image, ImageSize, &Context))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  SanitizeApplePeImage (Image, &ImageSize, &Context);
+  GetApplePeImageSha256 (Image, &Context);
+  memcpy (Hash, Context.PeImageHash, sizeof (Context.PeImageHash));
+  return EFI_SUCCESS;
+}
+
+//
+// Hash every chunk right after it is read.
+//
+static EFI_STATUS hashStream(uint8_t *Disk, uint32_t Size, uint8_t *Image, uint8_t *Hash) {
+  APPLE_PE_IMAGE_STREAM_CONTEXT  Stream;
+  EFI_STATUS                     Status;
+  UINTN                          ImageSize;
+  uint32_t                       Offset;
+  uint32_t                       Chunk;
+
+  Status = ApplePeImageStreamInit (&Stream, Size);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  for (Offset = 0; Offset < Size; Offset += Chunk) {
+    Chunk = MIN (TEST_READ_SIZE, Size - Offset);
+    memcpy (Image + Offset, Disk + Offset, Chunk);
+    ApplePeImageStreamUpdate (&Stream, Image + Offset, Chunk);
+  }
+
+  Status = ApplePeImageStreamFinal (&Stream, &ImageSize);
+  memcpy (Hash, Stream.PeContext.PeImageHash, sizeof (Stream.PeContext.PeImageHash));
+  return Status;
+}
+
+static int benchmark(const char *Name, uint8_t *Disk, uint32_t Size, uint32_t Rounds, int MustVerify) {
+  uint8_t     *Image;
+  uint8_t     LegacyHash[SHA256_DIGEST_SIZE];
+  uint8_t     StreamHash[SHA256_DIGEST_SIZE];
+  EFI_STATUS  Status;
+  uint32_t    r;
+  long long   start;
+  long long   legacyTime;
+  long long   streamTime;
+
+  Image = malloc (Size);
+  if (Image == NULL) {
+    return -1;
+  }
+
+  Status = hashStream (Disk, Size, Image, StreamHash);
+  if (EFI_ERROR (hashLegacy (Disk, Size, Image, LegacyHash))
+    || memcmp (LegacyHash, StreamHash, sizeof (LegacyHash)) != 0
+    || (MustVerify && EFI_ERROR (Status))) {
+    printf ("%s: hash mismatch or verification failure - %llx\n", Name, (unsigned long long) Status);
+    free (Image);
+    return -1;
+  }
+
+  start = current_timestamp ();
+  for (r = 0; r < Rounds; ++r) {
+    hashLegacy (Disk, Size, Image, LegacyHash);
+  }
+  legacyTime = current_timestamp () - start;
+
+  start = current_timestamp ();
+  for (r = 0; r < Rounds; ++r) {
+    hashStream (Disk, Size, Image, StreamHash);
+  }
+  streamTime = current_timestamp () - start;
+
+  if (legacyTime == 0) {
+    legacyTime = 1;
+  }
+
+  if (streamTime == 0) {
+    streamTime = 1;
+  }
+
+  printf ("%s: %u bytes, %u rounds\n", Name, Size, Rounds);
+  printf ("  read then hash: %lld us, %.2f MB/s\n", legacyTime, (double) Size * Rounds / legacyTime);
+  printf ("  streamed:       %lld us, %.2f MB/s\n", streamTime, (double) Size * Rounds / streamTime);
+
+  free (Image);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  uint32_t  rounds = TEST_DEFAULT_ROUNDS;
+  uint32_t  sizeMb = TEST_DEFAULT_SIZE_MB;
+  uint32_t  size;
+  uint8_t   *image;
+  int       i = 1;
+  int       code;
+
+  while (i + 1 < argc && argv[i][0] == '-') {
+    if (strcmp (argv[i], "-r") == 0) {
+      rounds = (uint32_t) strtoul (argv[i + 1], NULL, 0);
+    } else if (strcmp (argv[i], "-s") == 0) {
+      sizeMb = (uint32_t) strtoul (argv[i + 1], NULL, 0);
+    } else {
+      break;
+    }
+    i += 2;
+  }
+
+  if (rounds == 0 || sizeMb == 0 || sizeMb > 1024) {
+    printf ("Usage: %s [-r rounds] [-s size_mb] [image.efi ...]\n", argv[0]);
+    return -1;
+  }
+
+  image = buildImage (sizeMb * 1024 * 1024, &size);
+  if (image == NULL) {
+    return -1;
+  }
+
+  code = benchmark ("synthetic", image, size, rounds, 0);
+  free (image);
+
+  for (; i < argc && code == 0; ++i) {
+    image = readFile (argv[i], &size);
+    if (image == NULL) {
+      printf ("Failed to read %s\n", argv[i]);
+      return -1;
+    }
+
+    code = benchmark (argv[i], image, size, rounds, 1);
+    free (image);
+  }
+
+  return code;
+}
@@ -0,0 +1,192 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+//
+// lodepng is built in its host configuration, see the build commands below.
+//
+#undef EFIAPI
+#include "../../Library/OcPngLib/lodepng.h"
+#define EFIAPI
+#include "../../Library/OcPngLib/OcPng.c"
+
+#include <sys/time.h>
+
+/*
+ clang -O2 -DLODEPNG_NO_COMPILE_ALLOCATORS -c ../../Library/OcPngLib/lodepng.c -o lodepng.o
+ clang -O2 -fshort-wchar -I../Include -I../../Include -I../../../MdePkg/Include/ -include ../Include/Base.h PngDecode.c lodepng.o ../../Library/OcCompressionLib/zlib/zlib_uefi.c ../../Library/OcCompressionLib/zlib/adler32.c ../../Library/OcCompressionLib/zlib/deflate.c ../../Library/OcCompressionLib/zlib/crc32.c ../../Library/OcCompressionLib/zlib/compress.c ../../Library/OcCompressionLib/zlib/infback.c ../../Library/OcCompressionLib/zlib/inffast.c ../../Library/OcCompressionLib/zlib/inflate.c ../../Library/OcCompressionLib/zlib/inftrees.c ../../Library/OcCompressionLib/zlib/trees.c ../../Library/OcCompressionLib/zlib/uncompr.c -o PngDecode
+
+ ./PngDecode [-r rounds] icon1.png icon2.png ...
+
+ rm -rf PngDecode.dSYM PngDecode lodepng.o
+*/
+
+#define TEST_DEFAULT_ROUNDS 200
+
+void *lodepng_malloc(size_t size) {
+  return malloc(size);
+}
+
+void *lodepng_realloc(void *ptr, size_t new_size) {
+  return realloc(ptr, new_size);
+}
+
+void lodepng_free(void *ptr) {
+  free(ptr);
+}
+
+long long current_timestamp() {
+  struct timeval te;
+  gettimeofday(&te, NULL); // get current time
+  long long microseconds = te.tv_sec*1000000LL + te.tv_usec;
+  return microseconds;
+}
+
+uint8_t *readFile(const char *str, uint32_t *size) {
+  FILE *f = fopen(str, "rb");
+
+  if (!f) return NULL;
+
+  fseek(f, 0, SEEK_END);
+  long fsize = ftell(f);
+  fseek(f, 0, SEEK_SET);
+
+  uint8_t *string = malloc(fsize + 1);
+  fread(string, fsize, 1, f);
+  fclose(f);
+
+  string[fsize] = 0;
+  *size = fsize;
+
+  return string;
+}
+
+//
+// Decode with lodepng own inflater, as OcPngLib did before.
+//
+static unsigned decodeLodepng(uint8_t *buffer, uint32_t size, uint8_t **out, unsigned *w, unsigned *h) {
+  LodePNGState State;
+  unsigned     Error;
+
+  lodepng_state_init (&State);
+  Error = lodepng_decode (out, w, h, &State, buffer, size);
+  lodepng_state_cleanup (&State);
+
+  return Error;
+}
+
+int main(int argc, char** argv) {
+  uint32_t   rounds = TEST_DEFAULT_ROUNDS;
+  uint32_t   count;
+  uint8_t    **files;
+  uint32_t   *sizes;
+  uint64_t   total = 0;
+  uint32_t   i, r;
+  int        first = 1;
+  long long  start;
+  long long  lodepngTime;
+  long long  zlibTime;
+
+  if (argc > 2 && strcmp (argv[1], "-r") == 0) {
+    rounds = (uint32_t) strtoul (argv[2], NULL, 0);
+    first  = 3;
+  }
+
+  if (argc <= first || rounds == 0) {
+    printf ("Usage: %s [-r rounds] icon.png ...\n", argv[0]);
+    return -1;
+  }
+
+  count = argc - first;
+  files = calloc (count, sizeof (*files));
+  sizes = calloc (count, sizeof (*sizes));
+
+  //
+  // Load the corpus and check both decoders agree on every image.
+  //
+  for (i = 0; i < count; ++i) {
+    uint8_t   *expected;
+    VOID      *actual;
+    unsigned  w, h;
+    UINT32    Width, Height;
+
+    files[i] = readFile (argv[first + i], &sizes[i]);
+    if (files[i] == NULL) {
+      printf ("Failed to read %s\n", argv[first + i]);
+      return -1;
+    }
+
+    if (decodeLodepng (files[i], sizes[i], &expected, &w, &h) != 0) {
+      printf ("lodepng failed to decode %s\n", argv[first + i]);
+      return -1;
+    }
+
+    if (EFI_ERROR (DecodePng (files[i], sizes[i], &actual, &Width, &Height, NULL))) {
+      printf ("OcPngLib failed to decode %s\n", argv[first + i]);
+      return -1;
+    }
+
+    if (Width != w || Height != h || memcmp (expected, actual, (size_t) w * h * 4) != 0) {
+      printf ("Decoder mismatch in %s\n", argv[first + i]);
+      return -1;
+    }
+
+    total += (uint64_t) w * h * 4;
+
+    lodepng_free (expected);
+    FreePng (actual);
+  }
+
+  start = current_timestamp ();
+  for (r = 0; r < rounds; ++r) {
+    for (i = 0; i < count; ++i) {
+      uint8_t   *out;
+      unsigned  w, h;
+      decodeLodepng (files[i], sizes[i], &out, &w, &h);
+      lodepng_free (out);
+    }
+  }
+  lodepngTime = current_timestamp () - start;
+
+  start = current_timestamp ();
+  for (r = 0; r < rounds; ++r) {
+    for (i = 0; i < count; ++i) {
+      VOID    *out;
+      UINT32  w, h;
+      DecodePng (files[i], sizes[i], &out, &w, &h, NULL);
+      FreePng (out);
+    }
+  }
+  zlibTime = current_timestamp () - start;
+
+  if (lodepngTime == 0) {
+    lodepngTime = 1;
+  }
+
+  if (zlibTime == 0) {
+    zlibTime = 1;
+  }
+
+  printf ("%u images, %u rounds, %llu bytes decoded per round\n", count, rounds, (unsigned long long) total);
+  printf ("lodepng inflate: %lld us, %.2f MB/s\n", lodepngTime, (double) total * rounds / lodepngTime);
+  printf ("zlib inflate:    %lld us, %.2f MB/s\n", zlibTime, (double) total * rounds / zlibTime);
+
+  for (i = 0; i < count; ++i) {
+    free (files[i]);
+  }
+
+  free (files);
+  free (sizes);
+
+  return 0;
+}
@@ -16,6 +16,7 @@
 #include <Library/OcSerializeLib.h>
 #include <Library/OcMiscLib.h>
 #include <Library/OcAppleKernelLib.h>
+#include <Library/OcFileLib.h>
 
 #include <sys/time.h>
 
@@ -427,14 +428,36 @@ UINT8  *Prelinked;
 UINT32 PrelinkedSize;
 
 EFI_STATUS
-GetFileData (
+OcFileReaderInit (
+  OUT OC_FILE_READER     *Reader,
   IN  EFI_FILE_PROTOCOL  *File,
-  IN  UINT32             Position,
-  IN  UINT32             Size,
-  OUT UINT8              *Buffer
+  IN  UINT32             WindowSize,
+  IN  UINT32             BlockSize
   )
 {
   ASSERT (File == &nilFilProtocol);
+  ZeroMem (Reader, sizeof (*Reader));
+  Reader->File = File;
+  return EFI_SUCCESS;
+}
+
+VOID
+OcFileReaderFree (
+  IN OUT OC_FILE_READER  *Reader
+  )
+{
+  ASSERT (Reader->File == &nilFilProtocol);
+}
+
+EFI_STATUS
+OcFileReaderRead (
+  IN OUT OC_FILE_READER  *Reader,
+  IN     UINT32          Position,
+  IN     UINT32          Size,
+     OUT UINT8           *Buffer
+  )
+{
+  ASSERT (Reader->File == &nilFilProtocol);
 
   if ((UINT64) Position + Size > PrelinkedSize) {
     return EFI_INVALID_PARAMETER;
@@ -445,12 +468,12 @@ GetFileData (
 }
 
 EFI_STATUS
-GetFileSize (
-  IN  EFI_FILE_PROTOCOL  *File,
-  OUT UINT32             *Size
+OcFileReaderGetSize (
+  IN OUT OC_FILE_READER  *Reader,
+     OUT UINT32          *Size
   )
 {
-  ASSERT (File == &nilFilProtocol);
+  ASSERT (Reader->File == &nilFilProtocol);
   *Size = PrelinkedSize;
   return EFI_SUCCESS;
 }
@@ -53,6 +53,8 @@ EFI_GUID gEfiPciRootBridgeIoProtocolGuid;
 EFI_GUID gEfiSmbios3TableGuid;
 EFI_GUID gEfiSmbiosTableGuid;
 EFI_GUID gOcCustomSmbiosTableGuid;
+EFI_GUID gOcCpuInfoTableGuid;
+EFI_GUID gOcVendorVariableGuid;
 
 STATIC GUID SystemUUID = {0x5BC82C38, 0x4DB6, 0x4883, {0x85, 0x2E, 0xE7, 0x8D, 0x78, 0x0A, 0x6F, 0xE6}};
 STATIC UINT8 BoardType = 0xA; // Motherboard (BaseBoardTypeMotherBoard)
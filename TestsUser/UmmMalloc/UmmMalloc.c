@@ -0,0 +1,243 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/OcMemoryLib.h>
+
+#include <sys/time.h>
+
+/*
+ clang -g -O2 -fsanitize=undefined,address -fshort-wchar -I../Include -I../../Include -I../../../EfiPkg/Include/ -I../../../MdePkg/Include/ -I../../../UefiCpuPkg/Include/ -include ../Include/Base.h UmmMalloc.c ../../Library/OcMemoryLib/UmmMalloc.c -o UmmMalloc
+
+ rm -rf UmmMalloc.dSYM UmmMalloc
+
+ To compare against another allocator revision build it in place of
+ ../../Library/OcMemoryLib/UmmMalloc.c, e.g. from git show.
+*/
+
+#define TEST_HEAP_SIZE    (32 * BASE_1MB)
+#define TEST_SLOTS        8192
+#define TEST_OPERATIONS   2000000
+
+typedef struct {
+  UINT8   *Ptr;
+  UINT32  Size;
+  UINT8   Pattern;
+} TEST_SLOT;
+
+STATIC TEST_SLOT  mSlots[TEST_SLOTS];
+STATIC UINT8      *mHeap;
+STATIC UINT64     mLiveBytes;
+
+STATIC
+UINT64
+Now (
+  VOID
+  )
+{
+  struct timeval  Time;
+
+  gettimeofday (&Time, NULL);
+  return (UINT64) Time.tv_sec * 1000000ULL + Time.tv_usec;
+}
+
+/**
+  Pick allocation size resembling runtime allocations after ExitBootServices:
+  mostly small nodes with occasional medium buffers and rare large ones.
+**/
+STATIC
+UINT32
+RandomSize (
+  VOID
+  )
+{
+  UINT32  Kind;
+
+  Kind = rand () % 100;
+  if (Kind < 70) {
+    return 1 + rand () % 256;
+  }
+
+  if (Kind < 99) {
+    return 256 + rand () % (8 * BASE_1KB);
+  }
+
+  return 8 * BASE_1KB + rand () % (256 * BASE_1KB);
+}
+
+STATIC
+UINTN
+FreeSlot (
+  IN OUT TEST_SLOT  *Slot
+  )
+{
+  UINT32  Index;
+  UINTN   Failures;
+
+  Failures = 0;
+
+  //
+  // A corrupted pattern means that some other allocation overlapped ours.
+  //
+  for (Index = 0; Index < Slot->Size; Index += 61) {
+    if (Slot->Ptr[Index] != Slot->Pattern) {
+      ++Failures;
+      break;
+    }
+  }
+
+  if (!UmmFree (Slot->Ptr)) {
+    ++Failures;
+  }
+
+  mLiveBytes -= Slot->Size;
+  Slot->Ptr   = NULL;
+
+  return Failures;
+}
+
+STATIC
+UINTN
+AllocateSlot (
+  IN OUT TEST_SLOT  *Slot,
+  IN     UINT32     Size,
+  IN OUT UINTN      *OutOfMemory
+  )
+{
+  Slot->Ptr = UmmMalloc (Size);
+  if (Slot->Ptr == NULL) {
+    ++*OutOfMemory;
+    return 0;
+  }
+
+  if (Slot->Ptr < mHeap || Slot->Ptr + Size > mHeap + TEST_HEAP_SIZE) {
+    Slot->Ptr = NULL;
+    return 1;
+  }
+
+  Slot->Size    = Size;
+  Slot->Pattern = (UINT8) rand ();
+  SetMem (Slot->Ptr, Size, Slot->Pattern);
+  mLiveBytes   += Size;
+
+  return 0;
+}
+
+/**
+  Find the largest allocation, which currently succeeds.
+**/
+STATIC
+UINT32
+LargestAllocation (
+  VOID
+  )
+{
+  UINT32  Low;
+  UINT32  High;
+  UINT32  Middle;
+  VOID    *Ptr;
+
+  Low  = 0;
+  High = TEST_HEAP_SIZE;
+  while (Low < High) {
+    Middle = Low + (High - Low + 1) / 2;
+    Ptr    = UmmMalloc (Middle);
+    if (Ptr != NULL) {
+      UmmFree (Ptr);
+      Low = Middle;
+    } else {
+      High = Middle - 1;
+    }
+  }
+
+  return Low;
+}
+
+int main (int argc, char** argv) {
+  UINTN   Failures;
+  UINTN   OutOfMemory;
+  UINTN   Index;
+  UINTN   Operation;
+  UINT64  Start;
+  UINT64  Elapsed;
+  UINT32  Largest;
+
+  srand (argc > 1 ? atoi (argv[1]) : 1);
+
+  mHeap = malloc (TEST_HEAP_SIZE);
+  if (mHeap == NULL) {
+    abort ();
+  }
+
+  UmmSetHeap (mHeap, TEST_HEAP_SIZE);
+
+  Failures    = 0;
+  OutOfMemory = 0;
+
+  //
+  // Random trace with allocations slightly more likely than frees,
+  // which keeps the heap under pressure once the slots are filled.
+  //
+  Start = Now ();
+  for (Operation = 0; Operation < TEST_OPERATIONS; ++Operation) {
+    Index = rand () % TEST_SLOTS;
+    if (mSlots[Index].Ptr != NULL) {
+      Failures += FreeSlot (&mSlots[Index]);
+    } else {
+      Failures += AllocateSlot (&mSlots[Index], RandomSize (), &OutOfMemory);
+    }
+  }
+  Elapsed = Now () - Start;
+
+  //
+  // Fragmentation is the share of free memory, which cannot be used
+  // by a single allocation.
+  //
+  Largest = LargestAllocation ();
+
+  printf (
+    "%u ops in %llu us (%llu ops/ms), %u OOM, %llu KB live, largest free %u KB, fragmentation %u%%\n",
+    TEST_OPERATIONS,
+    (unsigned long long) Elapsed,
+    (unsigned long long) (TEST_OPERATIONS * 1000ULL / (Elapsed + 1)),
+    (UINT32) OutOfMemory,
+    (unsigned long long) (mLiveBytes / BASE_1KB),
+    Largest / BASE_1KB,
+    (UINT32) (100 - Largest * 100ULL / (TEST_HEAP_SIZE - mLiveBytes))
+    );
+
+  for (Index = 0; Index < TEST_SLOTS; ++Index) {
+    if (mSlots[Index].Ptr != NULL) {
+      Failures += FreeSlot (&mSlots[Index]);
+    }
+  }
+
+  //
+  // With everything freed the heap must coalesce back to a single block.
+  //
+  Largest = LargestAllocation ();
+  if (Largest + BASE_1KB < TEST_HEAP_SIZE) {
+    printf ("Heap did not coalesce, largest free %u bytes\n", Largest);
+    ++Failures;
+  }
+
+  if (UmmFree (mHeap - 1) || UmmFree (NULL)) {
+    ++Failures;
+  }
+
+  free (mHeap);
+
+  printf ("%u failures\n", (UINT32) Failures);
+
+  return Failures != 0;
+}
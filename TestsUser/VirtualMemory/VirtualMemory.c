@@ -0,0 +1,264 @@
+/** @file
+  Copyright (C) 2019, vit9696. All rights reserved.
+
+  All rights reserved.
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+**/
+
+#include <Library/OcMemoryLib.h>
+
+#include <sys/time.h>
+
+/*
+ clang -g -fsanitize=undefined,address -fshort-wchar -I../Include -I../../Include -I../../../EfiPkg/Include/ -I../../../MdePkg/Include/ -I../../../UefiCpuPkg/Include/ -include ../Include/Base.h VirtualMemory.c ../../Library/OcMemoryLib/VirtualMemory.c -o VirtualMemory
+
+ rm -rf VirtualMemory.dSYM VirtualMemory
+*/
+
+#define TEST_POOL_PAGES   32768
+#define TEST_RANGES       40
+#define TEST_PROBES       2000
+
+typedef struct {
+  EFI_VIRTUAL_ADDRESS   VirtualAddr;
+  EFI_PHYSICAL_ADDRESS  PhysicalAddr;
+  UINT64                NumPages;
+} TEST_RANGE;
+
+UINTN
+AsmReadCr3 (
+  VOID
+  )
+{
+  //
+  // Tests always pass an explicit synthetic page table.
+  //
+  abort ();
+}
+
+UINTN
+AsmWriteCr3 (
+  UINTN  Cr3
+  )
+{
+  return Cr3;
+}
+
+EFI_STATUS
+AllocatePagesFromTop (
+  IN     EFI_MEMORY_TYPE         MemoryType,
+  IN     UINTN                   Pages,
+  IN OUT EFI_PHYSICAL_ADDRESS    *Memory,
+  IN     EFI_GET_MEMORY_MAP      GetMemoryMap  OPTIONAL,
+  IN     CHECK_ALLOCATION_RANGE  CheckRange    OPTIONAL
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+STATIC
+UINT64
+RandomAddress (
+  VOID
+  )
+{
+  return (((UINT64) rand () << 32U) ^ ((UINT64) rand () << 12U)) & 0xFFFFFFF000ULL;
+}
+
+STATIC
+UINT64
+Now (
+  VOID
+  )
+{
+  struct timeval  Time;
+
+  gettimeofday (&Time, NULL);
+  return (UINT64) Time.tv_sec * 1000000ULL + Time.tv_usec;
+}
+
+STATIC
+UINTN
+VerifyRanges (
+  IN PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable,
+  IN TEST_RANGE                      *Ranges,
+  IN UINTN                           NumRanges
+  )
+{
+  EFI_STATUS            Status;
+  EFI_PHYSICAL_ADDRESS  PhysicalAddr;
+  UINT64                Offset;
+  UINTN                 Index;
+  UINTN                 Probe;
+  UINTN                 Failures;
+
+  Failures = 0;
+
+  for (Index = 0; Index < NumRanges; ++Index) {
+    for (Probe = 0; Probe < TEST_PROBES; ++Probe) {
+      if (Probe == 0) {
+        Offset = 0;
+      } else if (Probe == 1) {
+        Offset = EFI_PAGES_TO_SIZE (Ranges[Index].NumPages) - 1;
+      } else {
+        Offset = ((UINT64) rand () * rand ()) % EFI_PAGES_TO_SIZE (Ranges[Index].NumPages);
+      }
+
+      Status = GetPhysicalAddress (PageTable, Ranges[Index].VirtualAddr + Offset, &PhysicalAddr);
+      if (EFI_ERROR (Status) || PhysicalAddr != Ranges[Index].PhysicalAddr + Offset) {
+        if (Failures < 8) {
+          printf (
+            "Range %u offset %llx maps to %llx instead of %llx\n",
+            (UINT32) Index,
+            (unsigned long long) Offset,
+            (unsigned long long) PhysicalAddr,
+            (unsigned long long) (Ranges[Index].PhysicalAddr + Offset)
+            );
+        }
+        ++Failures;
+      }
+    }
+  }
+
+  return Failures;
+}
+
+STATIC
+UINTN
+TestMapping (
+  IN BOOLEAN  Aligned
+  )
+{
+  EFI_STATUS                      Status;
+  OC_VMEM_CONTEXT                 Context;
+  PAGE_MAP_AND_DIRECTORY_POINTER  *PageTable;
+  UINT8                           *Pool;
+  TEST_RANGE                      Ranges[TEST_RANGES + 1];
+  EFI_VIRTUAL_ADDRESS             VirtualAddr;
+  UINTN                           Index;
+  UINTN                           Failures;
+  UINT64                          Start;
+
+  Pool      = aligned_alloc (EFI_PAGE_SIZE, EFI_PAGES_TO_SIZE (TEST_POOL_PAGES));
+  PageTable = aligned_alloc (EFI_PAGE_SIZE, EFI_PAGE_SIZE);
+  if (Pool == NULL || PageTable == NULL) {
+    abort ();
+  }
+
+  ZeroMem (PageTable, EFI_PAGE_SIZE);
+  Context.MemoryPool = Pool;
+  Context.FreePages  = TEST_POOL_PAGES;
+
+  //
+  // Mimic XNU runtime mapping region with a mix of small runtime images,
+  // medium MMIO and huge reserved ranges at different alignments.
+  //
+  VirtualAddr = 0xFFFFFF8000000000ULL;
+  for (Index = 0; Index < TEST_RANGES; ++Index) {
+    switch (Index == TEST_RANGES - 1 ? 3 : rand () % 4) {
+      case 0:
+        Ranges[Index].NumPages = 1 + rand () % 64;
+        break;
+      case 1:
+        Ranges[Index].NumPages = EFI_SIZE_TO_PAGES (BASE_2MB) * (1 + rand () % 4) + rand () % 600;
+        break;
+      case 2:
+        Ranges[Index].NumPages = EFI_SIZE_TO_PAGES (BASE_1GB) + rand () % 2000;
+        break;
+      default:
+        Ranges[Index].NumPages = EFI_SIZE_TO_PAGES (BASE_1GB) * 2 + EFI_SIZE_TO_PAGES (BASE_2MB) * 3 + 7;
+        break;
+    }
+
+    if (rand () % 2 == 0) {
+      VirtualAddr = ALIGN_VALUE (VirtualAddr, BASE_1GB);
+    } else if (rand () % 2 == 0) {
+      VirtualAddr = ALIGN_VALUE (VirtualAddr, BASE_2MB);
+    }
+
+    Ranges[Index].VirtualAddr  = VirtualAddr;
+    Ranges[Index].PhysicalAddr = RandomAddress ();
+    if (Aligned) {
+      Ranges[Index].PhysicalAddr = (Ranges[Index].PhysicalAddr & ~(BASE_1GB - 1))
+        | (VirtualAddr & (BASE_1GB - 1));
+    }
+
+    VirtualAddr += EFI_PAGES_TO_SIZE (Ranges[Index].NumPages + rand () % 3);
+  }
+
+  Start = Now ();
+  for (Index = 0; Index < TEST_RANGES; ++Index) {
+    Status = VmMapVirtualPages (
+      &Context,
+      PageTable,
+      Ranges[Index].VirtualAddr,
+      Ranges[Index].NumPages,
+      Ranges[Index].PhysicalAddr
+      );
+    if (EFI_ERROR (Status)) {
+      printf ("Failed to map range %u - %u pages left in pool\n", (UINT32) Index, (UINT32) Context.FreePages);
+      free (PageTable);
+      free (Pool);
+      return 1;
+    }
+  }
+
+  printf (
+    "%s mapping took %llu us and %u page table pages\n",
+    Aligned ? "Aligned" : "Unaligned",
+    (unsigned long long) (Now () - Start),
+    (UINT32) (TEST_POOL_PAGES - Context.FreePages)
+    );
+
+  Failures = VerifyRanges (PageTable, Ranges, TEST_RANGES);
+
+  //
+  // Remap a single 4K page in the middle of the largest range, which must
+  // split the large pages without affecting their neighbours.
+  //
+  Ranges[TEST_RANGES].VirtualAddr  = Ranges[TEST_RANGES - 1].VirtualAddr + BASE_1GB + BASE_2MB + BASE_4KB * 3;
+  Ranges[TEST_RANGES].PhysicalAddr = RandomAddress ();
+  Ranges[TEST_RANGES].NumPages     = 1;
+
+  Status = VmMapVirtualPage (
+    &Context,
+    PageTable,
+    Ranges[TEST_RANGES].VirtualAddr,
+    Ranges[TEST_RANGES].PhysicalAddr
+    );
+  if (EFI_ERROR (Status)) {
+    printf ("Failed to remap a single page\n");
+    free (PageTable);
+    free (Pool);
+    return Failures + 1;
+  }
+
+  Failures += VerifyRanges (PageTable, &Ranges[TEST_RANGES], 1);
+  Ranges[TEST_RANGES - 1].NumPages = EFI_SIZE_TO_PAGES (BASE_1GB + BASE_2MB) + 3;
+  Failures += VerifyRanges (PageTable, &Ranges[TEST_RANGES - 1], 1);
+
+  free (PageTable);
+  free (Pool);
+
+  return Failures;
+}
+
+int main (int argc, char** argv) {
+  UINTN  Failures;
+
+  srand (argc > 1 ? atoi (argv[1]) : 1);
+
+  Failures  = TestMapping (TRUE);
+  Failures += TestMapping (FALSE);
+
+  printf ("%u failures\n", (UINT32) Failures);
+
+  return Failures != 0;
+}